@@ -1,11 +1,12 @@
 workspace "Advanced technics"
    configurations { "Debug", "Release" }
    language "C++"
+   cppdialect "C++17"
    architecture "x64"
-   systemversion "latest"
-   toolset "v142"
    optimize "Speed"
-   links { "d3d12", "dxgi", "d3dcompiler" }
+   filter("system:windows")
+      systemversion "latest"
+      toolset "v142"
    filter("configurations:Debug")
       defines({ "DEBUG" })
       symbols("On")
@@ -16,18 +17,36 @@ workspace "Advanced technics"
       symbols("On")
       targetdir ("bin/release")
 
+   -- The renderer needs Direct3D 12, the loader benchmark also builds elsewhere
+   if os.istarget("windows") then
    project "DX12 window"
       kind "WindowedApp"
       entrypoint "WinMainCRTStartup"
+      links { "d3d12", "dxgi", "d3dcompiler" }
       includedirs { "src" }
       includedirs { "libs/D3DX12" }
       includedirs { "libs/tinyobjloader" }
       includedirs { "libs/stb" }
-      files { "src/dx12_labs.h" }
+      files { "src/dx12_labs.h", "src/platform.h", "src/vertex_formats.h" }
       files { "src/renderer.h", "src/renderer.cpp"}
       files { "libs/tinyobjloader/tiny_obj_loader.h"}
       files { "libs/stb/stb_image.h" }
       files { "src/model_loader.h", "src/model_loader.cpp"}
+      files { "src/vertex_index_map.h", "src/vertex_index_map.cpp"}
+      files { "src/vertex_conversion.h", "src/vertex_conversion.cpp"}
+      files { "src/obj_parser.h", "src/obj_parser.cpp"}
+      files { "src/normal_generator.h", "src/normal_generator.cpp"}
+      files { "src/float_parser.h", "src/float_parser.cpp"}
+      files { "src/mapped_file.h", "src/mapped_file.cpp"}
+      files { "src/external_sort.h", "src/external_sort.cpp"}
+      files { "src/mesh_cache.h", "src/mesh_cache.cpp"}
+      files { "src/mesh_codec.h", "src/mesh_codec.cpp"}
+      files { "src/mesh_optimizer.h", "src/mesh_optimizer.cpp"}
+      files { "src/meshlet_builder.h", "src/meshlet_builder.cpp"}
+      files { "src/vertex_packing.h", "src/vertex_packing.cpp"}
+      files { "src/tangent_generator.h", "src/tangent_generator.cpp"}
+      files { "src/frustum_culling.h", "src/frustum_culling.cpp"}
+      files { "src/parallel_for.h" }
       files { "src/win32_window.h", "src/win32_window.cpp"}
       files { "src/win32_window_main.cpp" }
       postbuildcommands {
@@ -36,4 +55,34 @@ workspace "Advanced technics"
          "{COPY} models/**.mtl \"%{cfg.buildtarget.directory}\"",
          "{COPY} models/**.jpg \"%{cfg.buildtarget.directory}\"",
          "{COPY} models/**.png \"%{cfg.buildtarget.directory}\""
-       }
\ No newline at end of file
+       }
+   end
+
+   project "Loader benchmark"
+      kind "ConsoleApp"
+      includedirs { "src" }
+      includedirs { "libs/tinyobjloader" }
+      files { "src/platform.h", "src/vertex_formats.h" }
+      files { "libs/tinyobjloader/tiny_obj_loader.h"}
+      files { "src/model_loader.h", "src/model_loader.cpp"}
+      files { "src/vertex_index_map.h", "src/vertex_index_map.cpp"}
+      files { "src/vertex_conversion.h", "src/vertex_conversion.cpp"}
+      files { "src/obj_parser.h", "src/obj_parser.cpp"}
+      files { "src/normal_generator.h", "src/normal_generator.cpp"}
+      files { "src/float_parser.h", "src/float_parser.cpp"}
+      files { "src/mapped_file.h", "src/mapped_file.cpp"}
+      files { "src/external_sort.h", "src/external_sort.cpp"}
+      files { "src/mesh_cache.h", "src/mesh_cache.cpp"}
+      files { "src/mesh_codec.h", "src/mesh_codec.cpp"}
+      files { "src/mesh_optimizer.h", "src/mesh_optimizer.cpp"}
+      files { "src/meshlet_builder.h", "src/meshlet_builder.cpp"}
+      files { "src/vertex_packing.h", "src/vertex_packing.cpp"}
+      files { "src/tangent_generator.h", "src/tangent_generator.cpp"}
+      files { "src/frustum_culling.h", "src/frustum_culling.cpp"}
+      files { "src/parallel_for.h" }
+      files { "src/obj_generator.h", "src/obj_generator.cpp"}
+      files { "src/loader_benchmark.cpp" }
+      filter("system:windows")
+         links { "psapi" }
+      filter("system:not windows")
+         links { "pthread" }
@@ -1,8 +1,22 @@
 cbuffer ConstantBuffer : register(b0) {
 	float4x4 mwpMatrix;
 	float4 light;
+	// Dequantization of PackedVertex positions
+	float4 positionOffset;
+	float4 positionScale;
 }
 
+// Root constant set per draw call
+cbuffer DrawConstants : register(b1) {
+	uint materialId;
+}
+
+struct MaterialConstants {
+	float4 diffuse;
+};
+
+StructuredBuffer<MaterialConstants> g_materials : register(t1);
+
 Texture2D g_texture : register(t0);
 SamplerState g_sampler : register(s0);
 
@@ -13,17 +27,48 @@ struct PSInput {
 	float2 uv : TEXCOORD;
 };
 
-PSInput VSMain(float4 position : POSITION, float4 diffuseColor : DIFFUSE, float4 normal : NORMAL, float4 texcoord : TEXCOORD) {
+PSInput VSMain(float4 position : POSITION, float4 normal : NORMAL, float4 texcoord : TEXCOORD) {
 	PSInput result;
 
-	result.position = mul(mwpMatrix, position);
-	result.color = diffuseColor;
+	// precise keeps the depth bit exact with the depth pre-pass
+	precise float4 clipPosition = mul(mwpMatrix, position);
+	result.position = clipPosition;
+	result.color = g_materials[materialId].diffuse;
 	result.intensity = dot(normal, normalize(light - position.xyz)); //clamp(3.0f - length(position - light) / 3.0f, 0.0f, 1.0f);
 	result.uv = texcoord.xy;
 
 	return result;
 }
 
+float3 DecodeOctahedral(float2 encoded) {
+	float3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	float fold = saturate(-normal.z);
+	normal.xy += (normal.xy >= 0.0f) ? -fold : fold;
+	return normalize(normal);
+}
+
+float4 DecodePosition(float4 position) {
+	precise float3 decoded = positionOffset.xyz + positionScale.xyz * position.xyz;
+	return float4(decoded, 1.0f);
+}
+
+// Input layout of PackedVertex: unorm16 position, snorm16 octahedral normal, half texcoord
+PSInput VSMain_packed(float4 position : POSITION, float2 normal : NORMAL, float2 texcoord : TEXCOORD) {
+	float4 decodedPosition = DecodePosition(position);
+	float4 decodedNormal = float4(DecodeOctahedral(normal), 0.0f);
+	return VSMain(decodedPosition, decodedNormal, float4(texcoord, 0.0f, 0.0f));
+}
+
+// Depth pre-pass over the position only stream
+float4 VSMain_depth(float4 position : POSITION) : SV_POSITION {
+	precise float4 clipPosition = mul(mwpMatrix, position);
+	return clipPosition;
+}
+
+float4 VSMain_depth_packed(float4 position : POSITION) : SV_POSITION {
+	return VSMain_depth(DecodePosition(position));
+}
+
 float4 PSMain_texture(PSInput input) : SV_TARGET {
 	return clamp(g_texture.Sample(g_sampler, input.uv) * input.intensity, 0.0f, 1.0f);
 }
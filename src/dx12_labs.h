@@ -1,10 +1,7 @@
 #pragma once
 
-#ifndef UNICODE
-#define UNICODE
-#endif
-
-#include <Windows.h>
+#include "platform.h"
+#include "vertex_formats.h"
 
 #include <wrl.h>
 
@@ -18,6 +15,7 @@
 
 #include <iostream>
 #include <chrono>
+#include <cstdint>
 
 #include <exception>
 
@@ -57,10 +55,3 @@ struct ColorVertex {
 	XMFLOAT3 position;
 	XMFLOAT4 color;
 };
-
-struct FullVertex {
-	XMFLOAT3 position;
-	XMFLOAT3 diffuseColor;
-	XMFLOAT3 normal;
-	XMFLOAT2 texcoord;
-};
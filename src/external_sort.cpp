@@ -0,0 +1,49 @@
+#include "external_sort.h"
+
+#include <cstdio>
+
+SpillFile::~SpillFile() {
+	Remove();
+}
+
+bool SpillFile::Create(const std::string &file_path) {
+	Remove();
+	path = file_path;
+	stream.open(path, std::ios::binary | std::ios::trunc);
+	return stream.is_open();
+}
+
+bool SpillFile::Append(const void *data, size_t size_to_append) {
+	if (size_to_append == 0) {
+		return true;
+	}
+	stream.write(static_cast<const char *>(data), static_cast<std::streamsize>(size_to_append));
+	size += size_to_append;
+	return static_cast<bool>(stream);
+}
+
+bool SpillFile::Map() {
+	if (path.empty()) {
+		return size == 0;
+	}
+
+	stream.close();
+	if (stream.fail()) {
+		return false;
+	}
+	// Empty files are not mapped, GetArray returns nullptr then
+	return file.Open(path) && file.GetSize() == size;
+}
+
+void SpillFile::Remove() {
+	// The mapping has to go first, mapped files cannot be removed on Windows
+	file.Close();
+	if (stream.is_open()) {
+		stream.close();
+	}
+	if (!path.empty()) {
+		remove(path.c_str());
+		path.clear();
+	}
+	size = 0;
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Temporary file which is written front to back and then mapped for reading.
+// The file is removed with the object.
+class SpillFile {
+public:
+	SpillFile() = default;
+	~SpillFile();
+
+	SpillFile(const SpillFile &) = delete;
+	SpillFile &operator=(const SpillFile &) = delete;
+
+	bool Create(const std::string &file_path);
+	bool Append(const void *data, size_t size);
+
+	template <typename T>
+	bool AppendArray(const std::vector<T> &array) {
+		return Append(array.data(), array.size() * sizeof(T));
+	}
+
+	// Ends writing, Create may not have been called if nothing was appended
+	bool Map();
+	void Remove();
+
+	uint64_t GetSize() const { return size; }
+
+	// Valid after Map
+	template <typename T>
+	const T *GetArray() const {
+		return reinterpret_cast<const T *>(file.GetData());
+	}
+
+protected:
+	std::string path;
+	std::ofstream stream;
+	MappedFile file;
+	uint64_t size = 0;
+};
+
+// Sorts more records than fit in memory. Records are collected in a buffer of up
+// to memory_budget bytes and a full buffer is sorted in slices on thread_number
+// workers (all hardware threads when 0),
+// every slice becoming one sorted run of the run file. Finish sorts what is left
+// in the buffer the same way and maps the run file, then Pop merges the runs
+// through a heap. Records are copied as bytes, so T has to be trivially copyable.
+template <typename T, typename Less = std::less<T>>
+class ExternalSorter {
+public:
+	ExternalSorter(const std::string &run_path, size_t memory_budget, unsigned int thread_number = 0, Less less = Less())
+		: run_path(run_path), capacity(std::max<size_t>(memory_budget / sizeof(T), 1)),
+		thread_number(thread_number ? thread_number : GetWorkerNumber()), less(less) {}
+
+	ExternalSorter(const ExternalSorter &) = delete;
+	ExternalSorter &operator=(const ExternalSorter &) = delete;
+
+	bool Push(const T &record) {
+		if (buffer.size() == capacity && !SpillBuffer()) {
+			return false;
+		}
+		// Growing the buffer would briefly hold it twice, so it takes the whole budget at once
+		if (buffer.capacity() < capacity) {
+			buffer.reserve(capacity);
+		}
+		buffer.push_back(record);
+		record_number++;
+		return true;
+	}
+
+	bool Finish() {
+		SortSlices();
+		if (!run_file.Map()) {
+			return false;
+		}
+
+		const T *file_records = run_file.GetArray<T>();
+		for (const FileRun &file_run : file_runs) {
+			runs.push_back({file_records + file_run.start, file_records + file_run.start + file_run.number});
+		}
+		for (size_t slice = 0; slice + 1 < buffer_slices.size(); slice++) {
+			runs.push_back({buffer.data() + buffer_slices[slice], buffer.data() + buffer_slices[slice + 1]});
+		}
+
+		for (size_t run = 0; run < runs.size(); run++) {
+			if (runs[run].next != runs[run].end) {
+				heap.push_back(run);
+			}
+		}
+		std::make_heap(heap.begin(), heap.end(), HeapLess{this});
+		return true;
+	}
+
+	// Hands out the records in order, false once all of them are out
+	bool Pop(T &record) {
+		if (heap.empty()) {
+			return false;
+		}
+
+		std::pop_heap(heap.begin(), heap.end(), HeapLess{this});
+		Run &run = runs[heap.back()];
+		record = *run.next++;
+		if (run.next != run.end) {
+			std::push_heap(heap.begin(), heap.end(), HeapLess{this});
+		} else {
+			heap.pop_back();
+		}
+		return true;
+	}
+
+	uint64_t GetSize() const { return record_number; }
+	size_t GetRunNumber() const { return runs.size(); }
+
+protected:
+	struct FileRun {
+		uint64_t start;
+		uint64_t number;
+	};
+
+	struct Run {
+		const T *next;
+		const T *end;
+	};
+
+	// std heaps keep the largest element on top
+	struct HeapLess {
+		const ExternalSorter *sorter;
+		bool operator()(size_t a, size_t b) const {
+			return sorter->less(*sorter->runs[b].next, *sorter->runs[a].next);
+		}
+	};
+
+	// Slices smaller than this are not worth a worker
+	static constexpr size_t min_slice_size = 1 << 16;
+
+	std::string run_path;
+	size_t capacity;
+	unsigned int thread_number;
+	Less less;
+	uint64_t record_number = 0;
+
+	std::vector<T> buffer;
+	std::vector<size_t> buffer_slices;
+	SpillFile run_file;
+	uint64_t run_file_records = 0;
+	std::vector<FileRun> file_runs;
+
+	std::vector<Run> runs;
+	std::vector<size_t> heap;
+
+	void SortSlices() {
+		const size_t slice_number = std::max<size_t>(1, std::min<size_t>(thread_number, buffer.size() / min_slice_size));
+		buffer_slices.resize(slice_number + 1);
+		for (size_t slice = 0; slice <= slice_number; slice++) {
+			buffer_slices[slice] = buffer.size() * slice / slice_number;
+		}
+		ParallelFor(slice_number, [&](size_t slice) {
+			std::sort(buffer.begin() + buffer_slices[slice], buffer.begin() + buffer_slices[slice + 1], less);
+		}, thread_number);
+	}
+
+	bool SpillBuffer() {
+		if (file_runs.empty() && !run_file.Create(run_path)) {
+			return false;
+		}
+
+		SortSlices();
+		for (size_t slice = 0; slice + 1 < buffer_slices.size(); slice++) {
+			const size_t slice_size = buffer_slices[slice + 1] - buffer_slices[slice];
+			file_runs.push_back({run_file_records, slice_size});
+			run_file_records += slice_size;
+		}
+		if (!run_file.Append(buffer.data(), buffer.size() * sizeof(T))) {
+			return false;
+		}
+		buffer.clear();
+		return true;
+	}
+};
@@ -0,0 +1,327 @@
+#include "float_parser.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Binary32 parameters of the Eisel-Lemire algorithm
+static const int mantissa_explicit_bits = 23;
+static const int minimum_exponent = -127;
+static const int infinite_power = 0xFF;
+static const int min_exponent_round_to_even = -17;
+static const int max_exponent_round_to_even = 10;
+static const int smallest_power_of_ten = -65;
+static const int largest_power_of_ten = 38;
+static const uint64_t max_fast_path_mantissa = uint64_t(2) << mantissa_explicit_bits;
+static const int max_significant_digits = 19;
+
+// 128 bit truncated powers of five from 5^-65 to 5^38, high word first
+static const uint64_t power_of_five_128[] = {
+	0x86CCBB52EA94BAEAull, 0x98E947129FC2B4E9ull, // 5^-65
+	0xA87FEA27A539E9A5ull, 0x3F2398D747B36224ull, // 5^-64
+	0xD29FE4B18E88640Eull, 0x8EEC7F0D19A03AADull, // 5^-63
+	0x83A3EEEEF9153E89ull, 0x1953CF68300424ACull, // 5^-62
+	0xA48CEAAAB75A8E2Bull, 0x5FA8C3423C052DD7ull, // 5^-61
+	0xCDB02555653131B6ull, 0x3792F412CB06794Dull, // 5^-60
+	0x808E17555F3EBF11ull, 0xE2BBD88BBEE40BD0ull, // 5^-59
+	0xA0B19D2AB70E6ED6ull, 0x5B6ACEAEAE9D0EC4ull, // 5^-58
+	0xC8DE047564D20A8Bull, 0xF245825A5A445275ull, // 5^-57
+	0xFB158592BE068D2Eull, 0xEED6E2F0F0D56712ull, // 5^-56
+	0x9CED737BB6C4183Dull, 0x55464DD69685606Bull, // 5^-55
+	0xC428D05AA4751E4Cull, 0xAA97E14C3C26B886ull, // 5^-54
+	0xF53304714D9265DFull, 0xD53DD99F4B3066A8ull, // 5^-53
+	0x993FE2C6D07B7FABull, 0xE546A8038EFE4029ull, // 5^-52
+	0xBF8FDB78849A5F96ull, 0xDE98520472BDD033ull, // 5^-51
+	0xEF73D256A5C0F77Cull, 0x963E66858F6D4440ull, // 5^-50
+	0x95A8637627989AADull, 0xDDE7001379A44AA8ull, // 5^-49
+	0xBB127C53B17EC159ull, 0x5560C018580D5D52ull, // 5^-48
+	0xE9D71B689DDE71AFull, 0xAAB8F01E6E10B4A6ull, // 5^-47
+	0x9226712162AB070Dull, 0xCAB3961304CA70E8ull, // 5^-46
+	0xB6B00D69BB55C8D1ull, 0x3D607B97C5FD0D22ull, // 5^-45
+	0xE45C10C42A2B3B05ull, 0x8CB89A7DB77C506Aull, // 5^-44
+	0x8EB98A7A9A5B04E3ull, 0x77F3608E92ADB242ull, // 5^-43
+	0xB267ED1940F1C61Cull, 0x55F038B237591ED3ull, // 5^-42
+	0xDF01E85F912E37A3ull, 0x6B6C46DEC52F6688ull, // 5^-41
+	0x8B61313BBABCE2C6ull, 0x2323AC4B3B3DA015ull, // 5^-40
+	0xAE397D8AA96C1B77ull, 0xABEC975E0A0D081Aull, // 5^-39
+	0xD9C7DCED53C72255ull, 0x96E7BD358C904A21ull, // 5^-38
+	0x881CEA14545C7575ull, 0x7E50D64177DA2E54ull, // 5^-37
+	0xAA242499697392D2ull, 0xDDE50BD1D5D0B9E9ull, // 5^-36
+	0xD4AD2DBFC3D07787ull, 0x955E4EC64B44E864ull, // 5^-35
+	0x84EC3C97DA624AB4ull, 0xBD5AF13BEF0B113Eull, // 5^-34
+	0xA6274BBDD0FADD61ull, 0xECB1AD8AEACDD58Eull, // 5^-33
+	0xCFB11EAD453994BAull, 0x67DE18EDA5814AF2ull, // 5^-32
+	0x81CEB32C4B43FCF4ull, 0x80EACF948770CED7ull, // 5^-31
+	0xA2425FF75E14FC31ull, 0xA1258379A94D028Dull, // 5^-30
+	0xCAD2F7F5359A3B3Eull, 0x096EE45813A04330ull, // 5^-29
+	0xFD87B5F28300CA0Dull, 0x8BCA9D6E188853FCull, // 5^-28
+	0x9E74D1B791E07E48ull, 0x775EA264CF55347Eull, // 5^-27
+	0xC612062576589DDAull, 0x95364AFE032A819Eull, // 5^-26
+	0xF79687AED3EEC551ull, 0x3A83DDBD83F52205ull, // 5^-25
+	0x9ABE14CD44753B52ull, 0xC4926A9672793543ull, // 5^-24
+	0xC16D9A0095928A27ull, 0x75B7053C0F178294ull, // 5^-23
+	0xF1C90080BAF72CB1ull, 0x5324C68B12DD6339ull, // 5^-22
+	0x971DA05074DA7BEEull, 0xD3F6FC16EBCA5E04ull, // 5^-21
+	0xBCE5086492111AEAull, 0x88F4BB1CA6BCF585ull, // 5^-20
+	0xEC1E4A7DB69561A5ull, 0x2B31E9E3D06C32E6ull, // 5^-19
+	0x9392EE8E921D5D07ull, 0x3AFF322E62439FD0ull, // 5^-18
+	0xB877AA3236A4B449ull, 0x09BEFEB9FAD487C3ull, // 5^-17
+	0xE69594BEC44DE15Bull, 0x4C2EBE687989A9B4ull, // 5^-16
+	0x901D7CF73AB0ACD9ull, 0x0F9D37014BF60A11ull, // 5^-15
+	0xB424DC35095CD80Full, 0x538484C19EF38C95ull, // 5^-14
+	0xE12E13424BB40E13ull, 0x2865A5F206B06FBAull, // 5^-13
+	0x8CBCCC096F5088CBull, 0xF93F87B7442E45D4ull, // 5^-12
+	0xAFEBFF0BCB24AAFEull, 0xF78F69A51539D749ull, // 5^-11
+	0xDBE6FECEBDEDD5BEull, 0xB573440E5A884D1Cull, // 5^-10
+	0x89705F4136B4A597ull, 0x31680A88F8953031ull, // 5^-9
+	0xABCC77118461CEFCull, 0xFDC20D2B36BA7C3Eull, // 5^-8
+	0xD6BF94D5E57A42BCull, 0x3D32907604691B4Dull, // 5^-7
+	0x8637BD05AF6C69B5ull, 0xA63F9A49C2C1B110ull, // 5^-6
+	0xA7C5AC471B478423ull, 0x0FCF80DC33721D54ull, // 5^-5
+	0xD1B71758E219652Bull, 0xD3C36113404EA4A9ull, // 5^-4
+	0x83126E978D4FDF3Bull, 0x645A1CAC083126EAull, // 5^-3
+	0xA3D70A3D70A3D70Aull, 0x3D70A3D70A3D70A4ull, // 5^-2
+	0xCCCCCCCCCCCCCCCCull, 0xCCCCCCCCCCCCCCCDull, // 5^-1
+	0x8000000000000000ull, 0x0000000000000000ull, // 5^0
+	0xA000000000000000ull, 0x0000000000000000ull, // 5^1
+	0xC800000000000000ull, 0x0000000000000000ull, // 5^2
+	0xFA00000000000000ull, 0x0000000000000000ull, // 5^3
+	0x9C40000000000000ull, 0x0000000000000000ull, // 5^4
+	0xC350000000000000ull, 0x0000000000000000ull, // 5^5
+	0xF424000000000000ull, 0x0000000000000000ull, // 5^6
+	0x9896800000000000ull, 0x0000000000000000ull, // 5^7
+	0xBEBC200000000000ull, 0x0000000000000000ull, // 5^8
+	0xEE6B280000000000ull, 0x0000000000000000ull, // 5^9
+	0x9502F90000000000ull, 0x0000000000000000ull, // 5^10
+	0xBA43B74000000000ull, 0x0000000000000000ull, // 5^11
+	0xE8D4A51000000000ull, 0x0000000000000000ull, // 5^12
+	0x9184E72A00000000ull, 0x0000000000000000ull, // 5^13
+	0xB5E620F480000000ull, 0x0000000000000000ull, // 5^14
+	0xE35FA931A0000000ull, 0x0000000000000000ull, // 5^15
+	0x8E1BC9BF04000000ull, 0x0000000000000000ull, // 5^16
+	0xB1A2BC2EC5000000ull, 0x0000000000000000ull, // 5^17
+	0xDE0B6B3A76400000ull, 0x0000000000000000ull, // 5^18
+	0x8AC7230489E80000ull, 0x0000000000000000ull, // 5^19
+	0xAD78EBC5AC620000ull, 0x0000000000000000ull, // 5^20
+	0xD8D726B7177A8000ull, 0x0000000000000000ull, // 5^21
+	0x878678326EAC9000ull, 0x0000000000000000ull, // 5^22
+	0xA968163F0A57B400ull, 0x0000000000000000ull, // 5^23
+	0xD3C21BCECCEDA100ull, 0x0000000000000000ull, // 5^24
+	0x84595161401484A0ull, 0x0000000000000000ull, // 5^25
+	0xA56FA5B99019A5C8ull, 0x0000000000000000ull, // 5^26
+	0xCECB8F27F4200F3Aull, 0x0000000000000000ull, // 5^27
+	0x813F3978F8940984ull, 0x4000000000000000ull, // 5^28
+	0xA18F07D736B90BE5ull, 0x5000000000000000ull, // 5^29
+	0xC9F2C9CD04674EDEull, 0xA400000000000000ull, // 5^30
+	0xFC6F7C4045812296ull, 0x4D00000000000000ull, // 5^31
+	0x9DC5ADA82B70B59Dull, 0xF020000000000000ull, // 5^32
+	0xC5371912364CE305ull, 0x6C28000000000000ull, // 5^33
+	0xF684DF56C3E01BC6ull, 0xC732000000000000ull, // 5^34
+	0x9A130B963A6C115Cull, 0x3C7F400000000000ull, // 5^35
+	0xC097CE7BC90715B3ull, 0x4B9F100000000000ull, // 5^36
+	0xF0BDC21ABB48DB20ull, 0x1E86D40000000000ull, // 5^37
+	0x96769950B50D88F4ull, 0x1314448000000000ull, // 5^38
+};
+
+static const float exact_powers_of_ten[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+struct Value128 {
+	uint64_t low;
+	uint64_t high;
+};
+
+static inline Value128 FullMultiplication(uint64_t a, uint64_t b) {
+	Value128 result;
+#ifdef _MSC_VER
+	result.low = _umul128(a, b, &result.high);
+#else
+	unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+	result.low = static_cast<uint64_t>(product);
+	result.high = static_cast<uint64_t>(product >> 64);
+#endif
+	return result;
+}
+
+static inline int LeadingZeroes(uint64_t value) {
+#ifdef _MSC_VER
+	unsigned long bit;
+	_BitScanReverse64(&bit, value);
+	return 63 - static_cast<int>(bit);
+#else
+	return __builtin_clzll(value);
+#endif
+}
+
+static inline bool IsDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+static inline float MakeFloat(uint64_t mantissa, int power2, bool negative) {
+	uint32_t bits = static_cast<uint32_t>(mantissa) | (static_cast<uint32_t>(power2) << mantissa_explicit_bits);
+	bits |= negative ? 0x80000000u : 0u;
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+// Eisel-Lemire: w * 10^q with w != 0. Returns false when the result is subnormal
+// and needs the slow path.
+static bool ComputeFloat(uint64_t w, int q, bool negative, float &value) {
+	if (q < smallest_power_of_ten) {
+		value = negative ? -0.0f : 0.0f;
+		return true;
+	}
+	if (q > largest_power_of_ten) {
+		value = negative ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+		return true;
+	}
+
+	const int lz = LeadingZeroes(w);
+	w <<= lz;
+
+	// Only the bits which decide rounding need the low half of the power
+	const int index = 2 * (q - smallest_power_of_ten);
+	Value128 product = FullMultiplication(w, power_of_five_128[index]);
+	const uint64_t precision_mask = 0xFFFFFFFFFFFFFFFFull >> (mantissa_explicit_bits + 3);
+	if ((product.high & precision_mask) == precision_mask) {
+		Value128 second_product = FullMultiplication(w, power_of_five_128[index + 1]);
+		product.low += second_product.high;
+		if (second_product.high > product.low) {
+			product.high++;
+		}
+	}
+
+	const int upper_bit = static_cast<int>(product.high >> 63);
+	const int shift = upper_bit + 64 - mantissa_explicit_bits - 3;
+	uint64_t mantissa = product.high >> shift;
+	// floor(log2(5^q)) + 63
+	int power2 = (((152170 + 65536) * q) >> 16) + 63 + upper_bit - lz - minimum_exponent;
+	if (power2 <= 0) {
+		return false;
+	}
+
+	// Exact halfway between two floats rounds to even
+	if (product.low <= 1 && q >= min_exponent_round_to_even && q <= max_exponent_round_to_even &&
+		(mantissa & 3) == 1 && (mantissa << shift) == product.high) {
+		mantissa &= ~uint64_t(1);
+	}
+
+	mantissa += mantissa & 1;
+	mantissa >>= 1;
+	if (mantissa >= (uint64_t(2) << mantissa_explicit_bits)) {
+		mantissa = uint64_t(1) << mantissa_explicit_bits;
+		power2++;
+	}
+	mantissa &= ~(uint64_t(1) << mantissa_explicit_bits);
+
+	if (power2 >= infinite_power) {
+		value = negative ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+		return true;
+	}
+
+	value = MakeFloat(mantissa, power2, negative);
+	return true;
+}
+
+static const char *ParseFloatSlow(const char *begin, const char *end, float &value) {
+	char buffer[128];
+	const size_t length = static_cast<size_t>(end - begin) < sizeof(buffer) - 1 ? static_cast<size_t>(end - begin) : sizeof(buffer) - 1;
+	memcpy(buffer, begin, length);
+	buffer[length] = '\0';
+
+	char *number_end;
+	value = strtof(buffer, &number_end);
+	if (number_end == buffer) {
+		return nullptr;
+	}
+	return begin + (number_end - buffer);
+}
+
+const char *ParseFloat(const char *begin, const char *end, float &value) {
+	const char *p = begin;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+
+	uint64_t w = 0;
+	int digit_number = 0;
+	int exponent = 0;
+	bool has_digits = false;
+
+	while (p < end && IsDigit(*p)) {
+		if (w != 0 || *p != '0') {
+			digit_number++;
+		}
+		w = w * 10 + static_cast<uint64_t>(*p - '0');
+		has_digits = true;
+		p++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && IsDigit(*p)) {
+			if (w != 0 || *p != '0') {
+				digit_number++;
+			}
+			w = w * 10 + static_cast<uint64_t>(*p - '0');
+			exponent--;
+			has_digits = true;
+			p++;
+		}
+	}
+	if (!has_digits) {
+		// inf, nan and friends
+		return ParseFloatSlow(begin, end, value);
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char *exponent_begin = p;
+		p++;
+		bool negative_exponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative_exponent = (*p == '-');
+			p++;
+		}
+		if (p < end && IsDigit(*p)) {
+			int explicit_exponent = 0;
+			while (p < end && IsDigit(*p)) {
+				if (explicit_exponent < 100000) {
+					explicit_exponent = explicit_exponent * 10 + (*p - '0');
+				}
+				p++;
+			}
+			exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+		} else {
+			p = exponent_begin;
+		}
+	}
+
+	if (digit_number > max_significant_digits) {
+		// w has overflowed
+		return ParseFloatSlow(begin, end, value);
+	}
+
+	if (w == 0) {
+		value = negative ? -0.0f : 0.0f;
+		return p;
+	}
+
+	// Both w and the power of ten are exact floats, so one operation rounds correctly
+	if (w <= max_fast_path_mantissa && exponent >= -10 && exponent <= 10) {
+		float result = static_cast<float>(w);
+		result = (exponent < 0) ? result / exact_powers_of_ten[-exponent] : result * exact_powers_of_ten[exponent];
+		value = negative ? -result : result;
+		return p;
+	}
+
+	if (!ComputeFloat(w, exponent, negative, value)) {
+		return ParseFloatSlow(begin, end, value);
+	}
+	return p;
+}
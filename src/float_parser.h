@@ -0,0 +1,7 @@
+#pragma once
+
+// Parses a decimal floating point number from [begin, end) into the correctly
+// rounded float. Numbers up to 19 significant digits take an exact power of ten
+// fast path or the Eisel-Lemire algorithm; longer ones, subnormals and inf/nan
+// fall back to strtod. Returns the end of the number or nullptr on error.
+const char *ParseFloat(const char *begin, const char *end, float &value);
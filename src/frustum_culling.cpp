@@ -0,0 +1,161 @@
+#include "frustum_culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <emmintrin.h>
+
+DrawBounds ComputeDrawBounds(const float *positions, size_t position_stride, size_t vertex_number) {
+	DrawBounds bounds = {};
+	if (vertex_number == 0) {
+		return bounds;
+	}
+
+	float min_corner[3] = {positions[0], positions[1], positions[2]};
+	float max_corner[3] = {positions[0], positions[1], positions[2]};
+	for (size_t v = 1; v < vertex_number; v++) {
+		const float *position = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + v * position_stride);
+		for (int axis = 0; axis < 3; axis++) {
+			min_corner[axis] = std::min(min_corner[axis], position[axis]);
+			max_corner[axis] = std::max(max_corner[axis], position[axis]);
+		}
+	}
+
+	bounds.center = {(min_corner[0] + max_corner[0]) * 0.5f, (min_corner[1] + max_corner[1]) * 0.5f, (min_corner[2] + max_corner[2]) * 0.5f};
+	bounds.extent = {max_corner[0] - bounds.center.x, max_corner[1] - bounds.center.y, max_corner[2] - bounds.center.z};
+
+	// The sphere around the box center is not minimal, but it never needs a second pass
+	float radius_squared = 0.0f;
+	for (size_t v = 0; v < vertex_number; v++) {
+		const float *position = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + v * position_stride);
+		const float dx = position[0] - bounds.center.x;
+		const float dy = position[1] - bounds.center.y;
+		const float dz = position[2] - bounds.center.z;
+		radius_squared = std::max(radius_squared, dx * dx + dy * dy + dz * dz);
+	}
+	bounds.radius = std::sqrt(radius_squared);
+	return bounds;
+}
+
+void FrustumCuller::SetBounds(const DrawBounds *bounds, size_t number) {
+	bounds_number = number;
+	const size_t padded_number = (number + simd_width - 1) / simd_width * simd_width;
+
+	// Padding boxes are never written to visibility, any value works
+	center_x.assign(padded_number, 0.0f);
+	center_y.assign(padded_number, 0.0f);
+	center_z.assign(padded_number, 0.0f);
+	extent_x.assign(padded_number, 0.0f);
+	extent_y.assign(padded_number, 0.0f);
+	extent_z.assign(padded_number, 0.0f);
+	bounding_radius.assign(padded_number, 0.0f);
+	for (size_t b = 0; b < number; b++) {
+		center_x[b] = bounds[b].center.x;
+		center_y[b] = bounds[b].center.y;
+		center_z[b] = bounds[b].center.z;
+		extent_x[b] = bounds[b].extent.x;
+		extent_y[b] = bounds[b].extent.y;
+		extent_z[b] = bounds[b].extent.z;
+		bounding_radius[b] = bounds[b].radius;
+	}
+}
+
+void FrustumCuller::ExtractPlanes(const XMFLOAT4X4 &m, float planes[6][4]) {
+	// Gribb and Hartmann: clip space planes are sums of the matrix columns
+	for (int i = 0; i < 4; i++) {
+		planes[0][i] = m.m[i][3] + m.m[i][0];
+		planes[1][i] = m.m[i][3] - m.m[i][0];
+		planes[2][i] = m.m[i][3] + m.m[i][1];
+		planes[3][i] = m.m[i][3] - m.m[i][1];
+		planes[4][i] = m.m[i][2];
+		planes[5][i] = m.m[i][3] - m.m[i][2];
+	}
+}
+
+size_t FrustumCuller::Cull(const XMFLOAT4X4 &view_projection, uint8_t *visibility, float min_radius_per_depth) const {
+	float planes[6][4];
+	ExtractPlanes(view_projection, planes);
+
+	// Clip w is the fourth matrix column
+	const __m128 depth_x = _mm_set1_ps(view_projection.m[0][3]);
+	const __m128 depth_y = _mm_set1_ps(view_projection.m[1][3]);
+	const __m128 depth_z = _mm_set1_ps(view_projection.m[2][3]);
+	const __m128 depth_w = _mm_set1_ps(view_projection.m[3][3]);
+	const __m128 min_radius_scale = _mm_set1_ps(min_radius_per_depth);
+
+	__m128 plane_vectors[6][4];
+	for (int p = 0; p < 6; p++) {
+		for (int i = 0; i < 4; i++) {
+			plane_vectors[p][i] = _mm_set1_ps(planes[p][i]);
+		}
+	}
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 zero = _mm_setzero_ps();
+
+	size_t visible_number = 0;
+	for (size_t b = 0; b < bounds_number; b += simd_width) {
+		const __m128 cx = _mm_loadu_ps(center_x.data() + b);
+		const __m128 cy = _mm_loadu_ps(center_y.data() + b);
+		const __m128 cz = _mm_loadu_ps(center_z.data() + b);
+		const __m128 ex = _mm_loadu_ps(extent_x.data() + b);
+		const __m128 ey = _mm_loadu_ps(extent_y.data() + b);
+		const __m128 ez = _mm_loadu_ps(extent_z.data() + b);
+
+		// A box is outside a plane when its center distance plus its projected extent is negative
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_mul_ps(cx, plane_vectors[p][0]), plane_vectors[p][3]);
+			distance = _mm_add_ps(distance, _mm_mul_ps(cy, plane_vectors[p][1]));
+			distance = _mm_add_ps(distance, _mm_mul_ps(cz, plane_vectors[p][2]));
+
+			__m128 radius = _mm_mul_ps(ex, _mm_and_ps(plane_vectors[p][0], abs_mask));
+			radius = _mm_add_ps(radius, _mm_mul_ps(ey, _mm_and_ps(plane_vectors[p][1], abs_mask)));
+			radius = _mm_add_ps(radius, _mm_mul_ps(ez, _mm_and_ps(plane_vectors[p][2], abs_mask)));
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		__m128 depth = _mm_add_ps(_mm_mul_ps(cx, depth_x), depth_w);
+		depth = _mm_add_ps(depth, _mm_mul_ps(cy, depth_y));
+		depth = _mm_add_ps(depth, _mm_mul_ps(cz, depth_z));
+		const __m128 sphere_radius = _mm_loadu_ps(bounding_radius.data() + b);
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(sphere_radius, _mm_mul_ps(depth, min_radius_scale)));
+
+		const int mask = _mm_movemask_ps(inside);
+		const size_t lane_number = std::min(simd_width, bounds_number - b);
+		for (size_t lane = 0; lane < lane_number; lane++) {
+			visibility[b + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+			visible_number += visibility[b + lane];
+		}
+	}
+	return visible_number;
+}
+
+size_t FrustumCuller::CullReference(const XMFLOAT4X4 &view_projection, uint8_t *visibility, float min_radius_per_depth) const {
+	float planes[6][4];
+	ExtractPlanes(view_projection, planes);
+
+	size_t visible_number = 0;
+	for (size_t b = 0; b < bounds_number; b++) {
+		bool inside = true;
+		for (int p = 0; p < 6; p++) {
+			// Same operation order as the SIMD kernel, so both round identically
+			float distance = center_x[b] * planes[p][0] + planes[p][3];
+			distance = distance + center_y[b] * planes[p][1];
+			distance = distance + center_z[b] * planes[p][2];
+			float radius = extent_x[b] * std::abs(planes[p][0]);
+			radius = radius + extent_y[b] * std::abs(planes[p][1]);
+			radius = radius + extent_z[b] * std::abs(planes[p][2]);
+			inside = inside && (distance + radius >= 0.0f);
+		}
+
+		float depth = center_x[b] * view_projection.m[0][3] + view_projection.m[3][3];
+		depth = depth + center_y[b] * view_projection.m[1][3];
+		depth = depth + center_z[b] * view_projection.m[2][3];
+		inside = inside && (bounding_radius[b] >= depth * min_radius_per_depth);
+
+		visibility[b] = inside ? 1 : 0;
+		visible_number += visibility[b];
+	}
+	return visible_number;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "vertex_formats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Axis aligned box of a draw call and the bounding sphere around the same center
+struct DrawBounds {
+	XMFLOAT3 center;
+	float radius;
+	XMFLOAT3 extent;
+	float reserved;
+};
+
+// positions point to the x of the first vertex, position_stride is in bytes
+DrawBounds ComputeDrawBounds(const float *positions, size_t position_stride, size_t vertex_number);
+
+// Culls many boxes against a frustum at once. The boxes are kept as a structure
+// of arrays padded to the SIMD width, so the SSE2 kernel tests four boxes against
+// a plane with a handful of instructions.
+class FrustumCuller {
+public:
+	void SetBounds(const DrawBounds *bounds, size_t bounds_number);
+	size_t GetBoundsNumber() const { return bounds_number; }
+
+	// view_projection maps row vectors to clip space (clip = position * view_projection)
+	// with 0 <= z <= w. Writes 1 to visibility for every box touching the frustum and
+	// 0 for the others, returns the number of visible boxes. Boxes whose bounding
+	// sphere radius is below min_radius_per_depth times the clip w of its center are
+	// rejected as too small to cover a pixel.
+	size_t Cull(const XMFLOAT4X4 &view_projection, uint8_t *visibility, float min_radius_per_depth = 0.0f) const;
+	// Scalar version of Cull with the same results
+	size_t CullReference(const XMFLOAT4X4 &view_projection, uint8_t *visibility, float min_radius_per_depth = 0.0f) const;
+
+protected:
+	static constexpr size_t simd_width = 4;
+
+	size_t bounds_number = 0;
+	std::vector<float> center_x;
+	std::vector<float> center_y;
+	std::vector<float> center_z;
+	std::vector<float> extent_x;
+	std::vector<float> extent_y;
+	std::vector<float> extent_z;
+	std::vector<float> bounding_radius;
+
+	// Left, right, bottom, top, near and far as (a, b, c, d) with inside a*x + b*y + c*z + d >= 0
+	static void ExtractPlanes(const XMFLOAT4X4 &view_projection, float planes[6][4]);
+};
@@ -0,0 +1,1152 @@
+#include "frustum_culling.h"
+#include "mesh_codec.h"
+#include "mesh_optimizer.h"
+#include "model_loader.h"
+#include "obj_generator.h"
+#include "obj_parser.h"
+#include "parallel_for.h"
+#include "vertex_conversion.h"
+#include "vertex_index_map.h"
+#include "vertex_packing.h"
+
+#ifdef _WIN32
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <new>
+#include <tuple>
+#include <vector>
+
+using namespace std::chrono;
+
+// Every allocation of the process is counted, the loader itself is not instrumented.
+// Allocations carry their size in front so the live heap and its peak can be tracked.
+static std::atomic<size_t> allocation_number(0);
+static std::atomic<size_t> allocated_bytes(0);
+static std::atomic<size_t> live_bytes(0);
+static std::atomic<size_t> peak_live_bytes(0);
+static const size_t allocation_header_size = 16;
+
+// malloc and free stay inside these two, so the compiler never sees a new
+// expression paired with free or the header offset applied to a new'd array
+#ifdef _MSC_VER
+#define BENCHMARK_NOINLINE __declspec(noinline)
+#else
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#endif
+
+static BENCHMARK_NOINLINE void *AllocateCounted(size_t size) {
+	char *allocation = static_cast<char *>(malloc(size + allocation_header_size));
+	if (!allocation) {
+		return nullptr;
+	}
+	allocation_number++;
+	allocated_bytes += size;
+	memcpy(allocation, &size, sizeof(size));
+	const size_t live = live_bytes += size;
+	size_t peak = peak_live_bytes;
+	while (live > peak && !peak_live_bytes.compare_exchange_weak(peak, live)) {
+	}
+	return allocation + allocation_header_size;
+}
+
+static BENCHMARK_NOINLINE void FreeCounted(void *pointer) {
+	if (!pointer) {
+		return;
+	}
+	char *allocation = static_cast<char *>(pointer) - allocation_header_size;
+	size_t size;
+	memcpy(&size, allocation, sizeof(size));
+	live_bytes -= size;
+	free(allocation);
+}
+
+void *operator new(size_t size) {
+	void *pointer = AllocateCounted(size);
+	if (!pointer) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept {
+	FreeCounted(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+	FreeCounted(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+	FreeCounted(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+	FreeCounted(pointer);
+}
+
+struct BenchmarkOptions {
+	ObjGeneratorOptions generator;
+	LoaderOptions loader;
+	unsigned int iteration_number = 5;
+	std::string obj_file = "loader_benchmark.obj";
+	// Load an existing OBJ next to the executable instead of generating one
+	bool generate = true;
+	// Time the vertex conversion kernels instead of whole loads
+	bool kernels = false;
+	// Check the packed vertex error bounds on random vertices instead of whole loads
+	bool packing = false;
+	// Compare and time the frustum culling kernels on random boxes instead of whole loads
+	bool culling = false;
+	// Compare std::map and VertexIndexMap vertex dedup on the OBJ corners instead of whole loads
+	bool dedup = false;
+	// Compare the loader tangents with ComputeReferenceTangents after every load
+	bool tangents = false;
+	// Round trip every stream of the first cold load through mesh_codec
+	bool codec = false;
+	// Load with buffer size limits around the boundaries of the generated mesh instead
+	bool buffers = false;
+	// Compare streaming conversion with a load in memory instead
+	bool streaming = false;
+};
+
+#ifdef _WIN32
+
+static size_t GetPeakMemory() {
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+}
+
+static std::string GetModulePath() {
+	CHAR buffer[MAX_PATH];
+	GetModuleFileNameA(NULL, buffer, MAX_PATH);
+	return buffer;
+}
+
+#else
+
+// argv[0], used when /proc/self/exe cannot be read
+static const char *module_argument = nullptr;
+
+static size_t GetPeakMemory() {
+	rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return static_cast<size_t>(usage.ru_maxrss);
+#else
+	// Kilobytes on Linux
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+static std::string GetModulePath() {
+	std::error_code error;
+	std::string module_path = std::filesystem::read_symlink("/proc/self/exe", error).string();
+	if (module_path.empty() && module_argument != nullptr) {
+		module_path = module_argument;
+	}
+	return module_path;
+}
+
+#endif
+
+static std::string GetBinPath(const std::string &file) {
+	std::string module_path = GetModulePath();
+	std::string::size_type pos = module_path.find_last_of("\\/");
+	return module_path.substr(0, pos + 1) + file;
+}
+
+static bool ParseArguments(int argc, char **argv, BenchmarkOptions &options) {
+	for (int i = 1; i < argc; i++) {
+		const std::string argument = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (argument == "--triangles" && has_value) {
+			options.generator.triangle_number = strtoull(argv[++i], nullptr, 10);
+		} else if (argument == "--materials" && has_value) {
+			options.generator.material_number = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		} else if (argument == "--sharing" && has_value) {
+			options.generator.attribute_sharing = static_cast<float>(atof(argv[++i]));
+		} else if (argument == "--negative") {
+			options.generator.negative_indices = true;
+		} else if (argument == "--no-normals") {
+			options.generator.normals = false;
+		} else if (argument == "--seed" && has_value) {
+			options.generator.seed = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		} else if (argument == "--threads" && has_value) {
+			options.loader.thread_number = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		} else if (argument == "--iterations" && has_value) {
+			options.iteration_number = std::max(static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10)), 1u);
+		} else if (argument == "--obj" && has_value) {
+			options.obj_file = argv[++i];
+			options.generate = false;
+		} else if (argument == "--pack") {
+			options.loader.pack_vertices = true;
+		} else if (argument == "--overdraw") {
+			options.loader.optimize_overdraw = true;
+		} else if (argument == "--analyze-overdraw") {
+			options.loader.analyze_overdraw = true;
+		} else if (argument == "--weld" && has_value) {
+			options.loader.weld_tolerance = static_cast<float>(atof(argv[++i]));
+		} else if (argument == "--tangents") {
+			options.tangents = true;
+			options.loader.generate_tangents = true;
+		} else if (argument == "--kernels") {
+			options.kernels = true;
+		} else if (argument == "--packing") {
+			options.packing = true;
+		} else if (argument == "--culling") {
+			options.culling = true;
+		} else if (argument == "--dedup") {
+			options.dedup = true;
+		} else if (argument == "--compress") {
+			options.loader.compress_cache = true;
+		} else if (argument == "--entropy") {
+			options.loader.compress_cache = true;
+			options.loader.entropy_code_cache = true;
+		} else if (argument == "--codec") {
+			options.codec = true;
+		} else if (argument == "--buffers") {
+			options.buffers = true;
+		} else if (argument == "--streaming" && has_value) {
+			options.streaming = true;
+			options.loader.streaming_memory_budget = strtoull(argv[++i], nullptr, 10) << 20;
+		} else {
+			fprintf(stderr, "Usage: %s [--triangles N] [--materials N] [--sharing 0..1] [--negative] [--no-normals] [--seed N]\n"
+				"       [--threads N] [--iterations N] [--obj file] [--pack] [--overdraw] [--analyze-overdraw] [--weld tolerance]\n"
+				"       [--tangents] [--kernels] [--packing] [--culling] [--dedup] [--compress] [--entropy] [--codec] [--buffers] [--streaming MB]\n", argv[0]);
+			return false;
+		}
+	}
+	return true;
+}
+
+// One JSON object per line, so runs can be appended to a file and compared by scripts
+static void PrintRun(const char *run, unsigned int iteration, const ModelLoader &loader, size_t cache_bytes,
+	size_t allocations, size_t bytes, size_t peak_heap, const BenchmarkOptions &options) {
+	const LoaderStatistics statistics = loader.GetStatistics();
+	const double source_megabytes = statistics.source_size / 1e6;
+	const unsigned int thread_number = options.loader.thread_number ? options.loader.thread_number : GetWorkerNumber();
+	printf("{\"run\": \"%s\", \"iteration\": %u, \"threads\": %u, \"triangles\": %zu, \"materials\": %u, \"sharing\": %.3f, \"negative_indices\": %s, "
+		"\"cache_hit\": %s, \"source_bytes\": %zu, \"cache_bytes\": %zu, \"vertices\": %zu, \"draw_calls\": %u, \"buffers\": %u, \"welded_vertices\": %zu, \"removed_triangles\": %zu, "
+		"\"cache_ms\": %.3f, \"parse_ms\": %.3f, \"normals_ms\": %.3f, \"dedup_ms\": %.3f, \"assembly_ms\": %.3f, \"processing_ms\": %.3f, \"total_ms\": %.3f, "
+		"\"acmr_before\": %.3f, \"acmr_after\": %.3f, \"overdraw_before\": %.3f, \"overdraw_after\": %.3f, "
+		"\"parse_mb_per_s\": %.1f, \"parse_gb_per_s\": %.3f, \"allocations\": %zu, \"allocated_bytes\": %zu, \"peak_heap_bytes\": %zu, \"peak_rss_bytes\": %zu}\n",
+		run, iteration, thread_number, options.generator.triangle_number, options.generator.material_number, options.generator.attribute_sharing,
+		options.generator.negative_indices ? "true" : "false", statistics.cache_hit ? "true" : "false", statistics.source_size,
+		cache_bytes, loader.GetVertexNumber(), loader.GetDrawCallNumber(), loader.GetBufferNumber(), statistics.welded_vertex_number, statistics.removed_triangle_number,
+		statistics.cache_time * 1000.0, statistics.parse_time * 1000.0, statistics.normal_time * 1000.0, statistics.dedup_time * 1000.0,
+		statistics.assembly_time * 1000.0, statistics.processing_time * 1000.0, statistics.total_time * 1000.0,
+		statistics.acmr_before, statistics.acmr_after, statistics.overdraw_before, statistics.overdraw_after,
+		statistics.parse_time > 0.0 ? source_megabytes / statistics.parse_time : 0.0,
+		statistics.parse_time > 0.0 ? source_megabytes / 1000.0 / statistics.parse_time : 0.0, allocations, bytes, peak_heap, GetPeakMemory());
+	fflush(stdout);
+}
+
+// Converts random index triples, every seventh without a normal and every fifth
+// without a texcoord, with every kernel the CPU supports and compares the
+// results with the scalar kernel byte for byte
+static bool RunKernelBenchmark(const BenchmarkOptions &options) {
+	const size_t key_number = options.generator.triangle_number * 3;
+	const size_t attribute_number = std::max(options.generator.triangle_number / 2, static_cast<size_t>(1));
+	unsigned int state = options.generator.seed;
+	auto next_random = [&state]() {
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	};
+
+	tinyobj::attrib_t attrib;
+	attrib.vertices.resize(attribute_number * 3);
+	attrib.normals.resize(attribute_number * 3);
+	attrib.texcoords.resize(attribute_number * 2);
+	for (float &value : attrib.vertices) {
+		value = next_random() / 65536.0f - 128.0f;
+	}
+	for (float &value : attrib.normals) {
+		value = next_random() / 8388608.0f - 1.0f;
+	}
+	for (float &value : attrib.texcoords) {
+		value = next_random() / 16777216.0f;
+	}
+	std::vector<tinyobj::index_t> keys(key_number);
+	for (size_t k = 0; k < key_number; k++) {
+		keys[k].vertex_index = static_cast<int>(next_random() % attribute_number);
+		keys[k].normal_index = (k % 7 == 0) ? -1 : static_cast<int>(next_random() % attribute_number);
+		keys[k].texcoord_index = (k % 5 == 0) ? -1 : static_cast<int>(next_random() % attribute_number);
+	}
+
+	std::vector<FullVertex> reference(key_number);
+	std::vector<FullVertex> result(key_number);
+	ConvertVertices(reference.data(), attrib, keys.data(), key_number, VERTEX_CONVERSION_SCALAR);
+
+	const VertexConversionKernel widest_kernel = GetVertexConversionKernel();
+	const char *kernel_names[] = {"scalar", "sse2", "avx2"};
+	bool bit_exact = true;
+	for (int kernel = VERTEX_CONVERSION_SCALAR; kernel <= widest_kernel; kernel++) {
+		for (unsigned int iteration = 0; iteration < options.iteration_number; iteration++) {
+			memset(result.data(), 0xff, result.size() * sizeof(FullVertex));
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			ConvertVertices(result.data(), attrib, keys.data(), key_number, static_cast<VertexConversionKernel>(kernel));
+			const double time = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+			const bool matches = memcmp(result.data(), reference.data(), key_number * sizeof(FullVertex)) == 0;
+			bit_exact = bit_exact && matches;
+
+			printf("{\"run\": \"kernel\", \"kernel\": \"%s\", \"iteration\": %u, \"vertices\": %zu, \"convert_ms\": %.3f, "
+				"\"ns_per_vertex\": %.3f, \"bit_exact\": %s}\n",
+				kernel_names[kernel], iteration, key_number, time * 1000.0,
+				key_number ? time * 1e9 / key_number : 0.0, matches ? "true" : "false");
+			fflush(stdout);
+		}
+	}
+	return bit_exact;
+}
+
+// Packs random vertices, among them the corners of the bounds, axis aligned normals
+// and texcoords far outside [0, 1], and checks every unpacked vertex against the
+// bounds of the packed format: half a unorm16 step of its axis, plus the float
+// rounding of the coordinates, for positions,
+// max_packed_normal_degrees for normals and half the half float spacing at the
+// value for texcoords. Fails when any vertex exceeds them.
+static const double max_packed_normal_degrees = 0.04;
+
+static bool RunPackingBenchmark(const BenchmarkOptions &options) {
+	const size_t vertex_number = std::max(options.generator.triangle_number, static_cast<size_t>(64));
+	unsigned int state = options.generator.seed;
+	auto next_random = [&state]() {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	};
+
+	// Axes of very different extents, so every axis has its own step
+	const XMFLOAT3 min_corner = {-1000.0f, 0.25f, -3.0f};
+	const XMFLOAT3 extent = {2500.0f, 0.5f, 40.0f};
+	const XMFLOAT3 axis_normals[] = {{1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}};
+	std::vector<FullVertex> vertices(vertex_number);
+	for (size_t v = 0; v < vertex_number; v++) {
+		FullVertex &vertex = vertices[v];
+		if (v < 8) {
+			vertex.position = {min_corner.x + ((v & 1) ? extent.x : 0.0f), min_corner.y + ((v & 2) ? extent.y : 0.0f), min_corner.z + ((v & 4) ? extent.z : 0.0f)};
+		} else {
+			vertex.position = {min_corner.x + extent.x * next_random(), min_corner.y + extent.y * next_random(), min_corner.z + extent.z * next_random()};
+		}
+		if (v < std::size(axis_normals)) {
+			vertex.normal = axis_normals[v];
+		} else {
+			// Normals do not have to be unit length, the error is measured against the direction
+			const float length = 0.5f + next_random();
+			const XMFLOAT3 direction = {next_random() * 2.0f - 1.0f, next_random() * 2.0f - 1.0f, next_random() * 2.0f - 1.0f};
+			const float direction_length = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+			const float scale = (direction_length > 0.0f) ? length / direction_length : 0.0f;
+			vertex.normal = {direction.x * scale, direction.y * scale, (direction_length > 0.0f) ? direction.z * scale : 1.0f};
+		}
+		// Mostly in [0, 1], some tiling far outside and some near zero where half floats are denormal
+		const float texcoord_range = (v % 8 == 0) ? 512.0f : (v % 8 == 1) ? 1e-5f : 1.0f;
+		vertex.texcoord = {(next_random() * 2.0f - 1.0f) * texcoord_range, (next_random() * 2.0f - 1.0f) * texcoord_range};
+	}
+
+	const VertexQuantization quantization = ComputeVertexQuantization(vertices.data(), vertex_number);
+	std::vector<PackedVertex> packed_vertices(vertex_number);
+	double pack_time = 0.0;
+	for (unsigned int iteration = 0; iteration < options.iteration_number; iteration++) {
+		high_resolution_clock::time_point start = high_resolution_clock::now();
+		PackVertices(packed_vertices.data(), vertices.data(), vertex_number, quantization);
+		const double time = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+		pack_time = (iteration == 0) ? time : std::min(pack_time, time);
+	}
+
+	// Position errors in steps of their axis, texcoord errors in half float spacings at the value
+	const float position_steps[3] = {quantization.position_scale.x / 65535.0f, quantization.position_scale.y / 65535.0f,
+		quantization.position_scale.z / 65535.0f};
+	// Encoding and decoding in float add a few ulps of the largest coordinate on top of half a step
+	const float largest_coordinates[3] = {std::max(std::abs(min_corner.x), std::abs(min_corner.x + extent.x)),
+		std::max(std::abs(min_corner.y), std::abs(min_corner.y + extent.y)), std::max(std::abs(min_corner.z), std::abs(min_corner.z + extent.z))};
+	double position_bound_steps = 0.5;
+	for (int axis = 0; axis < 3; axis++) {
+		position_bound_steps = std::max(position_bound_steps, 0.5 + 4.0 * FLT_EPSILON * largest_coordinates[axis] / position_steps[axis]);
+	}
+	double max_position_steps = 0.0;
+	double max_texcoord_spacings = 0.0;
+	for (size_t v = 0; v < vertex_number; v++) {
+		const FullVertex unpacked = UnpackVertex(packed_vertices[v], quantization);
+		const float position_errors[3] = {std::abs(vertices[v].position.x - unpacked.position.x),
+			std::abs(vertices[v].position.y - unpacked.position.y), std::abs(vertices[v].position.z - unpacked.position.z)};
+		for (int axis = 0; axis < 3; axis++) {
+			max_position_steps = std::max(max_position_steps, static_cast<double>(position_errors[axis]) / position_steps[axis]);
+		}
+
+		const float texcoords[2] = {vertices[v].texcoord.x, vertices[v].texcoord.y};
+		const float unpacked_texcoords[2] = {unpacked.texcoord.x, unpacked.texcoord.y};
+		for (int component = 0; component < 2; component++) {
+			// Half floats have 10 fraction bits, denormals are spaced 2^-24 apart
+			int exponent;
+			std::frexp(texcoords[component], &exponent);
+			const double spacing = std::ldexp(1.0, std::max(exponent - 11, -24));
+			max_texcoord_spacings = std::max(max_texcoord_spacings, std::abs(texcoords[component] - unpacked_texcoords[component]) / spacing);
+		}
+	}
+	const VertexPackingError error = MeasureVertexPackingError(vertices.data(), packed_vertices.data(), vertex_number, quantization);
+
+	const bool position_valid = max_position_steps <= position_bound_steps;
+	const bool normal_valid = error.normal_degrees <= max_packed_normal_degrees;
+	const bool texcoord_valid = max_texcoord_spacings <= 0.5;
+	printf("{\"run\": \"packing\", \"vertices\": %zu, \"pack_ms\": %.3f, \"ns_per_vertex\": %.3f, \"max_position_error\": %g, "
+		"\"max_position_steps\": %.5f, \"position_bound_steps\": %.5f, \"max_normal_degrees\": %.5f, \"max_texcoord_error\": %g, \"max_texcoord_spacings\": %.5f, "
+		"\"within_bounds\": %s}\n",
+		vertex_number, pack_time * 1000.0, pack_time * 1e9 / vertex_number, error.position, max_position_steps, position_bound_steps,
+		error.normal_degrees, error.texcoord, max_texcoord_spacings,
+		(position_valid && normal_valid && texcoord_valid) ? "true" : "false");
+	fflush(stdout);
+	return position_valid && normal_valid && texcoord_valid;
+}
+
+// Row vector view projection of a camera at eye looking along yaw around +Y, with
+// the 0 <= z <= w clip space of XMMatrixPerspectiveFovLH
+static XMFLOAT4X4 MakeViewProjection(const XMFLOAT3 &eye, float yaw, float fov_y, float aspect, float near_z, float far_z) {
+	const float forward[3] = {std::sin(yaw), 0.0f, std::cos(yaw)};
+	const float right[3] = {std::cos(yaw), 0.0f, -std::sin(yaw)};
+	const float up[3] = {0.0f, 1.0f, 0.0f};
+	const float eye_position[3] = {eye.x, eye.y, eye.z};
+	const float y_scale = 1.0f / std::tan(fov_y * 0.5f);
+	const float x_scale = y_scale / aspect;
+	const float z_scale = far_z / (far_z - near_z);
+
+	XMFLOAT4X4 matrix = {};
+	for (int i = 0; i < 3; i++) {
+		matrix.m[i][0] = right[i] * x_scale;
+		matrix.m[i][1] = up[i] * y_scale;
+		matrix.m[i][2] = forward[i] * z_scale;
+		matrix.m[i][3] = forward[i];
+		matrix.m[3][0] -= eye_position[i] * right[i] * x_scale;
+		matrix.m[3][1] -= eye_position[i] * up[i] * y_scale;
+		matrix.m[3][2] -= eye_position[i] * forward[i] * z_scale;
+		matrix.m[3][3] -= eye_position[i] * forward[i];
+	}
+	matrix.m[3][2] -= near_z * z_scale;
+	return matrix;
+}
+
+// Culls 100k random boxes from cameras inside and around them, with and without the
+// screen size rejection, through FrustumCuller::Cull and CullReference. Both have to
+// agree on every box; the time is the best of iteration_number runs.
+static bool RunCullingBenchmark(const BenchmarkOptions &options) {
+	const size_t box_number = 100000;
+	unsigned int state = options.generator.seed;
+	auto next_random = [&state]() {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	};
+
+	std::vector<DrawBounds> bounds(box_number);
+	for (DrawBounds &box : bounds) {
+		box.center = {next_random() * 200.0f - 100.0f, next_random() * 200.0f - 100.0f, next_random() * 200.0f - 100.0f};
+		box.extent = {0.05f + next_random() * 5.0f, 0.05f + next_random() * 5.0f, 0.05f + next_random() * 5.0f};
+		box.radius = std::sqrt(box.extent.x * box.extent.x + box.extent.y * box.extent.y + box.extent.z * box.extent.z);
+	}
+	FrustumCuller culler;
+	culler.SetBounds(bounds.data(), box_number);
+
+	std::vector<uint8_t> visibility(box_number);
+	std::vector<uint8_t> reference_visibility(box_number);
+	bool all_match = true;
+	const int view_number = 8;
+	for (int view = 0; view < view_number; view++) {
+		// Every other camera stands outside the boxes, the rest in the middle of them
+		const float distance = (view % 2) ? 150.0f : 0.0f;
+		const float yaw = view * 2.0f * 3.14159265f / view_number;
+		const XMFLOAT3 eye = {-std::sin(yaw) * distance, 10.0f * (view % 3), -std::cos(yaw) * distance};
+		const XMFLOAT4X4 view_projection = MakeViewProjection(eye, yaw, 0.8f, 16.0f / 9.0f, 0.1f, 250.0f);
+		const float min_radius_per_depth = (view < view_number / 2) ? 0.0f : 0.01f;
+
+		double kernel_times[2] = {};
+		size_t visible_numbers[2] = {};
+		for (int kernel = 0; kernel < 2; kernel++) {
+			uint8_t *destination = kernel ? reference_visibility.data() : visibility.data();
+			for (unsigned int iteration = 0; iteration < options.iteration_number; iteration++) {
+				memset(destination, 0xff, box_number);
+				high_resolution_clock::time_point start = high_resolution_clock::now();
+				visible_numbers[kernel] = kernel ? culler.CullReference(view_projection, destination, min_radius_per_depth) :
+					culler.Cull(view_projection, destination, min_radius_per_depth);
+				const double time = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+				kernel_times[kernel] = (iteration == 0) ? time : std::min(kernel_times[kernel], time);
+			}
+		}
+		const bool matches = visible_numbers[0] == visible_numbers[1] && memcmp(visibility.data(), reference_visibility.data(), box_number) == 0;
+		all_match = all_match && matches;
+
+		printf("{\"run\": \"culling\", \"view\": %d, \"boxes\": %zu, \"min_radius_per_depth\": %.3f, \"visible\": %zu, "
+			"\"simd_ns_per_box\": %.3f, \"reference_ns_per_box\": %.3f, \"matches\": %s}\n",
+			view, box_number, min_radius_per_depth, visible_numbers[0], kernel_times[0] * 1e9 / box_number,
+			kernel_times[1] * 1e9 / box_number, matches ? "true" : "false");
+		fflush(stdout);
+	}
+	return all_match;
+}
+
+// Vertex dedup of LoadModel before VertexIndexMap
+typedef std::map<std::tuple<int, int, int>, unsigned int> index_map_type;
+
+// Deduplicates the corners of every material of the OBJ through index_map_type,
+// with count and operator[] like the loader used to, and through VertexIndexMap,
+// sized up front like LoadModel does. Both have to number the vertices the same way.
+static bool RunDedupBenchmark(const BenchmarkOptions &options, const std::string &obj_file) {
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn;
+	std::string err;
+	const std::string base_dir = obj_file.substr(0, obj_file.find_last_of("\\/") + 1);
+	if (!LoadObjParallel(&attrib, &shapes, &materials, nullptr, &warn, &err, obj_file.c_str(), base_dir.c_str(), options.loader.thread_number)) {
+		fprintf(stderr, "Cannot parse %s: %s\n", obj_file.c_str(), err.c_str());
+		return false;
+	}
+
+	// Corners in file order per material, faces without a material are skipped like in LoadModel
+	std::vector<std::vector<tinyobj::index_t>> material_corners(materials.size());
+	size_t corner_number = 0;
+	for (const tinyobj::shape_t &shape : shapes) {
+		size_t index_offset = 0;
+		for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
+			const unsigned int face_vertex_number = shape.mesh.num_face_vertices[f];
+			const int material_id = shape.mesh.material_ids[f];
+			if (material_id >= 0 && static_cast<size_t>(material_id) < materials.size()) {
+				std::vector<tinyobj::index_t> &corners = material_corners[material_id];
+				corners.insert(corners.end(), shape.mesh.indices.begin() + index_offset, shape.mesh.indices.begin() + index_offset + face_vertex_number);
+				corner_number += face_vertex_number;
+			}
+			index_offset += face_vertex_number;
+		}
+	}
+	// Only the corners are needed from here on
+	attrib = tinyobj::attrib_t();
+	std::vector<tinyobj::shape_t>().swap(shapes);
+
+	const char *map_names[] = {"std_map", "vertex_index_map"};
+	std::vector<std::vector<unsigned int>> map_indices[2];
+	size_t vertex_numbers[2] = {};
+	for (unsigned int iteration = 0; iteration < options.iteration_number; iteration++) {
+		for (int map = 0; map < 2; map++) {
+			std::vector<std::vector<unsigned int>>().swap(map_indices[map]);
+			const size_t allocations_before = allocation_number;
+			const size_t bytes_before = allocated_bytes;
+			const size_t live_before = live_bytes;
+			peak_live_bytes = live_before;
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+
+			std::vector<std::vector<unsigned int>> &indices = map_indices[map];
+			indices.resize(materials.size());
+			size_t vertex_number = 0;
+			for (size_t material_id = 0; material_id < materials.size(); material_id++) {
+				const std::vector<tinyobj::index_t> &corners = material_corners[material_id];
+				std::vector<unsigned int> &material_indices = indices[material_id];
+				unsigned int material_vertex_number = 0;
+				if (map == 0) {
+					index_map_type index_map;
+					for (const tinyobj::index_t &corner : corners) {
+						const std::tuple<int, int, int> key = std::make_tuple(corner.vertex_index, corner.normal_index, corner.texcoord_index);
+						if (index_map.count(key) > 0) {
+							material_indices.push_back(index_map[key]);
+						} else {
+							material_indices.push_back(material_vertex_number);
+							index_map[key] = material_vertex_number++;
+						}
+					}
+				} else {
+					VertexIndexMap index_map(corners.size());
+					material_indices.reserve(corners.size());
+					for (const tinyobj::index_t &corner : corners) {
+						bool inserted = false;
+						material_indices.push_back(index_map.FindOrInsert(corner, material_vertex_number, inserted));
+						material_vertex_number += inserted ? 1 : 0;
+					}
+				}
+				vertex_number += material_vertex_number;
+			}
+
+			const double time = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+			vertex_numbers[map] = vertex_number;
+			printf("{\"run\": \"dedup\", \"map\": \"%s\", \"iteration\": %u, \"corners\": %zu, \"vertices\": %zu, \"dedup_ms\": %.3f, "
+				"\"ns_per_corner\": %.3f, \"allocations\": %zu, \"allocated_bytes\": %zu, \"peak_heap_bytes\": %zu}\n",
+				map_names[map], iteration, corner_number, vertex_number, time * 1000.0, corner_number ? time * 1e9 / corner_number : 0.0,
+				allocation_number - allocations_before, allocated_bytes - bytes_before, peak_live_bytes - live_before);
+			fflush(stdout);
+		}
+	}
+
+	const bool matches = vertex_numbers[0] == vertex_numbers[1] && map_indices[0] == map_indices[1];
+	printf("{\"run\": \"dedup_check\", \"corners\": %zu, \"vertices\": %zu, \"matches\": %s}\n",
+		corner_number, vertex_numbers[1], matches ? "true" : "false");
+	fflush(stdout);
+	return matches;
+}
+
+// Encodes every vertex and index stream of the loaded mesh, decodes it
+// iteration_number times and compares the result with the stream byte for byte.
+// Vertex streams are encoded at both levels, index streams have only one.
+static bool RunCodecBenchmark(const BenchmarkOptions &options, const ModelLoader &loader) {
+	struct CodecStream {
+		const char *name;
+		const void *data;
+		size_t element_number;
+		size_t element_size;
+		bool indices;
+	};
+	const size_t position_number = loader.GetPositionStride() ? loader.GetPositionBufferSize() / loader.GetPositionStride() : 0;
+	const CodecStream streams[] = {
+		{"vertices", loader.GetVertexBuffer(), loader.GetVertexNumber(), loader.GetVertexStride(), false},
+		{"positions", loader.GetPositionBuffer(), position_number, loader.GetPositionStride(), false},
+		{"tangents", loader.GetTangentBuffer(), loader.GetTangentBufferSize() / sizeof(PackedTangent), sizeof(PackedTangent), false},
+		{"indices", loader.GetIndexBuffer(), loader.GetIndexNumber(), sizeof(unsigned int), true},
+		{"short_indices", loader.GetShortIndexBuffer(), loader.GetShortIndexNumber(), sizeof(uint16_t), true},
+		{"position_indices", loader.GetPositionIndexBuffer(), loader.GetPositionIndexBufferSize() / sizeof(unsigned int), sizeof(unsigned int), true},
+	};
+	const char *level_names[] = {"fast", "small"};
+
+	bool bit_exact = true;
+	for (const CodecStream &stream : streams) {
+		const size_t raw_size = stream.element_number * stream.element_size;
+		const int last_level = stream.indices ? MESH_CODEC_FAST : MESH_CODEC_SMALL;
+		for (int level = MESH_CODEC_FAST; level <= last_level && raw_size; level++) {
+			std::vector<uint8_t> encoded;
+			high_resolution_clock::time_point encode_start = high_resolution_clock::now();
+			bool matches;
+			if (!stream.indices) {
+				matches = EncodeVertexBuffer(encoded, stream.data, stream.element_number, stream.element_size, static_cast<MeshCodecLevel>(level));
+			} else if (stream.element_size == sizeof(uint16_t)) {
+				matches = EncodeIndexBuffer(encoded, static_cast<const uint16_t *>(stream.data), stream.element_number);
+			} else {
+				matches = EncodeIndexBuffer(encoded, static_cast<const unsigned int *>(stream.data), stream.element_number);
+			}
+			const double encode_time = duration_cast<duration<double>>(high_resolution_clock::now() - encode_start).count();
+
+			std::vector<uint8_t> decoded(raw_size);
+			double decode_time = 0.0;
+			for (unsigned int iteration = 0; iteration < options.iteration_number && matches; iteration++) {
+				memset(decoded.data(), 0xff, decoded.size());
+				high_resolution_clock::time_point decode_start = high_resolution_clock::now();
+				if (!stream.indices) {
+					matches = DecodeVertexBuffer(decoded.data(), stream.element_number, stream.element_size, encoded.data(), encoded.size());
+				} else if (stream.element_size == sizeof(uint16_t)) {
+					matches = DecodeIndexBuffer(reinterpret_cast<uint16_t *>(decoded.data()), stream.element_number, encoded.data(), encoded.size());
+				} else {
+					matches = DecodeIndexBuffer(reinterpret_cast<unsigned int *>(decoded.data()), stream.element_number, encoded.data(), encoded.size());
+				}
+				const double time = duration_cast<duration<double>>(high_resolution_clock::now() - decode_start).count();
+				decode_time = (iteration == 0) ? time : std::min(decode_time, time);
+				matches = matches && memcmp(decoded.data(), stream.data, raw_size) == 0;
+			}
+			bit_exact = bit_exact && matches;
+
+			printf("{\"run\": \"codec\", \"stream\": \"%s\", \"level\": \"%s\", \"raw_bytes\": %zu, \"encoded_bytes\": %zu, \"ratio\": %.4f, "
+				"\"encode_ms\": %.3f, \"decode_ms\": %.3f, \"decode_gb_per_s\": %.3f, \"bit_exact\": %s}\n",
+				stream.name, stream.indices ? "entropy" : level_names[level], raw_size, encoded.size(),
+				static_cast<double>(encoded.size()) / raw_size, encode_time * 1000.0, decode_time * 1000.0,
+				decode_time > 0.0 ? raw_size / decode_time / 1e9 : 0.0, matches ? "true" : "false");
+			fflush(stdout);
+		}
+	}
+	return bit_exact;
+}
+
+struct ReferenceVector {
+	double x;
+	double y;
+	double z;
+};
+
+static ReferenceVector ToReference(const XMFLOAT3 &vector) {
+	return {vector.x, vector.y, vector.z};
+}
+
+static double Dot(const ReferenceVector &a, const ReferenceVector &b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static ReferenceVector Cross(const ReferenceVector &a, const ReferenceVector &b) {
+	return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+static ReferenceVector Scale(const ReferenceVector &a, double scale) {
+	return {a.x * scale, a.y * scale, a.z * scale};
+}
+
+static ReferenceVector Add(const ReferenceVector &a, const ReferenceVector &b) {
+	return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+static ReferenceVector Normalize(const ReferenceVector &a) {
+	const double length = std::sqrt(Dot(a, a));
+	return (length > 0.0) ? Scale(a, 1.0 / length) : a;
+}
+
+// Tangent validation fails beyond this angle to the reference
+static const double max_tangent_error_degrees = 1.0;
+
+// Straightforward double precision MikkTSpace style tangents of one whole material:
+// the classic per triangle solve of the texture space basis, Gram-Schmidt against
+// each corner's normal and angle weighting. Returns per vertex tangent sums and
+// bitangent sums, not yet orthonormalized. Unlike MikkTSpace, a vertex shared by
+// triangles of opposite texture orientation is not split and sums both, triangles
+// without a texture mapping are skipped instead of taking their neighbours' frame,
+// and the texture space magnitudes are dropped.
+static void ComputeReferenceTangents(std::vector<ReferenceVector> &tangent_sums, std::vector<ReferenceVector> &bitangent_sums,
+	const FullVertex *vertices, size_t vertex_number, const std::vector<unsigned int> &indices) {
+	tangent_sums.assign(vertex_number, {0.0, 0.0, 0.0});
+	bitangent_sums.assign(vertex_number, {0.0, 0.0, 0.0});
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const FullVertex *corners[3] = {&vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]]};
+		const ReferenceVector e1 = Add(ToReference(corners[1]->position), Scale(ToReference(corners[0]->position), -1.0));
+		const ReferenceVector e2 = Add(ToReference(corners[2]->position), Scale(ToReference(corners[0]->position), -1.0));
+		const double du1 = static_cast<double>(corners[1]->texcoord.x) - corners[0]->texcoord.x;
+		const double dv1 = static_cast<double>(corners[1]->texcoord.y) - corners[0]->texcoord.y;
+		const double du2 = static_cast<double>(corners[2]->texcoord.x) - corners[0]->texcoord.x;
+		const double dv2 = static_cast<double>(corners[2]->texcoord.y) - corners[0]->texcoord.y;
+		const double determinant = du1 * dv2 - du2 * dv1;
+		if (determinant == 0.0) {
+			continue;
+		}
+		const ReferenceVector face_tangent = Scale(Add(Scale(e1, dv2), Scale(e2, -dv1)), 1.0 / determinant);
+		const ReferenceVector face_bitangent = Scale(Add(Scale(e2, du1), Scale(e1, -du2)), 1.0 / determinant);
+
+		for (int corner = 0; corner < 3; corner++) {
+			const ReferenceVector position = ToReference(corners[corner]->position);
+			const ReferenceVector normal = Normalize(ToReference(corners[corner]->normal));
+			const ReferenceVector next = Add(ToReference(corners[(corner + 1) % 3]->position), Scale(position, -1.0));
+			const ReferenceVector previous = Add(ToReference(corners[(corner + 2) % 3]->position), Scale(position, -1.0));
+			const double angle = std::atan2(std::sqrt(Dot(Cross(next, previous), Cross(next, previous))), Dot(next, previous));
+			const ReferenceVector tangent = Normalize(Add(face_tangent, Scale(normal, -Dot(normal, face_tangent))));
+			const ReferenceVector bitangent = Normalize(Add(face_bitangent, Scale(normal, -Dot(normal, face_bitangent))));
+			tangent_sums[indices[i + corner]] = Add(tangent_sums[indices[i + corner]], Scale(tangent, angle));
+			bitangent_sums[indices[i + corner]] = Add(bitangent_sums[indices[i + corner]], Scale(bitangent, angle));
+		}
+	}
+}
+
+// Prints the angle between the stored and the reference tangents and the number
+// of flipped bitangent signs. Vertices whose reference tangents cancel out have
+// no defined tangent and are only counted. Chunks and sub draws of a material are
+// put back together, bitwise equal vertices being one, and those copies have to
+// carry the same tangent. Fails beyond max_tangent_error_degrees, on any flipped
+// sign or on any copy with another tangent.
+static bool ValidateTangents(const char *run, const ModelLoader &loader) {
+	if (loader.HasPackedVertices() || loader.GetTangentBufferSize() != loader.GetVertexNumber() * sizeof(PackedTangent)) {
+		fprintf(stderr, "Tangent validation needs FullVertex vertices and a tangent for each of them\n");
+		return false;
+	}
+
+	const FullVertex *vertices = static_cast<const FullVertex *>(loader.GetVertexBuffer());
+	const PackedTangent *tangents = loader.GetTangentBuffer();
+	std::vector<ReferenceVector> tangent_sums;
+	std::vector<ReferenceVector> bitangent_sums;
+	double max_error_degrees = 0.0;
+	double error_sum_degrees = 0.0;
+	size_t compared_number = 0;
+	size_t undefined_number = 0;
+	size_t sign_mismatch_number = 0;
+	size_t copy_mismatch_number = 0;
+	high_resolution_clock::time_point reference_start = high_resolution_clock::now();
+
+	std::vector<std::vector<unsigned int>> material_draw_calls(loader.GetMaterialNumber());
+	for (unsigned int draw_call_id = 0; draw_call_id < loader.GetDrawCallNumber(); draw_call_id++) {
+		material_draw_calls[loader.GetDrawCallParams(draw_call_id).material_id].push_back(draw_call_id);
+	}
+
+	// Vertex stream position of every vertex of the material, and the tangent of the first copy of every welded vertex
+	std::vector<FullVertex> material_vertices;
+	std::vector<size_t> stream_vertices;
+	std::vector<unsigned int> material_indices;
+	std::vector<unsigned int> remap;
+	std::vector<FullVertex> welded_vertices;
+	std::vector<size_t> first_copies;
+	for (const std::vector<unsigned int> &draw_calls : material_draw_calls) {
+		material_vertices.clear();
+		stream_vertices.clear();
+		material_indices.clear();
+		for (unsigned int draw_call_id : draw_calls) {
+			const DrawCallParams params = loader.GetDrawCallParams(draw_call_id);
+			const MeshBuffer buffer = loader.GetBuffer(params.buffer_id);
+			const size_t draw_start_vertex = buffer.start_vertex + params.start_vertex;
+			const unsigned int material_start_vertex = static_cast<unsigned int>(material_vertices.size());
+			for (unsigned int v = 0; v < params.vertex_num; v++) {
+				material_vertices.push_back(vertices[draw_start_vertex + v]);
+				stream_vertices.push_back(draw_start_vertex + v);
+			}
+			for (unsigned int i = 0; i < params.index_num; i++) {
+				material_indices.push_back(material_start_vertex + ((params.index_size == sizeof(uint16_t)) ?
+					loader.GetShortIndexBuffer()[buffer.start_short_index + params.start_index + i] :
+					loader.GetIndexBuffer()[buffer.start_index + params.start_index + i]));
+			}
+		}
+
+		remap.resize(material_vertices.size());
+		const size_t welded_number = GeneratePositionRemap(remap.data(), material_vertices.data(), material_vertices.size(),
+			sizeof(FullVertex), sizeof(FullVertex));
+		welded_vertices.resize(welded_number);
+		first_copies.assign(welded_number, SIZE_MAX);
+		for (size_t v = 0; v < material_vertices.size(); v++) {
+			welded_vertices[remap[v]] = material_vertices[v];
+		}
+		for (unsigned int &index : material_indices) {
+			index = remap[index];
+		}
+		ComputeReferenceTangents(tangent_sums, bitangent_sums, welded_vertices.data(), welded_number, material_indices);
+
+		for (size_t v = 0; v < material_vertices.size(); v++) {
+			const unsigned int welded = remap[v];
+			const PackedTangent &packed = tangents[stream_vertices[v]];
+			if (first_copies[welded] == SIZE_MAX) {
+				first_copies[welded] = stream_vertices[v];
+			} else if (memcmp(&packed, &tangents[first_copies[welded]], sizeof(PackedTangent)) != 0) {
+				copy_mismatch_number++;
+			}
+
+			const ReferenceVector normal = Normalize(ToReference(welded_vertices[welded].normal));
+			const ReferenceVector projected = Add(tangent_sums[welded], Scale(normal, -Dot(normal, tangent_sums[welded])));
+			if (Dot(projected, projected) < 1e-12) {
+				undefined_number++;
+				continue;
+			}
+			const ReferenceVector reference = Normalize(projected);
+			const double reference_sign = (Dot(Cross(normal, reference), bitangent_sums[welded]) < 0.0) ? -1.0 : 1.0;
+
+			const XMFLOAT4 tangent = UnpackTangent(packed);
+			const double cosine = std::max(-1.0, std::min(1.0, Dot(reference, {tangent.x, tangent.y, tangent.z})));
+			const double error_degrees = std::acos(cosine) * 180.0 / 3.14159265358979;
+			max_error_degrees = std::max(max_error_degrees, error_degrees);
+			error_sum_degrees += error_degrees;
+			sign_mismatch_number += (reference_sign != tangent.w) ? 1 : 0;
+			compared_number++;
+		}
+	}
+	const double reference_time = duration_cast<duration<double>>(high_resolution_clock::now() - reference_start).count();
+
+	const bool valid = max_error_degrees <= max_tangent_error_degrees && sign_mismatch_number == 0 && copy_mismatch_number == 0;
+	printf("{\"run\": \"%s_tangents\", \"vertices\": %zu, \"undefined\": %zu, \"mean_error_degrees\": %.5f, "
+		"\"max_error_degrees\": %.5f, \"sign_mismatches\": %zu, \"copy_mismatches\": %zu, \"reference_ms\": %.3f, \"valid\": %s}\n",
+		run, compared_number, undefined_number, compared_number ? error_sum_degrees / compared_number : 0.0,
+		max_error_degrees, sign_mismatch_number, copy_mismatch_number, reference_time * 1000.0, valid ? "true" : "false");
+	fflush(stdout);
+	return valid;
+}
+
+struct BufferChecksums {
+	// Order independent sums of the full detail triangles, read through the vertex buffers...
+	uint64_t vertex_triangles;
+	// ...the position part of the same vertices...
+	uint64_t vertex_position_triangles;
+	// ...and through the position buffers
+	uint64_t position_triangles;
+};
+
+static uint64_t HashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ull) {
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// Checks that the buffers cover every stream in order with slices below
+// max_buffer_size, and that every draw call and level of detail stays inside
+// the slices of its own buffer. Returns the largest slice in bytes, 0 when a
+// check fails.
+static uint64_t ValidateBuffers(const ModelLoader &loader, uint64_t max_buffer_size, BufferChecksums &checksums) {
+	const uint64_t vertex_stride = loader.GetVertexStride();
+	const uint64_t position_stride = loader.GetPositionStride();
+	const bool position_stream = loader.GetPositionBufferSize() > 0;
+	const char *vertices = static_cast<const char *>(loader.GetVertexBuffer());
+	const char *positions = static_cast<const char *>(loader.GetPositionBuffer());
+	const unsigned int *indices = loader.GetIndexBuffer();
+	const uint16_t *short_indices = loader.GetShortIndexBuffer();
+	const unsigned int *position_indices = loader.GetPositionIndexBuffer();
+	const bool has_tangents = loader.GetTangentBufferSize() > 0;
+	checksums = {};
+
+	// Where the next buffer has to start in every stream
+	MeshBuffer next = {};
+	uint64_t largest_slice = 0;
+	bool valid = loader.GetBufferNumber() > 0 && (!has_tangents || loader.GetTangentBufferSize() == loader.GetVertexNumber() * sizeof(PackedTangent));
+	for (unsigned int buffer_id = 0; buffer_id < loader.GetBufferNumber() && valid; buffer_id++) {
+		const MeshBuffer buffer = loader.GetBuffer(buffer_id);
+		valid = buffer.start_vertex == next.start_vertex && buffer.start_index == next.start_index &&
+			buffer.start_short_index == next.start_short_index && buffer.start_position == next.start_position &&
+			buffer.start_position_index == next.start_position_index && buffer.start_draw_call == next.start_draw_call;
+		next.start_vertex += buffer.vertex_num;
+		next.start_index += buffer.index_num;
+		next.start_short_index += buffer.short_index_num;
+		next.start_position += buffer.position_num;
+		next.start_position_index += buffer.position_index_num;
+		next.start_draw_call += buffer.draw_call_num;
+
+		const uint64_t slice_sizes[] = {buffer.vertex_num * vertex_stride, buffer.index_num * sizeof(unsigned int),
+			buffer.short_index_num * sizeof(uint16_t), buffer.position_num * position_stride,
+			buffer.position_index_num * sizeof(unsigned int), has_tangents ? buffer.vertex_num * sizeof(PackedTangent) : 0};
+		for (uint64_t slice_size : slice_sizes) {
+			valid = valid && slice_size <= max_buffer_size;
+			largest_slice = std::max(largest_slice, slice_size);
+		}
+	}
+	valid = valid && next.start_vertex == loader.GetVertexNumber() && next.start_index == loader.GetIndexNumber() &&
+		next.start_short_index == loader.GetShortIndexNumber() &&
+		next.start_position * position_stride == loader.GetPositionBufferSize() &&
+		next.start_position_index * sizeof(unsigned int) == loader.GetPositionIndexBufferSize() &&
+		next.start_draw_call == loader.GetDrawCallNumber();
+
+	for (unsigned int draw_call_id = 0; draw_call_id < loader.GetDrawCallNumber() && valid; draw_call_id++) {
+		const DrawCallParams params = loader.GetDrawCallParams(draw_call_id);
+		valid = params.buffer_id < loader.GetBufferNumber();
+		const MeshBuffer buffer = loader.GetBuffer(valid ? params.buffer_id : 0);
+		const bool short_draw = params.index_size == sizeof(uint16_t);
+		const uint64_t buffer_index_number = short_draw ? buffer.short_index_num : buffer.index_num;
+		// BaseVertexLocation is a signed 32-bit value
+		valid = valid && draw_call_id >= buffer.start_draw_call && draw_call_id - buffer.start_draw_call < buffer.draw_call_num &&
+			params.start_vertex <= static_cast<unsigned int>(INT_MAX) && params.start_vertex + static_cast<uint64_t>(params.vertex_num) <= buffer.vertex_num;
+
+		for (unsigned int level = 0; level < loader.GetDrawLodNumber(draw_call_id) && valid; level++) {
+			const DrawLod lod = loader.GetDrawLod(draw_call_id, level);
+			valid = lod.start_index + static_cast<uint64_t>(lod.index_num) <= buffer_index_number &&
+				(!position_stream || lod.position_start_index + static_cast<uint64_t>(lod.index_num) <= buffer.position_index_num);
+			for (unsigned int i = 0; i < lod.index_num && valid; i += 3) {
+				uint64_t vertex_hash = 14695981039346656037ull;
+				uint64_t vertex_position_hash = vertex_hash;
+				uint64_t position_hash = vertex_hash;
+				for (unsigned int corner = 0; corner < 3 && valid; corner++) {
+					const uint64_t index = short_draw ? short_indices[buffer.start_short_index + lod.start_index + i + corner] :
+						indices[buffer.start_index + lod.start_index + i + corner];
+					valid = index < params.vertex_num;
+					const char *vertex = vertices + (buffer.start_vertex + params.start_vertex + index) * vertex_stride;
+					vertex_hash = HashBytes(vertex, vertex_stride, vertex_hash);
+					vertex_position_hash = HashBytes(vertex, position_stride, vertex_position_hash);
+					if (position_stream && valid) {
+						const uint64_t position_index = position_indices[buffer.start_position_index + lod.position_start_index + i + corner];
+						valid = position_index < buffer.position_num;
+						position_hash = HashBytes(positions + (buffer.start_position + position_index) * position_stride, position_stride, position_hash);
+					}
+				}
+				if (level == 0) {
+					checksums.vertex_triangles += vertex_hash;
+					checksums.vertex_position_triangles += vertex_position_hash;
+					checksums.position_triangles += position_stream ? position_hash : vertex_position_hash;
+				}
+			}
+		}
+	}
+	return valid ? std::max<uint64_t>(largest_slice, 1) : 0;
+}
+
+// Loads the mesh with the default limit as the reference, then with limits at
+// the boundaries the reference implies: where the largest stream stops fitting
+// one buffer and where the largest draw call stops fitting one buffer on its
+// own. Every limit is loaded cold and cooked, checked with ValidateBuffers and
+// has to draw the same triangles as the reference.
+static bool RunBufferBenchmark(const BenchmarkOptions &options, const std::string &cache_file) {
+	remove(cache_file.c_str());
+	ModelLoader reference;
+	reference.SetOptions(options.loader);
+	BufferChecksums reference_checksums;
+	if (FAILED(reference.LoadModel(options.obj_file)) ||
+		!ValidateBuffers(reference, std::min<uint64_t>(options.loader.max_buffer_size, 0xFFFFFFFFull), reference_checksums)) {
+		fprintf(stderr, "Reference load failed\n");
+		return false;
+	}
+
+	// Mirrors the limits of ModelLoader: streams and draw calls with their whole level of detail chain
+	const uint64_t largest_stream = std::max({reference.GetVertexBufferSize(), reference.GetIndexBufferSize(),
+		reference.GetShortIndexBufferSize(), reference.GetPositionIndexBufferSize()});
+	uint64_t largest_draw_call = 0;
+	for (unsigned int draw_call_id = 0; draw_call_id < reference.GetDrawCallNumber(); draw_call_id++) {
+		const DrawCallParams params = reference.GetDrawCallParams(draw_call_id);
+		largest_draw_call = std::max({largest_draw_call, static_cast<uint64_t>(params.vertex_num) * reference.GetVertexStride(),
+			static_cast<uint64_t>(params.index_num) * sizeof(unsigned int) * (options.loader.lod_level_number + 1)});
+	}
+	const uint64_t limits[] = {largest_stream, largest_stream - 1, largest_stream / 16, largest_draw_call, largest_draw_call - 1, largest_draw_call / 8};
+
+	bool all_valid = reference_checksums.vertex_position_triangles == reference_checksums.position_triangles;
+	for (uint64_t limit : limits) {
+		LoaderOptions loader_options = options.loader;
+		loader_options.max_buffer_size = limit;
+		remove(cache_file.c_str());
+		for (int cooked = 0; cooked < 2; cooked++) {
+			ModelLoader loader;
+			loader.SetOptions(loader_options);
+			if (FAILED(loader.LoadModel(options.obj_file))) {
+				fprintf(stderr, "Cannot load %s\n", options.obj_file.c_str());
+				return false;
+			}
+			BufferChecksums checksums;
+			const uint64_t largest_slice = ValidateBuffers(loader, limit, checksums);
+			const bool triangles_match = checksums.vertex_triangles == reference_checksums.vertex_triangles &&
+				checksums.position_triangles == reference_checksums.position_triangles &&
+				checksums.vertex_position_triangles == checksums.position_triangles;
+			// Exactly at the boundary everything still fits, one byte less splits
+			const bool buffers_expected = (limit >= std::max(largest_stream, largest_draw_call)) ? loader.GetBufferNumber() == 1 :
+				(limit < largest_stream) ? loader.GetBufferNumber() > 1 : true;
+			const bool draw_calls_expected = (limit >= largest_draw_call) ? loader.GetDrawCallNumber() == reference.GetDrawCallNumber() :
+				loader.GetDrawCallNumber() > reference.GetDrawCallNumber();
+			const bool valid = largest_slice != 0 && triangles_match && buffers_expected && draw_calls_expected;
+			all_valid = all_valid && valid;
+
+			printf("{\"run\": \"buffers\", \"cache_hit\": %s, \"max_buffer_size\": %llu, \"largest_slice\": %llu, \"buffers\": %u, "
+				"\"draw_calls\": %u, \"vertices\": %zu, \"triangles_match\": %s, \"valid\": %s}\n",
+				loader.GetStatistics().cache_hit ? "true" : "false", static_cast<unsigned long long>(limit),
+				static_cast<unsigned long long>(largest_slice), loader.GetBufferNumber(), loader.GetDrawCallNumber(), loader.GetVertexNumber(),
+				triangles_match ? "true" : "false", valid ? "true" : "false");
+			fflush(stdout);
+		}
+	}
+	remove(cache_file.c_str());
+	return all_valid;
+}
+
+// Loads the mesh in memory as the reference, then converts it out of core and
+// loads the cooked mesh that wrote. Both have to pass ValidateBuffers and draw
+// the same triangles as the reference, and the live heap of the conversion is
+// compared with the memory budget.
+static bool RunStreamingBenchmark(const BenchmarkOptions &options, const std::string &cache_file) {
+	remove(cache_file.c_str());
+	LoaderOptions reference_options = options.loader;
+	reference_options.streaming_memory_budget = 0;
+	BufferChecksums reference_checksums;
+	{
+		ModelLoader reference;
+		reference.SetOptions(reference_options);
+		if (FAILED(reference.LoadModel(options.obj_file)) ||
+			!ValidateBuffers(reference, std::min<uint64_t>(options.loader.max_buffer_size, 0xFFFFFFFFull), reference_checksums)) {
+			fprintf(stderr, "Reference load failed\n");
+			return false;
+		}
+	}
+	remove(cache_file.c_str());
+
+	bool all_valid = true;
+	const char *runs[] = {"streaming", "cooked"};
+	for (const char *run : runs) {
+		const size_t allocations_before = allocation_number;
+		const size_t bytes_before = allocated_bytes;
+		const size_t live_before = live_bytes;
+		peak_live_bytes = live_before;
+		ModelLoader loader;
+		loader.SetOptions(options.loader);
+		if (FAILED(loader.LoadModel(options.obj_file))) {
+			fprintf(stderr, "Cannot convert %s\n", options.obj_file.c_str());
+			return false;
+		}
+		const size_t peak_heap = peak_live_bytes - live_before;
+		std::error_code error;
+		const uintmax_t cache_bytes = std::filesystem::file_size(cache_file, error);
+		PrintRun(run, 0, loader, error ? 0 : static_cast<size_t>(cache_bytes),
+			allocation_number - allocations_before, allocated_bytes - bytes_before, peak_heap, options);
+
+		BufferChecksums checksums;
+		const bool buffers_valid = ValidateBuffers(loader, std::min<uint64_t>(options.loader.max_buffer_size, 0xFFFFFFFFull), checksums) != 0;
+		const bool triangles_match = checksums.vertex_triangles == reference_checksums.vertex_triangles &&
+			checksums.position_triangles == reference_checksums.position_triangles;
+		all_valid = all_valid && buffers_valid && triangles_match;
+		printf("{\"run\": \"%s_check\", \"memory_budget\": %llu, \"peak_heap_bytes\": %zu, \"within_budget\": %s, "
+			"\"triangles_match\": %s, \"valid\": %s}\n",
+			run, static_cast<unsigned long long>(options.loader.streaming_memory_budget), peak_heap,
+			peak_heap <= options.loader.streaming_memory_budget ? "true" : "false", triangles_match ? "true" : "false",
+			buffers_valid ? "true" : "false");
+		fflush(stdout);
+		if (options.tangents && !ValidateTangents(run, loader)) {
+			all_valid = false;
+		}
+	}
+	remove(cache_file.c_str());
+	return all_valid;
+}
+
+int main(int argc, char **argv) {
+#ifndef _WIN32
+	module_argument = argc > 0 ? argv[0] : nullptr;
+#endif
+	BenchmarkOptions options;
+	if (!ParseArguments(argc, argv, options)) {
+		return 1;
+	}
+	if (options.kernels) {
+		return RunKernelBenchmark(options) ? 0 : 1;
+	}
+	if (options.packing) {
+		return RunPackingBenchmark(options) ? 0 : 1;
+	}
+	if (options.culling) {
+		return RunCullingBenchmark(options) ? 0 : 1;
+	}
+
+	const std::string obj_file = GetBinPath(options.obj_file);
+	const std::string cache_file = obj_file + ".cache";
+	if (options.generate) {
+		high_resolution_clock::time_point generation_start = high_resolution_clock::now();
+		if (!GenerateObj(obj_file, options.generator)) {
+			fprintf(stderr, "Cannot write %s\n", obj_file.c_str());
+			return 1;
+		}
+		duration<double> generation_time = duration_cast<duration<double>>(high_resolution_clock::now() - generation_start);
+		fprintf(stderr, "Generated %s in %.1f ms\n", obj_file.c_str(), generation_time.count() * 1000.0);
+	}
+	if (options.dedup) {
+		return RunDedupBenchmark(options, obj_file) ? 0 : 1;
+	}
+	if (options.buffers) {
+		return RunBufferBenchmark(options, cache_file) ? 0 : 1;
+	}
+	if (options.streaming) {
+		return RunStreamingBenchmark(options, cache_file) ? 0 : 1;
+	}
+
+	for (unsigned int iteration = 0; iteration < options.iteration_number; iteration++) {
+		// Cold load from the OBJ, then a load of the cooked mesh it wrote
+		const char *runs[] = {"obj", "cooked"};
+		for (const char *run : runs) {
+			if (strcmp(run, "obj") == 0) {
+				remove(cache_file.c_str());
+			}
+
+			const size_t allocations_before = allocation_number;
+			const size_t bytes_before = allocated_bytes;
+			const size_t live_before = live_bytes;
+			peak_live_bytes = live_before;
+			ModelLoader loader;
+			loader.SetOptions(options.loader);
+			if (FAILED(loader.LoadModel(options.obj_file))) {
+				fprintf(stderr, "Cannot load %s\n", obj_file.c_str());
+				return 1;
+			}
+			std::error_code error;
+			const uintmax_t cache_bytes = std::filesystem::file_size(cache_file, error);
+			PrintRun(run, iteration, loader, error ? 0 : static_cast<size_t>(cache_bytes),
+				allocation_number - allocations_before, allocated_bytes - bytes_before, peak_live_bytes - live_before, options);
+			if (options.tangents && !ValidateTangents(run, loader)) {
+				return 1;
+			}
+			if (options.codec && iteration == 0 && strcmp(run, "obj") == 0 && !RunCodecBenchmark(options, loader)) {
+				return 1;
+			}
+		}
+	}
+
+	remove(cache_file.c_str());
+	return 0;
+}
@@ -0,0 +1,116 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string &path) {
+	Close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	file_handle = file;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		Close();
+		return false;
+	}
+
+	// Empty files cannot be mapped
+	size = static_cast<size_t>(file_size.QuadPart);
+	if (size == 0) {
+		return true;
+	}
+
+	mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_handle == nullptr) {
+		Close();
+		return false;
+	}
+
+	data = static_cast<const char *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data != nullptr) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping_handle != nullptr) {
+		CloseHandle(mapping_handle);
+	}
+	if (file_handle != nullptr) {
+		CloseHandle(file_handle);
+	}
+	data = nullptr;
+	size = 0;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string &path) {
+	Close();
+
+	file_descriptor = open(path.c_str(), O_RDONLY);
+	if (file_descriptor < 0) {
+		return false;
+	}
+
+	struct stat file_status;
+	if (fstat(file_descriptor, &file_status) != 0) {
+		Close();
+		return false;
+	}
+
+	// Empty files cannot be mapped
+	size = static_cast<size_t>(file_status.st_size);
+	if (size == 0) {
+		return true;
+	}
+
+	void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+	if (mapping == MAP_FAILED) {
+		Close();
+		return false;
+	}
+	madvise(mapping, size, MADV_SEQUENTIAL);
+	data = static_cast<const char *>(mapping);
+
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data != nullptr) {
+		munmap(const_cast<char *>(data), size);
+	}
+	if (file_descriptor >= 0) {
+		close(file_descriptor);
+	}
+	data = nullptr;
+	size = 0;
+	file_descriptor = -1;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+// Read only memory mapping of a whole file
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool Open(const std::string &path);
+	void Close();
+
+	const char *GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+protected:
+	const char *data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+#else
+	int file_descriptor = -1;
+#endif
+};
@@ -0,0 +1,267 @@
+#include "mesh_cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+static const char mesh_cache_magic[4] = {'D', 'X', 'M', 'C'};
+static const uint32_t mesh_cache_version = 1;
+static const uint64_t section_alignment = 16;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline uint64_t RotateLeft(uint64_t value, int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// Four independent multiply-rotate lanes over 8 byte words keep the checksum
+// close to memory speed. Sections are chained through seed.
+static uint64_t ComputeChecksum(const void *bytes, size_t size, uint64_t seed) {
+	const char *data = static_cast<const char *>(bytes);
+	const uint64_t prime_1 = 0x9E3779B185EBCA87ull;
+	const uint64_t prime_2 = 0xC2B2AE3D27D4EB4Full;
+	uint64_t lanes[4] = {seed + prime_1 + prime_2, seed + prime_2, seed, seed - prime_1};
+
+	size_t offset = 0;
+	for (; offset + 32 <= size; offset += 32) {
+		for (int lane = 0; lane < 4; lane++) {
+			uint64_t word;
+			memcpy(&word, data + offset + 8 * lane, sizeof(word));
+			lanes[lane] = RotateLeft(lanes[lane] + word * prime_2, 31) * prime_1;
+		}
+	}
+
+	uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+	for (; offset < size; offset++) {
+		hash = RotateLeft(hash ^ (static_cast<uint8_t>(data[offset]) * prime_1), 11) * prime_2;
+	}
+
+	hash ^= size;
+	hash ^= hash >> 33;
+	hash *= prime_2;
+	hash ^= hash >> 29;
+	return hash;
+}
+
+void MeshCacheWriter::AddSection(uint32_t id, const void *data, size_t size) {
+	sections.push_back({id, data, size});
+}
+
+bool MeshCacheWriter::Write(const std::string &path, uint64_t source_stamp, uint32_t layout_stamp) const {
+	std::vector<MeshCacheSection> table(sections.size());
+	uint64_t offset = AlignUp(sizeof(MeshCacheHeader) + sections.size() * sizeof(MeshCacheSection), section_alignment);
+	for (size_t s = 0; s < sections.size(); s++) {
+		table[s] = {sections[s].id, 0, offset, sections[s].size};
+		offset = AlignUp(offset + sections[s].size, section_alignment);
+	}
+
+	MeshCacheHeader header = {};
+	memcpy(header.magic, mesh_cache_magic, sizeof(header.magic));
+	header.version = mesh_cache_version;
+	header.source_stamp = source_stamp;
+	header.layout_stamp = layout_stamp;
+	header.section_number = static_cast<uint32_t>(sections.size());
+	header.checksum = ComputeChecksum(table.data(), table.size() * sizeof(MeshCacheSection), 0);
+	for (const PendingSection &section : sections) {
+		header.checksum = ComputeChecksum(section.data, section.size, header.checksum);
+	}
+
+	// Write to a temporary file first, so a crash never leaves a broken cache behind
+	const std::string temporary_path = path + ".tmp";
+	bool file_written;
+	{
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(MeshCacheSection));
+
+		const char padding[section_alignment] = {};
+		uint64_t written = sizeof(header) + table.size() * sizeof(MeshCacheSection);
+		for (size_t s = 0; s < sections.size(); s++) {
+			file.write(padding, static_cast<std::streamsize>(table[s].offset - written));
+			file.write(static_cast<const char *>(sections[s].data), static_cast<std::streamsize>(sections[s].size));
+			written = table[s].offset + table[s].size;
+		}
+
+		file.close();
+		file_written = static_cast<bool>(file);
+	}
+
+	// A temporary file that never became the cache is not left behind
+	std::error_code error;
+	if (file_written) {
+		std::filesystem::rename(temporary_path, path, error);
+	}
+	if (!file_written || error) {
+		std::filesystem::remove(temporary_path, error);
+		return false;
+	}
+	return true;
+}
+
+bool MeshCacheReader::Open(const std::string &path, uint64_t source_stamp, uint32_t layout_stamp) {
+	Close();
+	if (!file.Open(path) || file.GetSize() < sizeof(MeshCacheHeader)) {
+		Close();
+		return false;
+	}
+
+	MeshCacheHeader header;
+	memcpy(&header, file.GetData(), sizeof(header));
+	if (memcmp(header.magic, mesh_cache_magic, sizeof(header.magic)) != 0 ||
+		header.version != mesh_cache_version ||
+		header.source_stamp != source_stamp ||
+		header.layout_stamp != layout_stamp ||
+		sizeof(MeshCacheHeader) + header.section_number * sizeof(MeshCacheSection) > file.GetSize()) {
+		Close();
+		return false;
+	}
+
+	const MeshCacheSection *table = reinterpret_cast<const MeshCacheSection *>(file.GetData() + sizeof(MeshCacheHeader));
+	uint64_t checksum = ComputeChecksum(table, header.section_number * sizeof(MeshCacheSection), 0);
+	for (uint32_t s = 0; s < header.section_number; s++) {
+		if (table[s].offset > file.GetSize() || table[s].size > file.GetSize() - table[s].offset) {
+			Close();
+			return false;
+		}
+		checksum = ComputeChecksum(file.GetData() + table[s].offset, static_cast<size_t>(table[s].size), checksum);
+	}
+
+	if (checksum != header.checksum) {
+		Close();
+		return false;
+	}
+
+	sections = table;
+	section_number = header.section_number;
+	return true;
+}
+
+void MeshCacheReader::Close() {
+	file.Close();
+	sections = nullptr;
+	section_number = 0;
+}
+
+const void *MeshCacheReader::GetSection(uint32_t id, size_t &size) const {
+	for (uint32_t s = 0; s < section_number; s++) {
+		if (sections[s].id == id) {
+			size = static_cast<size_t>(sections[s].size);
+			return file.GetData() + sections[s].offset;
+		}
+	}
+
+	size = 0;
+	return nullptr;
+}
+
+uint64_t GetSourceStamp(const std::string &path) {
+	std::error_code error;
+	const uint64_t size = std::filesystem::file_size(path, error);
+	if (error) {
+		return 0;
+	}
+	const uint64_t time = static_cast<uint64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+	if (error) {
+		return 0;
+	}
+
+	return (size * 0x9E3779B97F4A7C15ull) ^ time;
+}
+
+uint64_t GetMaterialLibraryStamp(const std::string &basedir, const std::vector<std::string> &libraries) {
+	// Libraries which do not exist still count, so creating one changes the stamp too
+	uint64_t stamp = libraries.size();
+	for (const std::string &library : libraries) {
+		stamp = RotateLeft((stamp ^ GetSourceStamp(basedir + library)) * 0xC2B2AE3D27D4EB4Full, 29);
+	}
+	return stamp;
+}
+
+static void AppendBytes(std::vector<char> &blob, const void *data, size_t size) {
+	const char *bytes = static_cast<const char *>(data);
+	blob.insert(blob.end(), bytes, bytes + size);
+}
+
+static void AppendString(std::vector<char> &blob, const std::string &string) {
+	const uint32_t length = static_cast<uint32_t>(string.size());
+	AppendBytes(blob, &length, sizeof(length));
+	AppendBytes(blob, string.data(), string.size());
+}
+
+static bool ReadBytes(const char *&data, const char *end, void *value, size_t size) {
+	if (static_cast<size_t>(end - data) < size) {
+		return false;
+	}
+	memcpy(value, data, size);
+	data += size;
+	return true;
+}
+
+static bool ReadString(const char *&data, const char *end, std::string &string) {
+	uint32_t length;
+	if (!ReadBytes(data, end, &length, sizeof(length)) || static_cast<size_t>(end - data) < length) {
+		return false;
+	}
+	string.assign(data, length);
+	data += length;
+	return true;
+}
+
+std::vector<char> SerializeMaterials(const std::vector<tinyobj::material_t> &materials) {
+	std::vector<char> blob;
+	const uint32_t material_number = static_cast<uint32_t>(materials.size());
+	AppendBytes(blob, &material_number, sizeof(material_number));
+	for (const tinyobj::material_t &material : materials) {
+		AppendString(blob, material.name);
+		AppendBytes(blob, material.diffuse, sizeof(material.diffuse));
+		AppendString(blob, material.diffuse_texname);
+	}
+	return blob;
+}
+
+bool DeserializeMaterials(const char *data, size_t size, std::vector<tinyobj::material_t> &materials) {
+	const char *end = data + size;
+	uint32_t material_number;
+	if (data == nullptr || !ReadBytes(data, end, &material_number, sizeof(material_number))) {
+		return false;
+	}
+
+	materials.assign(material_number, tinyobj::material_t());
+	for (tinyobj::material_t &material : materials) {
+		if (!ReadString(data, end, material.name) ||
+			!ReadBytes(data, end, material.diffuse, sizeof(material.diffuse)) ||
+			!ReadString(data, end, material.diffuse_texname)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::vector<char> SerializeMaterialLibraries(const std::vector<std::string> &libraries, uint64_t stamp) {
+	std::vector<char> blob;
+	const uint32_t library_number = static_cast<uint32_t>(libraries.size());
+	AppendBytes(blob, &stamp, sizeof(stamp));
+	AppendBytes(blob, &library_number, sizeof(library_number));
+	for (const std::string &library : libraries) {
+		AppendString(blob, library);
+	}
+	return blob;
+}
+
+bool DeserializeMaterialLibraries(const char *data, size_t size, std::vector<std::string> &libraries, uint64_t &stamp) {
+	const char *end = data + size;
+	uint32_t library_number;
+	if (data == nullptr || !ReadBytes(data, end, &stamp, sizeof(stamp)) || !ReadBytes(data, end, &library_number, sizeof(library_number))) {
+		return false;
+	}
+
+	libraries.assign(library_number, std::string());
+	for (std::string &library : libraries) {
+		if (!ReadString(data, end, library)) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "tiny_obj_loader.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sections of a cooked mesh file
+enum MeshCacheSectionId : uint32_t {
+	MESH_CACHE_VERTICES = 1,
+	MESH_CACHE_INDICES = 2,
+	MESH_CACHE_DRAW_CALLS = 3,
+	MESH_CACHE_MATERIALS = 4,
+	MESH_CACHE_PACKED_VERTICES = 5,
+	MESH_CACHE_VERTEX_QUANTIZATION = 6,
+	MESH_CACHE_SHORT_INDICES = 7,
+	MESH_CACHE_POSITIONS = 8,
+	MESH_CACHE_POSITION_INDICES = 9,
+	MESH_CACHE_POSITION_INDEX_OFFSETS = 10,
+	MESH_CACHE_DRAW_BOUNDS = 11,
+	MESH_CACHE_MESHLETS = 12,
+	MESH_CACHE_MESHLET_BOUNDS = 13,
+	MESH_CACHE_MESHLET_VERTICES = 14,
+	MESH_CACHE_MESHLET_TRIANGLES = 15,
+	MESH_CACHE_MESHLET_OFFSETS = 16,
+	MESH_CACHE_DRAW_LODS = 17,
+	MESH_CACHE_DRAW_LOD_OFFSETS = 18,
+	MESH_CACHE_TANGENTS = 19,
+	// Encoded with mesh_codec instead of the plain sections above
+	MESH_CACHE_ENCODED_SIZES = 20,
+	MESH_CACHE_ENCODED_VERTICES = 21,
+	MESH_CACHE_ENCODED_INDICES = 22,
+	MESH_CACHE_ENCODED_SHORT_INDICES = 23,
+	MESH_CACHE_ENCODED_POSITIONS = 24,
+	MESH_CACHE_ENCODED_POSITION_INDICES = 25,
+	MESH_CACHE_ENCODED_TANGENTS = 26,
+	MESH_CACHE_MESH_BUFFERS = 27,
+	MESH_CACHE_MATERIAL_LIBRARIES = 28,
+};
+
+// Cooked mesh file layout: a header, a table of sections and the section data,
+// every section aligned to 16 bytes. The header stores the format version, a
+// stamp of the source file, a stamp of the in-memory layout of the stored
+// structures and a checksum of the section table and data.
+struct MeshCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t source_stamp;
+	uint64_t checksum;
+	uint32_t layout_stamp;
+	uint32_t section_number;
+};
+
+struct MeshCacheSection {
+	uint32_t id;
+	uint32_t reserved;
+	uint64_t offset;
+	uint64_t size;
+};
+
+class MeshCacheWriter {
+public:
+	// Data is referenced, not copied, until Write is called
+	void AddSection(uint32_t id, const void *data, size_t size);
+
+	template <typename T>
+	void AddArray(uint32_t id, const std::vector<T> &array) {
+		AddSection(id, array.data(), array.size() * sizeof(T));
+	}
+
+	bool Write(const std::string &path, uint64_t source_stamp, uint32_t layout_stamp) const;
+
+protected:
+	struct PendingSection {
+		uint32_t id;
+		const void *data;
+		size_t size;
+	};
+	std::vector<PendingSection> sections;
+};
+
+class MeshCacheReader {
+public:
+	// Maps the file and validates version, stamps and checksum
+	bool Open(const std::string &path, uint64_t source_stamp, uint32_t layout_stamp);
+	void Close();
+
+	const void *GetSection(uint32_t id, size_t &size) const;
+
+	template <typename T>
+	const T *GetArray(uint32_t id, size_t &count) const {
+		size_t size = 0;
+		const void *data = GetSection(id, size);
+		count = size / sizeof(T);
+		return static_cast<const T *>(data);
+	}
+
+protected:
+	MappedFile file;
+	const MeshCacheSection *sections = nullptr;
+	uint32_t section_number = 0;
+};
+
+// Stamp which changes whenever the file at path is modified, 0 if it does not exist
+uint64_t GetSourceStamp(const std::string &path);
+
+// Stamp of the material libraries an OBJ references, changes whenever one of them is modified, created or removed
+uint64_t GetMaterialLibraryStamp(const std::string &basedir, const std::vector<std::string> &libraries);
+
+// Name, diffuse color and diffuse texture of every material as a flat blob
+std::vector<char> SerializeMaterials(const std::vector<tinyobj::material_t> &materials);
+bool DeserializeMaterials(const char *data, size_t size, std::vector<tinyobj::material_t> &materials);
+
+// Names of the material libraries relative to the OBJ, together with their stamp when the mesh was cooked
+std::vector<char> SerializeMaterialLibraries(const std::vector<std::string> &libraries, uint64_t stamp);
+bool DeserializeMaterialLibraries(const char *data, size_t size, std::vector<std::string> &libraries, uint64_t &stamp);
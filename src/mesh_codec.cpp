@@ -0,0 +1,815 @@
+#include "mesh_codec.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+#include <emmintrin.h>
+
+// Order 0 rANS with four interleaved states and 16-bit renormalization
+// (https://github.com/rygorous/ryg_rans). A state is in [rans_lower_bound, 2^32)
+// and takes in at most one word per symbol.
+static const uint32_t rans_scale_bits = 12;
+static const uint32_t rans_scale = 1u << rans_scale_bits;
+static const uint32_t rans_lower_bound = 1u << 16;
+static const size_t rans_state_number = 4;
+
+// First byte of every entropy coded stream
+enum ByteStreamMode : uint8_t {
+	BYTE_STREAM_RAW = 0,
+	BYTE_STREAM_CONSTANT = 1,
+	BYTE_STREAM_RANS = 2,
+	BYTE_STREAM_GROUPS = 3,
+};
+
+// Groups of 16 bytes packed with 0, 2, 4 or 8 bits per byte, decoded with SSE2 at
+// several bytes per cycle. rANS decodes a byte at a time, so MESH_CODEC_SMALL only
+// picks it when it saves more than rans_saving_threshold of the other modes.
+static const size_t byte_group_size = 16;
+static const unsigned int byte_group_bits[4] = {0, 2, 4, 8};
+static const double rans_saving_threshold = 0.25;
+
+// Vertices per independently coded block; the block's byte streams for 16 bytes of the vertex stay in L2
+static const uint32_t vertex_block_size = 8192;
+static const uint32_t max_vertex_block_size = 65536;
+static const size_t max_vertex_size = 256;
+
+// Triangle code bytes below triangle_code_miss are hits: the high nibble is the
+// edge FIFO slot, the low nibble the vertex code of the third vertex
+static const unsigned int index_fifo_size = 16;
+static const unsigned int edge_fifo_slot_number = 15;
+static const unsigned int vertex_code_explicit = 15;
+static const uint8_t triangle_code_miss = 0xF0;
+// A miss which first restarts new vertices from 0, where the next draw call begins
+static const uint8_t triangle_code_restart = 0xF1;
+
+static void WriteVarint(std::vector<uint8_t> &destination, uint64_t value) {
+	while (value >= 0x80) {
+		destination.push_back(static_cast<uint8_t>(value) | 0x80);
+		value >>= 7;
+	}
+	destination.push_back(static_cast<uint8_t>(value));
+}
+
+static bool ReadVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value) {
+	value = 0;
+	for (int shift = 0; shift < 64 && data < end; shift += 7) {
+		const uint8_t byte = *data++;
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (byte < 0x80) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void WriteUint32(std::vector<uint8_t> &destination, uint32_t value) {
+	uint8_t bytes[sizeof(value)];
+	memcpy(bytes, &value, sizeof(value));
+	destination.insert(destination.end(), bytes, bytes + sizeof(value));
+}
+
+static bool ReadUint32(const uint8_t *&data, const uint8_t *end, uint32_t &value) {
+	if (static_cast<size_t>(end - data) < sizeof(value)) {
+		return false;
+	}
+	memcpy(&value, data, sizeof(value));
+	data += sizeof(value);
+	return true;
+}
+
+static inline uint64_t ZigzagEncode(int64_t value) {
+	return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static inline int64_t ZigzagDecode(uint64_t value) {
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Scales symbol counts to frequencies summing to rans_scale, every present symbol keeps at least 1
+static void NormalizeFrequencies(uint32_t frequencies[256], const uint32_t counts[256], size_t total) {
+	uint32_t sum = 0;
+	int largest = 0;
+	for (int symbol = 0; symbol < 256; symbol++) {
+		frequencies[symbol] = counts[symbol] ? std::max(static_cast<uint32_t>(static_cast<uint64_t>(counts[symbol]) * rans_scale / total), 1u) : 0;
+		sum += frequencies[symbol];
+		largest = (frequencies[symbol] > frequencies[largest]) ? symbol : largest;
+	}
+
+	if (sum <= rans_scale) {
+		frequencies[largest] += rans_scale - sum;
+		return;
+	}
+	// Rounding rare symbols up overshot, take the excess from the most frequent ones
+	while (sum > rans_scale) {
+		largest = 0;
+		for (int symbol = 1; symbol < 256; symbol++) {
+			largest = (frequencies[symbol] > frequencies[largest]) ? symbol : largest;
+		}
+		const uint32_t excess = std::min(sum - rans_scale, frequencies[largest] / 2);
+		frequencies[largest] -= excess;
+		sum -= excess;
+	}
+}
+
+static void EncodeGroups(std::vector<uint8_t> &destination, const uint8_t *data, size_t size) {
+	const size_t group_number = (size + byte_group_size - 1) / byte_group_size;
+	const size_t header_start = destination.size();
+	destination.push_back(BYTE_STREAM_GROUPS);
+	destination.resize(header_start + 1 + (group_number + 3) / 4);
+	for (size_t group = 0; group < group_number; group++) {
+		uint8_t values[byte_group_size] = {};
+		const size_t value_number = std::min(byte_group_size, size - group * byte_group_size);
+		memcpy(values, data + group * byte_group_size, value_number);
+		uint8_t used_bits = 0;
+		for (uint8_t value : values) {
+			used_bits |= value;
+		}
+		const unsigned int width = (used_bits == 0) ? 0 : (used_bits < 4) ? 1 : (used_bits < 16) ? 2 : 3;
+		destination[header_start + 1 + group / 4] |= static_cast<uint8_t>(width << (2 * (group % 4)));
+
+		// Earlier values go to the higher bits of a byte
+		const unsigned int bits = byte_group_bits[width];
+		for (size_t packed = 0; packed < bits * byte_group_size / 8; packed++) {
+			uint8_t byte = 0;
+			for (unsigned int slot = 0; slot < 8 / bits; slot++) {
+				byte |= static_cast<uint8_t>(values[packed * (8 / bits) + slot] << (8 - bits * (slot + 1)));
+			}
+			destination.push_back(byte);
+		}
+	}
+}
+
+static size_t GetGroupsSize(const uint8_t *data, size_t size) {
+	size_t encoded_size = 1 + (size + 4 * byte_group_size - 1) / (4 * byte_group_size);
+	for (size_t start = 0; start < size; start += byte_group_size) {
+		uint8_t used_bits = 0;
+		for (size_t i = start; i < std::min(size, start + byte_group_size); i++) {
+			used_bits |= data[i];
+		}
+		encoded_size += (used_bits == 0) ? 0 : (used_bits < 4) ? 4 : (used_bits < 16) ? 8 : 16;
+	}
+	return encoded_size;
+}
+
+static void EncodeRans(std::vector<uint8_t> &encoded, const uint8_t *data, size_t size, const uint32_t counts[256]) {
+	uint32_t frequencies[256];
+	uint32_t starts[256];
+	NormalizeFrequencies(frequencies, counts, size);
+	for (uint32_t symbol = 0, start = 0; symbol < 256; symbol++) {
+		starts[symbol] = start;
+		start += frequencies[symbol];
+	}
+
+	// Symbols are encoded back to front, so the decoder reads words front to back
+	std::vector<uint16_t> words(size + 2 * rans_state_number);
+	uint16_t *word = words.data() + words.size();
+	uint32_t states[rans_state_number] = {rans_lower_bound, rans_lower_bound, rans_lower_bound, rans_lower_bound};
+	for (size_t i = size; i-- > 0;) {
+		uint32_t &state = states[i % rans_state_number];
+		const uint32_t frequency = frequencies[data[i]];
+		if (state >= ((rans_lower_bound >> rans_scale_bits) << 16) * frequency) {
+			*--word = static_cast<uint16_t>(state);
+			state >>= 16;
+		}
+		state = ((state / frequency) << rans_scale_bits) + state % frequency + starts[data[i]];
+	}
+	for (size_t k = rans_state_number; k-- > 0;) {
+		*--word = static_cast<uint16_t>(states[k] >> 16);
+		*--word = static_cast<uint16_t>(states[k]);
+	}
+	const size_t word_number = words.data() + words.size() - word;
+
+	encoded.push_back(BYTE_STREAM_RANS);
+	// Bitmap of the present symbols, then their frequencies
+	uint8_t present[32] = {};
+	for (int symbol = 0; symbol < 256; symbol++) {
+		present[symbol / 8] |= frequencies[symbol] ? (1 << (symbol % 8)) : 0;
+	}
+	encoded.insert(encoded.end(), present, present + sizeof(present));
+	for (int symbol = 0; symbol < 256; symbol++) {
+		if (frequencies[symbol]) {
+			WriteVarint(encoded, frequencies[symbol] - 1);
+		}
+	}
+	WriteUint32(encoded, static_cast<uint32_t>(word_number));
+	const uint8_t *word_bytes = reinterpret_cast<const uint8_t *>(word);
+	encoded.insert(encoded.end(), word_bytes, word_bytes + word_number * sizeof(uint16_t));
+}
+
+// Appends a stream of size bytes in the smallest mode, the decoder is told the size separately
+static void EncodeByteStream(std::vector<uint8_t> &destination, const uint8_t *data, size_t size, MeshCodecLevel level) {
+	uint32_t counts[256] = {};
+	for (size_t i = 0; i < size; i++) {
+		counts[data[i]]++;
+	}
+	const int symbol_number = static_cast<int>(std::count_if(counts, counts + 256, [](uint32_t count) { return count != 0; }));
+	if (symbol_number == 1) {
+		destination.push_back(BYTE_STREAM_CONSTANT);
+		destination.push_back(data[0]);
+		return;
+	}
+
+	const size_t raw_size = size + 1;
+	const size_t groups_size = GetGroupsSize(data, size);
+	std::vector<uint8_t> encoded;
+	if (level == MESH_CODEC_SMALL && symbol_number > 1) {
+		EncodeRans(encoded, data, size, counts);
+	}
+	if (!encoded.empty() && encoded.size() < (1.0 - rans_saving_threshold) * std::min(raw_size, groups_size)) {
+		destination.insert(destination.end(), encoded.begin(), encoded.end());
+	} else if (groups_size < raw_size) {
+		EncodeGroups(destination, data, size);
+	} else {
+		destination.push_back(BYTE_STREAM_RAW);
+		destination.insert(destination.end(), data, data + size);
+	}
+}
+
+static inline uint32_t ReadWord(const uint8_t *data) {
+	uint16_t word;
+	memcpy(&word, data, sizeof(word));
+	return word;
+}
+
+// Table entries are symbol | frequency << 8 | (slot - start) << 20
+static inline uint8_t DecodeSymbol(const uint32_t *table, uint32_t &state) {
+	const uint32_t entry = table[state & (rans_scale - 1)];
+	state = ((entry >> 8) & (rans_scale - 1)) * (state >> rans_scale_bits) + (entry >> 20);
+	return static_cast<uint8_t>(entry);
+}
+
+static inline __m128i UnpackGroup(const uint8_t *data, unsigned int width) {
+	const __m128i low_2_bits = _mm_set1_epi8(3);
+	const __m128i low_4_bits = _mm_set1_epi8(15);
+	switch (width) {
+	case 0:
+		return _mm_setzero_si128();
+	case 1: {
+		// Byte k holds values 4k to 4k + 3 from its high bits down
+		int packed;
+		memcpy(&packed, data, sizeof(packed));
+		const __m128i bytes = _mm_cvtsi32_si128(packed);
+		const __m128i first = _mm_and_si128(_mm_srli_epi16(bytes, 6), low_2_bits);
+		const __m128i second = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_2_bits);
+		const __m128i third = _mm_and_si128(_mm_srli_epi16(bytes, 2), low_2_bits);
+		const __m128i fourth = _mm_and_si128(bytes, low_2_bits);
+		return _mm_unpacklo_epi16(_mm_unpacklo_epi8(first, second), _mm_unpacklo_epi8(third, fourth));
+	}
+	case 2: {
+		const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(data));
+		return _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(bytes, 4), low_4_bits), _mm_and_si128(bytes, low_4_bits));
+	}
+	default:
+		return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+	}
+}
+
+static const uint8_t *DecodeGroups(uint8_t *destination, size_t size, const uint8_t *data, const uint8_t *end) {
+	const size_t group_number = (size + byte_group_size - 1) / byte_group_size;
+	const size_t header_size = (group_number + 3) / 4;
+	if (static_cast<size_t>(end - data) < header_size) {
+		return nullptr;
+	}
+
+	// Bounds are checked once for the whole stream, unused header bits must be 0
+	const uint8_t *headers = data;
+	size_t packed_size = 0;
+	for (size_t h = 0; h < header_size; h++) {
+		for (unsigned int slot = 0; slot < 4; slot++) {
+			packed_size += byte_group_bits[(headers[h] >> (2 * slot)) & 3] * byte_group_size / 8;
+		}
+	}
+	const uint8_t *packed = data + header_size;
+	if (static_cast<size_t>(end - packed) < packed_size || (group_number % 4 && headers[header_size - 1] >> (2 * (group_number % 4)))) {
+		return nullptr;
+	}
+
+	for (size_t group = 0; group < group_number; group++) {
+		const unsigned int width = (headers[group / 4] >> (2 * (group % 4))) & 3;
+		const __m128i values = UnpackGroup(packed, width);
+		packed += byte_group_bits[width] * byte_group_size / 8;
+		if ((group + 1) * byte_group_size <= size) {
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + group * byte_group_size), values);
+		} else {
+			uint8_t last_values[byte_group_size];
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(last_values), values);
+			memcpy(destination + group * byte_group_size, last_values, size - group * byte_group_size);
+		}
+	}
+	return packed;
+}
+
+// Returns the end of the stream, or nullptr when it is broken
+static const uint8_t *DecodeByteStream(uint8_t *destination, size_t size, const uint8_t *data, const uint8_t *end) {
+	if (data >= end) {
+		return nullptr;
+	}
+
+	const uint8_t mode = *data++;
+	if (mode == BYTE_STREAM_RAW) {
+		if (static_cast<size_t>(end - data) < size) {
+			return nullptr;
+		}
+		memcpy(destination, data, size);
+		return data + size;
+	}
+	if (mode == BYTE_STREAM_CONSTANT) {
+		if (data >= end) {
+			return nullptr;
+		}
+		memset(destination, *data, size);
+		return data + 1;
+	}
+	if (mode == BYTE_STREAM_GROUPS) {
+		return DecodeGroups(destination, size, data, end);
+	}
+	if (mode != BYTE_STREAM_RANS || end - data < 32) {
+		return nullptr;
+	}
+
+	const uint8_t *present = data;
+	data += 32;
+	uint32_t table[rans_scale];
+	uint32_t start = 0;
+	for (uint32_t symbol = 0; symbol < 256; symbol++) {
+		if (!(present[symbol / 8] & (1 << (symbol % 8)))) {
+			continue;
+		}
+		uint64_t frequency;
+		if (!ReadVarint(data, end, frequency) || ++frequency >= rans_scale || start + frequency > rans_scale) {
+			return nullptr;
+		}
+		for (uint32_t slot = 0; slot < frequency; slot++) {
+			table[start + slot] = symbol | static_cast<uint32_t>(frequency << 8) | (slot << 20);
+		}
+		start += static_cast<uint32_t>(frequency);
+	}
+
+	uint32_t word_number;
+	if (start != rans_scale || !ReadUint32(data, end, word_number) || word_number < 2 * rans_state_number ||
+		static_cast<size_t>(end - data) / sizeof(uint16_t) < word_number) {
+		return nullptr;
+	}
+	const uint8_t *words = data;
+	const uint8_t *words_end = data + static_cast<size_t>(word_number) * sizeof(uint16_t);
+
+	uint32_t states[rans_state_number];
+	for (size_t k = 0; k < rans_state_number; k++) {
+		states[k] = ReadWord(words) | (ReadWord(words + 2) << 16);
+		words += 4;
+	}
+
+	// Four symbols take in at most four words, only the last ones need bounds checks
+	uint32_t state_0 = states[0], state_1 = states[1], state_2 = states[2], state_3 = states[3];
+	size_t i = 0;
+	for (; i + rans_state_number <= size && words_end - words >= static_cast<ptrdiff_t>(rans_state_number * sizeof(uint16_t)); i += rans_state_number) {
+		destination[i + 0] = DecodeSymbol(table, state_0);
+		destination[i + 1] = DecodeSymbol(table, state_1);
+		destination[i + 2] = DecodeSymbol(table, state_2);
+		destination[i + 3] = DecodeSymbol(table, state_3);
+		if (state_0 < rans_lower_bound) {
+			state_0 = (state_0 << 16) | ReadWord(words);
+			words += 2;
+		}
+		if (state_1 < rans_lower_bound) {
+			state_1 = (state_1 << 16) | ReadWord(words);
+			words += 2;
+		}
+		if (state_2 < rans_lower_bound) {
+			state_2 = (state_2 << 16) | ReadWord(words);
+			words += 2;
+		}
+		if (state_3 < rans_lower_bound) {
+			state_3 = (state_3 << 16) | ReadWord(words);
+			words += 2;
+		}
+	}
+	states[0] = state_0;
+	states[1] = state_1;
+	states[2] = state_2;
+	states[3] = state_3;
+	for (; i < size; i++) {
+		uint32_t &state = states[i % rans_state_number];
+		destination[i] = DecodeSymbol(table, state);
+		if (state < rans_lower_bound) {
+			if (words >= words_end) {
+				return nullptr;
+			}
+			state = (state << 16) | ReadWord(words);
+			words += 2;
+		}
+	}
+
+	// The encoder started every state at the lower bound
+	for (size_t k = 0; k < rans_state_number; k++) {
+		if (states[k] != rans_lower_bound) {
+			return nullptr;
+		}
+	}
+	return (words == words_end) ? words_end : nullptr;
+}
+
+template <typename T>
+static bool EncodeIndices(std::vector<uint8_t> &destination, const T *indices, size_t index_number) {
+	if (index_number % 3 != 0) {
+		return false;
+	}
+
+	const size_t triangle_number = index_number / 3;
+	std::vector<uint8_t> codes;
+	codes.reserve(triangle_number + 64);
+	std::vector<uint8_t> rotations(triangle_number);
+	std::vector<uint8_t> explicit_vertices;
+
+	// Edges are stored reversed, the way a neighbouring triangle walks them
+	uint32_t edge_fifo[index_fifo_size][2];
+	uint32_t vertex_fifo[index_fifo_size];
+	memset(edge_fifo, 0xff, sizeof(edge_fifo));
+	memset(vertex_fifo, 0xff, sizeof(vertex_fifo));
+	size_t edge_head = 0;
+	size_t vertex_head = 0;
+	uint32_t next = 0;
+	uint32_t last = 0;
+
+	auto push_edge = [&](uint32_t a, uint32_t b) {
+		edge_fifo[edge_head % index_fifo_size][0] = a;
+		edge_fifo[edge_head % index_fifo_size][1] = b;
+		edge_head++;
+	};
+	auto encode_vertex = [&](uint32_t vertex) -> unsigned int {
+		if (vertex == next) {
+			next++;
+			vertex_fifo[vertex_head++ % index_fifo_size] = vertex;
+			return 0;
+		}
+		for (unsigned int code = 1; code < vertex_code_explicit; code++) {
+			if (vertex_fifo[(vertex_head - code) % index_fifo_size] == vertex) {
+				return code;
+			}
+		}
+		WriteVarint(explicit_vertices, ZigzagEncode(static_cast<int64_t>(vertex) - last));
+		last = vertex;
+		vertex_fifo[vertex_head++ % index_fifo_size] = vertex;
+		return vertex_code_explicit;
+	};
+
+	for (size_t triangle = 0; triangle < triangle_number; triangle++) {
+		const uint32_t corners[3] = {indices[3 * triangle + 0], indices[3 * triangle + 1], indices[3 * triangle + 2]};
+
+		unsigned int hit_slot = edge_fifo_slot_number;
+		unsigned int rotation = 0;
+		for (unsigned int slot = 0; slot < edge_fifo_slot_number && hit_slot == edge_fifo_slot_number; slot++) {
+			const uint32_t *edge = edge_fifo[(edge_head - 1 - slot) % index_fifo_size];
+			for (rotation = 0; rotation < 3; rotation++) {
+				if (edge[0] == corners[rotation] && edge[1] == corners[(rotation + 1) % 3]) {
+					hit_slot = slot;
+					break;
+				}
+			}
+		}
+
+		if (hit_slot < edge_fifo_slot_number) {
+			const uint32_t a = corners[rotation];
+			const uint32_t b = corners[(rotation + 1) % 3];
+			const uint32_t c = corners[(rotation + 2) % 3];
+			codes.push_back(static_cast<uint8_t>((hit_slot << 4) | encode_vertex(c)));
+			rotations[triangle] = static_cast<uint8_t>(rotation);
+			push_edge(c, b);
+			push_edge(a, c);
+			continue;
+		}
+
+		// Vertex fetch optimization numbers every draw call's vertices from 0 in first use order
+		const bool restart = next != 0 && corners[0] == 0 && corners[1] == 1 && corners[2] == 2;
+		codes.push_back(restart ? triangle_code_restart : triangle_code_miss);
+		if (restart) {
+			next = 0;
+		}
+		const unsigned int code_a = encode_vertex(corners[0]);
+		const unsigned int code_b = encode_vertex(corners[1]);
+		const unsigned int code_c = encode_vertex(corners[2]);
+		codes.push_back(static_cast<uint8_t>((code_a << 4) | code_b));
+		codes.push_back(static_cast<uint8_t>(code_c));
+		push_edge(corners[1], corners[0]);
+		push_edge(corners[2], corners[1]);
+		push_edge(corners[0], corners[2]);
+	}
+
+	WriteVarint(destination, codes.size());
+	WriteVarint(destination, explicit_vertices.size());
+	// Decoding is bound by the FIFO logic, so rANS costs little here
+	EncodeByteStream(destination, codes.data(), codes.size(), MESH_CODEC_SMALL);
+	EncodeByteStream(destination, rotations.data(), rotations.size(), MESH_CODEC_SMALL);
+	EncodeByteStream(destination, explicit_vertices.data(), explicit_vertices.size(), MESH_CODEC_SMALL);
+	return true;
+}
+
+template <typename T>
+static bool DecodeIndices(T *destination, size_t index_number, const uint8_t *data, size_t size) {
+	const uint8_t *end = data + size;
+	const size_t triangle_number = index_number / 3;
+	uint64_t code_number;
+	uint64_t explicit_size;
+	// A triangle takes at most three code bytes and three varints
+	if (index_number % 3 != 0 || !ReadVarint(data, end, code_number) || !ReadVarint(data, end, explicit_size) ||
+		code_number > 3 * triangle_number || explicit_size > 30 * triangle_number) {
+		return false;
+	}
+
+	std::vector<uint8_t> codes(code_number);
+	std::vector<uint8_t> rotations(triangle_number);
+	std::vector<uint8_t> explicit_vertices(explicit_size);
+	data = DecodeByteStream(codes.data(), codes.size(), data, end);
+	data = data ? DecodeByteStream(rotations.data(), rotations.size(), data, end) : nullptr;
+	data = data ? DecodeByteStream(explicit_vertices.data(), explicit_vertices.size(), data, end) : nullptr;
+	if (data != end) {
+		return false;
+	}
+
+	uint32_t edge_fifo[index_fifo_size][2];
+	uint32_t vertex_fifo[index_fifo_size];
+	memset(edge_fifo, 0xff, sizeof(edge_fifo));
+	memset(vertex_fifo, 0xff, sizeof(vertex_fifo));
+	size_t edge_head = 0;
+	size_t vertex_head = 0;
+	uint32_t next = 0;
+	uint32_t last = 0;
+	const uint8_t *code = codes.data();
+	const uint8_t *code_end = code + codes.size();
+	const uint8_t *explicit_vertex = explicit_vertices.data();
+	const uint8_t *explicit_end = explicit_vertex + explicit_vertices.size();
+	bool valid = true;
+
+	auto decode_vertex = [&](unsigned int vertex_code) -> uint32_t {
+		if (vertex_code == 0) {
+			vertex_fifo[vertex_head++ % index_fifo_size] = next;
+			return next++;
+		}
+		if (vertex_code < vertex_code_explicit) {
+			return vertex_fifo[(vertex_head - vertex_code) % index_fifo_size];
+		}
+		uint64_t delta;
+		valid = valid && ReadVarint(explicit_vertex, explicit_end, delta);
+		const int64_t vertex = static_cast<int64_t>(last) + ZigzagDecode(valid ? delta : 0);
+		valid = valid && vertex >= 0 && static_cast<uint64_t>(vertex) <= std::numeric_limits<T>::max();
+		last = static_cast<uint32_t>(vertex);
+		vertex_fifo[vertex_head++ % index_fifo_size] = last;
+		return last;
+	};
+
+	for (size_t triangle = 0; triangle < triangle_number && valid; triangle++) {
+		if (code >= code_end) {
+			return false;
+		}
+		T *corners = destination + 3 * triangle;
+		const uint8_t triangle_code = *code++;
+
+		if (triangle_code < triangle_code_miss) {
+			const uint32_t *edge = edge_fifo[(edge_head - 1 - (triangle_code >> 4)) % index_fifo_size];
+			const unsigned int rotation = rotations[triangle];
+			const uint32_t a = edge[0];
+			const uint32_t b = edge[1];
+			const uint32_t c = decode_vertex(triangle_code & 15);
+			if (rotation > 2 || a > std::numeric_limits<T>::max() || b > std::numeric_limits<T>::max()) {
+				return false;
+			}
+			corners[rotation] = static_cast<T>(a);
+			corners[(rotation + 1) % 3] = static_cast<T>(b);
+			corners[(rotation + 2) % 3] = static_cast<T>(c);
+			edge_fifo[edge_head % index_fifo_size][0] = c;
+			edge_fifo[edge_head % index_fifo_size][1] = b;
+			edge_head++;
+			edge_fifo[edge_head % index_fifo_size][0] = a;
+			edge_fifo[edge_head % index_fifo_size][1] = c;
+			edge_head++;
+			continue;
+		}
+
+		if (triangle_code > triangle_code_restart || code_end - code < 2) {
+			return false;
+		}
+		if (triangle_code == triangle_code_restart) {
+			next = 0;
+		}
+		if (code[1] > vertex_code_explicit) {
+			return false;
+		}
+		const uint32_t a = decode_vertex(code[0] >> 4);
+		const uint32_t b = decode_vertex(code[0] & 15);
+		const uint32_t c = decode_vertex(code[1]);
+		if (a > std::numeric_limits<T>::max() || b > std::numeric_limits<T>::max()) {
+			return false;
+		}
+		code += 2;
+		corners[0] = static_cast<T>(a);
+		corners[1] = static_cast<T>(b);
+		corners[2] = static_cast<T>(c);
+		const uint32_t edges[3][2] = {{b, a}, {c, b}, {a, c}};
+		for (const uint32_t *edge : edges) {
+			edge_fifo[edge_head % index_fifo_size][0] = edge[0];
+			edge_fifo[edge_head % index_fifo_size][1] = edge[1];
+			edge_head++;
+		}
+	}
+	return valid && code == code_end && explicit_vertex == explicit_end;
+}
+
+bool EncodeIndexBuffer(std::vector<uint8_t> &destination, const unsigned int *indices, size_t index_number) {
+	return EncodeIndices(destination, indices, index_number);
+}
+
+bool EncodeIndexBuffer(std::vector<uint8_t> &destination, const uint16_t *indices, size_t index_number) {
+	return EncodeIndices(destination, indices, index_number);
+}
+
+bool DecodeIndexBuffer(unsigned int *destination, size_t index_number, const uint8_t *data, size_t size) {
+	return DecodeIndices(destination, index_number, data, size);
+}
+
+bool DecodeIndexBuffer(uint16_t *destination, size_t index_number, const uint8_t *data, size_t size) {
+	return DecodeIndices(destination, index_number, data, size);
+}
+
+static void EncodeVertexBlock(std::vector<uint8_t> &destination, const uint8_t *vertices, size_t vertex_number, size_t vertex_size,
+	MeshCodecLevel level) {
+	std::vector<uint8_t> streams(vertex_size * vertex_number);
+	uint32_t previous[max_vertex_size / sizeof(uint32_t)] = {};
+	for (size_t v = 0; v < vertex_number; v++) {
+		for (size_t w = 0; w < vertex_size / sizeof(uint32_t); w++) {
+			uint32_t word;
+			memcpy(&word, vertices + v * vertex_size + w * sizeof(uint32_t), sizeof(word));
+			const int32_t delta = static_cast<int32_t>(word - previous[w]);
+			const uint32_t zigzag = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+			previous[w] = word;
+			for (size_t b = 0; b < sizeof(uint32_t); b++) {
+				streams[(w * sizeof(uint32_t) + b) * vertex_number + v] = static_cast<uint8_t>(zigzag >> (8 * b));
+			}
+		}
+	}
+
+	for (size_t b = 0; b < vertex_size; b++) {
+		EncodeByteStream(destination, streams.data() + b * vertex_number, vertex_number, level);
+	}
+}
+
+// Transposes 16 rows of 16 bytes. Row j of the result is column bit_reversed_rows[j] of the input.
+template <int width>
+static inline __m128i UnpackLow(__m128i a, __m128i b) {
+	return width == 8 ? _mm_unpacklo_epi8(a, b) : width == 16 ? _mm_unpacklo_epi16(a, b) : width == 32 ? _mm_unpacklo_epi32(a, b) : _mm_unpacklo_epi64(a, b);
+}
+
+template <int width>
+static inline __m128i UnpackHigh(__m128i a, __m128i b) {
+	return width == 8 ? _mm_unpackhi_epi8(a, b) : width == 16 ? _mm_unpackhi_epi16(a, b) : width == 32 ? _mm_unpackhi_epi32(a, b) : _mm_unpackhi_epi64(a, b);
+}
+
+template <int width>
+static inline void TransposeRound(const __m128i *rows, __m128i *result) {
+	for (int i = 0; i < 8; i++) {
+		result[i] = UnpackLow<width>(rows[2 * i], rows[2 * i + 1]);
+		result[i + 8] = UnpackHigh<width>(rows[2 * i], rows[2 * i + 1]);
+	}
+}
+
+static inline void Transpose16x16(__m128i rows[16]) {
+	__m128i temporary[16];
+	TransposeRound<8>(rows, temporary);
+	TransposeRound<16>(temporary, rows);
+	TransposeRound<32>(rows, temporary);
+	TransposeRound<64>(temporary, rows);
+}
+
+static const int bit_reversed_rows[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+
+// Rebuilds bytes [offset, offset + group_size) of every vertex from their streams
+static void DecodeVertexGroup(uint8_t *vertices, size_t vertex_number, size_t vertex_size, size_t offset,
+	size_t group_size, const uint8_t *streams) {
+	// 16 vertices at a time: transpose their bytes back, undo the zigzag and add up the
+	// deltas. Groups narrower than 16 bytes transpose zero rows and store fewer bytes.
+	const __m128i one = _mm_set1_epi32(1);
+	__m128i accumulator = _mm_setzero_si128();
+	size_t v = 0;
+	for (; v + 16 <= vertex_number; v += 16) {
+		__m128i rows[16];
+		for (size_t r = 0; r < 16; r++) {
+			rows[r] = (r < group_size) ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(streams + r * vertex_number + v)) : _mm_setzero_si128();
+		}
+		Transpose16x16(rows);
+		for (int j = 0; j < 16; j++) {
+			const __m128i zigzag = rows[bit_reversed_rows[j]];
+			const __m128i delta = _mm_xor_si128(_mm_srli_epi32(zigzag, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(zigzag, one)));
+			accumulator = _mm_add_epi32(accumulator, delta);
+			uint8_t *vertex = vertices + (v + j) * vertex_size + offset;
+			if (group_size == 16) {
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(vertex), accumulator);
+			} else if (group_size == 12) {
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(vertex), accumulator);
+				const int last_word = _mm_cvtsi128_si32(_mm_srli_si128(accumulator, 8));
+				memcpy(vertex + 8, &last_word, sizeof(last_word));
+			} else if (group_size == 8) {
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(vertex), accumulator);
+			} else {
+				const int word = _mm_cvtsi128_si32(accumulator);
+				memcpy(vertex, &word, sizeof(word));
+			}
+		}
+	}
+	uint32_t previous[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(previous), accumulator);
+
+	for (; v < vertex_number; v++) {
+		for (size_t w = 0; w < group_size / sizeof(uint32_t); w++) {
+			uint32_t zigzag = 0;
+			for (size_t b = 0; b < sizeof(uint32_t); b++) {
+				zigzag |= static_cast<uint32_t>(streams[(w * sizeof(uint32_t) + b) * vertex_number + v]) << (8 * b);
+			}
+			previous[w] += (zigzag >> 1) ^ (0u - (zigzag & 1));
+			memcpy(vertices + v * vertex_size + offset + w * sizeof(uint32_t), &previous[w], sizeof(uint32_t));
+		}
+	}
+}
+
+// streams holds 16 byte streams of vertex_number bytes
+static bool DecodeVertexBlock(uint8_t *vertices, size_t vertex_number, size_t vertex_size, const uint8_t *data, const uint8_t *end,
+	uint8_t *streams) {
+	// Groups of 16 bytes are decoded and rebuilt while their streams are still in cache
+	for (size_t offset = 0; offset < vertex_size; offset += 16) {
+		const size_t group_size = std::min<size_t>(16, vertex_size - offset);
+		for (size_t b = 0; b < group_size && data; b++) {
+			data = DecodeByteStream(streams + b * vertex_number, vertex_number, data, end);
+		}
+		if (!data) {
+			return false;
+		}
+		DecodeVertexGroup(vertices, vertex_number, vertex_size, offset, group_size, streams);
+	}
+	return data == end;
+}
+
+bool EncodeVertexBuffer(std::vector<uint8_t> &destination, const void *vertices, size_t vertex_number, size_t vertex_size,
+	MeshCodecLevel level) {
+	if (vertex_size == 0 || vertex_size > max_vertex_size || vertex_size % sizeof(uint32_t) != 0) {
+		return false;
+	}
+
+	const size_t block_number = (vertex_number + vertex_block_size - 1) / vertex_block_size;
+	std::vector<std::vector<uint8_t>> blocks(block_number);
+	ParallelFor(block_number, [&](size_t block) {
+		const size_t first_vertex = block * vertex_block_size;
+		EncodeVertexBlock(blocks[block], static_cast<const uint8_t *>(vertices) + first_vertex * vertex_size,
+			std::min<size_t>(vertex_block_size, vertex_number - first_vertex), vertex_size, level);
+	});
+
+	// Block sizes up front, so blocks can be decoded in parallel
+	WriteUint32(destination, vertex_block_size);
+	for (const std::vector<uint8_t> &block : blocks) {
+		WriteVarint(destination, block.size());
+	}
+	for (const std::vector<uint8_t> &block : blocks) {
+		destination.insert(destination.end(), block.begin(), block.end());
+	}
+	return true;
+}
+
+bool DecodeVertexBuffer(void *destination, size_t vertex_number, size_t vertex_size, const uint8_t *data, size_t size) {
+	const uint8_t *end = data + size;
+	uint32_t block_size;
+	if (vertex_size == 0 || vertex_size > max_vertex_size || vertex_size % sizeof(uint32_t) != 0 ||
+		!ReadUint32(data, end, block_size) || block_size == 0 || block_size > max_vertex_block_size) {
+		return false;
+	}
+
+	const size_t block_number = (vertex_number + block_size - 1) / block_size;
+	std::vector<uint64_t> encoded_sizes(block_number);
+	for (uint64_t &encoded_size : encoded_sizes) {
+		if (!ReadVarint(data, end, encoded_size)) {
+			return false;
+		}
+	}
+	std::vector<const uint8_t *> block_starts(block_number + 1, data);
+	for (size_t block = 0; block < block_number; block++) {
+		if (encoded_sizes[block] > static_cast<uint64_t>(end - block_starts[block])) {
+			return false;
+		}
+		block_starts[block + 1] = block_starts[block] + encoded_sizes[block];
+	}
+	if (block_starts[block_number] != end) {
+		return false;
+	}
+
+	// Every worker takes every worker_number-th block with its own stream buffer
+	std::vector<uint8_t> block_valid(block_number);
+	const size_t worker_number = std::min<size_t>(GetWorkerNumber(), block_number);
+	ParallelFor(worker_number, [&](size_t worker) {
+		std::unique_ptr<uint8_t[]> streams(new uint8_t[16 * static_cast<size_t>(block_size)]);
+		for (size_t block = worker; block < block_number; block += worker_number) {
+			const size_t first_vertex = block * static_cast<size_t>(block_size);
+			block_valid[block] = DecodeVertexBlock(static_cast<uint8_t *>(destination) + first_vertex * vertex_size,
+				std::min<size_t>(block_size, vertex_number - first_vertex), vertex_size, block_starts[block], block_starts[block + 1], streams.get());
+		}
+	});
+	return std::all_of(block_valid.begin(), block_valid.end(), [](uint8_t valid) { return valid != 0; });
+}
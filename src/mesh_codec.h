@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Trade-off of the vertex encoder, both levels are read by the same decoder
+enum MeshCodecLevel {
+	// Streams are bit packed in groups of 16 bytes, decoding runs at several GB/s with SIMD
+	MESH_CODEC_FAST,
+	// Streams which shrink by more than a quarter are rANS coded instead, a smaller
+	// result which decodes a few times slower
+	MESH_CODEC_SMALL,
+};
+
+// Appends a compressed triangle list to destination. Triangles are coded against
+// a FIFO of recently seen edges and one of recently seen vertices, new vertices
+// in first use order cost almost nothing, the rest are deltas to the last
+// explicitly coded vertex. The codes are then entropy coded. Decoding restores
+// the indices exactly, including the rotation of every triangle. Returns false
+// unless index_number is a multiple of 3.
+bool EncodeIndexBuffer(std::vector<uint8_t> &destination, const unsigned int *indices, size_t index_number);
+bool EncodeIndexBuffer(std::vector<uint8_t> &destination, const uint16_t *indices, size_t index_number);
+
+// Returns false when data is not an encoding of index_number indices
+bool DecodeIndexBuffer(unsigned int *destination, size_t index_number, const uint8_t *data, size_t size);
+bool DecodeIndexBuffer(uint16_t *destination, size_t index_number, const uint8_t *data, size_t size);
+
+// Appends a compressed vertex array to destination. Vertices are split into
+// blocks; inside a block every 32-bit word is coded as the zigzag difference to
+// the same word of the previous vertex and every byte of the vertex goes to its
+// own stream, so the mostly zero high bytes compress well. vertex_size must be
+// a multiple of 4 up to 256, otherwise false is returned. Blocks are encoded
+// and decoded in parallel.
+bool EncodeVertexBuffer(std::vector<uint8_t> &destination, const void *vertices, size_t vertex_number, size_t vertex_size,
+	MeshCodecLevel level = MESH_CODEC_FAST);
+
+// Returns false when data is not an encoding of vertex_number vertices of vertex_size bytes
+bool DecodeVertexBuffer(void *destination, size_t vertex_number, size_t vertex_size, const uint8_t *data, size_t size);
@@ -0,0 +1,1012 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// Forsyth's scoring parameters
+static const int forsyth_cache_size = 32;
+static const int forsyth_max_valence = 32;
+static const float forsyth_cache_decay_power = 1.5f;
+static const float forsyth_last_triangle_score = 0.75f;
+static const float forsyth_valence_boost_scale = 2.0f;
+static const float forsyth_valence_boost_power = 0.5f;
+
+struct ForsythScoreTables {
+	float cache[forsyth_cache_size];
+	float valence[forsyth_max_valence];
+
+	ForsythScoreTables() {
+		for (int position = 0; position < forsyth_cache_size; position++) {
+			if (position < 3) {
+				// The vertices of the last triangle get a fixed score to avoid emitting it twice
+				cache[position] = forsyth_last_triangle_score;
+			} else {
+				const float scale = 1.0f / (forsyth_cache_size - 3);
+				cache[position] = std::pow(1.0f - (position - 3) * scale, forsyth_cache_decay_power);
+			}
+		}
+
+		valence[0] = 0.0f;
+		for (int triangles = 1; triangles < forsyth_max_valence; triangles++) {
+			valence[triangles] = forsyth_valence_boost_scale * std::pow(static_cast<float>(triangles), -forsyth_valence_boost_power);
+		}
+	}
+};
+
+static const ForsythScoreTables forsyth_score_tables;
+
+static float GetVertexScore(int cache_position, unsigned int live_triangles) {
+	if (live_triangles == 0) {
+		// No triangles left, the vertex is of no use
+		return -1.0f;
+	}
+
+	float score = (cache_position >= 0) ? forsyth_score_tables.cache[cache_position] : 0.0f;
+	return score + forsyth_score_tables.valence[std::min<unsigned int>(live_triangles, forsyth_max_valence - 1)];
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const unsigned int *indices, size_t index_number,
+	size_t vertex_number, unsigned int cache_size) {
+	VertexCacheStatistics statistics = {};
+	statistics.triangle_number = index_number / 3;
+
+	// A vertex is in the cache when it was pushed less than cache_size pushes ago
+	std::vector<size_t> push_time(vertex_number, 0);
+	size_t time = cache_size + 1;
+	for (size_t i = 0; i < index_number; i++) {
+		const unsigned int vertex = indices[i];
+		if (push_time[vertex] == 0) {
+			statistics.vertex_number++;
+		}
+		if (time - push_time[vertex] > cache_size) {
+			push_time[vertex] = time++;
+			statistics.vertices_transformed++;
+		}
+	}
+
+	statistics.acmr = statistics.triangle_number ? static_cast<float>(statistics.vertices_transformed) / statistics.triangle_number : 0.0f;
+	statistics.atvr = statistics.vertex_number ? static_cast<float>(statistics.vertices_transformed) / statistics.vertex_number : 0.0f;
+	return statistics;
+}
+
+void OptimizeVertexCache(unsigned int *destination, const unsigned int *indices, size_t index_number,
+	size_t vertex_number) {
+	const size_t triangle_number = index_number / 3;
+	if (triangle_number == 0) {
+		return;
+	}
+
+	// Triangles of every vertex as a compressed sparse row; the live ones are kept first
+	std::vector<unsigned int> live_triangles(vertex_number, 0);
+	for (size_t i = 0; i < index_number; i++) {
+		live_triangles[indices[i]]++;
+	}
+
+	std::vector<size_t> adjacency_offsets(vertex_number + 1, 0);
+	for (size_t v = 0; v < vertex_number; v++) {
+		adjacency_offsets[v + 1] = adjacency_offsets[v] + live_triangles[v];
+	}
+
+	std::vector<unsigned int> adjacency(index_number);
+	std::vector<size_t> adjacency_cursors(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (size_t i = 0; i < index_number; i++) {
+		adjacency[adjacency_cursors[indices[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<float> vertex_scores(vertex_number);
+	for (size_t v = 0; v < vertex_number; v++) {
+		vertex_scores[v] = GetVertexScore(-1, live_triangles[v]);
+	}
+
+	std::vector<bool> emitted(triangle_number, false);
+	size_t best_triangle = 0;
+	float best_score = -1.0f;
+	for (size_t t = 0; t < triangle_number; t++) {
+		const float score = vertex_scores[indices[3 * t + 0]] + vertex_scores[indices[3 * t + 1]] + vertex_scores[indices[3 * t + 2]];
+		if (score > best_score) {
+			best_score = score;
+			best_triangle = t;
+		}
+	}
+
+	// The cache holds three extra slots for vertices pushed out by the new triangle
+	unsigned int cache[forsyth_cache_size + 3];
+	unsigned int new_cache[forsyth_cache_size + 3];
+	size_t cache_count = 0;
+	size_t input_cursor = 0;
+	bool has_best = true;
+
+	for (size_t output_triangle = 0; output_triangle < triangle_number; output_triangle++) {
+		if (!has_best) {
+			// Nothing in the cache has triangles left, continue with the next unused one in input order
+			while (emitted[input_cursor]) {
+				input_cursor++;
+			}
+			best_triangle = input_cursor;
+		}
+
+		const unsigned int *triangle = indices + 3 * best_triangle;
+		destination[3 * output_triangle + 0] = triangle[0];
+		destination[3 * output_triangle + 1] = triangle[1];
+		destination[3 * output_triangle + 2] = triangle[2];
+		emitted[best_triangle] = true;
+
+		// Put the triangle vertices at the front of the cache and remove the triangle from their lists
+		size_t new_cache_count = 0;
+		for (int corner = 0; corner < 3; corner++) {
+			const unsigned int vertex = triangle[corner];
+			new_cache[new_cache_count++] = vertex;
+
+			unsigned int *vertex_triangles = adjacency.data() + adjacency_offsets[vertex];
+			const unsigned int live = live_triangles[vertex];
+			for (unsigned int i = 0; i < live; i++) {
+				if (vertex_triangles[i] == best_triangle) {
+					std::swap(vertex_triangles[i], vertex_triangles[live - 1]);
+					live_triangles[vertex]--;
+					break;
+				}
+			}
+		}
+		for (size_t i = 0; i < cache_count; i++) {
+			const unsigned int vertex = cache[i];
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+				new_cache[new_cache_count++] = vertex;
+			}
+		}
+
+		// Update scores of the cached vertices; the ones which fell out get position -1
+		for (size_t i = 0; i < new_cache_count; i++) {
+			const unsigned int vertex = new_cache[i];
+			const int position = (i < forsyth_cache_size) ? static_cast<int>(i) : -1;
+			vertex_scores[vertex] = GetVertexScore(position, live_triangles[vertex]);
+		}
+
+		// Rescore triangles touching the updated vertices and pick the best among them
+		has_best = false;
+		for (size_t i = 0; i < new_cache_count; i++) {
+			const unsigned int vertex = new_cache[i];
+			const unsigned int *vertex_triangles = adjacency.data() + adjacency_offsets[vertex];
+			for (unsigned int j = 0; j < live_triangles[vertex]; j++) {
+				const unsigned int t = vertex_triangles[j];
+				const float score = vertex_scores[indices[3 * t + 0]] + vertex_scores[indices[3 * t + 1]] + vertex_scores[indices[3 * t + 2]];
+				if (!has_best || score > best_score) {
+					has_best = true;
+					best_score = score;
+					best_triangle = t;
+				}
+			}
+		}
+
+		cache_count = std::min<size_t>(new_cache_count, forsyth_cache_size);
+		std::copy(new_cache, new_cache + cache_count, cache);
+	}
+}
+
+static const unsigned int overdraw_cache_size = 16;
+static const int overdraw_viewport_size = 256;
+
+struct Float3 {
+	float x;
+	float y;
+	float z;
+};
+
+static inline Float3 operator-(const Float3 &a, const Float3 &b) {
+	return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+static inline float Dot(const Float3 &a, const Float3 &b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline Float3 Cross(const Float3 &a, const Float3 &b) {
+	return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+static inline Float3 Normalize(const Float3 &a) {
+	const float length = std::sqrt(Dot(a, a));
+	return (length > 0.0f) ? Float3{a.x / length, a.y / length, a.z / length} : a;
+}
+
+static inline Float3 GetPosition(const float *positions, size_t position_stride, unsigned int vertex) {
+	const float *position = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + vertex * position_stride);
+	return {position[0], position[1], position[2]};
+}
+
+// FIFO cache over push timestamps, returns the number of misses of a triangle
+static unsigned int UpdateCache(const unsigned int *triangle, std::vector<size_t> &push_time, size_t &time) {
+	unsigned int misses = 0;
+	for (int corner = 0; corner < 3; corner++) {
+		if (time - push_time[triangle[corner]] > overdraw_cache_size) {
+			push_time[triangle[corner]] = time++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+struct OverdrawBuffer {
+	// Depth per pixel for front (0) and back (1) facing triangles
+	std::vector<float> depth[2];
+	size_t pixels_shaded = 0;
+};
+
+static void RasterizeTriangle(OverdrawBuffer &buffer, Float3 a, Float3 b, Float3 c) {
+	const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (area == 0.0f) {
+		return;
+	}
+
+	// Flip back facing triangles to a positive area
+	const int side = (area > 0.0f) ? 0 : 1;
+	if (side == 1) {
+		std::swap(b, c);
+	}
+	const float inverse_area = 1.0f / std::abs(area);
+
+	const int min_x = std::max(0, static_cast<int>(std::floor(std::min({a.x, b.x, c.x}))));
+	const int max_x = std::min(overdraw_viewport_size - 1, static_cast<int>(std::ceil(std::max({a.x, b.x, c.x}))));
+	const int min_y = std::max(0, static_cast<int>(std::floor(std::min({a.y, b.y, c.y}))));
+	const int max_y = std::min(overdraw_viewport_size - 1, static_cast<int>(std::ceil(std::max({a.y, b.y, c.y}))));
+
+	// A shared edge runs in opposite directions in its two triangles, so only one
+	// of them owns pixel centers lying exactly on it
+	const Float3 *edge_begin[3] = {&b, &c, &a};
+	const Float3 *edge_end[3] = {&c, &a, &b};
+	bool owns_edge[3];
+	for (int edge = 0; edge < 3; edge++) {
+		const float dx = edge_end[edge]->x - edge_begin[edge]->x;
+		const float dy = edge_end[edge]->y - edge_begin[edge]->y;
+		owns_edge[edge] = dy > 0.0f || (dy == 0.0f && dx < 0.0f);
+	}
+
+	std::vector<float> &depth = buffer.depth[side];
+	for (int y = min_y; y <= max_y; y++) {
+		const float py = y + 0.5f;
+		for (int x = min_x; x <= max_x; x++) {
+			const float px = x + 0.5f;
+
+			float weights[3];
+			bool inside = true;
+			for (int edge = 0; edge < 3 && inside; edge++) {
+				const Float3 &begin = *edge_begin[edge];
+				const Float3 &end = *edge_end[edge];
+				weights[edge] = (end.x - begin.x) * (py - begin.y) - (end.y - begin.y) * (px - begin.x);
+				inside = owns_edge[edge] ? weights[edge] >= 0.0f : weights[edge] > 0.0f;
+			}
+			if (!inside) {
+				continue;
+			}
+
+			const float z = (weights[0] * a.z + weights[1] * b.z + weights[2] * c.z) * inverse_area;
+			float &pixel_depth = depth[y * overdraw_viewport_size + x];
+			if (z < pixel_depth) {
+				pixel_depth = z;
+				buffer.pixels_shaded++;
+			}
+		}
+	}
+}
+
+OverdrawStatistics AnalyzeOverdraw(const unsigned int *indices, size_t index_number,
+	const float *positions, size_t position_stride, size_t vertex_number) {
+	OverdrawStatistics statistics = {};
+	if (index_number == 0 || vertex_number == 0) {
+		return statistics;
+	}
+
+	Float3 min_corner = GetPosition(positions, position_stride, indices[0]);
+	Float3 max_corner = min_corner;
+	for (size_t i = 0; i < index_number; i++) {
+		const Float3 position = GetPosition(positions, position_stride, indices[i]);
+		min_corner = {std::min(min_corner.x, position.x), std::min(min_corner.y, position.y), std::min(min_corner.z, position.z)};
+		max_corner = {std::max(max_corner.x, position.x), std::max(max_corner.y, position.y), std::max(max_corner.z, position.z)};
+	}
+
+	const Float3 center = {(min_corner.x + max_corner.x) * 0.5f, (min_corner.y + max_corner.y) * 0.5f, (min_corner.z + max_corner.z) * 0.5f};
+	const Float3 half_extent = max_corner - center;
+	const float radius = std::sqrt(Dot(half_extent, half_extent));
+	if (radius == 0.0f) {
+		return statistics;
+	}
+	const float scale = (overdraw_viewport_size - 1) / (2.0f * radius);
+
+	// The three axes and four diagonals; the opposite directions come from the back face buffers
+	const Float3 view_directions[] = {
+		{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f},
+		{1.0f, 1.0f, 1.0f}, {-1.0f, 1.0f, 1.0f}, {1.0f, -1.0f, 1.0f}, {1.0f, 1.0f, -1.0f},
+	};
+
+	std::vector<Float3> projected(vertex_number);
+	for (const Float3 &view_direction : view_directions) {
+		const Float3 forward = Normalize(view_direction);
+		const Float3 helper = (std::abs(forward.y) < 0.9f) ? Float3{0.0f, 1.0f, 0.0f} : Float3{1.0f, 0.0f, 0.0f};
+		const Float3 right = Normalize(Cross(helper, forward));
+		const Float3 up = Cross(forward, right);
+
+		for (size_t v = 0; v < vertex_number; v++) {
+			const Float3 offset = GetPosition(positions, position_stride, static_cast<unsigned int>(v)) - center;
+			projected[v] = {
+				Dot(offset, right) * scale + overdraw_viewport_size * 0.5f,
+				Dot(offset, up) * scale + overdraw_viewport_size * 0.5f,
+				Dot(offset, forward)
+			};
+		}
+
+		OverdrawBuffer buffer;
+		buffer.depth[0].assign(overdraw_viewport_size * overdraw_viewport_size, std::numeric_limits<float>::max());
+		buffer.depth[1].assign(overdraw_viewport_size * overdraw_viewport_size, std::numeric_limits<float>::max());
+		for (size_t i = 0; i + 2 < index_number; i += 3) {
+			RasterizeTriangle(buffer, projected[indices[i + 0]], projected[indices[i + 1]], projected[indices[i + 2]]);
+		}
+
+		statistics.pixels_shaded += buffer.pixels_shaded;
+		for (int side = 0; side < 2; side++) {
+			for (float depth : buffer.depth[side]) {
+				statistics.pixels_covered += (depth < std::numeric_limits<float>::max()) ? 1 : 0;
+			}
+		}
+	}
+
+	statistics.overdraw = statistics.pixels_covered ? static_cast<float>(statistics.pixels_shaded) / statistics.pixels_covered : 0.0f;
+	return statistics;
+}
+
+void OptimizeOverdraw(unsigned int *destination, const unsigned int *indices, size_t index_number,
+	const float *positions, size_t position_stride, size_t vertex_number, float threshold) {
+	const size_t triangle_number = index_number / 3;
+	if (triangle_number == 0) {
+		return;
+	}
+
+	// Hard boundaries: triangles which miss the cache with all three vertices
+	std::vector<size_t> push_time(vertex_number, 0);
+	size_t time = overdraw_cache_size + 1;
+	std::vector<size_t> hard_clusters;
+	for (size_t t = 0; t < triangle_number; t++) {
+		if (UpdateCache(indices + 3 * t, push_time, time) == 3) {
+			hard_clusters.push_back(t);
+		}
+	}
+	if (hard_clusters.empty() || hard_clusters[0] != 0) {
+		hard_clusters.insert(hard_clusters.begin(), 0);
+	}
+
+	// Soft boundaries: cut a hard cluster whenever the ACMR since the last cut is
+	// already within threshold of the ACMR of the whole hard cluster
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h < hard_clusters.size(); h++) {
+		const size_t start = hard_clusters[h];
+		const size_t end = (h + 1 < hard_clusters.size()) ? hard_clusters[h + 1] : triangle_number;
+
+		time += overdraw_cache_size + 1;
+		size_t cluster_misses = 0;
+		for (size_t t = start; t < end; t++) {
+			cluster_misses += UpdateCache(indices + 3 * t, push_time, time);
+		}
+		const float cluster_threshold = threshold * static_cast<float>(cluster_misses) / static_cast<float>(end - start);
+
+		clusters.push_back(start);
+		time += overdraw_cache_size + 1;
+		size_t running_misses = 0;
+		size_t running_triangles = 0;
+		for (size_t t = start; t < end; t++) {
+			running_misses += UpdateCache(indices + 3 * t, push_time, time);
+			running_triangles++;
+			if (static_cast<float>(running_misses) / static_cast<float>(running_triangles) <= cluster_threshold && t + 1 < end) {
+				clusters.push_back(t + 1);
+				time += overdraw_cache_size + 1;
+				running_misses = 0;
+				running_triangles = 0;
+			}
+		}
+	}
+
+	// Sort key: how much the area weighted cluster normal points away from the mesh centroid
+	Float3 mesh_centroid = {0.0f, 0.0f, 0.0f};
+	for (size_t i = 0; i < triangle_number * 3; i++) {
+		const Float3 position = GetPosition(positions, position_stride, indices[i]);
+		mesh_centroid = {mesh_centroid.x + position.x, mesh_centroid.y + position.y, mesh_centroid.z + position.z};
+	}
+	const float inverse_corner_number = 1.0f / (triangle_number * 3);
+	mesh_centroid = {mesh_centroid.x * inverse_corner_number, mesh_centroid.y * inverse_corner_number, mesh_centroid.z * inverse_corner_number};
+
+	std::vector<float> sort_keys(clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++) {
+		const size_t start = clusters[c];
+		const size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangle_number;
+
+		Float3 centroid = {0.0f, 0.0f, 0.0f};
+		Float3 normal = {0.0f, 0.0f, 0.0f};
+		float area = 0.0f;
+		for (size_t t = start; t < end; t++) {
+			const Float3 p0 = GetPosition(positions, position_stride, indices[3 * t + 0]);
+			const Float3 p1 = GetPosition(positions, position_stride, indices[3 * t + 1]);
+			const Float3 p2 = GetPosition(positions, position_stride, indices[3 * t + 2]);
+			const Float3 triangle_normal = Cross(p1 - p0, p2 - p0);
+			const float triangle_area = std::sqrt(Dot(triangle_normal, triangle_normal));
+
+			centroid.x += (p0.x + p1.x + p2.x) * (triangle_area / 3.0f);
+			centroid.y += (p0.y + p1.y + p2.y) * (triangle_area / 3.0f);
+			centroid.z += (p0.z + p1.z + p2.z) * (triangle_area / 3.0f);
+			normal = {normal.x + triangle_normal.x, normal.y + triangle_normal.y, normal.z + triangle_normal.z};
+			area += triangle_area;
+		}
+
+		if (area > 0.0f) {
+			centroid = {centroid.x / area, centroid.y / area, centroid.z / area};
+		} else {
+			centroid = mesh_centroid;
+		}
+		sort_keys[c] = Dot(centroid - mesh_centroid, Normalize(normal));
+	}
+
+	std::vector<size_t> cluster_order(clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++) {
+		cluster_order[c] = c;
+	}
+	std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](size_t a, size_t b) {
+		return sort_keys[a] > sort_keys[b];
+	});
+
+	size_t output_index = 0;
+	for (size_t c : cluster_order) {
+		const size_t start = clusters[c];
+		const size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangle_number;
+		std::copy(indices + 3 * start, indices + 3 * end, destination + output_index);
+		output_index += 3 * (end - start);
+	}
+}
+
+VertexFetchStatistics AnalyzeVertexFetch(const unsigned int *indices, size_t index_number,
+	size_t vertex_number, size_t vertex_size, size_t cache_line_size, size_t cache_size) {
+	VertexFetchStatistics statistics = {};
+	if (vertex_number == 0 || vertex_size == 0) {
+		return statistics;
+	}
+
+	// Same push timestamps as the post-transform cache, but over cache lines
+	const size_t line_number = (vertex_number * vertex_size + cache_line_size - 1) / cache_line_size;
+	const size_t cache_line_number = std::max<size_t>(1, cache_size / cache_line_size);
+	std::vector<size_t> push_time(line_number, 0);
+	std::vector<bool> referenced(vertex_number, false);
+	size_t time = cache_line_number + 1;
+	for (size_t i = 0; i < index_number; i++) {
+		const unsigned int vertex = indices[i];
+		if (!referenced[vertex]) {
+			referenced[vertex] = true;
+			statistics.bytes_referenced += vertex_size;
+		}
+
+		const size_t first_line = vertex * vertex_size / cache_line_size;
+		const size_t last_line = ((vertex + 1) * vertex_size - 1) / cache_line_size;
+		for (size_t line = first_line; line <= last_line; line++) {
+			if (time - push_time[line] > cache_line_number) {
+				push_time[line] = time++;
+				statistics.bytes_fetched += cache_line_size;
+			}
+		}
+	}
+
+	statistics.overfetch = statistics.bytes_referenced ? static_cast<float>(statistics.bytes_fetched) / statistics.bytes_referenced : 0.0f;
+	return statistics;
+}
+
+size_t OptimizeVertexFetch(void *destination, unsigned int *indices, size_t index_number,
+	const void *vertices, size_t vertex_number, size_t vertex_size) {
+	const unsigned int unused = std::numeric_limits<unsigned int>::max();
+	std::vector<unsigned int> remap(vertex_number, unused);
+
+	unsigned int next_vertex = 0;
+	for (size_t i = 0; i < index_number; i++) {
+		unsigned int &new_vertex = remap[indices[i]];
+		if (new_vertex == unused) {
+			new_vertex = next_vertex++;
+		}
+		indices[i] = new_vertex;
+	}
+
+	const size_t referenced_number = next_vertex;
+	for (size_t v = 0; v < vertex_number; v++) {
+		if (remap[v] == unused) {
+			remap[v] = next_vertex++;
+		}
+	}
+
+	const char *source = static_cast<const char *>(vertices);
+	char *target = static_cast<char *>(destination);
+	for (size_t v = 0; v < vertex_number; v++) {
+		memcpy(target + remap[v] * vertex_size, source + v * vertex_size, vertex_size);
+	}
+
+	return referenced_number;
+}
+
+size_t GeneratePositionRemap(unsigned int *remap, const void *vertices, size_t vertex_number,
+	size_t vertex_stride, size_t position_size) {
+	const char *bytes = static_cast<const char *>(vertices);
+	auto position_less = [&](unsigned int a, unsigned int b) {
+		return memcmp(bytes + a * vertex_stride, bytes + b * vertex_stride, position_size) < 0;
+	};
+
+	// Sort instead of hashing; the stable order makes the first vertex of every run its leader
+	std::vector<unsigned int> order(vertex_number);
+	for (size_t v = 0; v < vertex_number; v++) {
+		order[v] = static_cast<unsigned int>(v);
+	}
+	std::stable_sort(order.begin(), order.end(), position_less);
+
+	std::vector<unsigned int> leaders(vertex_number);
+	for (size_t i = 0; i < vertex_number; i++) {
+		const bool starts_run = (i == 0) || position_less(order[i - 1], order[i]);
+		leaders[order[i]] = starts_run ? order[i] : leaders[order[i - 1]];
+	}
+
+	unsigned int position_number = 0;
+	for (size_t v = 0; v < vertex_number; v++) {
+		remap[v] = (leaders[v] == v) ? position_number++ : remap[leaders[v]];
+	}
+	return position_number;
+}
+
+std::vector<size_t> ClusterTriangles(unsigned int *destination, const unsigned int *indices, size_t index_number,
+	const float *positions, size_t position_stride, size_t max_triangle_number, float max_extent) {
+	const size_t triangle_number = index_number / 3;
+	std::vector<size_t> cluster_offsets;
+	if (triangle_number == 0) {
+		cluster_offsets.push_back(0);
+		return cluster_offsets;
+	}
+
+	struct TriangleBounds {
+		Float3 min_corner;
+		Float3 max_corner;
+		Float3 centroid;
+	};
+	std::vector<TriangleBounds> triangle_bounds(triangle_number);
+	for (size_t t = 0; t < triangle_number; t++) {
+		const Float3 p0 = GetPosition(positions, position_stride, indices[3 * t + 0]);
+		const Float3 p1 = GetPosition(positions, position_stride, indices[3 * t + 1]);
+		const Float3 p2 = GetPosition(positions, position_stride, indices[3 * t + 2]);
+		TriangleBounds &bounds = triangle_bounds[t];
+		bounds.min_corner = {std::min({p0.x, p1.x, p2.x}), std::min({p0.y, p1.y, p2.y}), std::min({p0.z, p1.z, p2.z})};
+		bounds.max_corner = {std::max({p0.x, p1.x, p2.x}), std::max({p0.y, p1.y, p2.y}), std::max({p0.z, p1.z, p2.z})};
+		bounds.centroid = {(p0.x + p1.x + p2.x) / 3.0f, (p0.y + p1.y + p2.y) / 3.0f, (p0.z + p1.z + p2.z) / 3.0f};
+	}
+
+	std::vector<unsigned int> order(triangle_number);
+	for (size_t t = 0; t < triangle_number; t++) {
+		order[t] = static_cast<unsigned int>(t);
+	}
+
+	// Explicit stack of [begin, end) ranges of order; the right half is pushed first so clusters come out left to right
+	std::vector<std::pair<size_t, size_t>> ranges;
+	ranges.push_back({0, triangle_number});
+	while (!ranges.empty()) {
+		const size_t begin = ranges.back().first;
+		const size_t end = ranges.back().second;
+		ranges.pop_back();
+
+		Float3 min_corner = triangle_bounds[order[begin]].min_corner;
+		Float3 max_corner = triangle_bounds[order[begin]].max_corner;
+		Float3 centroid_min = triangle_bounds[order[begin]].centroid;
+		Float3 centroid_max = centroid_min;
+		for (size_t i = begin + 1; i < end; i++) {
+			const TriangleBounds &bounds = triangle_bounds[order[i]];
+			min_corner = {std::min(min_corner.x, bounds.min_corner.x), std::min(min_corner.y, bounds.min_corner.y), std::min(min_corner.z, bounds.min_corner.z)};
+			max_corner = {std::max(max_corner.x, bounds.max_corner.x), std::max(max_corner.y, bounds.max_corner.y), std::max(max_corner.z, bounds.max_corner.z)};
+			centroid_min = {std::min(centroid_min.x, bounds.centroid.x), std::min(centroid_min.y, bounds.centroid.y), std::min(centroid_min.z, bounds.centroid.z)};
+			centroid_max = {std::max(centroid_max.x, bounds.centroid.x), std::max(centroid_max.y, bounds.centroid.y), std::max(centroid_max.z, bounds.centroid.z)};
+		}
+
+		const Float3 diagonal = max_corner - min_corner;
+		const bool too_many = end - begin > max_triangle_number;
+		const bool too_large = max_extent > 0.0f && end - begin > 1 && Dot(diagonal, diagonal) > max_extent * max_extent;
+		if (!too_many && !too_large) {
+			cluster_offsets.push_back(begin);
+			continue;
+		}
+
+		// Split at the median centroid along the axis where centroids spread the most
+		const Float3 spread = centroid_max - centroid_min;
+		int axis = (spread.x >= spread.y && spread.x >= spread.z) ? 0 : (spread.y >= spread.z ? 1 : 2);
+		auto centroid_less = [&](unsigned int a, unsigned int b) {
+			const Float3 &ca = triangle_bounds[a].centroid;
+			const Float3 &cb = triangle_bounds[b].centroid;
+			return (axis == 0) ? ca.x < cb.x : (axis == 1) ? ca.y < cb.y : ca.z < cb.z;
+		};
+		const size_t middle = begin + (end - begin) / 2;
+		std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, centroid_less);
+
+		ranges.push_back({middle, end});
+		ranges.push_back({begin, middle});
+	}
+
+	for (size_t i = 0; i < triangle_number; i++) {
+		std::copy(indices + 3 * order[i], indices + 3 * order[i] + 3, destination + 3 * i);
+	}
+	cluster_offsets.push_back(triangle_number);
+	return cluster_offsets;
+}
+
+// Area weighted sum of squared plane distances, divided by the weight on evaluation
+struct Quadric {
+	float a00, a11, a22, a01, a02, a12;
+	float b0, b1, b2;
+	float c;
+	float weight;
+};
+
+static Quadric MakePlaneQuadric(const Float3 &p0, const Float3 &p1, const Float3 &p2) {
+	const Float3 normal = Cross(p1 - p0, p2 - p0);
+	const float area = std::sqrt(Dot(normal, normal)) * 0.5f;
+	const Float3 n = Normalize(normal);
+	const float d = -Dot(n, p0);
+
+	Quadric quadric;
+	quadric.a00 = area * n.x * n.x;
+	quadric.a11 = area * n.y * n.y;
+	quadric.a22 = area * n.z * n.z;
+	quadric.a01 = area * n.x * n.y;
+	quadric.a02 = area * n.x * n.z;
+	quadric.a12 = area * n.y * n.z;
+	quadric.b0 = area * n.x * d;
+	quadric.b1 = area * n.y * d;
+	quadric.b2 = area * n.z * d;
+	quadric.c = area * d * d;
+	quadric.weight = area;
+	return quadric;
+}
+
+static void AddQuadric(Quadric &destination, const Quadric &quadric) {
+	destination.a00 += quadric.a00;
+	destination.a11 += quadric.a11;
+	destination.a22 += quadric.a22;
+	destination.a01 += quadric.a01;
+	destination.a02 += quadric.a02;
+	destination.a12 += quadric.a12;
+	destination.b0 += quadric.b0;
+	destination.b1 += quadric.b1;
+	destination.b2 += quadric.b2;
+	destination.c += quadric.c;
+	destination.weight += quadric.weight;
+}
+
+// Mean squared distance of p to the planes of a and b together
+static float EvaluateQuadrics(const Quadric &a, const Quadric &b, const Float3 &p) {
+	Quadric q = a;
+	AddQuadric(q, b);
+	const float error = q.a00 * p.x * p.x + q.a11 * p.y * p.y + q.a22 * p.z * p.z +
+		2.0f * (q.a01 * p.x * p.y + q.a02 * p.x * p.z + q.a12 * p.y * p.z) +
+		2.0f * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z) + q.c;
+	return (q.weight > 0.0f) ? std::max(error, 0.0f) / q.weight : 0.0f;
+}
+
+size_t SimplifyMesh(unsigned int *destination, const unsigned int *indices, size_t index_number,
+	const float *positions, size_t position_stride, size_t vertex_number,
+	size_t target_index_number, float target_error, float *result_error) {
+	std::vector<unsigned int> current(indices, indices + index_number - index_number % 3);
+	float max_error = 0.0f;
+
+	// Vertex quadrics come from the input surface and are merged along with the collapses
+	std::vector<Quadric> quadrics(vertex_number, Quadric());
+	for (size_t i = 0; i < current.size(); i += 3) {
+		const Quadric quadric = MakePlaneQuadric(GetPosition(positions, position_stride, current[i + 0]),
+			GetPosition(positions, position_stride, current[i + 1]), GetPosition(positions, position_stride, current[i + 2]));
+		for (int corner = 0; corner < 3; corner++) {
+			AddQuadric(quadrics[current[i + corner]], quadric);
+		}
+	}
+
+	// A directed edge without its opposite is open, both of its vertices are locked
+	std::vector<uint8_t> locked(vertex_number, 0);
+	{
+		std::vector<std::pair<unsigned int, unsigned int>> edges;
+		edges.reserve(current.size());
+		for (size_t i = 0; i < current.size(); i += 3) {
+			for (int corner = 0; corner < 3; corner++) {
+				edges.push_back({current[i + corner], current[i + (corner + 1) % 3]});
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (const std::pair<unsigned int, unsigned int> &edge : edges) {
+			if (!std::binary_search(edges.begin(), edges.end(), std::make_pair(edge.second, edge.first))) {
+				locked[edge.first] = 1;
+				locked[edge.second] = 1;
+			}
+		}
+	}
+
+	struct Collapse {
+		float error;
+		unsigned int from;
+		unsigned int to;
+	};
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> triangle_offsets(vertex_number + 1);
+	std::vector<unsigned int> vertex_triangles;
+	std::vector<unsigned int> remap(vertex_number);
+	std::vector<uint8_t> touched(vertex_number);
+
+	// Every pass collapses a set of independent edges, cheapest first
+	while (current.size() > target_index_number) {
+		const size_t triangle_number = current.size() / 3;
+
+		// Triangles around every vertex, counting sort into CSR
+		std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+		for (unsigned int vertex : current) {
+			triangle_offsets[vertex + 1]++;
+		}
+		for (size_t v = 0; v < vertex_number; v++) {
+			triangle_offsets[v + 1] += triangle_offsets[v];
+		}
+		vertex_triangles.resize(current.size());
+		std::vector<unsigned int> cursors(triangle_offsets.begin(), triangle_offsets.end() - 1);
+		for (size_t i = 0; i < current.size(); i++) {
+			vertex_triangles[cursors[current[i]]++] = static_cast<unsigned int>(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < current.size(); i += 3) {
+			for (int corner = 0; corner < 3; corner++) {
+				const unsigned int a = current[i + corner];
+				const unsigned int b = current[i + (corner + 1) % 3];
+				if (!locked[a]) {
+					collapses.push_back({EvaluateQuadrics(quadrics[a], quadrics[b], GetPosition(positions, position_stride, b)), a, b});
+				}
+				if (!locked[b]) {
+					collapses.push_back({EvaluateQuadrics(quadrics[a], quadrics[b], GetPosition(positions, position_stride, a)), b, a});
+				}
+			}
+		}
+		if (collapses.empty()) {
+			break;
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+			return a.error < b.error || (a.error == b.error && (a.from < b.from || (a.from == b.from && a.to < b.to)));
+		});
+
+		for (size_t v = 0; v < vertex_number; v++) {
+			remap[v] = static_cast<unsigned int>(v);
+		}
+		std::fill(touched.begin(), touched.end(), 0);
+		size_t remaining_triangles = triangle_number;
+		size_t collapse_number = 0;
+		const size_t target_triangle_number = target_index_number / 3;
+
+		for (const Collapse &collapse : collapses) {
+			if (remaining_triangles <= target_triangle_number || collapse.error > target_error * target_error) {
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to]) {
+				continue;
+			}
+
+			// Reject collapses which flip or fold a triangle around the moving vertex
+			const Float3 target = GetPosition(positions, position_stride, collapse.to);
+			bool flips = false;
+			size_t removed_triangles = 0;
+			for (unsigned int k = triangle_offsets[collapse.from]; k < triangle_offsets[collapse.from + 1] && !flips; k++) {
+				const unsigned int *triangle = &current[3 * vertex_triangles[k]];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+					removed_triangles++;
+					continue;
+				}
+				Float3 corners[3];
+				for (int corner = 0; corner < 3; corner++) {
+					corners[corner] = GetPosition(positions, position_stride, triangle[corner]);
+				}
+				const Float3 normal_before = Cross(corners[1] - corners[0], corners[2] - corners[0]);
+				for (int corner = 0; corner < 3; corner++) {
+					if (triangle[corner] == collapse.from) {
+						corners[corner] = target;
+					}
+				}
+				const Float3 normal_after = Cross(corners[1] - corners[0], corners[2] - corners[0]);
+				// More than about 75 degrees of rotation counts as a flip, so slivers cannot fold over
+				flips = Dot(normal_before, normal_after) <= 0.25f * std::sqrt(Dot(normal_before, normal_before) * Dot(normal_after, normal_after));
+			}
+			if (flips) {
+				continue;
+			}
+
+			// Neighbours are frozen for the rest of the pass, so flip checks above see final positions
+			for (unsigned int k = triangle_offsets[collapse.from]; k < triangle_offsets[collapse.from + 1]; k++) {
+				const unsigned int *triangle = &current[3 * vertex_triangles[k]];
+				touched[triangle[0]] = 1;
+				touched[triangle[1]] = 1;
+				touched[triangle[2]] = 1;
+			}
+			remap[collapse.from] = collapse.to;
+			AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			max_error = std::max(max_error, collapse.error);
+			remaining_triangles -= removed_triangles;
+			collapse_number++;
+		}
+
+		if (collapse_number == 0) {
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < current.size(); i += 3) {
+			const unsigned int a = remap[current[i + 0]];
+			const unsigned int b = remap[current[i + 1]];
+			const unsigned int c = remap[current[i + 2]];
+			if (a != b && b != c && c != a) {
+				current[write++] = a;
+				current[write++] = b;
+				current[write++] = c;
+			}
+		}
+		current.resize(write);
+	}
+
+	std::copy(current.begin(), current.end(), destination);
+	if (result_error) {
+		*result_error = std::sqrt(max_error);
+	}
+	return current.size();
+}
+
+static inline int64_t GetWeldCell(float coordinate, float cell_scale) {
+	// Far away and non finite coordinates share the outermost cells, which only costs comparisons
+	const float cell = std::floor(coordinate * cell_scale);
+	if (!(cell > -1e15f)) {
+		return std::isnan(cell) ? 0 : -1000000000000000ll;
+	}
+	return (cell < 1e15f) ? static_cast<int64_t>(cell) : 1000000000000000ll;
+}
+
+static inline size_t HashWeldCell(int64_t x, int64_t y, int64_t z) {
+	uint64_t h = static_cast<uint64_t>(x) * 0x9E3779B97F4A7C15ull;
+	h ^= static_cast<uint64_t>(y) * 0xC2B2AE3D27D4EB4Full;
+	h ^= static_cast<uint64_t>(z) * 0x165667B19E3779F9ull;
+	h ^= h >> 32;
+	return static_cast<size_t>(h);
+}
+
+size_t GenerateWeldRemap(unsigned int *remap, const float *vertices, size_t vertex_stride, size_t vertex_number,
+	size_t attribute_number, float position_tolerance, float attribute_tolerance) {
+	const unsigned int no_leader = std::numeric_limits<unsigned int>::max();
+	const float cell_scale = 1.0f / position_tolerance;
+	const float tolerance_squared = position_tolerance * position_tolerance;
+	auto get_vertex = [&](size_t vertex) {
+		return reinterpret_cast<const float *>(reinterpret_cast<const char *>(vertices) + vertex * vertex_stride);
+	};
+
+	// Cells hash into buckets of chained leaders; cells sharing a bucket only cost extra comparisons
+	size_t bucket_number = 1;
+	while (bucket_number < 2 * vertex_number) {
+		bucket_number *= 2;
+	}
+	const size_t bucket_mask = bucket_number - 1;
+	std::vector<unsigned int> bucket_leaders(bucket_number, no_leader);
+	std::vector<unsigned int> next_leaders(vertex_number, no_leader);
+
+	unsigned int leader_number = 0;
+	for (size_t v = 0; v < vertex_number; v++) {
+		const float *vertex = get_vertex(v);
+		const int64_t cell_x = GetWeldCell(vertex[0], cell_scale);
+		const int64_t cell_y = GetWeldCell(vertex[1], cell_scale);
+		const int64_t cell_z = GetWeldCell(vertex[2], cell_scale);
+
+		// A leader within the tolerance lies in one of the 27 cells around the vertex
+		unsigned int found_leader = no_leader;
+		for (int64_t dz = -1; dz <= 1 && found_leader == no_leader; dz++) {
+			for (int64_t dy = -1; dy <= 1 && found_leader == no_leader; dy++) {
+				for (int64_t dx = -1; dx <= 1 && found_leader == no_leader; dx++) {
+					const size_t bucket = HashWeldCell(cell_x + dx, cell_y + dy, cell_z + dz) & bucket_mask;
+					for (unsigned int leader = bucket_leaders[bucket]; leader != no_leader; leader = next_leaders[leader]) {
+						const float *leader_vertex = get_vertex(leader);
+						const float x = vertex[0] - leader_vertex[0];
+						const float y = vertex[1] - leader_vertex[1];
+						const float z = vertex[2] - leader_vertex[2];
+						if (x * x + y * y + z * z > tolerance_squared) {
+							continue;
+						}
+						bool attributes_match = true;
+						for (size_t a = 3; a < 3 + attribute_number && attributes_match; a++) {
+							attributes_match = std::fabs(vertex[a] - leader_vertex[a]) <= attribute_tolerance;
+						}
+						if (attributes_match) {
+							found_leader = leader;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		if (found_leader != no_leader) {
+			remap[v] = remap[found_leader];
+		} else {
+			const size_t bucket = HashWeldCell(cell_x, cell_y, cell_z) & bucket_mask;
+			next_leaders[v] = bucket_leaders[bucket];
+			bucket_leaders[bucket] = static_cast<unsigned int>(v);
+			remap[v] = leader_number++;
+		}
+	}
+	return leader_number;
+}
+
+size_t RemoveDegenerateTriangles(unsigned int *destination, const unsigned int *indices, size_t index_number,
+	const float *positions, size_t position_stride, TriangleCleanupStatistics *statistics) {
+	struct TriangleKey {
+		unsigned int vertices[3];
+		unsigned int triangle;
+	};
+
+	const size_t triangle_number = index_number / 3;
+	std::vector<bool> removed(triangle_number, false);
+	std::vector<TriangleKey> keys;
+	keys.reserve(triangle_number);
+	size_t degenerate_number = 0;
+	for (size_t t = 0; t < triangle_number; t++) {
+		const unsigned int *triangle = indices + 3 * t;
+		const unsigned int a = triangle[0];
+		const unsigned int b = triangle[1];
+		const unsigned int c = triangle[2];
+		const Float3 normal = Cross(GetPosition(positions, position_stride, b) - GetPosition(positions, position_stride, a),
+			GetPosition(positions, position_stride, c) - GetPosition(positions, position_stride, a));
+		if (a == b || b == c || a == c || Dot(normal, normal) == 0.0f) {
+			removed[t] = true;
+			degenerate_number++;
+			continue;
+		}
+
+		// Rotate the smallest index first, which keeps the winding
+		TriangleKey key = {{a, b, c}, static_cast<unsigned int>(t)};
+		if (b < a && b < c) {
+			key = {{b, c, a}, static_cast<unsigned int>(t)};
+		} else if (c < a && c < b) {
+			key = {{c, a, b}, static_cast<unsigned int>(t)};
+		}
+		keys.push_back(key);
+	}
+
+	// Sort instead of hashing; equal triangles end up next to each other, the first one in index order leading
+	std::sort(keys.begin(), keys.end(), [](const TriangleKey &a, const TriangleKey &b) {
+		if (a.vertices[0] != b.vertices[0]) {
+			return a.vertices[0] < b.vertices[0];
+		}
+		if (a.vertices[1] != b.vertices[1]) {
+			return a.vertices[1] < b.vertices[1];
+		}
+		if (a.vertices[2] != b.vertices[2]) {
+			return a.vertices[2] < b.vertices[2];
+		}
+		return a.triangle < b.triangle;
+	});
+	size_t duplicate_number = 0;
+	for (size_t i = 1; i < keys.size(); i++) {
+		if (std::equal(keys[i].vertices, keys[i].vertices + 3, keys[i - 1].vertices)) {
+			removed[keys[i].triangle] = true;
+			duplicate_number++;
+		}
+	}
+
+	// Triangles only move towards the front, so copying forward works in place
+	size_t write_index = 0;
+	for (size_t t = 0; t < triangle_number; t++) {
+		if (removed[t]) {
+			continue;
+		}
+		const unsigned int a = indices[3 * t + 0];
+		const unsigned int b = indices[3 * t + 1];
+		const unsigned int c = indices[3 * t + 2];
+		destination[write_index++] = a;
+		destination[write_index++] = b;
+		destination[write_index++] = c;
+	}
+
+	if (statistics) {
+		statistics->degenerate_number = degenerate_number;
+		statistics->duplicate_number = duplicate_number;
+	}
+	return write_index;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct VertexCacheStatistics {
+	size_t vertices_transformed;
+	size_t triangle_number;
+	size_t vertex_number;
+	// Average cache miss ratio: transformed vertices per triangle (0.5 is ideal, 3 is worst)
+	float acmr;
+	// Average transform to vertex ratio: transformed vertices per referenced vertex (1 is ideal)
+	float atvr;
+};
+
+// Simulates a FIFO post-transform cache of cache_size entries over a triangle list
+VertexCacheStatistics AnalyzeVertexCache(const unsigned int *indices, size_t index_number,
+	size_t vertex_number, unsigned int cache_size = 16);
+
+// Reorders triangles for post-transform cache reuse with Forsyth's algorithm
+// (https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html).
+// destination must not overlap indices.
+void OptimizeVertexCache(unsigned int *destination, const unsigned int *indices, size_t index_number,
+	size_t vertex_number);
+
+struct OverdrawStatistics {
+	size_t pixels_covered;
+	size_t pixels_shaded;
+	// Shaded pixels per covered pixel (1 is ideal)
+	float overdraw;
+};
+
+// Estimates overdraw of a triangle list drawn in index order with a LESS depth
+// test. The mesh is rasterized orthographically from several directions around
+// it; front and back facing triangles go to separate depth buffers, so every
+// direction also accounts for the opposite viewpoint with back face culling.
+// positions point to the x of the first vertex, position_stride is in bytes.
+OverdrawStatistics AnalyzeOverdraw(const unsigned int *indices, size_t index_number,
+	const float *positions, size_t position_stride, size_t vertex_number);
+
+// Splits a cache optimized triangle list into clusters and sorts the clusters so
+// the ones facing away from the mesh center are drawn first (Sander et al., "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw"). A cluster ends
+// once its running ACMR is within threshold times the ACMR of the cache order,
+// so 1.0 keeps vertex cache efficiency and larger values give more clusters to sort.
+// destination must not overlap indices.
+void OptimizeOverdraw(unsigned int *destination, const unsigned int *indices, size_t index_number,
+	const float *positions, size_t position_stride, size_t vertex_number, float threshold);
+
+struct VertexFetchStatistics {
+	size_t bytes_fetched;
+	size_t bytes_referenced;
+	// Fetched bytes per referenced vertex byte (1 is ideal)
+	float overfetch;
+};
+
+// Simulates a FIFO cache of cache_size bytes in cache_line_size lines over the
+// vertex fetches of a triangle list. The vertex buffer is assumed to start on a
+// cache line.
+VertexFetchStatistics AnalyzeVertexFetch(const unsigned int *indices, size_t index_number,
+	size_t vertex_number, size_t vertex_size, size_t cache_line_size = 64, size_t cache_size = 16 * 1024);
+
+// Reorders vertices by their first use in indices, so consecutive triangles
+// fetch neighbouring memory, and rewrites indices in place to match.
+// Unreferenced vertices are moved to the end. Returns the number of referenced
+// vertices. destination must not overlap vertices.
+size_t OptimizeVertexFetch(void *destination, unsigned int *indices, size_t index_number,
+	const void *vertices, size_t vertex_number, size_t vertex_size);
+
+// Numbers the distinct positions (the first position_size bytes of every vertex,
+// compared bitwise) in order of first appearance and stores the number of every
+// vertex's position in remap. Returns the number of distinct positions.
+size_t GeneratePositionRemap(unsigned int *remap, const void *vertices, size_t vertex_number,
+	size_t vertex_stride, size_t position_size);
+
+// Reorders triangles so spatially close ones are adjacent, by recursive median
+// splits of the triangle centroids along the longest axis. A cluster is split
+// while it has more than max_triangle_number triangles or its bounding box
+// diagonal exceeds max_extent. Returns the first triangle of every cluster
+// followed by the triangle number. destination must not overlap indices.
+std::vector<size_t> ClusterTriangles(unsigned int *destination, const unsigned int *indices, size_t index_number,
+	const float *positions, size_t position_stride, size_t max_triangle_number, float max_extent);
+
+// Simplifies a triangle list by half edge collapses ordered by quadric error
+// (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics").
+// Vertices only move onto other vertices, so the result indexes the same vertex
+// buffer. Vertices on open edges never move: material and chunk borders as well
+// as UV and normal seams, which split vertices, keep their shape. Stops at
+// target_index_number indices or once the next collapse moves the surface by
+// more than target_error. Returns the index number and writes the largest
+// surface distance of the applied collapses to result_error.
+// destination may overlap indices.
+size_t SimplifyMesh(unsigned int *destination, const unsigned int *indices, size_t index_number,
+	const float *positions, size_t position_stride, size_t vertex_number,
+	size_t target_index_number, float target_error, float *result_error);
+
+// Welds vertices whose positions are at most position_tolerance apart and whose
+// attribute_number floats following the position differ by at most
+// attribute_tolerance each. Vertices are hashed into a grid of
+// position_tolerance sized cells and every vertex joins the first earlier
+// leader found in the surrounding cells, so leaders keep their attributes.
+// Leaders are numbered in vertex order and the number of every vertex's leader
+// is stored in remap, which never exceeds the vertex number itself. Returns the
+// number of leaders. position_tolerance must be positive.
+size_t GenerateWeldRemap(unsigned int *remap, const float *vertices, size_t vertex_stride, size_t vertex_number,
+	size_t attribute_number, float position_tolerance, float attribute_tolerance);
+
+struct TriangleCleanupStatistics {
+	// Triangles with a repeated vertex or zero area
+	size_t degenerate_number;
+	// Repeats of a triangle with the same vertices in the same winding
+	size_t duplicate_number;
+};
+
+// Removes degenerate triangles and all but the first copy of duplicate ones,
+// keeping the order of the rest. A triangle with the opposite winding is not a
+// duplicate, it is the back side. Returns the index number.
+// destination may overlap indices.
+size_t RemoveDegenerateTriangles(unsigned int *destination, const unsigned int *indices, size_t index_number,
+	const float *positions, size_t position_stride, TriangleCleanupStatistics *statistics);
@@ -0,0 +1,144 @@
+#include "meshlet_builder.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const uint8_t unused_local_vertex = 0xFF;
+
+static inline XMFLOAT3 LoadPosition(const float *positions, size_t position_stride, unsigned int vertex) {
+	const float *position = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + vertex * position_stride);
+	return {position[0], position[1], position[2]};
+}
+
+static inline XMFLOAT3 Subtract(const XMFLOAT3 &a, const XMFLOAT3 &b) {
+	return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+static inline float Dot(const XMFLOAT3 &a, const XMFLOAT3 &b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+void BuildMeshlets(std::vector<Meshlet> &meshlets, std::vector<unsigned int> &meshlet_vertices,
+	std::vector<uint8_t> &meshlet_triangles, const unsigned int *indices, size_t index_number,
+	size_t vertex_number, unsigned int vertex_offset, size_t max_vertex_number, size_t max_triangle_number) {
+	// Local index of every vertex in the current meshlet
+	std::vector<uint8_t> local_vertices(vertex_number, unused_local_vertex);
+
+	Meshlet meshlet = {};
+	meshlet.vertex_offset = static_cast<unsigned int>(meshlet_vertices.size());
+	meshlet.triangle_offset = static_cast<unsigned int>(meshlet_triangles.size() / 3);
+
+	for (size_t i = 0; i + 2 < index_number; i += 3) {
+		size_t new_vertex_number = 0;
+		for (int corner = 0; corner < 3; corner++) {
+			new_vertex_number += (local_vertices[indices[i + corner]] == unused_local_vertex) ? 1 : 0;
+		}
+
+		if (meshlet.vertex_number + new_vertex_number > max_vertex_number || meshlet.triangle_number + 1 > max_triangle_number) {
+			for (unsigned int v = 0; v < meshlet.vertex_number; v++) {
+				local_vertices[meshlet_vertices[meshlet.vertex_offset + v] - vertex_offset] = unused_local_vertex;
+			}
+			meshlets.push_back(meshlet);
+			meshlet.vertex_offset = static_cast<unsigned int>(meshlet_vertices.size());
+			meshlet.triangle_offset = static_cast<unsigned int>(meshlet_triangles.size() / 3);
+			meshlet.vertex_number = 0;
+			meshlet.triangle_number = 0;
+		}
+
+		for (int corner = 0; corner < 3; corner++) {
+			uint8_t &local_vertex = local_vertices[indices[i + corner]];
+			if (local_vertex == unused_local_vertex) {
+				local_vertex = static_cast<uint8_t>(meshlet.vertex_number++);
+				meshlet_vertices.push_back(vertex_offset + indices[i + corner]);
+			}
+			meshlet_triangles.push_back(local_vertex);
+		}
+		meshlet.triangle_number++;
+	}
+
+	if (meshlet.triangle_number > 0) {
+		meshlets.push_back(meshlet);
+	}
+}
+
+MeshletBounds ComputeMeshletBounds(const Meshlet &meshlet, const unsigned int *meshlet_vertices,
+	const uint8_t *meshlet_triangles, const float *positions, size_t position_stride) {
+	MeshletBounds bounds = {};
+	bounds.cone_cutoff = 1.0f;
+	if (meshlet.triangle_number == 0) {
+		return bounds;
+	}
+
+	const unsigned int *vertices = meshlet_vertices + meshlet.vertex_offset;
+	const uint8_t *triangles = meshlet_triangles + 3 * meshlet.triangle_offset;
+
+	// Sphere around the box center, like DrawBounds
+	XMFLOAT3 min_corner = LoadPosition(positions, position_stride, vertices[0]);
+	XMFLOAT3 max_corner = min_corner;
+	for (unsigned int v = 1; v < meshlet.vertex_number; v++) {
+		const XMFLOAT3 position = LoadPosition(positions, position_stride, vertices[v]);
+		min_corner = {std::min(min_corner.x, position.x), std::min(min_corner.y, position.y), std::min(min_corner.z, position.z)};
+		max_corner = {std::max(max_corner.x, position.x), std::max(max_corner.y, position.y), std::max(max_corner.z, position.z)};
+	}
+	bounds.center = {(min_corner.x + max_corner.x) * 0.5f, (min_corner.y + max_corner.y) * 0.5f, (min_corner.z + max_corner.z) * 0.5f};
+	for (unsigned int v = 0; v < meshlet.vertex_number; v++) {
+		const XMFLOAT3 offset = Subtract(LoadPosition(positions, position_stride, vertices[v]), bounds.center);
+		bounds.radius = std::max(bounds.radius, std::sqrt(Dot(offset, offset)));
+	}
+
+	// Cone axis is the average of the unit triangle normals, degenerate triangles are skipped.
+	// Normals point to the side the renderer treats as front (counter clockwise in a left-handed space).
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT3> first_corners;
+	normals.reserve(meshlet.triangle_number);
+	first_corners.reserve(meshlet.triangle_number);
+	XMFLOAT3 axis = {0.0f, 0.0f, 0.0f};
+	for (unsigned int t = 0; t < meshlet.triangle_number; t++) {
+		const XMFLOAT3 p0 = LoadPosition(positions, position_stride, vertices[triangles[3 * t + 0]]);
+		const XMFLOAT3 p1 = LoadPosition(positions, position_stride, vertices[triangles[3 * t + 1]]);
+		const XMFLOAT3 p2 = LoadPosition(positions, position_stride, vertices[triangles[3 * t + 2]]);
+		const XMFLOAT3 e1 = Subtract(p1, p0);
+		const XMFLOAT3 e2 = Subtract(p2, p0);
+		const XMFLOAT3 normal = {e2.y * e1.z - e2.z * e1.y, e2.z * e1.x - e2.x * e1.z, e2.x * e1.y - e2.y * e1.x};
+		const float length = std::sqrt(Dot(normal, normal));
+		if (length == 0.0f) {
+			continue;
+		}
+		normals.push_back({normal.x / length, normal.y / length, normal.z / length});
+		first_corners.push_back(p0);
+		axis = {axis.x + normals.back().x, axis.y + normals.back().y, axis.z + normals.back().z};
+	}
+
+	const float axis_length = std::sqrt(Dot(axis, axis));
+	if (axis_length == 0.0f) {
+		return bounds;
+	}
+	axis = {axis.x / axis_length, axis.y / axis_length, axis.z / axis_length};
+
+	float min_cosine = 1.0f;
+	for (const XMFLOAT3 &normal : normals) {
+		min_cosine = std::min(min_cosine, Dot(normal, axis));
+	}
+	if (min_cosine <= 0.1f) {
+		// Normals spread over more than a hemisphere, there is always a side that faces the camera
+		return bounds;
+	}
+
+	// The apex is moved back along the axis until every triangle plane is in front of it
+	float max_distance = 0.0f;
+	for (size_t t = 0; t < normals.size(); t++) {
+		const float distance = Dot(Subtract(bounds.center, first_corners[t]), normals[t]) / Dot(axis, normals[t]);
+		max_distance = std::max(max_distance, distance);
+	}
+
+	bounds.cone_axis = axis;
+	bounds.cone_apex = {bounds.center.x - axis.x * max_distance, bounds.center.y - axis.y * max_distance, bounds.center.z - axis.z * max_distance};
+	bounds.cone_cutoff = std::sqrt(1.0f - min_cosine * min_cosine);
+	return bounds;
+}
+
+bool IsMeshletBackfacing(const MeshletBounds &bounds, const XMFLOAT3 &camera_position) {
+	const XMFLOAT3 direction = Subtract(bounds.cone_apex, camera_position);
+	const float length = std::sqrt(Dot(direction, direction));
+	return length > 0.0f && Dot(direction, bounds.cone_axis) >= bounds.cone_cutoff * length;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "vertex_formats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Small cluster of a triangle list: its vertices are listed in meshlet_vertices
+// and its triangles are triples of 8-bit indices into that list
+struct Meshlet {
+	unsigned int vertex_offset;
+	unsigned int triangle_offset;
+	unsigned int vertex_number;
+	unsigned int triangle_number;
+};
+
+// Bounding sphere and normal cone of a meshlet. It faces away from a camera at
+// position when dot(normalize(cone_apex - position), cone_axis) >= cone_cutoff;
+// a cutoff of 1 marks a cone too wide to ever cull.
+struct MeshletBounds {
+	XMFLOAT3 center;
+	float radius;
+	XMFLOAT3 cone_apex;
+	float cone_cutoff;
+	XMFLOAT3 cone_axis;
+	float reserved;
+};
+
+static const size_t max_meshlet_vertex_number = 64;
+static const size_t max_meshlet_triangle_number = 124;
+
+// Splits a triangle list into meshlets in index order, so a cache optimized list
+// gives compact meshlets. Appends to the output arrays; meshlet_vertices gets
+// vertex_offset + the index of every meshlet vertex.
+void BuildMeshlets(std::vector<Meshlet> &meshlets, std::vector<unsigned int> &meshlet_vertices,
+	std::vector<uint8_t> &meshlet_triangles, const unsigned int *indices, size_t index_number,
+	size_t vertex_number, unsigned int vertex_offset = 0,
+	size_t max_vertex_number = max_meshlet_vertex_number, size_t max_triangle_number = max_meshlet_triangle_number);
+
+// positions point to the x of the first vertex, position_stride is in bytes.
+// The cone follows the front face winding of the renderer (counter clockwise).
+MeshletBounds ComputeMeshletBounds(const Meshlet &meshlet, const unsigned int *meshlet_vertices,
+	const uint8_t *meshlet_triangles, const float *positions, size_t position_stride);
+
+bool IsMeshletBackfacing(const MeshletBounds &bounds, const XMFLOAT3 &camera_position);
@@ -1,24 +1,79 @@
 #include "model_loader.h"
+#include "external_sort.h"
+#include "mesh_cache.h"
+#include "mesh_codec.h"
+#include "mesh_optimizer.h"
+#include "normal_generator.h"
+#include "obj_parser.h"
+#include "parallel_for.h"
+#include "tangent_generator.h"
+#include "vertex_conversion.h"
+#include "vertex_index_map.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
-typedef std::map<std::tuple<int, int, int>, unsigned int> index_map_type;
+using namespace std::chrono;
 
-HRESULT ModelLoader::LoadModel(std::string path) {
-	// Create and upload vertex buffer
-	obj_path = GetBinPath(std::string());
-	std::string obj_file = obj_path + path;
+// 16-bit indices address this many vertices above start_vertex
+static const unsigned int max_short_index_vertex_number = 65536;
 
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	//std::vector<tinyobj::material_t> materials;
+// Faces per chunk below which splitting the material partition further does not pay off
+static const size_t min_assembly_chunk_face_number = 16384;
 
-	std::string warn;
-	std::string err;
+// Buffer views store their size in 32 bits
+static const uint64_t max_buffer_view_size = 0xFFFFFFFFull;
+
+// Bumped whenever the loader produces different output for the same source and options
+static const uint64_t loader_output_version = 5;
+
+// Streaming conversion gives the parse window and the two sorters these shares of the memory
+// budget, and puts one triangle per this many bytes of it into a batch of ProcessMesh. Parsed
+// chunks take a few times the text of their window, and the index sorter fills while the corner
+// sorter still holds its last runs.
+static const uint64_t streaming_window_divisor = 16;
+static const uint64_t streaming_corner_sort_divisor = 2;
+static const uint64_t streaming_index_sort_divisor = 4;
+static const uint64_t streaming_batch_triangle_size = 320;
+// Tangent sums of a material take this share of the budget, larger materials are summed in windows
+static const uint64_t streaming_tangent_window_divisor = 4;
+
+// Vertices converted and indices written per spill file append
+static const size_t streaming_block_size = 1 << 12;
+
+struct FaceReference {
+	const tinyobj::index_t *corners;
+	unsigned int corner_number;
+};
+
+void ModelLoader::SetOptions(const LoaderOptions &loader_options) {
+	options = loader_options;
+}
 
-	bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, obj_file.c_str(), obj_path.c_str());
+static uint64_t GetBufferSizeLimit(const LoaderOptions &options) {
+	return std::min(options.max_buffer_size, max_buffer_view_size);
+}
+
+// Only what the enabled passes use is computed
+static void ComputeMeshExtent(const FullVertex *mesh_vertices, size_t mesh_vertex_number, const LoaderOptions &options,
+	DrawBounds &bounds, VertexQuantization &quantization) {
+	if (options.chunk_triangle_number > 0 && options.chunk_extent_ratio > 0.0f) {
+		bounds = ComputeDrawBounds(reinterpret_cast<const float *>(mesh_vertices), sizeof(FullVertex), mesh_vertex_number);
+	}
+	if (options.pack_vertices) {
+		quantization = ComputeVertexQuantization(mesh_vertices, mesh_vertex_number);
+	}
+}
 
+static void LogObjReaderMessages(const std::string &warn, const std::string &err) {
 	if (!warn.empty()) {
 		std::wstring wwarn(warn.begin(), warn.end());
 		wwarn = L"Tiny OBJ reader warning: " + wwarn + L"\n";
@@ -30,111 +85,1835 @@ HRESULT ModelLoader::LoadModel(std::string path) {
 		werr = L"Tiny OBJ reader error: " + werr + L"\n";
 		OutputDebugString(werr.c_str());
 	}
+}
+
+HRESULT ModelLoader::LoadModel(std::string path) {
+	// Create and upload vertex buffer
+	obj_path = GetBinPath(std::string());
+	std::string obj_file = obj_path + path;
+	std::string cache_file = obj_file + ".cache";
+	uint64_t source_stamp = GetSourceStamp(obj_file);
+	if (source_stamp != 0) {
+		source_stamp ^= GetOptionsStamp();
+	}
+
+	statistics = {};
+	high_resolution_clock::time_point cache_start = high_resolution_clock::now();
+	if (LoadCache(cache_file, source_stamp)) {
+		duration<double> cache_time = duration_cast<duration<double>>(high_resolution_clock::now() - cache_start);
+		std::wstring cache_message = L"Cooked mesh loaded in " + std::to_wstring(cache_time.count() * 1000.0) + L" ms\n";
+		OutputDebugString(cache_message.c_str());
+		statistics.cache_hit = true;
+		statistics.cache_time = cache_time.count();
+		statistics.total_time = cache_time.count();
+		return S_OK;
+	}
+	statistics.cache_time = duration_cast<duration<double>>(high_resolution_clock::now() - cache_start).count();
+
+	if (options.streaming_memory_budget > 0) {
+		HRESULT hr = LoadModelStreaming(obj_file, cache_file, source_stamp);
+		statistics.total_time = duration_cast<duration<double>>(high_resolution_clock::now() - cache_start).count();
+		return hr;
+	}
 
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	//std::vector<tinyobj::material_t> materials;
+
+	std::string warn;
+	std::string err;
+
+	high_resolution_clock::time_point parse_start = high_resolution_clock::now();
+	bool ret = LoadObjParallel(&attrib, &shapes, &materials, &material_libraries, &warn, &err, obj_file.c_str(), obj_path.c_str(), options.thread_number);
+	duration<double> parse_time = duration_cast<duration<double>>(high_resolution_clock::now() - parse_start);
+
+	LogObjReaderMessages(warn, err);
 	if (!ret) {
 		return E_ABORT;
 	}
 
-	//index_map_type indices_map;
-	std::vector<std::vector<FullVertex>> per_material_vertices(materials.size());
-	std::vector<std::vector<unsigned int>> per_material_indices(materials.size());
-	std::vector<index_map_type> per_material_indices_map(materials.size());
+	std::ifstream obj_stream(obj_file, std::ios::binary | std::ios::ate);
+	double obj_size = static_cast<double>(obj_stream.tellg());
+	statistics.parse_time = parse_time.count();
+	statistics.source_size = static_cast<size_t>(obj_size);
+	std::wstring parse_message = L"OBJ parsed in " + std::to_wstring(parse_time.count() * 1000.0) + L" ms (" +
+		std::to_wstring(obj_size / parse_time.count() / 1e9) + L" GB/s)\n";
+	OutputDebugString(parse_message.c_str());
 
-	// Loop over shapes
+	if (options.generate_normals) {
+		high_resolution_clock::time_point normal_start = high_resolution_clock::now();
+		const size_t generated_normal_number = GenerateNormals(attrib, shapes, options.normal_crease_angle, options.area_weighted_normals, options.thread_number);
+		statistics.normal_time = duration_cast<duration<double>>(high_resolution_clock::now() - normal_start).count();
+		if (generated_normal_number > 0) {
+			std::wstring normal_message = L"Normals generated: " + std::to_wstring(generated_normal_number) + L" in " +
+				std::to_wstring(statistics.normal_time * 1000.0) + L" ms\n";
+			OutputDebugString(normal_message.c_str());
+		}
+	}
+
+	high_resolution_clock::time_point assembly_start = high_resolution_clock::now();
+	const size_t material_number = materials.size();
+
+	// Faces of all shapes are numbered globally and cut into chunks, which may start inside a shape
+	std::vector<size_t> shape_face_offsets(shapes.size() + 1, 0);
+	std::vector<size_t> shape_corner_offsets(shapes.size() + 1, 0);
 	for (size_t s = 0; s < shapes.size(); s++) {
-		// Loop over faces(polygon)
-		size_t index_offset = 0;
-		for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-			int fv = shapes[s].mesh.num_face_vertices[f];
-
-			// Loop over vertices in the face.
-			// per-face material
-			int material_id = shapes[s].mesh.material_ids[f];
-			for (size_t v = 0; v < fv; v++) {
-				// access to vertex
-				tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-				std::tuple<int, int, int> idx_tuple = std::make_tuple(idx.vertex_index, idx.normal_index, idx.texcoord_index);
-
-				if (per_material_indices_map[material_id].count(idx_tuple) > 0) {
-					per_material_indices[material_id].push_back(per_material_indices_map[material_id][idx_tuple]);
-				} else {
-
-					tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-					tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-					tinyobj::real_t vz = -1.0f - attrib.vertices[3 * idx.vertex_index + 2];
-					tinyobj::real_t nx = (idx.normal_index > -1) ? attrib.normals[3 * idx.normal_index + 0] : 0.0f;
-					tinyobj::real_t ny = (idx.normal_index > -1) ? attrib.normals[3 * idx.normal_index + 1] : 0.0f;
-					tinyobj::real_t nz = (idx.normal_index > -1) ? -1.0f * attrib.normals[3 * idx.normal_index + 2] : 0.0f;
-					tinyobj::real_t tu = (idx.texcoord_index > -1) ? attrib.texcoords[2 * idx.texcoord_index + 0] : 0.0f;
-					tinyobj::real_t tv = (idx.texcoord_index > -1) ? 1.0f - attrib.texcoords[2 * idx.texcoord_index + 1] : 0.0f;
-
-					materials[material_id].diffuse;
-
-					FullVertex vertex = {};
-					vertex.position = {vx, vy, vz};
-					vertex.normal = {nx, ny, nz};
-					vertex.texcoord = {tu, tv};
-					vertex.diffuseColor = {
-						materials[material_id].diffuse[0],
-						materials[material_id].diffuse[1],
-						materials[material_id].diffuse[2]
-					};
-
-					per_material_indices[material_id].push_back(per_material_vertices[material_id].size());
-					per_material_indices_map[material_id][idx_tuple] = per_material_vertices[material_id].size();
-					per_material_vertices[material_id].push_back(vertex);
-				}
+		shape_face_offsets[s + 1] = shape_face_offsets[s] + shapes[s].mesh.num_face_vertices.size();
+		shape_corner_offsets[s + 1] = shape_corner_offsets[s] + shapes[s].mesh.indices.size();
+	}
+	const size_t face_number = shape_face_offsets[shapes.size()];
+	const size_t chunk_number = std::max<size_t>(1, std::min<size_t>(4 * (options.thread_number ? options.thread_number : GetWorkerNumber()), face_number / min_assembly_chunk_face_number));
+
+	// Radix partition of the faces by material: every chunk counts its faces and corners per material...
+	std::vector<size_t> chunk_face_counts(chunk_number * material_number, 0);
+	std::vector<size_t> chunk_index_counts(chunk_number * material_number, 0);
+	std::vector<size_t> chunk_corner_numbers(chunk_number + 1, 0);
+	std::vector<size_t> chunk_skipped_faces(chunk_number, 0);
+	ParallelFor(chunk_number, [&](size_t chunk) {
+		size_t *face_counts = chunk_face_counts.data() + chunk * material_number;
+		size_t *index_counts = chunk_index_counts.data() + chunk * material_number;
+		size_t corner_number = 0;
+		size_t skipped_faces = 0;
+		const size_t face_begin = face_number * chunk / chunk_number;
+		const size_t face_end = face_number * (chunk + 1) / chunk_number;
+		size_t s = std::upper_bound(shape_face_offsets.begin(), shape_face_offsets.end(), face_begin) - shape_face_offsets.begin() - 1;
+		for (size_t global_face = face_begin; global_face < face_end; global_face++) {
+			while (global_face >= shape_face_offsets[s + 1]) {
+				s++;
+			}
+			const size_t f = global_face - shape_face_offsets[s];
+			const int material_id = shapes[s].mesh.material_ids[f];
+			const unsigned int fv = shapes[s].mesh.num_face_vertices[f];
+			corner_number += fv;
+			if (material_id < 0 || static_cast<size_t>(material_id) >= material_number) {
+				skipped_faces++;
+				continue;
+			}
+			face_counts[material_id]++;
+			index_counts[material_id] += fv;
+		}
+		chunk_corner_numbers[chunk + 1] = corner_number;
+		chunk_skipped_faces[chunk] = skipped_faces;
+	}, options.thread_number);
+
+	// ...the counts are prefix summed material major, so every chunk gets its own cursors and file order is kept...
+	std::vector<size_t> material_face_offsets(material_number + 1, 0);
+	std::vector<size_t> material_index_offsets(material_number + 1, 0);
+	std::vector<size_t> chunk_face_cursors(chunk_number * material_number);
+	size_t skipped_face_num = 0;
+	for (size_t material_id = 0; material_id < material_number; material_id++) {
+		size_t face_cursor = material_face_offsets[material_id];
+		size_t index_cursor = material_index_offsets[material_id];
+		for (size_t chunk = 0; chunk < chunk_number; chunk++) {
+			chunk_face_cursors[chunk * material_number + material_id] = face_cursor;
+			face_cursor += chunk_face_counts[chunk * material_number + material_id];
+			index_cursor += chunk_index_counts[chunk * material_number + material_id];
+		}
+		material_face_offsets[material_id + 1] = face_cursor;
+		material_index_offsets[material_id + 1] = index_cursor;
+	}
+	for (size_t chunk = 0; chunk < chunk_number; chunk++) {
+		chunk_corner_numbers[chunk + 1] += chunk_corner_numbers[chunk];
+		skipped_face_num += chunk_skipped_faces[chunk];
+	}
+
+	if (skipped_face_num > 0) {
+		std::wstring skip_message = L"Faces without a material skipped: " + std::to_wstring(skipped_face_num) + L"\n";
+		OutputDebugString(skip_message.c_str());
+	}
+
+	// ...and scatters its faces
+	std::vector<FaceReference> material_faces(material_face_offsets[material_number]);
+	ParallelFor(chunk_number, [&](size_t chunk) {
+		size_t *face_cursors = chunk_face_cursors.data() + chunk * material_number;
+		const size_t face_begin = face_number * chunk / chunk_number;
+		const size_t face_end = face_number * (chunk + 1) / chunk_number;
+		size_t s = std::upper_bound(shape_face_offsets.begin(), shape_face_offsets.end(), face_begin) - shape_face_offsets.begin() - 1;
+		size_t index_offset = chunk_corner_numbers[chunk] - shape_corner_offsets[s];
+		for (size_t global_face = face_begin; global_face < face_end; global_face++) {
+			while (global_face >= shape_face_offsets[s + 1]) {
+				s++;
+				index_offset = 0;
+			}
+			const size_t f = global_face - shape_face_offsets[s];
+			const int material_id = shapes[s].mesh.material_ids[f];
+			const unsigned int fv = shapes[s].mesh.num_face_vertices[f];
+			if (material_id >= 0 && static_cast<size_t>(material_id) < material_number) {
+				material_faces[face_cursors[material_id]++] = {&shapes[s].mesh.indices[index_offset], fv};
 			}
 			index_offset += fv;
 		}
-	};
+	}, options.thread_number);
+
+	// Draw calls address the whole streams with 32-bit offsets until BuildMeshBuffers makes them buffer relative
+	if (material_index_offsets[material_number] > std::numeric_limits<unsigned int>::max()) {
+		std::wstring size_message = L"Meshes with more than 2^32 indices cannot be loaded in memory, convert them with streaming_memory_budget: " +
+			std::to_wstring(material_index_offsets[material_number]) + L"\n";
+		OutputDebugString(size_message.c_str());
+		return E_ABORT;
+	}
+
+	// Dedup every material on its own thread: indices go straight to their final place,
+	// the OBJ index triple of every new vertex is kept to build vertices later
+	indices.resize(material_index_offsets[material_number]);
+	std::vector<std::vector<tinyobj::index_t>> material_vertex_keys(material_number);
+	ParallelFor(material_number, [&](size_t material_id) {
+		std::vector<tinyobj::index_t> &vertex_keys = material_vertex_keys[material_id];
+		const size_t material_index_number = material_index_offsets[material_id + 1] - material_index_offsets[material_id];
+		unsigned int *material_indices = indices.data() + material_index_offsets[material_id];
+		VertexIndexMap vertex_index_map(material_index_number);
+		vertex_keys.reserve(material_index_number);
+
+		for (size_t f = material_face_offsets[material_id]; f < material_face_offsets[material_id + 1]; f++) {
+			const FaceReference &face = material_faces[f];
+			for (unsigned int v = 0; v < face.corner_number; v++) {
+				bool inserted;
+				unsigned int new_vertex_id = static_cast<unsigned int>(vertex_keys.size());
+				*material_indices++ = vertex_index_map.FindOrInsert(face.corners[v], new_vertex_id, inserted);
+				if (inserted) {
+					vertex_keys.push_back(face.corners[v]);
+				}
+			}
+		}
+	}, options.thread_number);
+
+	std::vector<size_t> material_vertex_offsets(material_number + 1, 0);
+	for (size_t material_id = 0; material_id < material_number; material_id++) {
+		material_vertex_offsets[material_id + 1] = material_vertex_offsets[material_id] + material_vertex_keys[material_id].size();
+	}
 
-	for (size_t material_id = 0; material_id < GetMaterialNumber(); material_id++) {
+	high_resolution_clock::time_point vertex_start = high_resolution_clock::now();
+	statistics.dedup_time = duration_cast<duration<double>>(vertex_start - assembly_start).count();
+
+	// Now the vertex number is known and vertices are written once, tangents follow in ProcessMesh
+	vertices.resize(material_vertex_offsets[material_number]);
+	tangents.clear();
+	ParallelFor(material_number, [&](size_t material_id) {
+		const std::vector<tinyobj::index_t> &vertex_keys = material_vertex_keys[material_id];
+		ConvertVertices(vertices.data() + material_vertex_offsets[material_id], attrib, vertex_keys.data(), vertex_keys.size());
+	}, options.thread_number);
+
+	for (size_t material_id = 0; material_id < material_number; material_id++) {
 		DrawCallParams param = {};
-		param.index_num = static_cast<unsigned int>(indices.size());
-		param.start_index = indices.size();
-		param.start_vertex = vertices.size();
+		param.index_num = static_cast<unsigned int>(material_index_offsets[material_id + 1] - material_index_offsets[material_id]);
+		param.start_index = static_cast<unsigned int>(material_index_offsets[material_id]);
+		param.start_vertex = static_cast<unsigned int>(material_vertex_offsets[material_id]);
+		param.vertex_num = static_cast<unsigned int>(material_vertex_offsets[material_id + 1] - material_vertex_offsets[material_id]);
+		param.material_id = static_cast<unsigned int>(material_id);
+		param.index_size = sizeof(unsigned int);
+		draw_call_params.push_back(param);
+	}
+
+	high_resolution_clock::time_point processing_start = high_resolution_clock::now();
+	duration<double> assembly_time = duration_cast<duration<double>>(processing_start - assembly_start);
+	statistics.assembly_time = duration_cast<duration<double>>(processing_start - vertex_start).count();
+	std::wstring assembly_message = L"Mesh assembled in " + std::to_wstring(assembly_time.count() * 1000.0) + L" ms (dedup " +
+		std::to_wstring(statistics.dedup_time * 1000.0) + L" ms)\n";
+	OutputDebugString(assembly_message.c_str());
 
-		vertices.insert(end(vertices), begin(per_material_vertices[material_id]), end(per_material_vertices[material_id]));
-		indices.insert(end(indices), begin(per_material_indices[material_id]), end(per_material_indices[material_id]));
+	// Bounds and quantization of the whole mesh come before cleanup, the only place streaming conversion has them too
+	DrawBounds mesh_bounds = {};
+	VertexQuantization mesh_quantization = {};
+	ComputeMeshExtent(vertices.data(), vertices.size(), options, mesh_bounds, mesh_quantization);
+	ProcessMesh(mesh_bounds, mesh_quantization);
 
-		param.index_num = static_cast<unsigned int>(per_material_indices[material_id].size());
-		per_material_draw_call_params.push_back(param);
+	vertex_number = vertices.size();
+	index_data = indices.data();
+	index_number = indices.size();
+	short_index_data = short_indices.data();
+	short_index_number = short_indices.size();
+	tangent_data = tangents.data();
+	tangent_number = tangents.size();
+	position_data = positions.data();
+	position_number = positions.size() / position_stride;
+	position_index_data = position_indices.data();
+	position_index_number = position_indices.size();
+	position_index_offset_data = position_index_offsets.data();
+	position_index_offset_number = position_index_offsets.size();
+	meshlet_data = meshlets.data();
+	meshlet_bounds_data = meshlet_bounds.data();
+	meshlet_number = meshlets.size();
+	meshlet_vertex_data = meshlet_vertices.data();
+	meshlet_vertex_number = meshlet_vertices.size();
+	meshlet_triangle_data = meshlet_triangles.data();
+	meshlet_triangle_number = meshlet_triangles.size() / 3;
+	meshlet_offset_data = meshlet_offsets.data();
+	meshlet_offset_number = meshlet_offsets.size();
+
+	statistics.processing_time = duration_cast<duration<double>>(high_resolution_clock::now() - processing_start).count();
+
+	if (!SaveCache(cache_file, source_stamp)) {
+		OutputDebugString(L"Cannot write cooked mesh\n");
 	}
 
+	statistics.total_time = duration_cast<duration<double>>(high_resolution_clock::now() - cache_start).count();
 	return S_OK;
 }
 
-const FullVertex *ModelLoader::GetVertexBuffer() const {
-	return vertices.data();
+void ModelLoader::ProcessMesh(const DrawBounds &mesh_bounds, const VertexQuantization &mesh_quantization) {
+	if (options.weld_tolerance > 0.0f || options.remove_degenerate_triangles) {
+		CleanMesh();
+	}
+
+	// Tangents are summed while every draw call is still a whole material, so the vertices chunks and
+	// sub draws duplicate on their borders get the same tangent. Streaming batches come with theirs.
+	if (options.generate_tangents && tangents.empty()) {
+		BuildTangents();
+	}
+
+	if (options.chunk_triangle_number > 0) {
+		ChunkDrawCalls(mesh_bounds);
+	}
+
+	OptimizeMesh();
+
+	// Every draw call has to fit a buffer on its own, its levels of detail included.
+	// Each level keeps at most 90% of the previous one, so the chain takes at most
+	// lod_level_number + 1 times the indices of the draw call.
+	const uint64_t buffer_size = GetBufferSizeLimit(options);
+	const size_t final_vertex_stride = options.pack_vertices ? sizeof(PackedVertex) : sizeof(FullVertex);
+	size_t max_draw_vertex_number = static_cast<size_t>(std::min<uint64_t>(buffer_size / final_vertex_stride, std::numeric_limits<unsigned int>::max()));
+	size_t max_draw_index_number = static_cast<size_t>(buffer_size / sizeof(unsigned int) / (options.lod_level_number + 1ull)) / 3 * 3;
+	if (options.short_indices && options.split_large_draw_calls) {
+		max_draw_vertex_number = std::min<size_t>(max_draw_vertex_number, max_short_index_vertex_number);
+	}
+	SplitDrawCalls(std::max<size_t>(max_draw_vertex_number, 3), std::max<size_t>(max_draw_index_number, 3));
+
+	if (options.pack_vertices) {
+		vertex_quantization = mesh_quantization;
+		PackMesh();
+		vertex_data = packed_vertices.data();
+		vertex_stride = sizeof(PackedVertex);
+	} else {
+		vertex_data = vertices.data();
+		vertex_stride = sizeof(FullVertex);
+	}
+
+	BuildDrawBounds();
+
+	if (options.build_meshlets) {
+		BuildDrawMeshlets();
+	}
+
+	BuildDrawLods();
+
+	// Lays out both index streams in draw call order, with the levels of detail next to their draw call
+	BuildShortIndices();
+
+	BuildMeshBuffers();
+
+	// Positions come from the final vertex format, so both streams produce the same depth
+	if (options.position_stream) {
+		BuildPositionStream();
+	}
 }
 
-const unsigned int ModelLoader::GetVertexBufferSize() const {
-	return static_cast<unsigned int>(vertices.size() * sizeof(FullVertex));
+// One triangle corner while materials are deduplicated out of core
+struct StreamingCorner {
+	unsigned int material_id;
+	tinyobj::index_t key;
+	// Number of the corner in the file, keeps the triangle order of every material
+	uint64_t corner_id;
+};
+
+// Equal keys of a material end up next to each other
+struct StreamingCornerLess {
+	bool operator()(const StreamingCorner &a, const StreamingCorner &b) const {
+		if (a.material_id != b.material_id) {
+			return a.material_id < b.material_id;
+		}
+		if (a.key.vertex_index != b.key.vertex_index) {
+			return a.key.vertex_index < b.key.vertex_index;
+		}
+		if (a.key.normal_index != b.key.normal_index) {
+			return a.key.normal_index < b.key.normal_index;
+		}
+		if (a.key.texcoord_index != b.key.texcoord_index) {
+			return a.key.texcoord_index < b.key.texcoord_index;
+		}
+		return a.corner_id < b.corner_id;
+	}
+};
+
+// Deduplicated vertex of a corner, sorted back into triangle order
+struct StreamingIndex {
+	uint64_t corner_id;
+	unsigned int material_id;
+	unsigned int vertex_id;
+};
+
+struct StreamingIndexLess {
+	bool operator()(const StreamingIndex &a, const StreamingIndex &b) const {
+		return a.material_id != b.material_id ? a.material_id < b.material_id : a.corner_id < b.corner_id;
+	}
+};
+
+// Output of streaming conversion, appended batch by batch and mapped for the cooked mesh write
+struct StreamingStreams {
+	SpillFile vertices;
+	SpillFile indices;
+	SpillFile short_indices;
+	SpillFile tangents;
+	SpillFile positions;
+	SpillFile position_indices;
+	SpillFile meshlets;
+	SpillFile meshlet_bounds;
+	SpillFile meshlet_vertices;
+	SpillFile meshlet_triangles;
+};
+
+HRESULT ModelLoader::LoadModelStreaming(const std::string &obj_file, const std::string &cache_file, uint64_t source_stamp) {
+	// Spill files go next to the cooked mesh and are removed on the way out
+	SpillFile vertex_file;
+	SpillFile index_file;
+	std::vector<uint64_t> material_vertex_offsets;
+	std::vector<uint64_t> material_index_offsets;
+	if (!SpillObj(obj_file, cache_file, vertex_file, index_file, material_vertex_offsets, material_index_offsets)) {
+		return E_ABORT;
+	}
+
+	high_resolution_clock::time_point processing_start = high_resolution_clock::now();
+	{
+		// The cooked mesh is written from the output spill files, which go once it is
+		StreamingStreams streams;
+		if (!CookSpilledMesh(vertex_file.GetArray<FullVertex>(), index_file.GetArray<unsigned int>(), material_vertex_offsets,
+			material_index_offsets, cache_file, streams)) {
+			return E_ABORT;
+		}
+		vertex_file.Remove();
+		index_file.Remove();
+
+		const bool saved = SaveCache(cache_file, source_stamp);
+		statistics.processing_time = duration_cast<duration<double>>(high_resolution_clock::now() - processing_start).count();
+		if (!saved) {
+			OutputDebugString(L"Cannot write cooked mesh\n");
+			return E_ABORT;
+		}
+	}
+
+	// Unlike a cold load in memory, the mesh only exists in the cooked mesh afterwards
+	if (!LoadCache(cache_file, source_stamp)) {
+		OutputDebugString(L"Cannot map the cooked mesh written by streaming conversion\n");
+		return E_ABORT;
+	}
+	return S_OK;
 }
 
-const unsigned int ModelLoader::GetVertexNumber() const {
-	return vertices.size();
+bool ModelLoader::SpillObj(const std::string &obj_file, const std::string &spill_path, SpillFile &vertex_file, SpillFile &index_file,
+	std::vector<uint64_t> &material_vertex_offsets, std::vector<uint64_t> &material_index_offsets) {
+	const uint64_t budget = options.streaming_memory_budget;
+	SpillFile position_file;
+	SpillFile normal_file;
+	SpillFile texcoord_file;
+	if (!position_file.Create(spill_path + ".positions.tmp") || !normal_file.Create(spill_path + ".normals.tmp") ||
+		!texcoord_file.Create(spill_path + ".texcoords.tmp") || !vertex_file.Create(spill_path + ".mesh_vertices.tmp") ||
+		!index_file.Create(spill_path + ".mesh_indices.tmp")) {
+		OutputDebugString(L"Cannot create spill files next to the cooked mesh\n");
+		return false;
+	}
+
+	// Sorted back into triangle order once the corners are deduplicated
+	ExternalSorter<StreamingIndex, StreamingIndexLess> index_sorter(spill_path + ".index_runs.tmp", static_cast<size_t>(budget / streaming_index_sort_divisor), options.thread_number);
+	size_t missing_normal_number = 0;
+	uint64_t vertex_number = 0;
+	size_t run_number = 0;
+	high_resolution_clock::time_point parse_start = high_resolution_clock::now();
+	{
+		// First pass: attributes go to their spill files and corners into sorted runs, keyed by material and OBJ indices
+		ExternalSorter<StreamingCorner, StreamingCornerLess> corner_sorter(spill_path + ".corner_runs.tmp", static_cast<size_t>(budget / streaming_corner_sort_divisor), options.thread_number);
+		uint64_t corner_number = 0;
+		size_t skipped_face_num = 0;
+		bool spilled = true;
+		std::string warn;
+		std::string err;
+		materials.clear();
+		const size_t window_size = static_cast<size_t>(std::max<uint64_t>(budget / streaming_window_divisor, 1));
+		bool ret = StreamObjParallel(&materials, &material_libraries, &warn, &err, obj_file.c_str(), obj_path.c_str(), window_size, [&](const ObjStreamBlock &block) {
+			spilled = position_file.Append(block.vertices, block.vertex_number * 3 * sizeof(float)) &&
+				normal_file.Append(block.normals, block.normal_number * 3 * sizeof(float)) &&
+				texcoord_file.Append(block.texcoords, block.texcoord_number * 2 * sizeof(float));
+			for (size_t t = 0; t < block.triangle_number && spilled; t++) {
+				const int material_id = block.material_ids[t];
+				if (material_id < 0 || static_cast<size_t>(material_id) >= materials.size()) {
+					skipped_face_num++;
+					continue;
+				}
+				for (int corner = 0; corner < 3 && spilled; corner++) {
+					spilled = corner_sorter.Push({static_cast<unsigned int>(material_id), block.corners[3 * t + corner], corner_number++});
+				}
+			}
+			return spilled;
+		}, options.thread_number);
+
+		LogObjReaderMessages(warn, err);
+		if (!spilled) {
+			OutputDebugString(L"Cannot write spill files next to the cooked mesh\n");
+		}
+		if (!ret || !position_file.Map() || !normal_file.Map() || !texcoord_file.Map() || !corner_sorter.Finish()) {
+			return false;
+		}
+
+		std::ifstream obj_stream(obj_file, std::ios::binary | std::ios::ate);
+		statistics.source_size = static_cast<size_t>(obj_stream.tellg());
+		statistics.parse_time = duration_cast<duration<double>>(high_resolution_clock::now() - parse_start).count();
+		run_number = corner_sorter.GetRunNumber();
+		std::wstring parse_message = L"OBJ streamed in " + std::to_wstring(statistics.parse_time * 1000.0) + L" ms (" +
+			std::to_wstring(statistics.source_size / statistics.parse_time / 1e9) + L" GB/s), " + std::to_wstring(corner_number) +
+			L" corners in " + std::to_wstring(run_number) + L" sorted runs\n";
+		OutputDebugString(parse_message.c_str());
+		if (skipped_face_num > 0) {
+			std::wstring skip_message = L"Faces without a material skipped: " + std::to_wstring(skipped_face_num) + L"\n";
+			OutputDebugString(skip_message.c_str());
+		}
+
+		// Second pass: the merged runs bring equal keys together, every new key of a material becomes
+		// its next vertex, converted from the mapped attributes
+		high_resolution_clock::time_point dedup_start = high_resolution_clock::now();
+		const ObjAttributes attributes = {position_file.GetArray<float>(), position_file.GetSize() / (3 * sizeof(float)),
+			normal_file.GetArray<float>(), normal_file.GetSize() / (3 * sizeof(float)),
+			texcoord_file.GetArray<float>(), texcoord_file.GetSize() / (2 * sizeof(float))};
+		const size_t material_number = materials.size();
+		material_vertex_offsets.assign(material_number + 1, 0);
+		std::vector<tinyobj::index_t> vertex_keys;
+		std::vector<FullVertex> vertex_block(streaming_block_size);
+		vertex_keys.reserve(streaming_block_size);
+		auto flush_vertices = [&]() {
+			ConvertVertices(vertex_block.data(), attributes, vertex_keys.data(), vertex_keys.size());
+			spilled = vertex_file.Append(vertex_block.data(), vertex_keys.size() * sizeof(FullVertex));
+			vertex_keys.clear();
+		};
+
+		StreamingCorner corner;
+		StreamingCorner previous = {};
+		bool first = true;
+		bool in_range = true;
+		while (spilled && in_range && corner_sorter.Pop(corner)) {
+			const tinyobj::index_t &key = corner.key;
+			if (first || corner.material_id != previous.material_id || key.vertex_index != previous.key.vertex_index ||
+				key.normal_index != previous.key.normal_index || key.texcoord_index != previous.key.texcoord_index) {
+				in_range = key.vertex_index >= 0 && static_cast<size_t>(key.vertex_index) < attributes.vertex_number &&
+					key.normal_index >= -1 && key.normal_index < static_cast<int64_t>(attributes.normal_number) &&
+					key.texcoord_index >= -1 && key.texcoord_index < static_cast<int64_t>(attributes.texcoord_number) &&
+					material_vertex_offsets[corner.material_id + 1] < std::numeric_limits<unsigned int>::max();
+				missing_normal_number += (key.normal_index < 0) ? 1 : 0;
+				material_vertex_offsets[corner.material_id + 1]++;
+				vertex_number++;
+				vertex_keys.push_back(key);
+				if (vertex_keys.size() == streaming_block_size) {
+					flush_vertices();
+				}
+				first = false;
+			}
+			const unsigned int vertex_id = static_cast<unsigned int>(material_vertex_offsets[corner.material_id + 1] - 1);
+			spilled = spilled && index_sorter.Push({corner.corner_id, corner.material_id, vertex_id});
+			previous = corner;
+		}
+		if (in_range && spilled) {
+			flush_vertices();
+		}
+		if (!in_range) {
+			OutputDebugString(L"Face index is out of range, or a material has more than 2^32 vertices\n");
+		}
+		if (!spilled) {
+			OutputDebugString(L"Cannot write spill files next to the cooked mesh\n");
+		}
+		if (!in_range || !spilled || !index_sorter.Finish()) {
+			return false;
+		}
+		for (size_t material_id = 0; material_id < material_number; material_id++) {
+			material_vertex_offsets[material_id + 1] += material_vertex_offsets[material_id];
+		}
+		statistics.dedup_time = duration_cast<duration<double>>(high_resolution_clock::now() - dedup_start).count();
+	}
+
+	// Third pass: indices come out material after material in triangle order
+	high_resolution_clock::time_point index_start = high_resolution_clock::now();
+	material_index_offsets.assign(materials.size() + 1, 0);
+	std::vector<unsigned int> index_block;
+	index_block.reserve(streaming_block_size);
+	bool spilled = true;
+	StreamingIndex index;
+	while (spilled && index_sorter.Pop(index)) {
+		material_index_offsets[index.material_id + 1]++;
+		index_block.push_back(index.vertex_id);
+		if (index_block.size() == streaming_block_size) {
+			spilled = index_file.AppendArray(index_block);
+			index_block.clear();
+		}
+	}
+	spilled = spilled && index_file.AppendArray(index_block);
+	if (!spilled || !vertex_file.Map() || !index_file.Map()) {
+		OutputDebugString(L"Cannot write spill files next to the cooked mesh\n");
+		return false;
+	}
+	for (size_t material_id = 0; material_id < materials.size(); material_id++) {
+		material_index_offsets[material_id + 1] += material_index_offsets[material_id];
+	}
+	statistics.assembly_time = duration_cast<duration<double>>(high_resolution_clock::now() - index_start).count();
+
+	std::wstring dedup_message = L"Materials deduplicated out of core in " + std::to_wstring((statistics.dedup_time + statistics.assembly_time) * 1000.0) +
+		L" ms: " + std::to_wstring(material_index_offsets.back()) + L" indices, " + std::to_wstring(vertex_number) + L" vertices\n";
+	OutputDebugString(dedup_message.c_str());
+	if (options.generate_normals && missing_normal_number > 0) {
+		std::wstring normal_message = L"Normals are not generated in streaming conversion, vertices without one: " +
+			std::to_wstring(missing_normal_number) + L"\n";
+		OutputDebugString(normal_message.c_str());
+	}
+	return true;
+}
+
+bool ModelLoader::SpillTangents(const FullVertex *mesh_vertices, const unsigned int *mesh_indices, const std::vector<uint64_t> &material_vertex_offsets,
+	const std::vector<uint64_t> &material_index_offsets, const std::string &spill_path, SpillFile &tangent_file) {
+	high_resolution_clock::time_point tangent_start = high_resolution_clock::now();
+	if (!tangent_file.Create(spill_path + ".mesh_tangents.tmp")) {
+		OutputDebugString(L"Cannot create spill files next to the cooked mesh\n");
+		return false;
+	}
+
+	// Every window of vertices takes one pass over the triangles of its material
+	const size_t window_vertex_number = static_cast<size_t>(std::max<uint64_t>(options.streaming_memory_budget / streaming_tangent_window_divisor /
+		(sizeof(TangentSums) + sizeof(XMFLOAT4) + sizeof(PackedTangent)), 1));
+	std::vector<TangentSums> sums;
+	std::vector<XMFLOAT4> window_tangents;
+	std::vector<PackedTangent> packed_tangents;
+	size_t window_number = 0;
+	bool appended = true;
+	for (size_t material_id = 0; material_id < materials.size() && appended; material_id++) {
+		const FullVertex *material_vertices = mesh_vertices + material_vertex_offsets[material_id];
+		const unsigned int *material_indices = mesh_indices + material_index_offsets[material_id];
+		const size_t material_vertex_number = static_cast<size_t>(material_vertex_offsets[material_id + 1] - material_vertex_offsets[material_id]);
+		const size_t material_index_number = static_cast<size_t>(material_index_offsets[material_id + 1] - material_index_offsets[material_id]);
+		for (size_t first_vertex = 0; first_vertex < material_vertex_number && appended; first_vertex += window_vertex_number) {
+			const size_t vertex_number = std::min(window_vertex_number, material_vertex_number - first_vertex);
+			sums.assign(vertex_number, TangentSums{});
+			window_tangents.resize(vertex_number);
+			packed_tangents.resize(vertex_number);
+			AccumulateTangents(sums.data(), first_vertex, vertex_number, material_vertices, material_indices, material_index_number);
+			ResolveTangents(window_tangents.data(), sums.data(), material_vertices + first_vertex, vertex_number);
+			for (size_t v = 0; v < vertex_number; v++) {
+				packed_tangents[v] = PackTangent(window_tangents[v]);
+			}
+			appended = tangent_file.AppendArray(packed_tangents);
+			window_number++;
+		}
+	}
+	if (!appended || !tangent_file.Map()) {
+		OutputDebugString(L"Cannot write spill files next to the cooked mesh\n");
+		return false;
+	}
+
+	duration<double> tangent_time = duration_cast<duration<double>>(high_resolution_clock::now() - tangent_start);
+	std::wstring tangent_message = L"Tangents generated out of core in " + std::to_wstring(tangent_time.count() * 1000.0) + L" ms, " +
+		std::to_wstring(window_number) + L" vertex windows\n";
+	OutputDebugString(tangent_message.c_str());
+	return true;
+}
+
+bool ModelLoader::CookSpilledMesh(const FullVertex *mesh_vertices, const unsigned int *mesh_indices, const std::vector<uint64_t> &material_vertex_offsets,
+	const std::vector<uint64_t> &material_index_offsets, const std::string &spill_path, StreamingStreams &streams) {
+	const size_t material_number = materials.size();
+	DrawBounds mesh_bounds = {};
+	VertexQuantization mesh_quantization = {};
+	ComputeMeshExtent(mesh_vertices, static_cast<size_t>(material_vertex_offsets[material_number]), options, mesh_bounds, mesh_quantization);
+
+	SpillFile *stream_files[] = {&streams.vertices, &streams.indices, &streams.short_indices, &streams.tangents, &streams.positions,
+		&streams.position_indices, &streams.meshlets, &streams.meshlet_bounds, &streams.meshlet_vertices, &streams.meshlet_triangles};
+	const char *stream_names[] = {"vertices", "long_indices", "short_indices", "tangents", "position_stream", "position_indices",
+		"meshlets", "meshlet_bounds", "meshlet_vertices", "meshlet_triangles"};
+	for (size_t stream = 0; stream < std::size(stream_files); stream++) {
+		if (!stream_files[stream]->Create(spill_path + "." + stream_names[stream] + ".tmp")) {
+			OutputDebugString(L"Cannot create spill files next to the cooked mesh\n");
+			return false;
+		}
+	}
+
+	// Slabs cut materials, so tangents are summed over every whole material first and copied with the vertices
+	SpillFile tangent_file;
+	if (options.generate_tangents && !SpillTangents(mesh_vertices, mesh_indices, material_vertex_offsets, material_index_offsets,
+		spill_path, tangent_file)) {
+		return false;
+	}
+	const PackedTangent *mesh_tangents = tangent_file.GetArray<PackedTangent>();
+
+	// Every index of a batch, its levels of detail included, has to stay within 32 bits
+	const uint64_t batch_index_limit = std::numeric_limits<unsigned int>::max() / (options.lod_level_number + 1ull);
+	const size_t batch_index_number = static_cast<size_t>(std::max<uint64_t>(std::min(options.streaming_memory_budget / streaming_batch_triangle_size,
+		batch_index_limit / 3), 1) * 3);
+
+	// Tables of the whole mesh. Draw calls address their buffer relatively, so appending a batch only
+	// moves its buffers, its offsets into the tables and its meshlets.
+	std::vector<DrawCallParams> mesh_draw_call_params;
+	std::vector<MeshBuffer> mesh_mesh_buffers;
+	std::vector<DrawBounds> mesh_draw_bounds;
+	std::vector<DrawLod> mesh_draw_lods;
+	std::vector<unsigned int> mesh_draw_lod_offsets(1, 0);
+	std::vector<uint64_t> mesh_position_index_offsets(options.position_stream ? 1 : 0, 0);
+	std::vector<unsigned int> mesh_meshlet_offsets(options.build_meshlets ? 1 : 0, 0);
+	MeshBuffer stream_ends = {};
+	size_t batch_number = 0;
+	uint64_t meshlet_vertex_end = 0;
+	uint64_t meshlet_triangle_end = 0;
+	bool appended = true;
+
+	size_t material_id = 0;
+	uint64_t material_index = 0;
+	while (material_id < material_number && appended) {
+		// Materials are cut into slabs in triangle order, every slab becomes a draw call with the vertices it uses
+		vertices.clear();
+		tangents.clear();
+		indices.clear();
+		draw_call_params.clear();
+		while (material_id < material_number && indices.size() < batch_index_number) {
+			const uint64_t material_index_number = material_index_offsets[material_id + 1] - material_index_offsets[material_id];
+			const size_t slab_index_number = static_cast<size_t>(std::min<uint64_t>(material_index_number - material_index, batch_index_number - indices.size()));
+			const unsigned int *slab_indices = mesh_indices + material_index_offsets[material_id] + material_index;
+			const FullVertex *material_vertices = mesh_vertices + material_vertex_offsets[material_id];
+			const PackedTangent *material_tangents = mesh_tangents ? mesh_tangents + material_vertex_offsets[material_id] : nullptr;
+
+			// Sorting the slab by vertex keeps the material order of the vertices and reads them front to back
+			std::vector<uint64_t> slab_order(slab_index_number);
+			for (size_t i = 0; i < slab_index_number; i++) {
+				slab_order[i] = (static_cast<uint64_t>(slab_indices[i]) << 32) | i;
+			}
+			std::sort(slab_order.begin(), slab_order.end());
+
+			DrawCallParams params = {};
+			params.index_num = static_cast<unsigned int>(slab_index_number);
+			params.start_index = static_cast<unsigned int>(indices.size());
+			params.start_vertex = static_cast<unsigned int>(vertices.size());
+			params.material_id = static_cast<unsigned int>(material_id);
+			params.index_size = sizeof(unsigned int);
+			indices.resize(indices.size() + slab_index_number);
+			unsigned int *draw_indices = indices.data() + params.start_index;
+			for (size_t i = 0; i < slab_index_number; i++) {
+				const uint64_t vertex = slab_order[i] >> 32;
+				if (i == 0 || vertex != (slab_order[i - 1] >> 32)) {
+					vertices.push_back(material_vertices[vertex]);
+					if (material_tangents) {
+						tangents.push_back(material_tangents[vertex]);
+					}
+					params.vertex_num++;
+				}
+				draw_indices[slab_order[i] & 0xFFFFFFFFull] = params.vertex_num - 1;
+			}
+			// Materials without faces keep their empty draw call, like in memory
+			if (slab_index_number > 0 || material_index_number == 0) {
+				draw_call_params.push_back(params);
+			}
+
+			material_index += slab_index_number;
+			if (material_index == material_index_number) {
+				material_id++;
+				material_index = 0;
+			}
+		}
+
+		ProcessMesh(mesh_bounds, mesh_quantization);
+		batch_number++;
+
+		const unsigned int buffer_base = static_cast<unsigned int>(mesh_mesh_buffers.size());
+		const unsigned int draw_call_base = static_cast<unsigned int>(mesh_draw_call_params.size());
+		for (DrawCallParams params : draw_call_params) {
+			params.buffer_id += buffer_base;
+			mesh_draw_call_params.push_back(params);
+		}
+		for (MeshBuffer buffer : mesh_buffers) {
+			buffer.start_vertex += stream_ends.start_vertex;
+			buffer.start_index += stream_ends.start_index;
+			buffer.start_short_index += stream_ends.start_short_index;
+			buffer.start_position += stream_ends.start_position;
+			buffer.start_position_index += stream_ends.start_position_index;
+			buffer.start_draw_call += draw_call_base;
+			mesh_mesh_buffers.push_back(buffer);
+		}
+		mesh_draw_bounds.insert(mesh_draw_bounds.end(), draw_bounds.begin(), draw_bounds.end());
+		const unsigned int lod_base = static_cast<unsigned int>(mesh_draw_lods.size());
+		mesh_draw_lods.insert(mesh_draw_lods.end(), draw_lods.begin(), draw_lods.end());
+		for (size_t draw_call_id = 1; draw_call_id < draw_lod_offsets.size(); draw_call_id++) {
+			mesh_draw_lod_offsets.push_back(lod_base + draw_lod_offsets[draw_call_id]);
+		}
+		if (options.position_stream) {
+			const uint64_t position_index_base = mesh_position_index_offsets.back();
+			for (size_t draw_call_id = 1; draw_call_id < position_index_offsets.size(); draw_call_id++) {
+				mesh_position_index_offsets.push_back(position_index_base + position_index_offsets[draw_call_id]);
+			}
+		}
+
+		// Meshlet vertices index the whole vertex stream
+		if (options.build_meshlets) {
+			if (stream_ends.start_vertex + vertices.size() > std::numeric_limits<unsigned int>::max()) {
+				OutputDebugString(L"Meshlets of meshes with more than 2^32 vertices cannot be built\n");
+				return false;
+			}
+			const unsigned int meshlet_base = mesh_meshlet_offsets.back();
+			for (size_t draw_call_id = 1; draw_call_id < meshlet_offsets.size(); draw_call_id++) {
+				mesh_meshlet_offsets.push_back(meshlet_base + meshlet_offsets[draw_call_id]);
+			}
+			for (Meshlet &meshlet : meshlets) {
+				meshlet.vertex_offset += static_cast<unsigned int>(meshlet_vertex_end);
+				meshlet.triangle_offset += static_cast<unsigned int>(meshlet_triangle_end);
+			}
+			for (unsigned int &vertex : meshlet_vertices) {
+				vertex += static_cast<unsigned int>(stream_ends.start_vertex);
+			}
+			meshlet_vertex_end += meshlet_vertices.size();
+			meshlet_triangle_end += meshlet_triangles.size() / 3;
+		}
+
+		appended = (options.pack_vertices ? streams.vertices.AppendArray(packed_vertices) : streams.vertices.AppendArray(vertices)) &&
+			streams.indices.AppendArray(indices) && streams.short_indices.AppendArray(short_indices) &&
+			streams.tangents.AppendArray(tangents) && streams.positions.AppendArray(positions) &&
+			streams.position_indices.AppendArray(position_indices) && streams.meshlets.AppendArray(meshlets) &&
+			streams.meshlet_bounds.AppendArray(meshlet_bounds) && streams.meshlet_vertices.AppendArray(meshlet_vertices) &&
+			streams.meshlet_triangles.AppendArray(meshlet_triangles);
+		stream_ends.start_vertex += vertices.size();
+		stream_ends.start_index += indices.size();
+		stream_ends.start_short_index += short_indices.size();
+		stream_ends.start_position += positions.size() / position_stride;
+		stream_ends.start_position_index += position_indices.size();
+	}
+
+	// The batch vectors are released before the cooked mesh is written from the spill files
+	std::vector<FullVertex>().swap(vertices);
+	std::vector<PackedVertex>().swap(packed_vertices);
+	std::vector<unsigned int>().swap(indices);
+	std::vector<uint16_t>().swap(short_indices);
+	std::vector<PackedTangent>().swap(tangents);
+	std::vector<char>().swap(positions);
+	std::vector<unsigned int>().swap(position_indices);
+	std::vector<Meshlet>().swap(meshlets);
+	std::vector<MeshletBounds>().swap(meshlet_bounds);
+	std::vector<unsigned int>().swap(meshlet_vertices);
+	std::vector<uint8_t>().swap(meshlet_triangles);
+	bool mapped = appended;
+	for (SpillFile *stream_file : stream_files) {
+		mapped = mapped && stream_file->Map();
+	}
+	if (!mapped) {
+		OutputDebugString(L"Cannot write spill files next to the cooked mesh\n");
+		return false;
+	}
+
+	// A mesh without materials still gets its one buffer
+	if (mesh_mesh_buffers.empty()) {
+		mesh_mesh_buffers.push_back(MeshBuffer());
+	}
+	draw_call_params.swap(mesh_draw_call_params);
+	mesh_buffers.swap(mesh_mesh_buffers);
+	draw_bounds.swap(mesh_draw_bounds);
+	draw_lods.swap(mesh_draw_lods);
+	draw_lod_offsets.swap(mesh_draw_lod_offsets);
+	position_index_offsets.swap(mesh_position_index_offsets);
+	meshlet_offsets.swap(mesh_meshlet_offsets);
+
+	vertex_quantization = mesh_quantization;
+	vertex_stride = options.pack_vertices ? sizeof(PackedVertex) : sizeof(FullVertex);
+	position_stride = options.pack_vertices ? sizeof(PackedVertex::position) : sizeof(XMFLOAT3);
+	vertex_data = streams.vertices.GetArray<char>();
+	vertex_number = static_cast<size_t>(stream_ends.start_vertex);
+	index_data = streams.indices.GetArray<unsigned int>();
+	index_number = static_cast<size_t>(stream_ends.start_index);
+	short_index_data = streams.short_indices.GetArray<uint16_t>();
+	short_index_number = static_cast<size_t>(stream_ends.start_short_index);
+	tangent_data = streams.tangents.GetArray<PackedTangent>();
+	tangent_number = static_cast<size_t>(streams.tangents.GetSize() / sizeof(PackedTangent));
+	position_data = streams.positions.GetArray<char>();
+	position_number = static_cast<size_t>(stream_ends.start_position);
+	position_index_data = streams.position_indices.GetArray<unsigned int>();
+	position_index_number = static_cast<size_t>(stream_ends.start_position_index);
+	position_index_offset_data = position_index_offsets.data();
+	position_index_offset_number = position_index_offsets.size();
+	meshlet_data = streams.meshlets.GetArray<Meshlet>();
+	meshlet_bounds_data = streams.meshlet_bounds.GetArray<MeshletBounds>();
+	meshlet_number = static_cast<size_t>(streams.meshlets.GetSize() / sizeof(Meshlet));
+	meshlet_vertex_data = streams.meshlet_vertices.GetArray<unsigned int>();
+	meshlet_vertex_number = static_cast<size_t>(meshlet_vertex_end);
+	meshlet_triangle_data = streams.meshlet_triangles.GetArray<uint8_t>();
+	meshlet_triangle_number = static_cast<size_t>(meshlet_triangle_end);
+	meshlet_offset_data = meshlet_offsets.data();
+	meshlet_offset_number = meshlet_offsets.size();
+
+	std::wstring batch_message = L"Streaming conversion processed " + std::to_wstring(batch_number) + L" batches of up to " +
+		std::to_wstring(batch_index_number / 3) + L" triangles into " + std::to_wstring(draw_call_params.size()) + L" draw calls and " +
+		std::to_wstring(mesh_buffers.size()) + L" buffers\n";
+	OutputDebugString(batch_message.c_str());
+	return true;
+}
+
+static double GetMeshAcmr(const std::vector<VertexCacheStatistics> &per_draw_statistics) {
+	size_t vertices_transformed = 0;
+	size_t triangle_number = 0;
+	for (const VertexCacheStatistics &statistics : per_draw_statistics) {
+		vertices_transformed += statistics.vertices_transformed;
+		triangle_number += statistics.triangle_number;
+	}
+	return triangle_number ? static_cast<double>(vertices_transformed) / triangle_number : 0.0;
+}
+
+static std::wstring FormatVertexCacheStatistics(const std::vector<VertexCacheStatistics> &per_draw_statistics) {
+	size_t vertices_transformed = 0;
+	size_t vertex_number = 0;
+	for (const VertexCacheStatistics &statistics : per_draw_statistics) {
+		vertices_transformed += statistics.vertices_transformed;
+		vertex_number += statistics.vertex_number;
+	}
+
+	double atvr = vertex_number ? static_cast<double>(vertices_transformed) / vertex_number : 0.0;
+	return L"ACMR " + std::to_wstring(GetMeshAcmr(per_draw_statistics)) + L", ATVR " + std::to_wstring(atvr);
+}
+
+static std::wstring FormatVertexFetchStatistics(const std::vector<VertexFetchStatistics> &per_draw_statistics) {
+	size_t bytes_fetched = 0;
+	size_t bytes_referenced = 0;
+	for (const VertexFetchStatistics &statistics : per_draw_statistics) {
+		bytes_fetched += statistics.bytes_fetched;
+		bytes_referenced += statistics.bytes_referenced;
+	}
+
+	double overfetch = bytes_referenced ? static_cast<double>(bytes_fetched) / bytes_referenced : 0.0;
+	return L"overfetch " + std::to_wstring(overfetch) + L", " + std::to_wstring(bytes_fetched / 1024) + L" KB fetched";
+}
+
+void ModelLoader::OptimizeMesh() {
+	high_resolution_clock::time_point optimization_start = high_resolution_clock::now();
+	const size_t draw_call_number = draw_call_params.size();
+	std::vector<VertexCacheStatistics> statistics_before(draw_call_number);
+	std::vector<VertexCacheStatistics> statistics_after(draw_call_number);
+	std::vector<VertexFetchStatistics> fetch_before(draw_call_number);
+	std::vector<VertexFetchStatistics> fetch_after(draw_call_number);
+
+	const bool measure_overdraw = options.optimize_overdraw || options.analyze_overdraw;
+	OverdrawStatistics overdraw_before = {};
+	if (measure_overdraw) {
+		overdraw_before = AnalyzeMeshOverdraw();
+	}
+
+	// Draw calls own disjoint index ranges, so they are optimized independently
+	ParallelFor(draw_call_number, [&](size_t draw_call_id) {
+		const DrawCallParams &params = draw_call_params[draw_call_id];
+		if (params.index_num == 0) {
+			return;
+		}
+
+		unsigned int *draw_indices = indices.data() + params.start_index;
+		const float *draw_positions = &vertices[params.start_vertex].position.x;
+		statistics_before[draw_call_id] = AnalyzeVertexCache(draw_indices, params.index_num, params.vertex_num);
+
+		std::vector<unsigned int> optimized_indices(params.index_num);
+		OptimizeVertexCache(optimized_indices.data(), draw_indices, params.index_num, params.vertex_num);
+		if (options.optimize_overdraw) {
+			OptimizeOverdraw(draw_indices, optimized_indices.data(), params.index_num,
+				draw_positions, sizeof(FullVertex), params.vertex_num, options.overdraw_threshold);
+		} else {
+			std::copy(optimized_indices.begin(), optimized_indices.end(), draw_indices);
+		}
+
+		statistics_after[draw_call_id] = AnalyzeVertexCache(draw_indices, params.index_num, params.vertex_num);
+
+		// Vertices follow the final triangle order; every draw call owns its vertex slice as well
+		FullVertex *draw_vertices = vertices.data() + params.start_vertex;
+		fetch_before[draw_call_id] = AnalyzeVertexFetch(draw_indices, params.index_num, params.vertex_num, sizeof(FullVertex));
+
+		std::vector<FullVertex> source_vertices(draw_vertices, draw_vertices + params.vertex_num);
+		std::vector<unsigned int> source_indices;
+		if (!tangents.empty()) {
+			source_indices.assign(draw_indices, draw_indices + params.index_num);
+		}
+		OptimizeVertexFetch(draw_vertices, draw_indices, params.index_num, source_vertices.data(), params.vertex_num, sizeof(FullVertex));
+
+		// The same indices give the tangents the same order
+		if (!tangents.empty()) {
+			PackedTangent *draw_tangents = tangents.data() + params.start_vertex;
+			std::vector<PackedTangent> source_tangents(draw_tangents, draw_tangents + params.vertex_num);
+			OptimizeVertexFetch(draw_tangents, source_indices.data(), params.index_num, source_tangents.data(), params.vertex_num, sizeof(PackedTangent));
+		}
+
+		fetch_after[draw_call_id] = AnalyzeVertexFetch(draw_indices, params.index_num, params.vertex_num, sizeof(FullVertex));
+	}, options.thread_number);
+
+	duration<double> optimization_time = duration_cast<duration<double>>(high_resolution_clock::now() - optimization_start);
+	std::wstring optimization_message = L"Mesh optimized in " + std::to_wstring(optimization_time.count() * 1000.0) + L" ms: " +
+		FormatVertexCacheStatistics(statistics_before) + L" -> " + FormatVertexCacheStatistics(statistics_after) + L"\n";
+	OutputDebugString(optimization_message.c_str());
+
+	std::wstring fetch_message = L"Vertex fetch: " + FormatVertexFetchStatistics(fetch_before) + L" -> " +
+		FormatVertexFetchStatistics(fetch_after) + L"\n";
+	OutputDebugString(fetch_message.c_str());
+
+	statistics.acmr_before = GetMeshAcmr(statistics_before);
+	statistics.acmr_after = GetMeshAcmr(statistics_after);
+	if (measure_overdraw) {
+		OverdrawStatistics overdraw_after = AnalyzeMeshOverdraw();
+		statistics.overdraw_before = overdraw_before.overdraw;
+		statistics.overdraw_after = overdraw_after.overdraw;
+		std::wstring overdraw_message = L"Overdraw " + std::to_wstring(overdraw_before.overdraw) + L" -> " +
+			std::to_wstring(overdraw_after.overdraw) + L"\n";
+		OutputDebugString(overdraw_message.c_str());
+	}
+}
+
+void ModelLoader::CleanMesh() {
+	high_resolution_clock::time_point cleanup_start = high_resolution_clock::now();
+
+	// Every draw call is still a whole material and is cleaned in place inside its own ranges
+	const size_t draw_call_number = draw_call_params.size();
+	std::vector<TriangleCleanupStatistics> triangle_statistics(draw_call_number);
+	std::vector<DrawCallParams> cleaned_params(draw_call_params);
+	// Tangents of streaming batches stay with their vertices, leaders keep their own
+	const bool carry_tangents = !tangents.empty();
+	ParallelFor(draw_call_number, [&](size_t draw_call_id) {
+		DrawCallParams &params = cleaned_params[draw_call_id];
+		FullVertex *draw_vertices = vertices.data() + params.start_vertex;
+		unsigned int *draw_indices = indices.data() + params.start_index;
+
+		if (options.weld_tolerance > 0.0f) {
+			// Normal and texcoord follow the position
+			const size_t attribute_number = (sizeof(FullVertex) - sizeof(XMFLOAT3)) / sizeof(float);
+			std::vector<unsigned int> remap(params.vertex_num);
+			const size_t welded_vertex_num = GenerateWeldRemap(remap.data(), &draw_vertices->position.x, sizeof(FullVertex),
+				params.vertex_num, attribute_number, options.weld_tolerance, options.weld_attribute_tolerance);
+
+			// Leaders are numbered in order and never after themselves, so they move to the front in place
+			unsigned int next_leader = 0;
+			for (unsigned int v = 0; v < params.vertex_num; v++) {
+				if (remap[v] == next_leader) {
+					if (carry_tangents) {
+						tangents[params.start_vertex + next_leader] = tangents[params.start_vertex + v];
+					}
+					draw_vertices[next_leader++] = draw_vertices[v];
+				}
+			}
+			for (unsigned int i = 0; i < params.index_num; i++) {
+				draw_indices[i] = remap[draw_indices[i]];
+			}
+			params.vertex_num = static_cast<unsigned int>(welded_vertex_num);
+		}
+
+		if (options.remove_degenerate_triangles) {
+			params.index_num = static_cast<unsigned int>(RemoveDegenerateTriangles(draw_indices, draw_indices, params.index_num,
+				&draw_vertices->position.x, sizeof(FullVertex), &triangle_statistics[draw_call_id]));
+		}
+	}, options.thread_number);
+
+	// Close the gaps between the shrunk ranges, which only move towards the front
+	unsigned int vertex_cursor = 0;
+	unsigned int index_cursor = 0;
+	for (size_t draw_call_id = 0; draw_call_id < draw_call_number; draw_call_id++) {
+		DrawCallParams &params = cleaned_params[draw_call_id];
+		if (params.start_vertex != vertex_cursor) {
+			std::copy(vertices.begin() + params.start_vertex, vertices.begin() + params.start_vertex + params.vertex_num, vertices.begin() + vertex_cursor);
+			if (carry_tangents) {
+				std::copy(tangents.begin() + params.start_vertex, tangents.begin() + params.start_vertex + params.vertex_num, tangents.begin() + vertex_cursor);
+			}
+		}
+		if (params.start_index != index_cursor) {
+			std::copy(indices.begin() + params.start_index, indices.begin() + params.start_index + params.index_num, indices.begin() + index_cursor);
+		}
+		params.start_vertex = vertex_cursor;
+		params.start_index = index_cursor;
+		vertex_cursor += params.vertex_num;
+		index_cursor += params.index_num;
+	}
+	vertices.resize(vertex_cursor);
+	indices.resize(index_cursor);
+	if (carry_tangents) {
+		tangents.resize(vertex_cursor);
+	}
+
+	for (size_t draw_call_id = 0; draw_call_id < draw_call_number; draw_call_id++) {
+		const DrawCallParams &before = draw_call_params[draw_call_id];
+		const DrawCallParams &after = cleaned_params[draw_call_id];
+		const TriangleCleanupStatistics &triangles = triangle_statistics[draw_call_id];
+		const unsigned int welded_vertex_num = before.vertex_num - after.vertex_num;
+		statistics.welded_vertex_number += welded_vertex_num;
+		statistics.removed_triangle_number += (before.index_num - after.index_num) / 3;
+		if (welded_vertex_num == 0 && before.index_num == after.index_num) {
+			continue;
+		}
+
+		const std::string &name = materials[before.material_id].name;
+		std::wstring material_message = L"Material " + std::wstring(name.begin(), name.end()) + L": " +
+			std::to_wstring(welded_vertex_num) + L" vertices welded, " + std::to_wstring(triangles.degenerate_number) +
+			L" degenerate and " + std::to_wstring(triangles.duplicate_number) + L" duplicate triangles removed\n";
+		OutputDebugString(material_message.c_str());
+	}
+	draw_call_params.swap(cleaned_params);
+
+	duration<double> cleanup_time = duration_cast<duration<double>>(high_resolution_clock::now() - cleanup_start);
+	std::wstring cleanup_message = L"Mesh cleaned in " + std::to_wstring(cleanup_time.count() * 1000.0) + L" ms: " +
+		std::to_wstring(statistics.welded_vertex_number) + L" vertices welded, " +
+		std::to_wstring(statistics.removed_triangle_number) + L" triangles removed\n";
+	OutputDebugString(cleanup_message.c_str());
+}
+
+void ModelLoader::ChunkDrawCalls(const DrawBounds &mesh_bounds) {
+	high_resolution_clock::time_point chunking_start = high_resolution_clock::now();
+
+	float max_extent = 0.0f;
+	if (options.chunk_extent_ratio > 0.0f) {
+		const XMFLOAT3 &extent = mesh_bounds.extent;
+		max_extent = 2.0f * std::sqrt(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z) * options.chunk_extent_ratio;
+	}
+
+	// Cluster every material on its own, the triangle order inside a cluster is fixed by OptimizeMesh later
+	const size_t draw_call_number = draw_call_params.size();
+	std::vector<std::vector<unsigned int>> clustered_indices(draw_call_number);
+	std::vector<std::vector<size_t>> cluster_offsets(draw_call_number);
+	ParallelFor(draw_call_number, [&](size_t draw_call_id) {
+		const DrawCallParams &params = draw_call_params[draw_call_id];
+		const float *draw_positions = reinterpret_cast<const float *>(vertices.data() + params.start_vertex);
+		clustered_indices[draw_call_id].resize(params.index_num);
+		cluster_offsets[draw_call_id] = ClusterTriangles(clustered_indices[draw_call_id].data(), indices.data() + params.start_index,
+			params.index_num, draw_positions, sizeof(FullVertex), options.chunk_triangle_number, max_extent);
+	}, options.thread_number);
+
+	// Every chunk becomes a draw call with its own vertex slice; vertices shared between chunks are duplicated
+	std::vector<FullVertex> chunk_vertices;
+	std::vector<PackedTangent> chunk_tangents;
+	std::vector<unsigned int> chunk_indices;
+	std::vector<DrawCallParams> chunk_draw_call_params;
+	const bool carry_tangents = !tangents.empty();
+	chunk_vertices.reserve(vertices.size());
+	chunk_tangents.reserve(carry_tangents ? vertices.size() : 0);
+	chunk_indices.reserve(indices.size());
+	std::vector<unsigned int> remap;
+	std::vector<unsigned int> remap_stamps;
+
+	for (size_t draw_call_id = 0; draw_call_id < draw_call_number; draw_call_id++) {
+		const DrawCallParams &params = draw_call_params[draw_call_id];
+		const FullVertex *draw_vertices = vertices.data() + params.start_vertex;
+		const std::vector<unsigned int> &draw_indices = clustered_indices[draw_call_id];
+		const std::vector<size_t> &offsets = cluster_offsets[draw_call_id];
+		remap.assign(params.vertex_num, 0);
+		remap_stamps.assign(params.vertex_num, 0);
+
+		for (size_t cluster = 0; cluster + 1 < offsets.size(); cluster++) {
+			const unsigned int stamp = static_cast<unsigned int>(cluster + 1);
+			DrawCallParams chunk_params = params;
+			chunk_params.start_index = static_cast<unsigned int>(chunk_indices.size());
+			chunk_params.start_vertex = static_cast<unsigned int>(chunk_vertices.size());
+			chunk_params.index_num = static_cast<unsigned int>(3 * (offsets[cluster + 1] - offsets[cluster]));
+			chunk_params.vertex_num = 0;
+
+			for (size_t i = 3 * offsets[cluster]; i < 3 * offsets[cluster + 1]; i++) {
+				const unsigned int vertex = draw_indices[i];
+				if (remap_stamps[vertex] != stamp) {
+					remap_stamps[vertex] = stamp;
+					remap[vertex] = chunk_params.vertex_num++;
+					chunk_vertices.push_back(draw_vertices[vertex]);
+					if (carry_tangents) {
+						chunk_tangents.push_back(tangents[params.start_vertex + vertex]);
+					}
+				}
+				chunk_indices.push_back(remap[vertex]);
+			}
+			chunk_draw_call_params.push_back(chunk_params);
+		}
+	}
+
+	duration<double> chunking_time = duration_cast<duration<double>>(high_resolution_clock::now() - chunking_start);
+	std::wstring chunking_message = L"Materials chunked in " + std::to_wstring(chunking_time.count() * 1000.0) + L" ms: " +
+		std::to_wstring(draw_call_params.size()) + L" -> " + std::to_wstring(chunk_draw_call_params.size()) + L" draw calls, vertices " +
+		std::to_wstring(vertices.size()) + L" -> " + std::to_wstring(chunk_vertices.size()) + L"\n";
+	OutputDebugString(chunking_message.c_str());
+
+	vertices.swap(chunk_vertices);
+	tangents.swap(chunk_tangents);
+	indices.swap(chunk_indices);
+	draw_call_params.swap(chunk_draw_call_params);
+}
+
+void ModelLoader::SplitDrawCalls(size_t max_vertex_number, size_t max_index_number) {
+	size_t large_draw_call_number = 0;
+	for (const DrawCallParams &params : draw_call_params) {
+		large_draw_call_number += (params.vertex_num > max_vertex_number || params.index_num > max_index_number) ? 1 : 0;
+	}
+	if (large_draw_call_number == 0) {
+		return;
+	}
+
+	std::vector<FullVertex> split_vertices;
+	std::vector<PackedTangent> split_tangents;
+	std::vector<unsigned int> split_indices;
+	std::vector<DrawCallParams> split_draw_call_params;
+	const bool carry_tangents = !tangents.empty();
+	split_vertices.reserve(vertices.size());
+	split_tangents.reserve(carry_tangents ? vertices.size() : 0);
+	split_indices.reserve(indices.size());
+
+	// Vertex number inside the current sub draw, valid while its stamp matches
+	std::vector<unsigned int> remap;
+	std::vector<unsigned int> remap_stamps;
+
+	for (const DrawCallParams &params : draw_call_params) {
+		const unsigned int *draw_indices = indices.data() + params.start_index;
+		const FullVertex *draw_vertices = vertices.data() + params.start_vertex;
+
+		DrawCallParams sub_params = params;
+		sub_params.start_index = static_cast<unsigned int>(split_indices.size());
+		sub_params.start_vertex = static_cast<unsigned int>(split_vertices.size());
+		if (params.vertex_num <= max_vertex_number && params.index_num <= max_index_number) {
+			split_indices.insert(split_indices.end(), draw_indices, draw_indices + params.index_num);
+			split_vertices.insert(split_vertices.end(), draw_vertices, draw_vertices + params.vertex_num);
+			if (carry_tangents) {
+				split_tangents.insert(split_tangents.end(), tangents.begin() + params.start_vertex, tangents.begin() + params.start_vertex + params.vertex_num);
+			}
+			split_draw_call_params.push_back(sub_params);
+			continue;
+		}
+
+		// Triangles keep their optimized order and vertices are copied on first use,
+		// so every sub draw stays cache and fetch friendly. Shared vertices are duplicated.
+		remap.assign(params.vertex_num, 0);
+		remap_stamps.assign(params.vertex_num, 0);
+		unsigned int stamp = 1;
+		sub_params.index_num = 0;
+		sub_params.vertex_num = 0;
+		for (unsigned int i = 0; i + 2 < params.index_num; i += 3) {
+			unsigned int new_vertex_number = 0;
+			for (int corner = 0; corner < 3; corner++) {
+				new_vertex_number += (remap_stamps[draw_indices[i + corner]] != stamp) ? 1 : 0;
+			}
+
+			if (sub_params.vertex_num + new_vertex_number > max_vertex_number || sub_params.index_num + 3 > max_index_number) {
+				split_draw_call_params.push_back(sub_params);
+				sub_params.start_index = static_cast<unsigned int>(split_indices.size());
+				sub_params.start_vertex = static_cast<unsigned int>(split_vertices.size());
+				sub_params.index_num = 0;
+				sub_params.vertex_num = 0;
+				stamp++;
+			}
+
+			for (int corner = 0; corner < 3; corner++) {
+				const unsigned int vertex = draw_indices[i + corner];
+				if (remap_stamps[vertex] != stamp) {
+					remap_stamps[vertex] = stamp;
+					remap[vertex] = sub_params.vertex_num++;
+					split_vertices.push_back(draw_vertices[vertex]);
+					if (carry_tangents) {
+						split_tangents.push_back(tangents[params.start_vertex + vertex]);
+					}
+				}
+				split_indices.push_back(remap[vertex]);
+			}
+			sub_params.index_num += 3;
+		}
+
+		if (sub_params.index_num > 0) {
+			split_draw_call_params.push_back(sub_params);
+		}
+	}
+
+	std::wstring split_message = L"Large draw calls split: " + std::to_wstring(draw_call_params.size()) + L" -> " +
+		std::to_wstring(split_draw_call_params.size()) + L", vertices " + std::to_wstring(vertices.size()) + L" -> " +
+		std::to_wstring(split_vertices.size()) + L"\n";
+	OutputDebugString(split_message.c_str());
+
+	vertices.swap(split_vertices);
+	tangents.swap(split_tangents);
+	indices.swap(split_indices);
+	draw_call_params.swap(split_draw_call_params);
+}
+
+void ModelLoader::BuildShortIndices() {
+	// Draw calls which fit move to the 16-bit buffer, the rest is compacted in the 32-bit one
+	std::vector<unsigned int> long_indices;
+	short_indices.clear();
+	short_indices.reserve(indices.size());
+
+	for (size_t draw_call_id = 0; draw_call_id < draw_call_params.size(); draw_call_id++) {
+		DrawCallParams &params = draw_call_params[draw_call_id];
+		const bool fits = options.short_indices && params.vertex_num <= max_short_index_vertex_number;
+		params.index_size = fits ? sizeof(uint16_t) : sizeof(unsigned int);
+
+		// Every level of detail follows its draw call into the same buffer
+		for (unsigned int lod_id = draw_lod_offsets[draw_call_id]; lod_id < draw_lod_offsets[draw_call_id + 1]; lod_id++) {
+			DrawLod &lod = draw_lods[lod_id];
+			const unsigned int *lod_indices = indices.data() + lod.start_index;
+			if (fits) {
+				lod.start_index = static_cast<unsigned int>(short_indices.size());
+				for (unsigned int i = 0; i < lod.index_num; i++) {
+					short_indices.push_back(static_cast<uint16_t>(lod_indices[i]));
+				}
+			} else {
+				lod.start_index = static_cast<unsigned int>(long_indices.size());
+				long_indices.insert(long_indices.end(), lod_indices, lod_indices + lod.index_num);
+			}
+		}
+		params.start_index = draw_lods[draw_lod_offsets[draw_call_id]].start_index;
+	}
+
+	indices.swap(long_indices);
+	std::wstring index_message = L"Indices: " + std::to_wstring(short_indices.size()) + L" 16-bit, " +
+		std::to_wstring(indices.size()) + L" 32-bit\n";
+	OutputDebugString(index_message.c_str());
+}
+
+void ModelLoader::BuildMeshBuffers() {
+	// Both index streams hold every draw call followed by its levels of detail, so a run of
+	// draw calls owns one contiguous slice of every stream. A new buffer starts whenever
+	// the next draw call would take a slice of the current one past the size limit.
+	const uint64_t buffer_size = GetBufferSizeLimit(options);
+	mesh_buffers.clear();
+	MeshBuffer buffer = {};
+	uint64_t vertex_end = 0;
+	uint64_t index_end = 0;
+	uint64_t short_index_end = 0;
+	for (size_t draw_call_id = 0; draw_call_id < draw_call_params.size(); draw_call_id++) {
+		DrawCallParams &params = draw_call_params[draw_call_id];
+		const bool short_draw = params.index_size == sizeof(uint16_t);
+		const DrawLod &last_lod = draw_lods[draw_lod_offsets[draw_call_id + 1] - 1];
+		const uint64_t draw_vertex_end = params.start_vertex + static_cast<uint64_t>(params.vertex_num);
+		const uint64_t draw_index_end = last_lod.start_index + static_cast<uint64_t>(last_lod.index_num);
+		uint64_t draw_index_number = 0;
+		for (unsigned int lod_id = draw_lod_offsets[draw_call_id]; lod_id < draw_lod_offsets[draw_call_id + 1]; lod_id++) {
+			draw_index_number += draw_lods[lod_id].index_num;
+		}
+
+		// Positions never outgrow the vertices, position indices cover both index streams
+		const uint64_t buffer_position_index_number = buffer.position_index_num + (options.position_stream ? draw_index_number : 0);
+		const bool fits = (draw_vertex_end - buffer.start_vertex) * vertex_stride <= buffer_size &&
+			(short_draw ? (draw_index_end - buffer.start_short_index) * sizeof(uint16_t) : (draw_index_end - buffer.start_index) * sizeof(unsigned int)) <= buffer_size &&
+			buffer_position_index_number * sizeof(unsigned int) <= buffer_size;
+		if (!fits && buffer.draw_call_num > 0) {
+			buffer.vertex_num = vertex_end - buffer.start_vertex;
+			buffer.index_num = index_end - buffer.start_index;
+			buffer.short_index_num = short_index_end - buffer.start_short_index;
+			mesh_buffers.push_back(buffer);
+			buffer = {};
+			buffer.start_vertex = vertex_end;
+			buffer.start_index = index_end;
+			buffer.start_short_index = short_index_end;
+			buffer.start_draw_call = static_cast<unsigned int>(draw_call_id);
+		}
+
+		// Counted here only to size the buffer, BuildPositionStream lays the position slices out
+		buffer.position_index_num += options.position_stream ? draw_index_number : 0;
+		buffer.draw_call_num++;
+		vertex_end = draw_vertex_end;
+		if (short_draw) {
+			short_index_end = draw_index_end;
+		} else {
+			index_end = draw_index_end;
+		}
+
+		const uint64_t index_start = short_draw ? buffer.start_short_index : buffer.start_index;
+		params.buffer_id = static_cast<unsigned int>(mesh_buffers.size());
+		params.start_vertex = static_cast<unsigned int>(params.start_vertex - buffer.start_vertex);
+		for (unsigned int lod_id = draw_lod_offsets[draw_call_id]; lod_id < draw_lod_offsets[draw_call_id + 1]; lod_id++) {
+			draw_lods[lod_id].start_index = static_cast<unsigned int>(draw_lods[lod_id].start_index - index_start);
+		}
+		params.start_index = draw_lods[draw_lod_offsets[draw_call_id]].start_index;
+	}
+
+	// The last buffer takes the rest of every stream
+	buffer.vertex_num = vertices.size() - buffer.start_vertex;
+	buffer.index_num = indices.size() - buffer.start_index;
+	buffer.short_index_num = short_indices.size() - buffer.start_short_index;
+	mesh_buffers.push_back(buffer);
+
+	if (mesh_buffers.size() > 1) {
+		std::wstring buffer_message = L"Streams split between " + std::to_wstring(mesh_buffers.size()) + L" buffers of at most " +
+			std::to_wstring(buffer_size) + L" bytes\n";
+		OutputDebugString(buffer_message.c_str());
+	}
+}
+
+void ModelLoader::BuildDrawLods() {
+	high_resolution_clock::time_point lod_start = high_resolution_clock::now();
+
+	// Every level is simplified from the full draw call, so its error is measured against the real surface
+	const size_t draw_call_number = draw_call_params.size();
+	std::vector<std::vector<unsigned int>> level_indices(draw_call_number);
+	std::vector<std::vector<DrawLod>> levels(draw_call_number);
+	ParallelFor(draw_call_number, [&](size_t draw_call_id) {
+		const DrawCallParams &params = draw_call_params[draw_call_id];
+		const unsigned int *draw_indices = indices.data() + params.start_index;
+		const float *draw_positions = &vertices[params.start_vertex].position.x;
+		std::vector<unsigned int> simplified_indices(params.index_num);
+		std::vector<unsigned int> optimized_indices(params.index_num);
+		size_t previous_index_number = params.index_num;
+		float previous_error = 0.0f;
+
+		for (unsigned int level = 1; level <= options.lod_level_number; level++) {
+			const size_t target_index_number = static_cast<size_t>(previous_index_number / 3 * options.lod_triangle_ratio) * 3;
+			float error = 0.0f;
+			const size_t index_number = SimplifyMesh(simplified_indices.data(), draw_indices, params.index_num, draw_positions,
+				sizeof(FullVertex), params.vertex_num, target_index_number, std::numeric_limits<float>::max(), &error);
+
+			// Locked borders and seams stop the chain once a level barely removes anything
+			if (index_number == 0 || index_number * 10 > previous_index_number * 9) {
+				break;
+			}
+
+			OptimizeVertexCache(optimized_indices.data(), simplified_indices.data(), index_number, params.vertex_num);
+			DrawLod lod = {};
+			lod.start_index = static_cast<unsigned int>(level_indices[draw_call_id].size());
+			lod.index_num = static_cast<unsigned int>(index_number);
+			lod.error = std::max(error, previous_error);
+			levels[draw_call_id].push_back(lod);
+			level_indices[draw_call_id].insert(level_indices[draw_call_id].end(), optimized_indices.begin(), optimized_indices.begin() + index_number);
+			previous_index_number = index_number;
+			previous_error = lod.error;
+		}
+	}, options.thread_number);
+
+	// Level 0 points at the draw call, simplified levels are appended after all draw calls
+	draw_lods.clear();
+	draw_lod_offsets.assign(1, 0);
+	std::vector<size_t> level_triangle_numbers(options.lod_level_number + 1, 0);
+	for (size_t draw_call_id = 0; draw_call_id < draw_call_number; draw_call_id++) {
+		const DrawCallParams &params = draw_call_params[draw_call_id];
+		DrawLod full_lod = {};
+		full_lod.start_index = params.start_index;
+		full_lod.index_num = params.index_num;
+		draw_lods.push_back(full_lod);
+
+		const unsigned int level_start_index = static_cast<unsigned int>(indices.size());
+		for (DrawLod lod : levels[draw_call_id]) {
+			lod.start_index += level_start_index;
+			draw_lods.push_back(lod);
+		}
+		indices.insert(indices.end(), level_indices[draw_call_id].begin(), level_indices[draw_call_id].end());
+		draw_lod_offsets.push_back(static_cast<unsigned int>(draw_lods.size()));
+
+		// Draw calls with a shorter chain count with their coarsest level
+		for (size_t level = 0; level < level_triangle_numbers.size(); level++) {
+			const size_t lod_id = draw_lod_offsets[draw_call_id] + std::min(level, levels[draw_call_id].size());
+			level_triangle_numbers[level] += draw_lods[lod_id].index_num / 3;
+		}
+	}
+
+	if (options.lod_level_number == 0) {
+		return;
+	}
+
+	duration<double> lod_time = duration_cast<duration<double>>(high_resolution_clock::now() - lod_start);
+	std::wstring lod_message = L"LOD chains built in " + std::to_wstring(lod_time.count() * 1000.0) + L" ms, triangles per level:";
+	for (size_t level = 0; level < level_triangle_numbers.size(); level++) {
+		lod_message += (level ? L" -> " : L" ") + std::to_wstring(level_triangle_numbers[level]);
+	}
+	lod_message += L"\n";
+	OutputDebugString(lod_message.c_str());
+}
+
+void ModelLoader::BuildDrawBounds() {
+	draw_bounds.resize(draw_call_params.size());
+	ParallelFor(draw_call_params.size(), [&](size_t draw_call_id) {
+		const DrawCallParams &params = draw_call_params[draw_call_id];
+		// position is the first member of FullVertex
+		const float *draw_positions = reinterpret_cast<const float *>(vertices.data() + params.start_vertex);
+		draw_bounds[draw_call_id] = ComputeDrawBounds(draw_positions, sizeof(FullVertex), params.vertex_num);
+	}, options.thread_number);
+
+	if (options.pack_vertices) {
+		// Packed positions may land up to half a quantization step away, grow by a whole step
+		const XMFLOAT4 &scale = vertex_quantization.position_scale;
+		const XMFLOAT3 step = {scale.x / 65535.0f, scale.y / 65535.0f, scale.z / 65535.0f};
+		const float step_length = std::sqrt(step.x * step.x + step.y * step.y + step.z * step.z);
+		for (DrawBounds &bounds : draw_bounds) {
+			bounds.extent = {bounds.extent.x + step.x, bounds.extent.y + step.y, bounds.extent.z + step.z};
+			bounds.radius += step_length;
+		}
+	}
+}
+
+void ModelLoader::BuildDrawMeshlets() {
+	high_resolution_clock::time_point meshlet_start = high_resolution_clock::now();
+
+	// Every draw call gets its own meshlets, in the triangle order OptimizeMesh left
+	const size_t draw_call_number = draw_call_params.size();
+	std::vector<std::vector<Meshlet>> draw_meshlets(draw_call_number);
+	std::vector<std::vector<unsigned int>> draw_meshlet_vertices(draw_call_number);
+	std::vector<std::vector<uint8_t>> draw_meshlet_triangles(draw_call_number);
+	ParallelFor(draw_call_number, [&](size_t draw_call_id) {
+		const DrawCallParams &params = draw_call_params[draw_call_id];
+		BuildMeshlets(draw_meshlets[draw_call_id], draw_meshlet_vertices[draw_call_id], draw_meshlet_triangles[draw_call_id],
+			indices.data() + params.start_index, params.index_num, params.vertex_num, params.start_vertex);
+	}, options.thread_number);
+
+	// Concatenate, moving the offsets of every meshlet past the previous draw calls
+	meshlets.clear();
+	meshlet_vertices.clear();
+	meshlet_triangles.clear();
+	meshlet_offsets.assign(1, 0);
+	for (size_t draw_call_id = 0; draw_call_id < draw_call_number; draw_call_id++) {
+		const unsigned int vertex_offset = static_cast<unsigned int>(meshlet_vertices.size());
+		const unsigned int triangle_offset = static_cast<unsigned int>(meshlet_triangles.size() / 3);
+		for (Meshlet meshlet : draw_meshlets[draw_call_id]) {
+			meshlet.vertex_offset += vertex_offset;
+			meshlet.triangle_offset += triangle_offset;
+			meshlets.push_back(meshlet);
+		}
+		meshlet_vertices.insert(meshlet_vertices.end(), draw_meshlet_vertices[draw_call_id].begin(), draw_meshlet_vertices[draw_call_id].end());
+		meshlet_triangles.insert(meshlet_triangles.end(), draw_meshlet_triangles[draw_call_id].begin(), draw_meshlet_triangles[draw_call_id].end());
+		meshlet_offsets.push_back(static_cast<unsigned int>(meshlets.size()));
+	}
+
+	meshlet_bounds.resize(meshlets.size());
+	ParallelFor(meshlets.size(), [&](size_t meshlet_id) {
+		meshlet_bounds[meshlet_id] = ComputeMeshletBounds(meshlets[meshlet_id], meshlet_vertices.data(), meshlet_triangles.data(),
+			&vertices[0].position.x, sizeof(FullVertex));
+	}, options.thread_number);
+
+	if (options.pack_vertices) {
+		// Same margin as the draw bounds
+		const XMFLOAT4 &scale = vertex_quantization.position_scale;
+		const float step_length = std::sqrt(scale.x * scale.x + scale.y * scale.y + scale.z * scale.z) / 65535.0f;
+		for (MeshletBounds &bounds : meshlet_bounds) {
+			bounds.radius += step_length;
+		}
+	}
+
+	duration<double> meshlet_time = duration_cast<duration<double>>(high_resolution_clock::now() - meshlet_start);
+	const double meshlet_divisor = meshlets.empty() ? 1.0 : static_cast<double>(meshlets.size());
+	std::wstring meshlet_message = L"Meshlets built in " + std::to_wstring(meshlet_time.count() * 1000.0) + L" ms: " +
+		std::to_wstring(meshlets.size()) + L" meshlets, " + std::to_wstring(meshlet_vertices.size() / meshlet_divisor) + L" vertices and " +
+		std::to_wstring(meshlet_triangles.size() / 3 / meshlet_divisor) + L" triangles on average\n";
+	OutputDebugString(meshlet_message.c_str());
+
+	AnalyzeMeshletCulling();
+}
+
+void ModelLoader::AnalyzeMeshletCulling() const {
+	if (meshlets.empty()) {
+		return;
+	}
+
+	// Cameras on the face and corner directions of a cube around the mesh, at twice its bounding radius
+	const DrawBounds mesh_bounds = ComputeDrawBounds(&vertices[0].position.x, sizeof(FullVertex), vertices.size());
+	std::vector<XMFLOAT3> camera_positions;
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+			for (int z = -1; z <= 1; z++) {
+				const int axis_number = (x != 0) + (y != 0) + (z != 0);
+				if (axis_number != 1 && axis_number != 3) {
+					continue;
+				}
+				const float distance = 2.0f * mesh_bounds.radius / std::sqrt(static_cast<float>(axis_number));
+				camera_positions.push_back({mesh_bounds.center.x + x * distance, mesh_bounds.center.y + y * distance, mesh_bounds.center.z + z * distance});
+			}
+		}
+	}
+
+	// Triangles rejected with their meshlet, and back facing triangles as the limit for per triangle culling
+	std::vector<size_t> rejected_triangles(camera_positions.size(), 0);
+	std::vector<size_t> back_facing_triangles(camera_positions.size(), 0);
+	ParallelFor(camera_positions.size(), [&](size_t camera_id) {
+		const XMFLOAT3 &camera = camera_positions[camera_id];
+		for (size_t meshlet_id = 0; meshlet_id < meshlets.size(); meshlet_id++) {
+			const Meshlet &meshlet = meshlets[meshlet_id];
+			if (IsMeshletBackfacing(meshlet_bounds[meshlet_id], camera)) {
+				rejected_triangles[camera_id] += meshlet.triangle_number;
+			}
+
+			const unsigned int *local_vertices = meshlet_vertices.data() + meshlet.vertex_offset;
+			const uint8_t *triangles = meshlet_triangles.data() + 3 * meshlet.triangle_offset;
+			for (unsigned int t = 0; t < meshlet.triangle_number; t++) {
+				const XMFLOAT3 &p0 = vertices[local_vertices[triangles[3 * t + 0]]].position;
+				const XMFLOAT3 &p1 = vertices[local_vertices[triangles[3 * t + 1]]].position;
+				const XMFLOAT3 &p2 = vertices[local_vertices[triangles[3 * t + 2]]].position;
+				const XMFLOAT3 e1 = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+				const XMFLOAT3 e2 = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+				// Same winding as ComputeMeshletBounds
+				const XMFLOAT3 normal = {e2.y * e1.z - e2.z * e1.y, e2.z * e1.x - e2.x * e1.z, e2.x * e1.y - e2.y * e1.x};
+				const float facing = (p0.x - camera.x) * normal.x + (p0.y - camera.y) * normal.y + (p0.z - camera.z) * normal.z;
+				back_facing_triangles[camera_id] += (facing > 0.0f) ? 1 : 0;
+			}
+		}
+	}, options.thread_number);
+
+	const double triangle_number = static_cast<double>(meshlet_triangles.size() / 3) * camera_positions.size();
+	size_t rejected_total = 0;
+	size_t back_facing_total = 0;
+	for (size_t camera_id = 0; camera_id < camera_positions.size(); camera_id++) {
+		rejected_total += rejected_triangles[camera_id];
+		back_facing_total += back_facing_triangles[camera_id];
+	}
+	std::wstring culling_message = L"Meshlet cone culling over " + std::to_wstring(camera_positions.size()) + L" views: " +
+		std::to_wstring(100.0 * rejected_total / triangle_number) + L"% of triangles rejected, " +
+		std::to_wstring(100.0 * back_facing_total / triangle_number) + L"% back facing\n";
+	OutputDebugString(culling_message.c_str());
+}
+
+template <typename T>
+static void AppendPositionIndices(std::vector<unsigned int> &position_indices, const T *draw_indices, size_t index_number,
+	const unsigned int *draw_remap) {
+	for (size_t i = 0; i < index_number; i++) {
+		position_indices.push_back(draw_remap[draw_indices[i]]);
+	}
+}
+
+void ModelLoader::BuildPositionStream() {
+	high_resolution_clock::time_point position_start = high_resolution_clock::now();
+	const char *source = options.pack_vertices ? reinterpret_cast<const char *>(packed_vertices.data()) : reinterpret_cast<const char *>(vertices.data());
+	const size_t source_stride = options.pack_vertices ? sizeof(PackedVertex) : sizeof(FullVertex);
+	position_stride = options.pack_vertices ? sizeof(PackedVertex::position) : sizeof(XMFLOAT3);
+
+	positions.clear();
+	position_indices.clear();
+	position_indices.reserve(indices.size() + short_indices.size());
+	position_index_offsets.assign(1, 0);
+	std::vector<unsigned int> remap;
+	for (MeshBuffer &buffer : mesh_buffers) {
+		// Vertices of the buffer which differ only in normal, texcoord or color share one position
+		const char *buffer_source = source + buffer.start_vertex * source_stride;
+		remap.resize(buffer.vertex_num);
+		buffer.start_position = positions.size() / position_stride;
+		buffer.position_num = GeneratePositionRemap(remap.data(), buffer_source, buffer.vertex_num, source_stride, position_stride);
+		positions.resize((buffer.start_position + buffer.position_num) * position_stride);
+		char *buffer_positions = positions.data() + buffer.start_position * position_stride;
+		for (size_t v = 0; v < buffer.vertex_num; v++) {
+			memcpy(buffer_positions + remap[v] * position_stride, buffer_source + v * source_stride, position_stride);
+		}
+
+		// Simplified levels follow the full draw calls of the buffer, so runs of full draw calls stay contiguous
+		buffer.start_position_index = position_indices.size();
+		auto append_lod = [&](const DrawCallParams &params, DrawLod &lod) {
+			lod.position_start_index = static_cast<unsigned int>(position_indices.size() - buffer.start_position_index);
+			if (params.index_size == sizeof(uint16_t)) {
+				AppendPositionIndices(position_indices, short_indices.data() + buffer.start_short_index + lod.start_index, lod.index_num,
+					remap.data() + params.start_vertex);
+			} else {
+				AppendPositionIndices(position_indices, indices.data() + buffer.start_index + lod.start_index, lod.index_num,
+					remap.data() + params.start_vertex);
+			}
+		};
+		const size_t draw_call_end = buffer.start_draw_call + static_cast<size_t>(buffer.draw_call_num);
+		for (size_t draw_call_id = buffer.start_draw_call; draw_call_id < draw_call_end; draw_call_id++) {
+			const DrawCallParams &params = draw_call_params[draw_call_id];
+			append_lod(params, draw_lods[draw_lod_offsets[draw_call_id]]);
+			position_index_offsets.push_back(position_index_offsets.back() + params.index_num);
+		}
+		for (size_t draw_call_id = buffer.start_draw_call; draw_call_id < draw_call_end; draw_call_id++) {
+			for (unsigned int lod_id = draw_lod_offsets[draw_call_id] + 1; lod_id < draw_lod_offsets[draw_call_id + 1]; lod_id++) {
+				append_lod(draw_call_params[draw_call_id], draw_lods[lod_id]);
+			}
+		}
+		buffer.position_index_num = position_indices.size() - buffer.start_position_index;
+	}
+
+	duration<double> position_time = duration_cast<duration<double>>(high_resolution_clock::now() - position_start);
+	std::wstring position_message = L"Position stream built in " + std::to_wstring(position_time.count() * 1000.0) + L" ms: " +
+		std::to_wstring(positions.size() / position_stride) + L" positions for " + std::to_wstring(vertices.size()) + L" vertices, " +
+		std::to_wstring(positions.size() / 1024) + L" KB instead of " + std::to_wstring(vertices.size() * source_stride / 1024) + L" KB\n";
+	OutputDebugString(position_message.c_str());
+}
+
+void ModelLoader::PackMesh() {
+	high_resolution_clock::time_point packing_start = high_resolution_clock::now();
+
+	// vertex_quantization is one grid for the whole mesh, so the renderer sets it once
+	packed_vertices.resize(vertices.size());
+	PackVertices(packed_vertices.data(), vertices.data(), vertices.size(), vertex_quantization);
+
+	duration<double> packing_time = duration_cast<duration<double>>(high_resolution_clock::now() - packing_start);
+	VertexPackingError error = MeasureVertexPackingError(vertices.data(), packed_vertices.data(), vertices.size(), vertex_quantization);
+	std::wstring packing_message = L"Vertices packed in " + std::to_wstring(packing_time.count() * 1000.0) + L" ms: " +
+		std::to_wstring(sizeof(FullVertex)) + L" -> " + std::to_wstring(sizeof(PackedVertex)) + L" bytes, max error position " +
+		std::to_wstring(error.position) + L", normal " + std::to_wstring(error.normal_degrees) + L" deg, texcoord " +
+		std::to_wstring(error.texcoord) + L"\n";
+	OutputDebugString(packing_message.c_str());
+}
+
+void ModelLoader::BuildTangents() {
+	high_resolution_clock::time_point tangent_start = high_resolution_clock::now();
+
+	// Draw calls are whole materials owning their vertex slices, so every one of them is an independent job
+	tangents.resize(vertices.size());
+	ParallelFor(draw_call_params.size(), [&](size_t draw_call_id) {
+		const DrawCallParams &params = draw_call_params[draw_call_id];
+		std::vector<XMFLOAT4> draw_tangents(params.vertex_num);
+		GenerateTangents(draw_tangents.data(), vertices.data() + params.start_vertex, params.vertex_num,
+			indices.data() + params.start_index, params.index_num);
+		for (unsigned int v = 0; v < params.vertex_num; v++) {
+			tangents[params.start_vertex + v] = PackTangent(draw_tangents[v]);
+		}
+	}, options.thread_number);
+
+	duration<double> tangent_time = duration_cast<duration<double>>(high_resolution_clock::now() - tangent_start);
+	std::wstring tangent_message = L"Tangents generated in " + std::to_wstring(tangent_time.count() * 1000.0) + L" ms: " +
+		std::to_wstring(sizeof(XMFLOAT4)) + L" -> " + std::to_wstring(sizeof(PackedTangent)) + L" bytes per vertex\n";
+	OutputDebugString(tangent_message.c_str());
+}
+
+OverdrawStatistics ModelLoader::AnalyzeMeshOverdraw() const {
+	// Overdraw depends on the draw order of the whole scene, so all draw calls are rasterized together
+	if (vertices.empty()) {
+		return OverdrawStatistics();
+	}
+
+	std::vector<unsigned int> mesh_indices(indices.size());
+	for (const DrawCallParams &params : draw_call_params) {
+		for (unsigned int i = 0; i < params.index_num; i++) {
+			mesh_indices[params.start_index + i] = params.start_vertex + indices[params.start_index + i];
+		}
+	}
+
+	return AnalyzeOverdraw(mesh_indices.data(), mesh_indices.size(), &vertices[0].position.x, sizeof(FullVertex), vertices.size());
+}
+
+const LoaderStatistics ModelLoader::GetStatistics() const {
+	return statistics;
+}
+
+const void *ModelLoader::GetVertexBuffer() const {
+	return vertex_data;
+}
+
+const uint64_t ModelLoader::GetVertexBufferSize() const {
+	return static_cast<uint64_t>(vertex_number) * vertex_stride;
+}
+
+const unsigned int ModelLoader::GetVertexStride() const {
+	return static_cast<unsigned int>(vertex_stride);
+}
+
+const size_t ModelLoader::GetVertexNumber() const {
+	return vertex_number;
+}
+
+const bool ModelLoader::HasPackedVertices() const {
+	return vertex_stride == sizeof(PackedVertex);
+}
+
+const VertexQuantization ModelLoader::GetVertexQuantization() const {
+	return vertex_quantization;
 }
 
 const unsigned int *ModelLoader::GetIndexBuffer() const {
-	return indices.data();
+	return index_data;
+}
+
+const uint64_t ModelLoader::GetIndexBufferSize() const {
+	return static_cast<uint64_t>(index_number) * sizeof(unsigned int);
+}
+
+const size_t ModelLoader::GetIndexNumber() const {
+	return index_number;
+}
+
+const uint16_t *ModelLoader::GetShortIndexBuffer() const {
+	return short_index_data;
+}
+
+const uint64_t ModelLoader::GetShortIndexBufferSize() const {
+	return static_cast<uint64_t>(short_index_number) * sizeof(uint16_t);
+}
+
+const size_t ModelLoader::GetShortIndexNumber() const {
+	return short_index_number;
+}
+
+const PackedTangent *ModelLoader::GetTangentBuffer() const {
+	return tangent_data;
+}
+
+const uint64_t ModelLoader::GetTangentBufferSize() const {
+	return static_cast<uint64_t>(tangent_number) * sizeof(PackedTangent);
+}
+
+const void *ModelLoader::GetPositionBuffer() const {
+	return position_data;
+}
+
+const uint64_t ModelLoader::GetPositionBufferSize() const {
+	return static_cast<uint64_t>(position_number) * position_stride;
+}
+
+const unsigned int ModelLoader::GetPositionStride() const {
+	return static_cast<unsigned int>(position_stride);
+}
+
+const unsigned int *ModelLoader::GetPositionIndexBuffer() const {
+	return position_index_data;
+}
+
+const uint64_t ModelLoader::GetPositionIndexBufferSize() const {
+	return static_cast<uint64_t>(position_index_number) * sizeof(unsigned int);
+}
+
+const uint64_t ModelLoader::GetPositionIndexNumber(unsigned int draw_call_number) const {
+	if (position_index_offset_number == 0) {
+		return 0;
+	}
+	return position_index_offset_data[std::min<size_t>(draw_call_number, position_index_offset_number - 1)];
 }
 
-const unsigned int ModelLoader::GetIndexBufferSize() const {
-	return static_cast<unsigned int>(indices.size() * sizeof(unsigned int));
+const unsigned int ModelLoader::GetBufferNumber() const {
+	return static_cast<unsigned int>(mesh_buffers.size());
 }
 
-const unsigned int ModelLoader::GetIndexNumber() const {
-	return indices.size();
+const MeshBuffer ModelLoader::GetBuffer(unsigned int buffer_id) const {
+	return mesh_buffers[buffer_id];
+}
+
+const std::vector<MaterialConstants> ModelLoader::GetMaterialConstants() const {
+	std::vector<MaterialConstants> material_constants(materials.size());
+	for (size_t material_id = 0; material_id < materials.size(); material_id++) {
+		const tinyobj::real_t *diffuse = materials[material_id].diffuse;
+		material_constants[material_id].diffuse = {diffuse[0], diffuse[1], diffuse[2], 1.0f};
+	}
+	return material_constants;
 }
 
 const unsigned int ModelLoader::GetMaterialNumber() const {
 	return materials.size();
 }
 
-const DrawCallParams ModelLoader::GetDrawCallParams(unsigned int material_id) const {
-	return per_material_draw_call_params[material_id];
+const unsigned int ModelLoader::GetDrawCallNumber() const {
+	return static_cast<unsigned int>(draw_call_params.size());
+}
+
+const DrawCallParams ModelLoader::GetDrawCallParams(unsigned int draw_call_id) const {
+	return draw_call_params[draw_call_id];
+}
+
+const DrawBounds *ModelLoader::GetDrawBounds() const {
+	return draw_bounds.data();
+}
+
+const unsigned int ModelLoader::GetMeshletNumber() const {
+	return static_cast<unsigned int>(meshlet_number);
+}
+
+const Meshlet *ModelLoader::GetMeshlets() const {
+	return meshlet_data;
+}
+
+const MeshletBounds *ModelLoader::GetMeshletBounds() const {
+	return meshlet_bounds_data;
+}
+
+const unsigned int *ModelLoader::GetMeshletVertices() const {
+	return meshlet_vertex_data;
+}
+
+const unsigned int ModelLoader::GetMeshletVertexNumber() const {
+	return static_cast<unsigned int>(meshlet_vertex_number);
+}
+
+const uint8_t *ModelLoader::GetMeshletTriangles() const {
+	return meshlet_triangle_data;
+}
+
+const unsigned int ModelLoader::GetMeshletTriangleNumber() const {
+	return static_cast<unsigned int>(meshlet_triangle_number);
+}
+
+const unsigned int ModelLoader::GetMeshletOffset(unsigned int draw_call_number) const {
+	if (meshlet_offset_number == 0) {
+		return 0;
+	}
+	return meshlet_offset_data[std::min<size_t>(draw_call_number, meshlet_offset_number - 1)];
+}
+
+const unsigned int ModelLoader::GetDrawLodNumber(unsigned int draw_call_id) const {
+	return draw_lod_offsets[draw_call_id + 1] - draw_lod_offsets[draw_call_id];
+}
+
+const DrawLod ModelLoader::GetDrawLod(unsigned int draw_call_id, unsigned int level) const {
+	return draw_lods[draw_lod_offsets[draw_call_id] + level];
 }
 
 const std::string ModelLoader::GetTexturePath(unsigned int material_id) const {
@@ -156,10 +1935,371 @@ const unsigned int ModelLoader::GetTextureNumber() const {
 	return texture_num;
 }
 
+static bool IsSliceValid(uint64_t start, uint64_t number, uint64_t stream_number) {
+	return start <= stream_number && number <= stream_number - start;
+}
+
+bool ModelLoader::LoadCache(const std::string &cache_file, uint64_t source_stamp) {
+	if (source_stamp == 0 || !mesh_cache.Open(cache_file, source_stamp, GetCacheLayoutStamp())) {
+		return false;
+	}
+
+	size_t draw_call_number;
+	size_t materials_size;
+	size_t quantization_number = 0;
+	vertex_stride = options.pack_vertices ? sizeof(PackedVertex) : sizeof(FullVertex);
+	position_stride = options.pack_vertices ? sizeof(PackedVertex::position) : sizeof(XMFLOAT3);
+	if (options.pack_vertices) {
+		const VertexQuantization *quantization = mesh_cache.GetArray<VertexQuantization>(MESH_CACHE_VERTEX_QUANTIZATION, quantization_number);
+		if (quantization_number == 1) {
+			vertex_quantization = *quantization;
+		}
+	}
+	bool streams_valid = true;
+	if (options.compress_cache) {
+		streams_valid = DecodeCacheStreams();
+	} else {
+		if (options.pack_vertices) {
+			vertex_data = mesh_cache.GetArray<PackedVertex>(MESH_CACHE_PACKED_VERTICES, vertex_number);
+		} else {
+			vertex_data = mesh_cache.GetArray<FullVertex>(MESH_CACHE_VERTICES, vertex_number);
+		}
+		index_data = mesh_cache.GetArray<unsigned int>(MESH_CACHE_INDICES, index_number);
+		short_index_data = mesh_cache.GetArray<uint16_t>(MESH_CACHE_SHORT_INDICES, short_index_number);
+		tangent_data = mesh_cache.GetArray<PackedTangent>(MESH_CACHE_TANGENTS, tangent_number);
+		size_t positions_size = 0;
+		position_data = mesh_cache.GetSection(MESH_CACHE_POSITIONS, positions_size);
+		position_number = positions_size / position_stride;
+		position_index_data = mesh_cache.GetArray<unsigned int>(MESH_CACHE_POSITION_INDICES, position_index_number);
+	}
+	position_index_offset_data = mesh_cache.GetArray<uint64_t>(MESH_CACHE_POSITION_INDEX_OFFSETS, position_index_offset_number);
+	const DrawCallParams *draw_calls = mesh_cache.GetArray<DrawCallParams>(MESH_CACHE_DRAW_CALLS, draw_call_number);
+	size_t buffer_number = 0;
+	const MeshBuffer *buffers = mesh_cache.GetArray<MeshBuffer>(MESH_CACHE_MESH_BUFFERS, buffer_number);
+	size_t draw_bounds_number = 0;
+	const DrawBounds *bounds = mesh_cache.GetArray<DrawBounds>(MESH_CACHE_DRAW_BOUNDS, draw_bounds_number);
+	const char *materials_data = static_cast<const char *>(mesh_cache.GetSection(MESH_CACHE_MATERIALS, materials_size));
+	size_t libraries_size = 0;
+	const char *libraries_data = static_cast<const char *>(mesh_cache.GetSection(MESH_CACHE_MATERIAL_LIBRARIES, libraries_size));
+	meshlet_data = mesh_cache.GetArray<Meshlet>(MESH_CACHE_MESHLETS, meshlet_number);
+	size_t meshlet_bounds_number = 0;
+	meshlet_bounds_data = mesh_cache.GetArray<MeshletBounds>(MESH_CACHE_MESHLET_BOUNDS, meshlet_bounds_number);
+	meshlet_vertex_data = mesh_cache.GetArray<unsigned int>(MESH_CACHE_MESHLET_VERTICES, meshlet_vertex_number);
+	meshlet_triangle_data = mesh_cache.GetArray<uint8_t>(MESH_CACHE_MESHLET_TRIANGLES, meshlet_triangle_number);
+	meshlet_triangle_number /= 3;
+	meshlet_offset_data = mesh_cache.GetArray<unsigned int>(MESH_CACHE_MESHLET_OFFSETS, meshlet_offset_number);
+	size_t lod_number = 0;
+	const DrawLod *lods = mesh_cache.GetArray<DrawLod>(MESH_CACHE_DRAW_LODS, lod_number);
+	size_t lod_offset_number = 0;
+	const unsigned int *lod_offsets = mesh_cache.GetArray<unsigned int>(MESH_CACHE_DRAW_LOD_OFFSETS, lod_offset_number);
+
+	// The source stamp only covers the OBJ, the material libraries it named are stamped here
+	uint64_t library_stamp = 0;
+	bool cache_valid = streams_valid && DeserializeMaterials(materials_data, materials_size, materials) &&
+		DeserializeMaterialLibraries(libraries_data, libraries_size, material_libraries, library_stamp) &&
+		library_stamp == GetMaterialLibraryStamp(obj_path, material_libraries) && draw_bounds_number == draw_call_number &&
+		lod_offset_number == draw_call_number + 1 && lod_offsets[draw_call_number] == lod_number && buffer_number > 0;
+	for (size_t buffer_id = 0; buffer_id < buffer_number && cache_valid; buffer_id++) {
+		const MeshBuffer &buffer = buffers[buffer_id];
+		cache_valid = IsSliceValid(buffer.start_vertex, buffer.vertex_num, vertex_number) &&
+			IsSliceValid(buffer.start_index, buffer.index_num, index_number) &&
+			IsSliceValid(buffer.start_short_index, buffer.short_index_num, short_index_number) &&
+			IsSliceValid(buffer.start_position, buffer.position_num, position_number) &&
+			IsSliceValid(buffer.start_position_index, buffer.position_index_num, position_index_number) &&
+			IsSliceValid(buffer.start_draw_call, buffer.draw_call_num, draw_call_number);
+	}
+
+	// Draw calls and their levels of detail have to stay inside the slices of their buffer
+	for (size_t draw_call_id = 0; draw_call_id < draw_call_number && cache_valid; draw_call_id++) {
+		const DrawCallParams &params = draw_calls[draw_call_id];
+		cache_valid = params.material_id < materials.size() && params.buffer_id < buffer_number &&
+			lod_offsets[draw_call_id] < lod_offsets[draw_call_id + 1];
+		const MeshBuffer &buffer = buffers[cache_valid ? params.buffer_id : 0];
+		const uint64_t buffer_index_number = (params.index_size == sizeof(uint16_t)) ? buffer.short_index_num : buffer.index_num;
+		cache_valid = cache_valid && IsSliceValid(params.start_vertex, params.vertex_num, buffer.vertex_num) &&
+			IsSliceValid(params.start_index, params.index_num, buffer_index_number);
+		for (size_t lod_id = lod_offsets[draw_call_id]; lod_id < lod_offsets[draw_call_id + 1] && cache_valid; lod_id++) {
+			cache_valid = IsSliceValid(lods[lod_id].start_index, lods[lod_id].index_num, buffer_index_number) &&
+				(!options.position_stream || IsSliceValid(lods[lod_id].position_start_index, lods[lod_id].index_num, buffer.position_index_num));
+		}
+	}
+
+	if (options.position_stream) {
+		cache_valid = cache_valid && position_index_offset_number == draw_call_number + 1 &&
+			position_index_offset_data[draw_call_number] <= position_index_number;
+	}
+
+	if (options.generate_tangents) {
+		cache_valid = cache_valid && tangent_number == vertex_number;
+	}
+
+	if (options.build_meshlets) {
+		cache_valid = cache_valid && meshlet_bounds_number == meshlet_number && meshlet_offset_number == draw_call_number + 1 &&
+			meshlet_offset_data[draw_call_number] == meshlet_number;
+		for (size_t meshlet_id = 0; meshlet_id < meshlet_number && cache_valid; meshlet_id++) {
+			const Meshlet &meshlet = meshlet_data[meshlet_id];
+			cache_valid = meshlet.vertex_offset + static_cast<size_t>(meshlet.vertex_number) <= meshlet_vertex_number &&
+				meshlet.triangle_offset + static_cast<size_t>(meshlet.triangle_number) <= meshlet_triangle_number;
+		}
+	}
+
+	if (!cache_valid ||
+		(options.pack_vertices && quantization_number != 1)) {
+		mesh_cache.Close();
+		materials.clear();
+		material_libraries.clear();
+		// Filled by DecodeCacheStreams
+		vertices.clear();
+		packed_vertices.clear();
+		indices.clear();
+		short_indices.clear();
+		positions.clear();
+		position_indices.clear();
+		tangents.clear();
+		vertex_data = nullptr;
+		vertex_number = 0;
+		index_data = nullptr;
+		index_number = 0;
+		short_index_data = nullptr;
+		short_index_number = 0;
+		tangent_data = nullptr;
+		tangent_number = 0;
+		position_data = nullptr;
+		position_number = 0;
+		position_index_data = nullptr;
+		position_index_number = 0;
+		position_index_offset_data = nullptr;
+		position_index_offset_number = 0;
+		meshlet_data = nullptr;
+		meshlet_bounds_data = nullptr;
+		meshlet_number = 0;
+		meshlet_vertex_data = nullptr;
+		meshlet_vertex_number = 0;
+		meshlet_triangle_data = nullptr;
+		meshlet_triangle_number = 0;
+		meshlet_offset_data = nullptr;
+		meshlet_offset_number = 0;
+		return false;
+	}
+
+	draw_call_params.assign(draw_calls, draw_calls + draw_call_number);
+	mesh_buffers.assign(buffers, buffers + buffer_number);
+	draw_bounds.assign(bounds, bounds + draw_bounds_number);
+	draw_lods.assign(lods, lods + lod_number);
+	draw_lod_offsets.assign(lod_offsets, lod_offsets + lod_offset_number);
+	return true;
+}
+
+// Decodes the streams SaveCache compressed into the vectors cold loads fill
+bool ModelLoader::DecodeCacheStreams() {
+	size_t size_number = 0;
+	const uint64_t *sizes = mesh_cache.GetArray<uint64_t>(MESH_CACHE_ENCODED_SIZES, size_number);
+	if (size_number != 6) {
+		return false;
+	}
+
+	void *vertex_destination;
+	if (options.pack_vertices) {
+		packed_vertices.resize(sizes[0]);
+		vertex_destination = packed_vertices.data();
+	} else {
+		vertices.resize(sizes[0]);
+		vertex_destination = vertices.data();
+	}
+	indices.resize(sizes[1]);
+	short_indices.resize(sizes[2]);
+	positions.resize(sizes[3] * position_stride);
+	position_indices.resize(sizes[4]);
+	tangents.resize(sizes[5]);
+
+	// Index streams decode one triangle at a time, so the streams go to separate workers
+	uint8_t stream_valid[6] = {};
+	ParallelFor(6, [&](size_t stream) {
+		const uint32_t section_ids[6] = {MESH_CACHE_ENCODED_VERTICES, MESH_CACHE_ENCODED_INDICES, MESH_CACHE_ENCODED_SHORT_INDICES,
+			MESH_CACHE_ENCODED_POSITIONS, MESH_CACHE_ENCODED_POSITION_INDICES, MESH_CACHE_ENCODED_TANGENTS};
+		size_t size = 0;
+		const uint8_t *data = mesh_cache.GetArray<uint8_t>(section_ids[stream], size);
+		switch (stream) {
+		case 0:
+			stream_valid[stream] = DecodeVertexBuffer(vertex_destination, sizes[0], vertex_stride, data, size);
+			break;
+		case 1:
+			stream_valid[stream] = DecodeIndexBuffer(indices.data(), indices.size(), data, size);
+			break;
+		case 2:
+			stream_valid[stream] = DecodeIndexBuffer(short_indices.data(), short_indices.size(), data, size);
+			break;
+		case 3:
+			stream_valid[stream] = DecodeVertexBuffer(positions.data(), sizes[3], position_stride, data, size);
+			break;
+		case 4:
+			stream_valid[stream] = DecodeIndexBuffer(position_indices.data(), position_indices.size(), data, size);
+			break;
+		default:
+			stream_valid[stream] = DecodeVertexBuffer(tangents.data(), tangents.size(), sizeof(PackedTangent), data, size);
+			break;
+		}
+	}, options.thread_number);
+
+	vertex_data = vertex_destination;
+	vertex_number = sizes[0];
+	index_data = indices.data();
+	index_number = indices.size();
+	short_index_data = short_indices.data();
+	short_index_number = short_indices.size();
+	position_data = positions.data();
+	position_number = sizes[3];
+	position_index_data = position_indices.data();
+	position_index_number = position_indices.size();
+	tangent_data = tangents.data();
+	tangent_number = tangents.size();
+	return std::all_of(stream_valid, stream_valid + 6, [](uint8_t valid) { return valid != 0; });
+}
+
+bool ModelLoader::SaveCache(const std::string &cache_file, uint64_t source_stamp) const {
+	if (source_stamp == 0) {
+		return false;
+	}
+
+	std::vector<char> materials_data = SerializeMaterials(materials);
+	std::vector<char> libraries_data = SerializeMaterialLibraries(material_libraries, GetMaterialLibraryStamp(obj_path, material_libraries));
+
+	MeshCacheWriter writer;
+	// Only the stream handed to the renderer is stored
+	std::vector<VertexQuantization> quantization(1, vertex_quantization);
+	if (options.pack_vertices) {
+		writer.AddArray(MESH_CACHE_VERTEX_QUANTIZATION, quantization);
+	}
+
+	// Referenced by the writer until Write returns
+	std::vector<uint64_t> encoded_sizes;
+	std::vector<uint8_t> encoded_streams[6];
+	if (options.compress_cache) {
+		high_resolution_clock::time_point encode_start = high_resolution_clock::now();
+		const MeshCodecLevel level = options.entropy_code_cache ? MESH_CODEC_SMALL : MESH_CODEC_FAST;
+		encoded_sizes = {vertex_number, index_number, short_index_number, position_number, position_index_number, tangent_number};
+
+		uint8_t stream_encoded[6] = {};
+		ParallelFor(6, [&](size_t stream) {
+			switch (stream) {
+			case 0:
+				stream_encoded[stream] = EncodeVertexBuffer(encoded_streams[stream], vertex_data, vertex_number, vertex_stride, level);
+				break;
+			case 1:
+				stream_encoded[stream] = EncodeIndexBuffer(encoded_streams[stream], index_data, index_number);
+				break;
+			case 2:
+				stream_encoded[stream] = EncodeIndexBuffer(encoded_streams[stream], short_index_data, short_index_number);
+				break;
+			case 3:
+				stream_encoded[stream] = EncodeVertexBuffer(encoded_streams[stream], position_data, position_number, position_stride, level);
+				break;
+			case 4:
+				stream_encoded[stream] = EncodeIndexBuffer(encoded_streams[stream], position_index_data, position_index_number);
+				break;
+			default:
+				stream_encoded[stream] = EncodeVertexBuffer(encoded_streams[stream], tangent_data, tangent_number, sizeof(PackedTangent), level);
+				break;
+			}
+		}, options.thread_number);
+		if (!std::all_of(stream_encoded, stream_encoded + 6, [](uint8_t encoded) { return encoded != 0; })) {
+			return false;
+		}
+
+		writer.AddArray(MESH_CACHE_ENCODED_SIZES, encoded_sizes);
+		const uint32_t section_ids[6] = {MESH_CACHE_ENCODED_VERTICES, MESH_CACHE_ENCODED_INDICES, MESH_CACHE_ENCODED_SHORT_INDICES,
+			MESH_CACHE_ENCODED_POSITIONS, MESH_CACHE_ENCODED_POSITION_INDICES, MESH_CACHE_ENCODED_TANGENTS};
+		const size_t raw_size = vertex_number * vertex_stride + index_number * sizeof(unsigned int) + short_index_number * sizeof(uint16_t) +
+			position_number * position_stride + position_index_number * sizeof(unsigned int) + tangent_number * sizeof(PackedTangent);
+		size_t encoded_size = 0;
+		for (size_t stream = 0; stream < 6; stream++) {
+			writer.AddArray(section_ids[stream], encoded_streams[stream]);
+			encoded_size += encoded_streams[stream].size();
+		}
+
+		duration<double> encode_time = duration_cast<duration<double>>(high_resolution_clock::now() - encode_start);
+		std::wstring encode_message = L"Cooked mesh streams compressed from " + std::to_wstring(raw_size) + L" to " +
+			std::to_wstring(encoded_size) + L" bytes in " + std::to_wstring(encode_time.count() * 1000.0) + L" ms\n";
+		OutputDebugString(encode_message.c_str());
+	} else {
+		// Streams go through the data pointers, which streaming conversion points at its spill files
+		writer.AddSection(options.pack_vertices ? MESH_CACHE_PACKED_VERTICES : MESH_CACHE_VERTICES, vertex_data, vertex_number * vertex_stride);
+		writer.AddSection(MESH_CACHE_INDICES, index_data, index_number * sizeof(unsigned int));
+		writer.AddSection(MESH_CACHE_SHORT_INDICES, short_index_data, short_index_number * sizeof(uint16_t));
+		writer.AddSection(MESH_CACHE_TANGENTS, tangent_data, tangent_number * sizeof(PackedTangent));
+		writer.AddSection(MESH_CACHE_POSITIONS, position_data, position_number * position_stride);
+		writer.AddSection(MESH_CACHE_POSITION_INDICES, position_index_data, position_index_number * sizeof(unsigned int));
+	}
+	writer.AddArray(MESH_CACHE_POSITION_INDEX_OFFSETS, position_index_offsets);
+	writer.AddArray(MESH_CACHE_DRAW_CALLS, draw_call_params);
+	writer.AddArray(MESH_CACHE_MESH_BUFFERS, mesh_buffers);
+	writer.AddArray(MESH_CACHE_DRAW_BOUNDS, draw_bounds);
+	writer.AddArray(MESH_CACHE_DRAW_LODS, draw_lods);
+	writer.AddArray(MESH_CACHE_DRAW_LOD_OFFSETS, draw_lod_offsets);
+	writer.AddSection(MESH_CACHE_MESHLETS, meshlet_data, meshlet_number * sizeof(Meshlet));
+	writer.AddSection(MESH_CACHE_MESHLET_BOUNDS, meshlet_bounds_data, meshlet_number * sizeof(MeshletBounds));
+	writer.AddSection(MESH_CACHE_MESHLET_VERTICES, meshlet_vertex_data, meshlet_vertex_number * sizeof(unsigned int));
+	writer.AddSection(MESH_CACHE_MESHLET_TRIANGLES, meshlet_triangle_data, meshlet_triangle_number * 3);
+	writer.AddArray(MESH_CACHE_MESHLET_OFFSETS, meshlet_offsets);
+	writer.AddArray(MESH_CACHE_MATERIALS, materials_data);
+	writer.AddArray(MESH_CACHE_MATERIAL_LIBRARIES, libraries_data);
+	return writer.Write(cache_file, source_stamp, GetCacheLayoutStamp());
+}
+
+static uint64_t MixStamp(uint64_t stamp, uint64_t value) {
+	return (stamp ^ (value + 0x9E3779B97F4A7C15ull + (stamp << 6) + (stamp >> 2))) * 0xC2B2AE3D27D4EB4Full;
+}
+
+static uint64_t GetFloatBits(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+uint64_t ModelLoader::GetOptionsStamp() const {
+	// Options which change the loader output, together with the version of the passes themselves
+	uint64_t stamp = loader_output_version;
+	stamp = MixStamp(stamp, options.generate_normals);
+	stamp = MixStamp(stamp, options.generate_normals ? GetFloatBits(options.normal_crease_angle) : 0);
+	stamp = MixStamp(stamp, options.generate_normals && options.area_weighted_normals);
+	stamp = MixStamp(stamp, GetFloatBits(options.weld_tolerance));
+	stamp = MixStamp(stamp, options.weld_tolerance > 0.0f ? GetFloatBits(options.weld_attribute_tolerance) : 0);
+	stamp = MixStamp(stamp, options.remove_degenerate_triangles);
+	stamp = MixStamp(stamp, options.chunk_triangle_number);
+	stamp = MixStamp(stamp, options.chunk_triangle_number ? GetFloatBits(options.chunk_extent_ratio) : 0);
+	stamp = MixStamp(stamp, options.optimize_overdraw ? GetFloatBits(options.overdraw_threshold) : 0);
+	stamp = MixStamp(stamp, options.pack_vertices);
+	stamp = MixStamp(stamp, options.short_indices);
+	stamp = MixStamp(stamp, options.short_indices && options.split_large_draw_calls);
+	stamp = MixStamp(stamp, GetBufferSizeLimit(options));
+	stamp = MixStamp(stamp, options.position_stream);
+	stamp = MixStamp(stamp, options.generate_tangents);
+	stamp = MixStamp(stamp, options.compress_cache);
+	stamp = MixStamp(stamp, options.compress_cache && options.entropy_code_cache);
+	stamp = MixStamp(stamp, options.build_meshlets);
+	stamp = MixStamp(stamp, options.lod_level_number);
+	stamp = MixStamp(stamp, options.lod_level_number ? GetFloatBits(options.lod_triangle_ratio) : 0);
+	stamp = MixStamp(stamp, options.streaming_memory_budget);
+	return stamp;
+}
+
+uint32_t ModelLoader::GetCacheLayoutStamp() {
+	// Changes whenever a structure stored in the cache changes its size
+	const uint32_t stamp = static_cast<uint32_t>((sizeof(FullVertex) << 24) | (sizeof(PackedVertex) << 16) | (sizeof(DrawBounds) << 8) | sizeof(DrawCallParams));
+	return stamp ^ static_cast<uint32_t>((sizeof(Meshlet) << 20) | (sizeof(MeshletBounds) << 12) | (sizeof(DrawLod) << 4) | sizeof(PackedTangent)) ^
+		static_cast<uint32_t>(sizeof(MeshBuffer) << 24);
+}
+
 std::string ModelLoader::GetBinPath(std::string shader_file) {
+#ifdef _WIN32
 	CHAR buffer[MAX_PATH];
 	GetModuleFileNameA(NULL, buffer, MAX_PATH);
 	std::string module_path = buffer;
+#else
+	// Without procfs the path stays relative to the working directory
+	std::error_code error;
+	std::string module_path = std::filesystem::read_symlink("/proc/self/exe", error).string();
+#endif
 	std::string::size_type pos = module_path.find_last_of("\\/");
 	return module_path.substr(0, pos + 1) + shader_file;
 }
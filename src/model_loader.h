@@ -1,12 +1,140 @@
 #pragma once
 
-#include "dx12_labs.h"
+#include "vertex_formats.h"
+#include "frustum_culling.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "meshlet_builder.h"
+#include "vertex_packing.h"
 #include "tiny_obj_loader.h"
 
+class SpillFile;
+struct StreamingStreams;
+
+// start_index and start_vertex are relative to the slices of the MeshBuffer buffer_id
 struct DrawCallParams {
 	unsigned int index_num;
 	unsigned int start_index;
 	unsigned int start_vertex;
+	unsigned int vertex_num;
+	unsigned int material_id;
+	// 2 when start_index points into the 16-bit index buffer, 4 for the 32-bit one
+	unsigned int index_size;
+	unsigned int buffer_id;
+};
+
+// Slices of the streams which go to one set of GPU buffers. Streams are split
+// between buffers so every slice stays below LoaderOptions::max_buffer_size and
+// the 32-bit sizes and offsets of the graphics API; draw calls and their levels
+// of detail address the slices of their own buffer. Buffers follow each other in
+// draw call order and together cover every stream.
+struct MeshBuffer {
+	// Vertices, and tangents parallel to them
+	uint64_t start_vertex;
+	uint64_t vertex_num;
+	uint64_t start_index;
+	uint64_t index_num;
+	uint64_t start_short_index;
+	uint64_t short_index_num;
+	uint64_t start_position;
+	uint64_t position_num;
+	uint64_t start_position_index;
+	uint64_t position_index_num;
+	unsigned int start_draw_call;
+	unsigned int draw_call_num;
+};
+
+// One level of detail of a draw call. Level 0 is the draw call itself; start_index
+// points into the same index buffer slice as DrawCallParams::start_index.
+struct DrawLod {
+	unsigned int start_index;
+	unsigned int index_num;
+	// Indices of the level in the position index slice of the buffer
+	unsigned int position_start_index;
+	// Largest distance between the level and the full surface, in model units
+	float error;
+};
+
+struct LoaderOptions {
+	// Generate smooth normals for faces without them, honoring smoothing groups
+	bool generate_normals = true;
+	// Faces meeting at a sharper angle in degrees keep a hard edge between them
+	float normal_crease_angle = 60.0f;
+	// Weight face normals by face area instead of the corner angle
+	bool area_weighted_normals = false;
+	// Weld vertices closer than this in model units whose normals and texcoords match (0 welds only identical OBJ indices)
+	float weld_tolerance = 0.0f;
+	// Largest difference of a normal or texcoord component between welded vertices
+	float weld_attribute_tolerance = 1e-3f;
+	// Drop triangles with zero area and repeats of the same triangle
+	bool remove_degenerate_triangles = true;
+	// Split every material into spatially compact draw calls of up to this many triangles (0 keeps one per material)
+	unsigned int chunk_triangle_number = 4096;
+	// Largest chunk box diagonal as a fraction of the whole mesh diagonal (0 for no limit)
+	float chunk_extent_ratio = 0.125f;
+	// Reorder triangle clusters of every draw call to reduce overdraw
+	bool optimize_overdraw = false;
+	// Vertex cache efficiency (ACMR ratio) the overdraw pass may give up
+	float overdraw_threshold = 1.05f;
+	// Measure overdraw before and after the optimization even when the overdraw pass is off
+	bool analyze_overdraw = false;
+	// Hand out PackedVertex instead of FullVertex
+	bool pack_vertices = false;
+	// Store indices of draw calls with up to 65536 vertices as 16 bits
+	bool short_indices = true;
+	// Split larger draw calls so every one of them gets 16-bit indices
+	bool split_large_draw_calls = true;
+	// Largest GPU buffer of a stream in bytes, capped at the 4 GB of a buffer view. Streams are
+	// split between buffers at draw call boundaries and draw calls which do not fit are split.
+	uint64_t max_buffer_size = 1ull << 30;
+	// Build a deduplicated position only stream for depth only passes
+	bool position_stream = true;
+	// Build a PackedTangent stream parallel to the vertex buffer for normal mapping
+	bool generate_tangents = false;
+	// Split every draw call into meshlets with bounding spheres and normal cones for cluster culling
+	bool build_meshlets = false;
+	// Store the vertex, index, position and tangent streams of the cooked mesh compressed,
+	// loads decode them instead of serving them from the mapping
+	bool compress_cache = false;
+	// Entropy code the compressed vertex streams too: a smaller cooked mesh which decodes a few times slower
+	bool entropy_code_cache = false;
+	// Simplified levels of detail generated on top of every draw call (0 for none)
+	unsigned int lod_level_number = 0;
+	// Triangle number of every level relative to the previous one
+	float lod_triangle_ratio = 0.5f;
+	// Convert the OBJ out of core with about this many bytes of memory and serve the cooked mesh from
+	// its mapping (0 loads everything in memory). Materials are deduplicated with external sorts and
+	// processed in batches with their own buffers, which welding does not cross; normals are not
+	// generated and compress_cache still encodes and decodes the streams in memory.
+	uint64_t streaming_memory_budget = 0;
+	// Threads of the OBJ parser and the parallel passes (0 uses all hardware threads)
+	unsigned int thread_number = 0;
+};
+
+// Timings of the last LoadModel call in seconds, phases which did not run stay 0
+struct LoaderStatistics {
+	bool cache_hit;
+	size_t source_size;
+	double cache_time;
+	double parse_time;
+	// Generating missing normals
+	double normal_time;
+	// Grouping faces by material and welding their index tuples
+	double dedup_time;
+	// Writing vertices and draw calls
+	double assembly_time;
+	// Removed by welding and triangle cleanup, per material in the debug output
+	size_t welded_vertex_number;
+	size_t removed_triangle_number;
+	// Everything between assembly and the cooked mesh write
+	double processing_time;
+	// Vertex cache ACMR of all draw calls before and after the optimization, and the
+	// overdraw of the whole mesh with optimize_overdraw or analyze_overdraw
+	double acmr_before;
+	double acmr_after;
+	double overdraw_before;
+	double overdraw_after;
+	double total_time;
 };
 
 class ModelLoader {
@@ -14,30 +142,163 @@ public:
 	ModelLoader() = default;
 	~ModelLoader() = default;
 
+	void SetOptions(const LoaderOptions &loader_options);
 	HRESULT LoadModel(std::string path);
+	const LoaderStatistics GetStatistics() const;
 
-	const FullVertex *GetVertexBuffer() const;
-	const unsigned int GetVertexBufferSize() const;
-	const unsigned int GetVertexNumber() const;
+	// Whole streams, GetBuffer tells which slices of them go to which GPU buffer
+	// FullVertex or PackedVertex array, see HasPackedVertices
+	const void *GetVertexBuffer() const;
+	const uint64_t GetVertexBufferSize() const;
+	const unsigned int GetVertexStride() const;
+	const size_t GetVertexNumber() const;
+	const bool HasPackedVertices() const;
+	const VertexQuantization GetVertexQuantization() const;
 
 	const unsigned int *GetIndexBuffer() const;
-	const unsigned int GetIndexBufferSize() const;
-	const unsigned int GetIndexNumber() const;
+	const uint64_t GetIndexBufferSize() const;
+	const size_t GetIndexNumber() const;
+
+	const uint16_t *GetShortIndexBuffer() const;
+	const uint64_t GetShortIndexBufferSize() const;
+	const size_t GetShortIndexNumber() const;
+
+	// Positions in the format of the vertex buffer (XMFLOAT3 or the unorm16 of PackedVertex)
+	const void *GetPositionBuffer() const;
+	const uint64_t GetPositionBufferSize() const;
+	const unsigned int GetPositionStride() const;
+	// 32-bit indices into the position slice of their buffer
+	const unsigned int *GetPositionIndexBuffer() const;
+	const uint64_t GetPositionIndexBufferSize() const;
+	// Full detail position indices of the first draw_call_number draw calls, levels of detail are not counted
+	const uint64_t GetPositionIndexNumber(unsigned int draw_call_number) const;
+
+	// PackedTangent per vertex, empty unless generate_tangents is set
+	const PackedTangent *GetTangentBuffer() const;
+	const uint64_t GetTangentBufferSize() const;
+
+	// At least 1, indexed by DrawCallParams::buffer_id
+	const unsigned int GetBufferNumber() const;
+	const MeshBuffer GetBuffer(unsigned int buffer_id) const;
 
 	const unsigned int GetMaterialNumber() const;
-	const DrawCallParams GetDrawCallParams(unsigned int material_id) const;
+	// Indexed by DrawCallParams::material_id in the shaders
+	const std::vector<MaterialConstants> GetMaterialConstants() const;
+	const unsigned int GetDrawCallNumber() const;
+	const DrawCallParams GetDrawCallParams(unsigned int draw_call_id) const;
+	// Bounds of every draw call, GetDrawCallNumber long
+	const DrawBounds *GetDrawBounds() const;
+	// At least 1, levels get coarser and their error grows with the level
+	const unsigned int GetDrawLodNumber(unsigned int draw_call_id) const;
+	const DrawLod GetDrawLod(unsigned int draw_call_id, unsigned int level) const;
+
+	// Meshlets of all draw calls in draw call order, MeshletBounds is parallel to Meshlet
+	const unsigned int GetMeshletNumber() const;
+	const Meshlet *GetMeshlets() const;
+	const MeshletBounds *GetMeshletBounds() const;
+	// Meshlet vertices index the whole vertex stream rather than the slice of a buffer
+	const unsigned int *GetMeshletVertices() const;
+	const unsigned int GetMeshletVertexNumber() const;
+	// Three 8-bit indices into the meshlet vertices per triangle
+	const uint8_t *GetMeshletTriangles() const;
+	const unsigned int GetMeshletTriangleNumber() const;
+	// Meshlets covering the first draw_call_number draw calls
+	const unsigned int GetMeshletOffset(unsigned int draw_call_number) const;
 	const std::string GetTexturePath(unsigned int material_id) const;
 	const bool HasTexture(unsigned int material_id) const;
 	const unsigned int GetTextureNumber() const;
 
 protected:
+	LoaderOptions options;
+	LoaderStatistics statistics = {};
 	std::string obj_path;
 
 	std::vector<FullVertex> vertices;
+	std::vector<PackedVertex> packed_vertices;
+	VertexQuantization vertex_quantization = {};
 	std::vector<unsigned int> indices;
+	std::vector<uint16_t> short_indices;
+	std::vector<PackedTangent> tangents;
+	std::vector<char> positions;
+	std::vector<unsigned int> position_indices;
+	std::vector<uint64_t> position_index_offsets;
 	std::vector<tinyobj::material_t> materials;
+	// mtllib files the materials came from, relative to obj_path
+	std::vector<std::string> material_libraries;
+
+	std::vector<DrawCallParams> draw_call_params;
+	std::vector<MeshBuffer> mesh_buffers;
+	std::vector<DrawBounds> draw_bounds;
+	std::vector<DrawLod> draw_lods;
+	std::vector<unsigned int> draw_lod_offsets;
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshletBounds> meshlet_bounds;
+	std::vector<unsigned int> meshlet_vertices;
+	std::vector<uint8_t> meshlet_triangles;
+	std::vector<unsigned int> meshlet_offsets;
+
+	// Point either to the vectors above or into the mapped cooked mesh
+	const void *vertex_data = nullptr;
+	size_t vertex_number = 0;
+	size_t vertex_stride = sizeof(FullVertex);
+	const unsigned int *index_data = nullptr;
+	size_t index_number = 0;
+	const uint16_t *short_index_data = nullptr;
+	size_t short_index_number = 0;
+	const PackedTangent *tangent_data = nullptr;
+	size_t tangent_number = 0;
+	const void *position_data = nullptr;
+	size_t position_number = 0;
+	size_t position_stride = sizeof(XMFLOAT3);
+	const unsigned int *position_index_data = nullptr;
+	size_t position_index_number = 0;
+	const uint64_t *position_index_offset_data = nullptr;
+	size_t position_index_offset_number = 0;
+	const Meshlet *meshlet_data = nullptr;
+	const MeshletBounds *meshlet_bounds_data = nullptr;
+	size_t meshlet_number = 0;
+	const unsigned int *meshlet_vertex_data = nullptr;
+	size_t meshlet_vertex_number = 0;
+	const uint8_t *meshlet_triangle_data = nullptr;
+	size_t meshlet_triangle_number = 0;
+	const unsigned int *meshlet_offset_data = nullptr;
+	size_t meshlet_offset_number = 0;
+	MeshCacheReader mesh_cache;
+
+	// Every pass from cleanup to the position stream on the mesh in memory. The bounds and quantization
+	// are the ones of the whole mesh, which streaming conversion only holds a batch of at a time.
+	void ProcessMesh(const DrawBounds &mesh_bounds, const VertexQuantization &mesh_quantization);
+	void CleanMesh();
+	void ChunkDrawCalls(const DrawBounds &mesh_bounds);
+	void OptimizeMesh();
+	void PackMesh();
+	void BuildTangents();
+	void SplitDrawCalls(size_t max_vertex_number, size_t max_index_number);
+	void BuildShortIndices();
+	void BuildMeshBuffers();
+	void BuildPositionStream();
+	void BuildDrawBounds();
+	void BuildDrawMeshlets();
+	void BuildDrawLods();
+	void AnalyzeMeshletCulling() const;
+	OverdrawStatistics AnalyzeMeshOverdraw() const;
+
+	HRESULT LoadModelStreaming(const std::string &obj_file, const std::string &cache_file, uint64_t source_stamp);
+	// Deduplicates every material out of core into FullVertex and material relative index spill files
+	bool SpillObj(const std::string &obj_file, const std::string &spill_path, SpillFile &vertex_file, SpillFile &index_file,
+		std::vector<uint64_t> &material_vertex_offsets, std::vector<uint64_t> &material_index_offsets);
+	// PackedTangent of every whole material into a spill file parallel to the mesh vertices
+	bool SpillTangents(const FullVertex *mesh_vertices, const unsigned int *mesh_indices, const std::vector<uint64_t> &material_vertex_offsets,
+		const std::vector<uint64_t> &material_index_offsets, const std::string &spill_path, SpillFile &tangent_file);
+	// Runs ProcessMesh batch by batch and leaves the streams and tables pointing at the output
+	bool CookSpilledMesh(const FullVertex *mesh_vertices, const unsigned int *mesh_indices, const std::vector<uint64_t> &material_vertex_offsets,
+		const std::vector<uint64_t> &material_index_offsets, const std::string &spill_path, StreamingStreams &streams);
 
-	std::vector<DrawCallParams> per_material_draw_call_params;
+	bool LoadCache(const std::string &cache_file, uint64_t source_stamp);
+	bool DecodeCacheStreams();
+	bool SaveCache(const std::string &cache_file, uint64_t source_stamp) const;
+	static uint32_t GetCacheLayoutStamp();
+	uint64_t GetOptionsStamp() const;
 
 	std::string GetBinPath(std::string shader_file);
 };
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "normal_generator.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Faces and positions per parallel task
+static const size_t normal_task_size = 16384;
+
+struct NormalVector {
+	float x;
+	float y;
+	float z;
+};
+
+static inline NormalVector operator-(const NormalVector &a, const NormalVector &b) {
+	return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+static inline float Dot(const NormalVector &a, const NormalVector &b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline NormalVector Normalize(const NormalVector &a) {
+	const float length = std::sqrt(Dot(a, a));
+	return (length > 0.0f) ? NormalVector{a.x / length, a.y / length, a.z / length} : a;
+}
+
+static inline NormalVector GetAttribPosition(const tinyobj::attrib_t &attrib, int vertex_index) {
+	const tinyobj::real_t *position = &attrib.vertices[3 * static_cast<size_t>(vertex_index)];
+	return {position[0], position[1], position[2]};
+}
+
+size_t GenerateNormals(tinyobj::attrib_t &attrib, std::vector<tinyobj::shape_t> &shapes,
+	float crease_angle, bool area_weighted, unsigned int thread_number) {
+	// Global face and corner numbering over all shapes
+	size_t face_number = 0;
+	size_t corner_number = 0;
+	bool has_missing_normals = false;
+	bool has_smoothing_groups = false;
+	for (const tinyobj::shape_t &shape : shapes) {
+		face_number += shape.mesh.num_face_vertices.size();
+		corner_number += shape.mesh.indices.size();
+		for (const tinyobj::index_t &corner : shape.mesh.indices) {
+			has_missing_normals = has_missing_normals || corner.normal_index < 0;
+		}
+		for (unsigned int smoothing_group : shape.mesh.smoothing_group_ids) {
+			has_smoothing_groups = has_smoothing_groups || smoothing_group != 0;
+		}
+	}
+	if (!has_missing_normals) {
+		return 0;
+	}
+
+	std::vector<tinyobj::index_t *> corner_keys(corner_number);
+	std::vector<size_t> face_corner_offsets(face_number + 1, 0);
+	std::vector<unsigned int> face_smoothing_groups(face_number, 0);
+	{
+		size_t face = 0;
+		size_t corner = 0;
+		for (tinyobj::shape_t &shape : shapes) {
+			const bool has_groups = shape.mesh.smoothing_group_ids.size() == shape.mesh.num_face_vertices.size();
+			size_t index_offset = 0;
+			for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++, face++) {
+				face_smoothing_groups[face] = has_groups ? shape.mesh.smoothing_group_ids[f] : 0;
+				for (unsigned int v = 0; v < shape.mesh.num_face_vertices[f]; v++) {
+					corner_keys[corner++] = &shape.mesh.indices[index_offset++];
+				}
+				face_corner_offsets[face + 1] = corner;
+			}
+		}
+	}
+
+	// Unit face normals by Newell's method and the weight every corner gives its face
+	std::vector<NormalVector> face_normals(face_number);
+	std::vector<float> corner_weights(corner_number);
+	std::vector<unsigned int> corner_faces(corner_number);
+	ParallelFor((face_number + normal_task_size - 1) / normal_task_size, [&](size_t task) {
+		const size_t face_end = std::min(face_number, (task + 1) * normal_task_size);
+		for (size_t face = task * normal_task_size; face < face_end; face++) {
+			const size_t corner_begin = face_corner_offsets[face];
+			const size_t face_corner_number = face_corner_offsets[face + 1] - corner_begin;
+			NormalVector normal = {0.0f, 0.0f, 0.0f};
+			for (size_t v = 0; v < face_corner_number; v++) {
+				const NormalVector a = GetAttribPosition(attrib, corner_keys[corner_begin + v]->vertex_index);
+				const NormalVector b = GetAttribPosition(attrib, corner_keys[corner_begin + (v + 1) % face_corner_number]->vertex_index);
+				normal.x += (a.y - b.y) * (a.z + b.z);
+				normal.y += (a.z - b.z) * (a.x + b.x);
+				normal.z += (a.x - b.x) * (a.y + b.y);
+			}
+			const float area = 0.5f * std::sqrt(Dot(normal, normal));
+			face_normals[face] = Normalize(normal);
+
+			for (size_t v = 0; v < face_corner_number; v++) {
+				const size_t corner = corner_begin + v;
+				corner_faces[corner] = static_cast<unsigned int>(face);
+				if (area_weighted) {
+					corner_weights[corner] = area;
+					continue;
+				}
+				const NormalVector position = GetAttribPosition(attrib, corner_keys[corner]->vertex_index);
+				const NormalVector previous = GetAttribPosition(attrib, corner_keys[corner_begin + (v + face_corner_number - 1) % face_corner_number]->vertex_index);
+				const NormalVector next = GetAttribPosition(attrib, corner_keys[corner_begin + (v + 1) % face_corner_number]->vertex_index);
+				const float cosine = Dot(Normalize(next - position), Normalize(previous - position));
+				corner_weights[corner] = std::acos(std::max(-1.0f, std::min(1.0f, cosine)));
+			}
+		}
+	}, thread_number);
+
+	// Position to corner adjacency: corners are counted per position, the counts
+	// prefix summed and the corners scattered, which keeps them in face order
+	const size_t position_number = attrib.vertices.size() / 3;
+	std::vector<size_t> position_corner_offsets(position_number + 1, 0);
+	for (size_t corner = 0; corner < corner_number; corner++) {
+		position_corner_offsets[corner_keys[corner]->vertex_index + 1]++;
+	}
+	for (size_t position = 0; position < position_number; position++) {
+		position_corner_offsets[position + 1] += position_corner_offsets[position];
+	}
+	std::vector<unsigned int> position_corners(corner_number);
+	{
+		std::vector<size_t> position_cursors(position_corner_offsets.begin(), position_corner_offsets.end() - 1);
+		for (size_t corner = 0; corner < corner_number; corner++) {
+			position_corners[position_cursors[corner_keys[corner]->vertex_index]++] = static_cast<unsigned int>(corner);
+		}
+	}
+
+	// Every corner without a normal sums the faces around its position it is smooth with.
+	// Equal normals of a position are numbered once, so their corners can share a vertex later.
+	const float crease_cosine = std::cos(crease_angle * 3.14159265f / 180.0f);
+	const size_t position_task_number = (position_number + normal_task_size - 1) / normal_task_size;
+	std::vector<NormalVector> corner_normals(corner_number);
+	std::vector<unsigned int> corner_ranks(corner_number);
+	std::vector<size_t> position_normal_offsets(position_number + 1, 0);
+	ParallelFor(position_task_number, [&](size_t task) {
+		const size_t position_end = std::min(position_number, (task + 1) * normal_task_size);
+		for (size_t position = task * normal_task_size; position < position_end; position++) {
+			const unsigned int *corners = position_corners.data() + position_corner_offsets[position];
+			const size_t position_corner_number = position_corner_offsets[position + 1] - position_corner_offsets[position];
+			unsigned int normal_number = 0;
+			for (size_t i = 0; i < position_corner_number; i++) {
+				const unsigned int corner = corners[i];
+				if (corner_keys[corner]->normal_index >= 0) {
+					continue;
+				}
+
+				const unsigned int face = corner_faces[corner];
+				const unsigned int smoothing_group = face_smoothing_groups[face];
+				NormalVector normal = face_normals[face];
+				if (smoothing_group != 0 || !has_smoothing_groups) {
+					normal = {0.0f, 0.0f, 0.0f};
+					for (size_t j = 0; j < position_corner_number; j++) {
+						const unsigned int other_face = corner_faces[corners[j]];
+						if (face_smoothing_groups[other_face] != smoothing_group ||
+							Dot(face_normals[face], face_normals[other_face]) < crease_cosine) {
+							continue;
+						}
+						const float weight = corner_weights[corners[j]];
+						normal.x += weight * face_normals[other_face].x;
+						normal.y += weight * face_normals[other_face].y;
+						normal.z += weight * face_normals[other_face].z;
+					}
+					normal = Normalize(normal);
+				}
+
+				unsigned int rank = normal_number;
+				for (size_t j = 0; j < i; j++) {
+					const unsigned int other_corner = corners[j];
+					if (corner_keys[other_corner]->normal_index < 0 &&
+						memcmp(&corner_normals[other_corner], &normal, sizeof(NormalVector)) == 0) {
+						rank = corner_ranks[other_corner];
+						break;
+					}
+				}
+				if (rank == normal_number) {
+					normal_number++;
+				}
+				corner_normals[corner] = normal;
+				corner_ranks[corner] = rank;
+			}
+			position_normal_offsets[position + 1] = normal_number;
+		}
+	}, thread_number);
+
+	for (size_t position = 0; position < position_number; position++) {
+		position_normal_offsets[position + 1] += position_normal_offsets[position];
+	}
+	const size_t generated_normal_number = position_normal_offsets[position_number];
+	const size_t normal_base = attrib.normals.size() / 3;
+	attrib.normals.resize(3 * (normal_base + generated_normal_number));
+
+	// Corners of a position belong to one task, so their writes never race
+	ParallelFor(position_task_number, [&](size_t task) {
+		const size_t position_end = std::min(position_number, (task + 1) * normal_task_size);
+		for (size_t position = task * normal_task_size; position < position_end; position++) {
+			for (size_t i = position_corner_offsets[position]; i < position_corner_offsets[position + 1]; i++) {
+				const unsigned int corner = position_corners[i];
+				tinyobj::index_t &key = *corner_keys[corner];
+				if (key.normal_index >= 0) {
+					continue;
+				}
+				const size_t normal_index = normal_base + position_normal_offsets[position] + corner_ranks[corner];
+				attrib.normals[3 * normal_index + 0] = corner_normals[corner].x;
+				attrib.normals[3 * normal_index + 1] = corner_normals[corner].y;
+				attrib.normals[3 * normal_index + 2] = corner_normals[corner].z;
+				key.normal_index = static_cast<int>(normal_index);
+			}
+		}
+	}, thread_number);
+	return generated_normal_number;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "tiny_obj_loader.h"
+
+#include <cstddef>
+#include <vector>
+
+// Generates a normal for every face corner without one, averaging the normals
+// of the faces around its position weighted by the corner angle (or the face
+// area when area_weighted is set). Only faces of the same smoothing group whose
+// normals are within crease_angle degrees of the corner's face take part;
+// smoothing group 0 ("s off") is flat unless the file has no smoothing groups
+// at all, then the crease angle alone decides. Corners of a position which end
+// up with the same normal share it. New normals are appended to attrib.normals
+// and the corners get their normal_index. Positions are processed in parallel
+// over a position to corner adjacency built by counting sort, on thread_number
+// threads (all hardware threads when 0). Returns the number of generated normals.
+size_t GenerateNormals(tinyobj::attrib_t &attrib, std::vector<tinyobj::shape_t> &shapes,
+	float crease_angle, bool area_weighted, unsigned int thread_number = 0);
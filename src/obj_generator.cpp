@@ -0,0 +1,198 @@
+#include "obj_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Lines are formatted into a buffer which is flushed in large writes
+class ObjWriter {
+public:
+	explicit ObjWriter(FILE *file) : file(file) {
+		buffer.reserve(buffer_size + 256);
+	}
+
+	~ObjWriter() {
+		Flush();
+	}
+
+	void Printf(const char *format, ...) {
+		char line[256];
+		va_list arguments;
+		va_start(arguments, format);
+		const int length = vsnprintf(line, sizeof(line), format, arguments);
+		va_end(arguments);
+		if (length > 0) {
+			buffer.append(line, std::min<size_t>(length, sizeof(line) - 1));
+		}
+		if (buffer.size() >= buffer_size) {
+			Flush();
+		}
+	}
+
+	bool Flush() {
+		const bool written = buffer.empty() || fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+		failed = failed || !written;
+		buffer.clear();
+		return !failed;
+	}
+
+protected:
+	static const size_t buffer_size = 1 << 20;
+	FILE *file;
+	std::string buffer;
+	bool failed = false;
+};
+
+static std::string GetMtlName(const std::string &obj_file) {
+	const std::string::size_type slash = obj_file.find_last_of("\\/");
+	const std::string file_name = (slash == std::string::npos) ? obj_file : obj_file.substr(slash + 1);
+	const std::string::size_type dot = file_name.find_last_of('.');
+	return ((dot == std::string::npos) ? file_name : file_name.substr(0, dot)) + ".mtl";
+}
+
+static bool GenerateMtl(const std::string &mtl_file, const ObjGeneratorOptions &options) {
+	FILE *file = fopen(mtl_file.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+
+	std::mt19937 random(options.seed);
+	std::uniform_real_distribution<float> color(0.1f, 0.9f);
+	bool written;
+	{
+		ObjWriter writer(file);
+		for (unsigned int material_id = 0; material_id < options.material_number; material_id++) {
+			writer.Printf("newmtl material_%u\nKd %.3f %.3f %.3f\n\n", material_id, color(random), color(random), color(random));
+		}
+		written = writer.Flush();
+	}
+	return fclose(file) == 0 && written;
+}
+
+bool GenerateObj(const std::string &obj_file, const ObjGeneratorOptions &options) {
+	const std::string mtl_name = GetMtlName(obj_file);
+	const std::string::size_type slash = obj_file.find_last_of("\\/");
+	const std::string directory = (slash == std::string::npos) ? std::string() : obj_file.substr(0, slash + 1);
+	const unsigned int material_number = std::max(options.material_number, 1u);
+	if (!GenerateMtl(directory + mtl_name, options)) {
+		return false;
+	}
+
+	FILE *file = fopen(obj_file.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+
+	// A columns x rows grid of quads, two triangles each
+	const size_t quad_number = std::max<size_t>(options.triangle_number / 2, 1);
+	const size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(quad_number))));
+	const size_t rows = (quad_number + columns - 1) / columns;
+	const size_t grid_vertex_number = (columns + 1) * (rows + 1);
+
+	std::mt19937 random(options.seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	bool written;
+	{
+		ObjWriter writer(file);
+		writer.Printf("# Generated: %zu triangles, %u materials, sharing %.3f\nmtllib %s\n", std::max<size_t>(options.triangle_number, 1),
+			material_number, options.attribute_sharing, mtl_name.c_str());
+
+		// Shared attributes, one of each per grid vertex
+		for (size_t y = 0; y <= rows; y++) {
+			for (size_t x = 0; x <= columns; x++) {
+				const float u = static_cast<float>(x) / columns;
+				const float v = static_cast<float>(y) / rows;
+				writer.Printf("v %.6f %.6f %.6f\n", u * 10.0f, 0.25f * std::sin(u * 31.0f) * std::cos(v * 23.0f), v * 10.0f);
+			}
+		}
+		for (size_t y = 0; y <= rows; y++) {
+			for (size_t x = 0; x <= columns; x++) {
+				writer.Printf("vt %.6f %.6f\n", static_cast<float>(x) / columns, static_cast<float>(y) / rows);
+			}
+		}
+		for (size_t y = 0; y <= rows && options.normals; y++) {
+			for (size_t x = 0; x <= columns; x++) {
+				const float u = static_cast<float>(x) / columns;
+				const float v = static_cast<float>(y) / rows;
+				const float dx = -0.25f * 31.0f / 10.0f * std::cos(u * 31.0f) * std::cos(v * 23.0f);
+				const float dz = 0.25f * 23.0f / 10.0f * std::sin(u * 31.0f) * std::sin(v * 23.0f);
+				const float length = std::sqrt(dx * dx + 1.0f + dz * dz);
+				writer.Printf("vn %.6f %.6f %.6f\n", dx / length, 1.0f / length, dz / length);
+			}
+		}
+
+		// Running attribute counts, unique attributes are written right before their face
+		size_t texcoord_number = grid_vertex_number;
+		size_t normal_number = grid_vertex_number;
+		unsigned int current_material = material_number;
+		size_t triangles_left = std::max<size_t>(options.triangle_number, 1);
+
+		for (size_t y = 0; y < rows && triangles_left > 0; y++) {
+			const unsigned int material_id = static_cast<unsigned int>(y * material_number / rows);
+			if (material_id != current_material) {
+				writer.Printf("usemtl material_%u\n", material_id);
+				if (!options.normals) {
+					writer.Printf("s %u\n", material_id + 1);
+				}
+				current_material = material_id;
+			}
+
+			for (size_t x = 0; x < columns && triangles_left > 0; x++) {
+				const size_t quad[4] = {y * (columns + 1) + x, y * (columns + 1) + x + 1,
+					(y + 1) * (columns + 1) + x + 1, (y + 1) * (columns + 1) + x};
+				const int triangles[2][3] = {{0, 1, 2}, {0, 2, 3}};
+
+				for (int t = 0; t < 2 && triangles_left > 0; t++, triangles_left--) {
+					size_t texcoords[3];
+					size_t normals[3];
+					for (int corner = 0; corner < 3; corner++) {
+						const size_t vertex = quad[triangles[t][corner]];
+						texcoords[corner] = vertex;
+						normals[corner] = vertex;
+						if (unit(random) >= options.attribute_sharing) {
+							writer.Printf(options.normals ? "vt %.6f %.6f\nvn 0 1 0\n" : "vt %.6f %.6f\n", unit(random), unit(random));
+							texcoords[corner] = texcoord_number++;
+							normals[corner] = normal_number++;
+						}
+					}
+
+					if (!options.normals && options.negative_indices) {
+						writer.Printf("f %lld/%lld %lld/%lld %lld/%lld\n",
+							static_cast<long long>(quad[triangles[t][0]]) - static_cast<long long>(grid_vertex_number),
+							static_cast<long long>(texcoords[0]) - static_cast<long long>(texcoord_number),
+							static_cast<long long>(quad[triangles[t][1]]) - static_cast<long long>(grid_vertex_number),
+							static_cast<long long>(texcoords[1]) - static_cast<long long>(texcoord_number),
+							static_cast<long long>(quad[triangles[t][2]]) - static_cast<long long>(grid_vertex_number),
+							static_cast<long long>(texcoords[2]) - static_cast<long long>(texcoord_number));
+					} else if (!options.normals) {
+						writer.Printf("f %zu/%zu %zu/%zu %zu/%zu\n",
+							quad[triangles[t][0]] + 1, texcoords[0] + 1,
+							quad[triangles[t][1]] + 1, texcoords[1] + 1,
+							quad[triangles[t][2]] + 1, texcoords[2] + 1);
+					} else if (options.negative_indices) {
+						writer.Printf("f %lld/%lld/%lld %lld/%lld/%lld %lld/%lld/%lld\n",
+							static_cast<long long>(quad[triangles[t][0]]) - static_cast<long long>(grid_vertex_number),
+							static_cast<long long>(texcoords[0]) - static_cast<long long>(texcoord_number),
+							static_cast<long long>(normals[0]) - static_cast<long long>(normal_number),
+							static_cast<long long>(quad[triangles[t][1]]) - static_cast<long long>(grid_vertex_number),
+							static_cast<long long>(texcoords[1]) - static_cast<long long>(texcoord_number),
+							static_cast<long long>(normals[1]) - static_cast<long long>(normal_number),
+							static_cast<long long>(quad[triangles[t][2]]) - static_cast<long long>(grid_vertex_number),
+							static_cast<long long>(texcoords[2]) - static_cast<long long>(texcoord_number),
+							static_cast<long long>(normals[2]) - static_cast<long long>(normal_number));
+					} else {
+						writer.Printf("f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+							quad[triangles[t][0]] + 1, texcoords[0] + 1, normals[0] + 1,
+							quad[triangles[t][1]] + 1, texcoords[1] + 1, normals[1] + 1,
+							quad[triangles[t][2]] + 1, texcoords[2] + 1, normals[2] + 1);
+					}
+				}
+			}
+		}
+		written = writer.Flush();
+	}
+	return fclose(file) == 0 && written;
+}
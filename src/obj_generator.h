@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+struct ObjGeneratorOptions {
+	size_t triangle_number = 1000000;
+	unsigned int material_number = 16;
+	// Fraction of corners which reuse the texcoord and normal of their position;
+	// the rest get their own, like corners along UV seams
+	float attribute_sharing = 0.9f;
+	// Reference attributes relative to the end of the file, as streaming exporters do
+	bool negative_indices = false;
+	// Without normals every material band gets its own smoothing group instead
+	bool normals = true;
+	unsigned int seed = 1;
+};
+
+// Writes a wavy grid of about triangle_number triangles split into horizontal
+// bands of material_number materials, together with an .mtl next to it.
+// Returns false when a file cannot be written.
+bool GenerateObj(const std::string &obj_file, const ObjGeneratorOptions &options);
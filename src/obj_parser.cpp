@@ -0,0 +1,643 @@
+#include "obj_parser.h"
+#include "float_parser.h"
+#include "mapped_file.h"
+#include "parallel_for.h"
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string_view>
+
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Material id of faces which precede the first usemtl of a chunk
+static const int inherited_material = -2;
+// Chunks smaller than this are not worth a thread
+static const size_t min_chunk_size = 1 << 20;
+
+static const unsigned char relative_vertex = 1;
+static const unsigned char relative_normal = 2;
+static const unsigned char relative_texcoord = 4;
+
+struct ObjShapeBreak {
+	size_t face_offset;
+	std::string name;
+};
+
+struct ObjChunk {
+	const char *begin = nullptr;
+	const char *end = nullptr;
+
+	std::vector<tinyobj::real_t> vertices;
+	std::vector<tinyobj::real_t> normals;
+	std::vector<tinyobj::real_t> texcoords;
+
+	// Triangulated faces. Material ids index material_names until stitching
+	std::vector<tinyobj::index_t> corners;
+	std::vector<int> material_ids;
+	std::vector<unsigned int> smoothing_group_ids;
+	// Corners with negative OBJ indices: corner * 3 + component (vertex, normal, texcoord).
+	// They are resolved against this chunk's attribute counts and need the chunk base added.
+	std::vector<size_t> relative_corners;
+
+	int material = inherited_material;
+	bool has_smoothing_group = false;
+	unsigned int smoothing_group = 0;
+	size_t inherited_smoothing_faces = 0;
+
+	std::vector<std::string> material_names;
+	std::vector<std::string> material_libraries;
+	std::vector<ObjShapeBreak> shape_breaks;
+
+	std::string error;
+
+	// Scratch polygon reused by every face line
+	std::vector<tinyobj::index_t> polygon;
+	std::vector<unsigned char> polygon_relative;
+
+	// Filled while stitching
+	size_t vertex_base = 0;
+	size_t normal_base = 0;
+	size_t texcoord_base = 0;
+	size_t face_base = 0;
+	int first_material = -1;
+	unsigned int first_smoothing_group = 0;
+	std::vector<int> global_material_ids;
+};
+
+struct ObjShapeRange {
+	size_t face_begin;
+	size_t face_end;
+	std::string name;
+};
+
+static inline bool IsSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool IsDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+static inline unsigned int FirstBit(unsigned int mask) {
+#ifdef _MSC_VER
+	unsigned long bit;
+	_BitScanForward(&bit, mask);
+	return static_cast<unsigned int>(bit);
+#else
+	return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+// Finds the next '\n' in [p, end) comparing 16 bytes at a time, or returns end
+static const char *FindNewline(const char *p, const char *end) {
+	const __m128i newline = _mm_set1_epi8('\n');
+	for (; end - p >= 16; p += 16) {
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+		if (mask != 0) {
+			return p + FirstBit(mask);
+		}
+	}
+	for (; p < end; p++) {
+		if (*p == '\n') {
+			return p;
+		}
+	}
+	return end;
+}
+
+// Splits the next whitespace separated token off the front of line
+static std::string_view NextToken(std::string_view &line) {
+	size_t begin = 0;
+	while (begin < line.size() && IsSpace(line[begin])) {
+		begin++;
+	}
+	size_t end = begin;
+	while (end < line.size() && !IsSpace(line[end])) {
+		end++;
+	}
+
+	std::string_view token = line.substr(begin, end - begin);
+	line.remove_prefix(end);
+	return token;
+}
+
+static std::string_view Trim(std::string_view line) {
+	while (!line.empty() && IsSpace(line.front())) {
+		line.remove_prefix(1);
+	}
+	while (!line.empty() && IsSpace(line.back())) {
+		line.remove_suffix(1);
+	}
+	return line;
+}
+
+static bool ParseReal(std::string_view &line, tinyobj::real_t &value) {
+	const std::string_view token = NextToken(line);
+	const char *token_end = token.data() + token.size();
+	return !token.empty() && ParseFloat(token.data(), token_end, value) == token_end;
+}
+
+// Parses one OBJ index into a zero based one. Negative indices count back from
+// count, the number of attributes this chunk has seen so far.
+static bool ParseIndex(std::string_view &token, size_t count, int &index, bool &relative) {
+	bool negative = false;
+	if (!token.empty() && token.front() == '-') {
+		negative = true;
+		token.remove_prefix(1);
+	}
+	if (token.empty() || !IsDigit(token.front())) {
+		return false;
+	}
+
+	long long value = 0;
+	while (!token.empty() && IsDigit(token.front())) {
+		value = value * 10 + (token.front() - '0');
+		token.remove_prefix(1);
+		if (value > INT32_MAX) {
+			return false;
+		}
+	}
+	if (value == 0) {
+		return false;
+	}
+
+	relative = negative;
+	index = static_cast<int>(negative ? static_cast<long long>(count) - value : value - 1);
+	return true;
+}
+
+static void AddCorner(ObjChunk &chunk, size_t polygon_corner) {
+	const size_t corner = chunk.corners.size();
+	const unsigned char relative = chunk.polygon_relative[polygon_corner];
+	if (relative & relative_vertex) {
+		chunk.relative_corners.push_back(corner * 3 + 0);
+	}
+	if (relative & relative_normal) {
+		chunk.relative_corners.push_back(corner * 3 + 1);
+	}
+	if (relative & relative_texcoord) {
+		chunk.relative_corners.push_back(corner * 3 + 2);
+	}
+	chunk.corners.push_back(chunk.polygon[polygon_corner]);
+}
+
+static bool ParseFace(ObjChunk &chunk, std::string_view line) {
+	chunk.polygon.clear();
+	chunk.polygon_relative.clear();
+
+	for (std::string_view token = NextToken(line); !token.empty(); token = NextToken(line)) {
+		tinyobj::index_t index = {-1, -1, -1};
+		unsigned char relative = 0;
+		bool is_relative;
+
+		if (!ParseIndex(token, chunk.vertices.size() / 3, index.vertex_index, is_relative)) {
+			return false;
+		}
+		relative |= is_relative ? relative_vertex : 0;
+
+		if (!token.empty() && token.front() == '/') {
+			token.remove_prefix(1);
+			if (!token.empty() && token.front() != '/') {
+				if (!ParseIndex(token, chunk.texcoords.size() / 2, index.texcoord_index, is_relative)) {
+					return false;
+				}
+				relative |= is_relative ? relative_texcoord : 0;
+			}
+			if (!token.empty() && token.front() == '/') {
+				token.remove_prefix(1);
+				if (!ParseIndex(token, chunk.normals.size() / 3, index.normal_index, is_relative)) {
+					return false;
+				}
+				relative |= is_relative ? relative_normal : 0;
+			}
+		}
+
+		if (!token.empty()) {
+			return false;
+		}
+
+		chunk.polygon.push_back(index);
+		chunk.polygon_relative.push_back(relative);
+	}
+
+	// Degenerated faces are skipped like tinyobj does
+	for (size_t v = 1; v + 1 < chunk.polygon.size(); v++) {
+		AddCorner(chunk, 0);
+		AddCorner(chunk, v);
+		AddCorner(chunk, v + 1);
+		chunk.material_ids.push_back(chunk.material);
+		chunk.smoothing_group_ids.push_back(chunk.smoothing_group);
+	}
+
+	return true;
+}
+
+static bool ParseLine(ObjChunk &chunk, std::string_view line) {
+	const std::string_view command = NextToken(line);
+	if (command.empty() || command.front() == '#') {
+		return true;
+	}
+
+	if (command == "v") {
+		tinyobj::real_t x, y, z;
+		if (!ParseReal(line, x) || !ParseReal(line, y) || !ParseReal(line, z)) {
+			return false;
+		}
+		chunk.vertices.push_back(x);
+		chunk.vertices.push_back(y);
+		chunk.vertices.push_back(z);
+	} else if (command == "vn") {
+		tinyobj::real_t x, y, z;
+		if (!ParseReal(line, x) || !ParseReal(line, y) || !ParseReal(line, z)) {
+			return false;
+		}
+		chunk.normals.push_back(x);
+		chunk.normals.push_back(y);
+		chunk.normals.push_back(z);
+	} else if (command == "vt") {
+		tinyobj::real_t u, v = 0.0f;
+		if (!ParseReal(line, u)) {
+			return false;
+		}
+		ParseReal(line, v);
+		chunk.texcoords.push_back(u);
+		chunk.texcoords.push_back(v);
+	} else if (command == "f") {
+		return ParseFace(chunk, line);
+	} else if (command == "usemtl") {
+		const std::string_view name = Trim(line);
+		auto found = std::find(chunk.material_names.begin(), chunk.material_names.end(), name);
+		chunk.material = static_cast<int>(found - chunk.material_names.begin());
+		if (found == chunk.material_names.end()) {
+			chunk.material_names.push_back(std::string(name));
+		}
+	} else if (command == "mtllib") {
+		for (std::string_view name = NextToken(line); !name.empty(); name = NextToken(line)) {
+			chunk.material_libraries.push_back(std::string(name));
+		}
+	} else if (command == "o" || command == "g") {
+		chunk.shape_breaks.push_back({chunk.material_ids.size(), std::string(Trim(line))});
+	} else if (command == "s") {
+		if (!chunk.has_smoothing_group) {
+			chunk.has_smoothing_group = true;
+			chunk.inherited_smoothing_faces = chunk.material_ids.size();
+		}
+		std::string_view group = NextToken(line);
+		chunk.smoothing_group = 0;
+		bool relative;
+		int group_index;
+		if (group != "off" && ParseIndex(group, 0, group_index, relative) && !relative) {
+			chunk.smoothing_group = static_cast<unsigned int>(group_index) + 1;
+		}
+	}
+
+	// Other statements (lines, points, free-form geometry) are ignored
+	return true;
+}
+
+static void ParseChunk(ObjChunk &chunk) {
+	for (const char *line = chunk.begin; line < chunk.end;) {
+		const char *line_end = FindNewline(line, chunk.end);
+		const std::string_view line_view(line, static_cast<size_t>(line_end - line));
+
+		if (!ParseLine(chunk, line_view)) {
+			chunk.error = "Cannot parse line: " + std::string(Trim(line_view)) + "\n";
+			return;
+		}
+		line = line_end + 1;
+	}
+
+	if (!chunk.has_smoothing_group) {
+		chunk.inherited_smoothing_faces = chunk.material_ids.size();
+	}
+}
+
+// Adds the chunk base to the corners with negative OBJ indices
+static void ResolveRelativeCorners(ObjChunk &chunk) {
+	for (size_t relative_corner : chunk.relative_corners) {
+		tinyobj::index_t &index = chunk.corners[relative_corner / 3];
+		switch (relative_corner % 3) {
+			case 0:
+				index.vertex_index += static_cast<int>(chunk.vertex_base);
+				break;
+			case 1:
+				index.normal_index += static_cast<int>(chunk.normal_base);
+				break;
+			default:
+				index.texcoord_index += static_cast<int>(chunk.texcoord_base);
+				break;
+		}
+	}
+}
+
+// Cuts [begin, end) at line boundaries into one piece per chunk
+static void SplitChunks(std::vector<ObjChunk> &chunks, const char *begin, const char *end) {
+	const size_t text_size = static_cast<size_t>(end - begin);
+	const char *chunk_begin = begin;
+	for (size_t c = 0; c < chunks.size(); c++) {
+		const char *chunk_end = end;
+		if (c + 1 < chunks.size()) {
+			chunk_end = std::max(chunk_begin, begin + text_size * (c + 1) / chunks.size());
+			chunk_end = FindNewline(chunk_end, end);
+			chunk_end = (chunk_end < end) ? chunk_end + 1 : end;
+		}
+		chunks[c].begin = chunk_begin;
+		chunks[c].end = chunk_end;
+		chunk_begin = chunk_end;
+	}
+}
+
+// Loads the material libraries the chunks name, in file order, skipping the ones loaded before
+static void LoadMaterialLibraries(const std::vector<ObjChunk> &chunks, tinyobj::MaterialFileReader &material_reader,
+	std::set<std::string> &loaded_libraries, std::vector<tinyobj::material_t> *materials, std::map<std::string, int> &material_map,
+	std::string *warn, std::string *err) {
+	for (const ObjChunk &chunk : chunks) {
+		for (const std::string &library : chunk.material_libraries) {
+			if (!loaded_libraries.insert(library).second) {
+				continue;
+			}
+			std::string library_warn;
+			std::string library_err;
+			if (!material_reader(library, materials, &material_map, &library_warn, &library_err)) {
+				*warn += "Cannot load material library [" + library + "]\n";
+			}
+			*warn += library_warn;
+			*err += library_err;
+		}
+	}
+}
+
+static void ResolveMaterialNames(ObjChunk &chunk, const std::map<std::string, int> &material_map, std::string *warn) {
+	for (const std::string &name : chunk.material_names) {
+		auto found = material_map.find(name);
+		if (found == material_map.end()) {
+			*warn += "Material [" + name + "] is not found\n";
+			chunk.global_material_ids.push_back(-1);
+		} else {
+			chunk.global_material_ids.push_back(found->second);
+		}
+	}
+}
+
+// Adds the chunk base to relative indices, converts material ids to global ones
+// and copies the chunk into its place in attrib and shapes.
+static void StitchChunk(ObjChunk &chunk, const std::vector<ObjShapeRange> &shape_ranges,
+	tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes) {
+	const size_t vertex_number = attrib->vertices.size() / 3;
+	const size_t normal_number = attrib->normals.size() / 3;
+	const size_t texcoord_number = attrib->texcoords.size() / 2;
+
+	std::copy(chunk.vertices.begin(), chunk.vertices.end(), attrib->vertices.begin() + 3 * chunk.vertex_base);
+	std::copy(chunk.normals.begin(), chunk.normals.end(), attrib->normals.begin() + 3 * chunk.normal_base);
+	std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib->texcoords.begin() + 2 * chunk.texcoord_base);
+
+	ResolveRelativeCorners(chunk);
+
+	for (const tinyobj::index_t &index : chunk.corners) {
+		if (index.vertex_index < 0 || static_cast<size_t>(index.vertex_index) >= vertex_number ||
+			index.normal_index < -1 || index.normal_index >= static_cast<int>(normal_number) ||
+			index.texcoord_index < -1 || index.texcoord_index >= static_cast<int>(texcoord_number)) {
+			chunk.error = "Face index is out of range\n";
+			return;
+		}
+	}
+
+	// Find the shape which holds the first face of the chunk
+	size_t shape_id = 0;
+	while (shape_id + 1 < shape_ranges.size() && shape_ranges[shape_id].face_end <= chunk.face_base) {
+		shape_id++;
+	}
+
+	const size_t face_number = chunk.material_ids.size();
+	for (size_t f = 0; f < face_number;) {
+		const ObjShapeRange &range = shape_ranges[shape_id];
+		const size_t global_face = chunk.face_base + f;
+		const size_t run = std::min(face_number - f, range.face_end - global_face);
+		const size_t shape_face = global_face - range.face_begin;
+		tinyobj::mesh_t &mesh = (*shapes)[shape_id].mesh;
+
+		std::copy(chunk.corners.begin() + 3 * f, chunk.corners.begin() + 3 * (f + run), mesh.indices.begin() + 3 * shape_face);
+		for (size_t i = 0; i < run; i++) {
+			const int material = chunk.material_ids[f + i];
+			mesh.material_ids[shape_face + i] = (material == inherited_material) ? chunk.first_material : chunk.global_material_ids[material];
+			mesh.smoothing_group_ids[shape_face + i] = (f + i < chunk.inherited_smoothing_faces) ? chunk.first_smoothing_group : chunk.smoothing_group_ids[f + i];
+		}
+
+		f += run;
+		shape_id++;
+	}
+}
+
+bool LoadObjParallel(tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes,
+	std::vector<tinyobj::material_t> *materials, std::vector<std::string> *material_libraries, std::string *warn, std::string *err,
+	const char *filename, const char *mtl_basedir, unsigned int thread_number) {
+	attrib->vertices.clear();
+	attrib->normals.clear();
+	attrib->texcoords.clear();
+	attrib->colors.clear();
+	shapes->clear();
+
+	MappedFile file;
+	if (!file.Open(filename)) {
+		*err += "Cannot open file [" + std::string(filename) + "]\n";
+		return false;
+	}
+
+	// Split the text at line boundaries
+	if (thread_number == 0) {
+		thread_number = GetWorkerNumber();
+	}
+	const size_t text_size = file.GetSize();
+	const size_t chunk_number = std::min<size_t>(thread_number, text_size / min_chunk_size + 1);
+	std::vector<ObjChunk> chunks(chunk_number);
+	SplitChunks(chunks, file.GetData(), file.GetData() + text_size);
+
+	ParallelFor(chunk_number, [&](size_t c) {
+		ParseChunk(chunks[c]);
+	}, thread_number);
+
+	for (const ObjChunk &chunk : chunks) {
+		if (!chunk.error.empty()) {
+			*err += chunk.error;
+			return false;
+		}
+	}
+
+	// Load material libraries in file order
+	std::map<std::string, int> material_map;
+	std::set<std::string> loaded_libraries;
+	tinyobj::MaterialFileReader material_reader(mtl_basedir ? mtl_basedir : "");
+	LoadMaterialLibraries(chunks, material_reader, loaded_libraries, materials, material_map, warn, err);
+	if (material_libraries) {
+		material_libraries->assign(loaded_libraries.begin(), loaded_libraries.end());
+	}
+
+	// Walk chunks in file order to find attribute bases and the state each chunk inherits
+	size_t vertex_number = 0;
+	size_t normal_number = 0;
+	size_t texcoord_number = 0;
+	size_t face_number = 0;
+	int material = -1;
+	unsigned int smoothing_group = 0;
+	std::vector<ObjShapeRange> shape_ranges;
+	ObjShapeRange current_shape = {0, 0, std::string()};
+
+	for (ObjChunk &chunk : chunks) {
+		chunk.vertex_base = vertex_number;
+		chunk.normal_base = normal_number;
+		chunk.texcoord_base = texcoord_number;
+		chunk.face_base = face_number;
+		chunk.first_material = material;
+		chunk.first_smoothing_group = smoothing_group;
+
+		ResolveMaterialNames(chunk, material_map, warn);
+
+		for (const ObjShapeBreak &shape_break : chunk.shape_breaks) {
+			const size_t break_face = face_number + shape_break.face_offset;
+			if (break_face > current_shape.face_begin) {
+				current_shape.face_end = break_face;
+				shape_ranges.push_back(current_shape);
+				current_shape.face_begin = break_face;
+			}
+			current_shape.name = shape_break.name;
+		}
+
+		vertex_number += chunk.vertices.size() / 3;
+		normal_number += chunk.normals.size() / 3;
+		texcoord_number += chunk.texcoords.size() / 2;
+		face_number += chunk.material_ids.size();
+		if (chunk.material != inherited_material) {
+			material = chunk.global_material_ids[chunk.material];
+		}
+		if (chunk.has_smoothing_group) {
+			smoothing_group = chunk.smoothing_group;
+		}
+	}
+
+	if (face_number > current_shape.face_begin) {
+		current_shape.face_end = face_number;
+		shape_ranges.push_back(current_shape);
+	}
+
+	attrib->vertices.resize(3 * vertex_number);
+	attrib->normals.resize(3 * normal_number);
+	attrib->texcoords.resize(2 * texcoord_number);
+
+	shapes->resize(shape_ranges.size());
+	for (size_t s = 0; s < shape_ranges.size(); s++) {
+		const size_t shape_face_number = shape_ranges[s].face_end - shape_ranges[s].face_begin;
+		tinyobj::shape_t &shape = (*shapes)[s];
+		shape.name = shape_ranges[s].name;
+		shape.mesh.indices.resize(3 * shape_face_number);
+		shape.mesh.num_face_vertices.assign(shape_face_number, 3);
+		shape.mesh.material_ids.resize(shape_face_number);
+		shape.mesh.smoothing_group_ids.resize(shape_face_number);
+	}
+
+	ParallelFor(chunk_number, [&](size_t c) {
+		StitchChunk(chunks[c], shape_ranges, attrib, shapes);
+	}, thread_number);
+
+	for (const ObjChunk &chunk : chunks) {
+		if (!chunk.error.empty()) {
+			*err += chunk.error;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool StreamObjParallel(std::vector<tinyobj::material_t> *materials, std::vector<std::string> *material_libraries, std::string *warn, std::string *err,
+	const char *filename, const char *mtl_basedir, size_t window_size,
+	const std::function<bool(const ObjStreamBlock &)> &consumer, unsigned int thread_number) {
+	MappedFile file;
+	if (!file.Open(filename)) {
+		*err += "Cannot open file [" + std::string(filename) + "]\n";
+		return false;
+	}
+
+	if (thread_number == 0) {
+		thread_number = GetWorkerNumber();
+	}
+	std::map<std::string, int> material_map;
+	std::set<std::string> loaded_libraries;
+	tinyobj::MaterialFileReader material_reader(mtl_basedir ? mtl_basedir : "");
+
+	// State carried from one window to the next, like the chunk walk of LoadObjParallel
+	size_t vertex_number = 0;
+	size_t normal_number = 0;
+	size_t texcoord_number = 0;
+	int material = -1;
+
+	const char *text_end = file.GetData() + file.GetSize();
+	for (const char *window_begin = file.GetData(); window_begin < text_end;) {
+		const char *window_end = text_end;
+		if (static_cast<size_t>(text_end - window_begin) > window_size) {
+			window_end = FindNewline(window_begin + window_size, text_end);
+			window_end = (window_end < text_end) ? window_end + 1 : text_end;
+		}
+
+		// Chunks live only as long as their window, which bounds the memory of the parse
+		const size_t chunk_number = std::min<size_t>(thread_number, static_cast<size_t>(window_end - window_begin) / min_chunk_size + 1);
+		std::vector<ObjChunk> chunks(chunk_number);
+		SplitChunks(chunks, window_begin, window_end);
+		ParallelFor(chunk_number, [&](size_t c) {
+			ParseChunk(chunks[c]);
+		}, thread_number);
+
+		for (const ObjChunk &chunk : chunks) {
+			if (!chunk.error.empty()) {
+				*err += chunk.error;
+				return false;
+			}
+		}
+
+		// Libraries are loaded as the windows reach them, so usemtl has to follow its mtllib
+		LoadMaterialLibraries(chunks, material_reader, loaded_libraries, materials, material_map, warn, err);
+
+		for (ObjChunk &chunk : chunks) {
+			chunk.vertex_base = vertex_number;
+			chunk.normal_base = normal_number;
+			chunk.texcoord_base = texcoord_number;
+			ResolveMaterialNames(chunk, material_map, warn);
+			ResolveRelativeCorners(chunk);
+			for (int &material_id : chunk.material_ids) {
+				material_id = (material_id == inherited_material) ? material : chunk.global_material_ids[material_id];
+			}
+
+			ObjStreamBlock block = {};
+			block.vertices = chunk.vertices.data();
+			block.vertex_number = chunk.vertices.size() / 3;
+			block.normals = chunk.normals.data();
+			block.normal_number = chunk.normals.size() / 3;
+			block.texcoords = chunk.texcoords.data();
+			block.texcoord_number = chunk.texcoords.size() / 2;
+			block.corners = chunk.corners.data();
+			block.material_ids = chunk.material_ids.data();
+			block.triangle_number = chunk.material_ids.size();
+			if (!consumer(block)) {
+				return false;
+			}
+
+			vertex_number += block.vertex_number;
+			normal_number += block.normal_number;
+			texcoord_number += block.texcoord_number;
+			if (chunk.material != inherited_material) {
+				material = chunk.global_material_ids[chunk.material];
+			}
+		}
+
+		window_begin = window_end;
+	}
+
+	if (material_libraries) {
+		material_libraries->assign(loaded_libraries.begin(), loaded_libraries.end());
+	}
+	return true;
+}
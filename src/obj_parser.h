@@ -0,0 +1,41 @@
+#pragma once
+
+#include "tiny_obj_loader.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Alternative to tinyobj::LoadObj which maps the OBJ file, splits the text at
+// line boundaries, parses the chunks on thread_number threads (all hardware
+// threads when 0) and stitches them into the same attrib_t/shape_t/material_t
+// layout. Lines are tokenized in place without allocations. Polygons are fan
+// triangulated, material libraries are read with tinyobj and their names, relative
+// to mtl_basedir, are returned in material_libraries unless it is nullptr.
+bool LoadObjParallel(tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes,
+	std::vector<tinyobj::material_t> *materials, std::vector<std::string> *material_libraries, std::string *warn, std::string *err,
+	const char *filename, const char *mtl_basedir, unsigned int thread_number = 0);
+
+// Attributes and triangles of one piece of an OBJ file, in file order
+struct ObjStreamBlock {
+	const tinyobj::real_t *vertices;
+	size_t vertex_number;
+	const tinyobj::real_t *normals;
+	size_t normal_number;
+	const tinyobj::real_t *texcoords;
+	size_t texcoord_number;
+	// Three corners per triangle with absolute zero based indices, not range checked
+	// since later lines may still define the attributes they point to
+	const tinyobj::index_t *corners;
+	// Per triangle, -1 without a material
+	const int *material_ids;
+	size_t triangle_number;
+};
+
+// Parses the OBJ file like LoadObjParallel but only window_size bytes of text at a
+// time and hands the pieces to consumer in file order instead of keeping them, so
+// files larger than memory can be read. Shapes and smoothing groups are dropped.
+// Stops with false as soon as consumer returns false.
+bool StreamObjParallel(std::vector<tinyobj::material_t> *materials, std::vector<std::string> *material_libraries, std::string *warn, std::string *err,
+	const char *filename, const char *mtl_basedir, size_t window_size,
+	const std::function<bool(const ObjStreamBlock &)> &consumer, unsigned int thread_number = 0);
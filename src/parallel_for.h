@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+inline unsigned int GetWorkerNumber() {
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls function(task_id) for every task in [0, task_number) on up to
+// worker_number threads (all hardware threads when 0). Tasks are handed out one
+// at a time, so uneven tasks like per-material work balance themselves.
+template <typename Function>
+void ParallelFor(size_t task_number, Function function, unsigned int worker_number = 0) {
+	if (worker_number == 0) {
+		worker_number = GetWorkerNumber();
+	}
+
+	const size_t thread_number = std::min<size_t>(worker_number, task_number);
+	if (thread_number <= 1) {
+		for (size_t task_id = 0; task_id < task_number; task_id++) {
+			function(task_id);
+		}
+		return;
+	}
+
+	std::atomic<size_t> next_task(0);
+	auto worker = [&]() {
+		for (size_t task_id = next_task++; task_id < task_number; task_id = next_task++) {
+			function(task_id);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t thread_id = 1; thread_id < thread_number; thread_id++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+// The Windows and DirectXMath pieces the loader modules use. Windows builds get the
+// real headers, other systems get stand-ins so the loader benchmark builds there too.
+#ifdef _WIN32
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <Windows.h>
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#else
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+typedef int32_t HRESULT;
+
+#define S_OK ((HRESULT)0)
+#define E_ABORT ((HRESULT)0x80004004)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+// Loader messages are ASCII, write them to stderr without changing its orientation
+inline void OutputDebugString(const wchar_t *message) {
+	for (; *message != L'\0'; message++) {
+		fputc(*message < 128 ? static_cast<char>(*message) : '?', stderr);
+	}
+}
+
+namespace DirectX {
+	constexpr float XM_PI = 3.141592654f;
+
+	struct XMFLOAT2 {
+		float x;
+		float y;
+
+		XMFLOAT2() = default;
+		constexpr XMFLOAT2(float x, float y) : x(x), y(y) {}
+	};
+
+	struct XMFLOAT3 {
+		float x;
+		float y;
+		float z;
+
+		XMFLOAT3() = default;
+		constexpr XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+	};
+
+	struct XMFLOAT4 {
+		float x;
+		float y;
+		float z;
+		float w;
+
+		XMFLOAT4() = default;
+		constexpr XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMFLOAT4X4 {
+		float m[4][4];
+	};
+
+	namespace PackedVector {
+		typedef uint16_t HALF;
+
+		// Round to nearest even like DirectXMath, overflow gives infinity
+		inline HALF XMConvertFloatToHalf(float value) {
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			const uint32_t sign = (bits >> 16) & 0x8000u;
+			uint32_t magnitude = bits & 0x7FFFFFFFu;
+			if (magnitude >= 0x7F800000u) {
+				return static_cast<HALF>(sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u));
+			}
+			// 65520 and above round past the largest half
+			if (magnitude >= 0x477FF000u) {
+				return static_cast<HALF>(sign | 0x7C00u);
+			}
+			// Below 2^-14 the result is a denormal, 2^-25 and below round to zero
+			if (magnitude < 0x38800000u) {
+				if (magnitude <= 0x33000000u) {
+					return static_cast<HALF>(sign);
+				}
+				const uint32_t shift = 126 - (magnitude >> 23);
+				const uint32_t mantissa = (magnitude & 0x7FFFFFu) | 0x800000u;
+				uint32_t result = mantissa >> shift;
+				const uint32_t remainder = mantissa & ((1u << shift) - 1);
+				const uint32_t halfway = 1u << (shift - 1);
+				if (remainder > halfway || (remainder == halfway && (result & 1) != 0)) {
+					result++;
+				}
+				return static_cast<HALF>(sign | result);
+			}
+			// Rebias the exponent from 127 to 15 and round away 13 mantissa bits
+			magnitude -= 112u << 23;
+			magnitude += 0x0FFFu + ((magnitude >> 13) & 1u);
+			return static_cast<HALF>(sign | (magnitude >> 13));
+		}
+
+		inline float XMConvertHalfToFloat(HALF value) {
+			const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+			uint32_t exponent = (value >> 10) & 0x1Fu;
+			uint32_t mantissa = value & 0x3FFu;
+			uint32_t bits;
+			if (exponent == 0x1F) {
+				bits = sign | 0x7F800000u | (mantissa << 13);
+			} else if (exponent != 0) {
+				bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+			} else if (mantissa == 0) {
+				bits = sign;
+			} else {
+				// Normalize the denormal
+				exponent = 113;
+				while ((mantissa & 0x400u) == 0) {
+					mantissa <<= 1;
+					exponent--;
+				}
+				bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+			}
+			float result;
+			memcpy(&result, &bits, sizeof(result));
+			return result;
+		}
+	}
+}
+
+#endif
+
+using namespace DirectX;
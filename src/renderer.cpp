@@ -34,6 +34,54 @@ void Renderer::OnUpdate() {
 	//world_view_projection = world;
 	memcpy(constant_buffer_data_begin, &world_view_projection, sizeof(world_view_projection));
 	memcpy(constant_buffer_data_begin + sizeof(world_view_projection), &light, sizeof(light));
+
+	// Row vector convention of DirectXMath, the culler wants clip = position * matrix
+	unsigned int visible_draw_call_num = modelLoader.GetDrawCallNumber();
+	// A length r at view depth z covers about r * projection[1][1] / z * height / 2 pixels
+	const float projection_scale = XMVectorGetY(projection.r[1]);
+	// Draw bounds are in model space, world scales their radius by up to its largest axis
+	const float world_scale = std::max({XMVectorGetX(XMVector3Length(world.r[0])),
+		XMVectorGetX(XMVector3Length(world.r[1])), XMVectorGetX(XMVector3Length(world.r[2]))});
+	if (frustum_culling) {
+		XMFLOAT4X4 view_projection;
+		XMStoreFloat4x4(&view_projection, world * view * projection);
+		const float min_radius_per_depth = 2.0f * min_projected_radius_pixels / (projection_scale * height * world_scale);
+		visible_draw_call_num = static_cast<unsigned int>(frustum_culler.Cull(view_projection, draw_call_visibility.data(), min_radius_per_depth));
+	} else {
+		std::fill(draw_call_visibility.begin(), draw_call_visibility.end(), static_cast<uint8_t>(1));
+	}
+
+	// Coarsest level whose error projects below max_lod_error_pixels at the nearest point of the draw bounds
+	const XMMATRIX world_view = world * view;
+	const float error_pixels_per_depth = world_scale * projection_scale * height * 0.5f;
+	const DrawBounds *draw_bounds = modelLoader.GetDrawBounds();
+	unsigned int triangle_num = 0;
+	for (unsigned int draw_call_id = 0; draw_call_id < modelLoader.GetDrawCallNumber(); draw_call_id++) {
+		unsigned int level = 0;
+		if (lod_selection && draw_call_visibility[draw_call_id]) {
+			const DrawBounds &bounds = draw_bounds[draw_call_id];
+			const float depth = XMVectorGetZ(XMVector3Transform(XMLoadFloat3(&bounds.center), world_view)) - bounds.radius * world_scale;
+			const unsigned int lod_number = modelLoader.GetDrawLodNumber(draw_call_id);
+			while (level + 1 < lod_number &&
+				modelLoader.GetDrawLod(draw_call_id, level + 1).error * error_pixels_per_depth <= max_lod_error_pixels * depth) {
+				level++;
+			}
+		}
+		draw_call_lods[draw_call_id] = static_cast<uint8_t>(level);
+		if (draw_call_visibility[draw_call_id]) {
+			triangle_num += modelLoader.GetDrawLod(draw_call_id, level).index_num / 3;
+		}
+	}
+
+	const unsigned int culled_num = modelLoader.GetDrawCallNumber() - visible_draw_call_num;
+	if (culled_num != culled_draw_call_num || triangle_num != submitted_triangle_num) {
+		culled_draw_call_num = culled_num;
+		submitted_triangle_num = triangle_num;
+		std::wstring culling_title = title + L" - " + std::to_wstring(culled_draw_call_num) + L" of " +
+			std::to_wstring(modelLoader.GetDrawCallNumber()) + L" draw calls culled, " +
+			std::to_wstring(submitted_triangle_num) + L" triangles";
+		SetWindowText(Win32Window::GetHwnd(), culling_title.c_str());
+	}
 }
 
 void Renderer::OnRender() {
@@ -86,6 +134,19 @@ void Renderer::OnKeyDown(UINT8 key) {
 			lightVelocityX = -1.0f;
 			break;
 
+		case 'C':
+			frustum_culling = !frustum_culling;
+			OutputDebugString(frustum_culling ? L"Frustum culling on\n" : L"Frustum culling off\n");
+			break;
+		case 'P':
+			depth_prepass = !depth_prepass;
+			OutputDebugString(depth_prepass ? L"Depth pre-pass on\n" : L"Depth pre-pass off\n");
+			break;
+		case 'M':
+			lod_selection = !lod_selection;
+			OutputDebugString(lod_selection ? L"LOD selection on\n" : L"LOD selection off\n");
+			break;
+
 		case VK_OEM_MINUS:
 			if (max_draw_call_num > 0) {
 				max_draw_call_num--;
@@ -94,7 +155,7 @@ void Renderer::OnKeyDown(UINT8 key) {
 			}
 			break;
 		case VK_OEM_PLUS:
-			if (max_draw_call_num < modelLoader.GetMaterialNumber()) {
+			if (max_draw_call_num < modelLoader.GetDrawCallNumber()) {
 				max_draw_call_num++;
 				std::wstring kek = L"Max draw call increased: " + std::to_wstring(max_draw_call_num) + L"\n";
 				OutputDebugString(kek.c_str());
@@ -194,8 +255,15 @@ void Renderer::LoadPipeline() {
 
 	frame_index = swap_chain->GetCurrentBackBufferIndex();
 
+	LoaderOptions loader_options;
+	loader_options.pack_vertices = true;
+	loader_options.lod_level_number = 4;
+	modelLoader.SetOptions(loader_options);
 	ThrowIfFailed(modelLoader.LoadModel(obj_file));
-	max_draw_call_num = modelLoader.GetMaterialNumber();
+	max_draw_call_num = modelLoader.GetDrawCallNumber();
+	frustum_culler.SetBounds(modelLoader.GetDrawBounds(), modelLoader.GetDrawCallNumber());
+	draw_call_visibility.assign(modelLoader.GetDrawCallNumber(), 1);
+	draw_call_lods.assign(modelLoader.GetDrawCallNumber(), 0);
 	per_material_srv_offset.resize(modelLoader.GetMaterialNumber());
 
 	// Create descriptor heap for render target view
@@ -270,13 +338,16 @@ void Renderer::LoadAssets() {
 	}
 
 	CD3DX12_DESCRIPTOR_RANGE1 ranges[2];
-	CD3DX12_ROOT_PARAMETER1 root_paramters[2];
+	CD3DX12_ROOT_PARAMETER1 root_paramters[4];
 
 	ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
 	ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
 
 	root_paramters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_VERTEX);
 	root_paramters[1].InitAsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_PIXEL);
+	// Material id of the draw call and the material table it indexes
+	root_paramters[2].InitAsConstants(1, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	root_paramters[3].InitAsShaderResourceView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
 
 	D3D12_ROOT_SIGNATURE_FLAGS rs_flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
 
@@ -324,8 +395,9 @@ void Renderer::LoadAssets() {
 
 
 	std::wstring shader_path = GetBinPath(std::wstring(L"shaders.hlsl"));
+	const char *vertex_shader_entry = modelLoader.HasPackedVertices() ? "VSMain_packed" : "VSMain";
 	serializeResult = D3DCompileFromFile(shader_path.c_str(), nullptr, nullptr,
-		"VSMain", "vs_5_0", compile_flags, 0, &vertex_shader, &error);
+		vertex_shader_entry, "vs_5_0", compile_flags, 0, &vertex_shader, &error);
 	if (error) {
 		OutputDebugStringA((char *) error->GetBufferPointer());
 	}
@@ -342,18 +414,36 @@ void Renderer::LoadAssets() {
 		OutputDebugStringA((char *) error->GetBufferPointer());
 	}
 
+	ComPtr<ID3DBlob> depth_vertex_shader;
+	const char *depth_vertex_shader_entry = modelLoader.HasPackedVertices() ? "VSMain_depth_packed" : "VSMain_depth";
+	serializeResult = D3DCompileFromFile(shader_path.c_str(), nullptr, nullptr,
+		depth_vertex_shader_entry, "vs_5_0", compile_flags, 0, &depth_vertex_shader, &error);
+	if (error) {
+		OutputDebugStringA((char *) error->GetBufferPointer());
+	}
+
 	ThrowIfFailed(serializeResult);
 
 	D3D12_INPUT_ELEMENT_DESC input_element_descriptors[] =
 	{
 		{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-		{"DIFFUSE", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-		{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-		{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 36, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
+		{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
+	};
+
+	D3D12_INPUT_ELEMENT_DESC packed_input_element_descriptors[] =
+	{
+		{"POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
 	};
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC pso_descriptor = {};
-	pso_descriptor.InputLayout = {input_element_descriptors, _countof(input_element_descriptors)};
+	if (modelLoader.HasPackedVertices()) {
+		pso_descriptor.InputLayout = {packed_input_element_descriptors, _countof(packed_input_element_descriptors)};
+	} else {
+		pso_descriptor.InputLayout = {input_element_descriptors, _countof(input_element_descriptors)};
+	}
 	pso_descriptor.pRootSignature = root_signature.Get();
 	pso_descriptor.VS = CD3DX12_SHADER_BYTECODE(vertex_shader.Get());
 	pso_descriptor.PS = CD3DX12_SHADER_BYTECODE(pixel_shader_color.Get());
@@ -379,6 +469,25 @@ void Renderer::LoadAssets() {
 	pso_descriptor.PS = CD3DX12_SHADER_BYTECODE(pixel_shader_texture.Get());
 	ThrowIfFailed(device->CreateGraphicsPipelineState(&pso_descriptor, IID_PPV_ARGS(&pipeline_state_texture)));
 
+	if (modelLoader.GetPositionBufferSize() > 0) {
+		pso_descriptor.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+		pso_descriptor.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+		ThrowIfFailed(device->CreateGraphicsPipelineState(&pso_descriptor, IID_PPV_ARGS(&pipeline_state_texture_equal)));
+		pso_descriptor.PS = CD3DX12_SHADER_BYTECODE(pixel_shader_color.Get());
+		ThrowIfFailed(device->CreateGraphicsPipelineState(&pso_descriptor, IID_PPV_ARGS(&pipeline_state_color_equal)));
+
+		D3D12_INPUT_ELEMENT_DESC position_element_descriptor = {"POSITION", 0,
+			modelLoader.HasPackedVertices() ? DXGI_FORMAT_R16G16B16A16_UNORM : DXGI_FORMAT_R32G32B32_FLOAT,
+			0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0};
+		pso_descriptor.InputLayout = {&position_element_descriptor, 1};
+		pso_descriptor.VS = CD3DX12_SHADER_BYTECODE(depth_vertex_shader.Get());
+		pso_descriptor.PS = {};
+		pso_descriptor.BlendState.RenderTarget[0].RenderTargetWriteMask = 0;
+		pso_descriptor.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+		pso_descriptor.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+		ThrowIfFailed(device->CreateGraphicsPipelineState(&pso_descriptor, IID_PPV_ARGS(&pipeline_state_depth)));
+	}
+
 	// Create command list
 	ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, command_allocator.Get(),
 		pipeline_state_color.Get(), IID_PPV_ARGS(&command_list)));
@@ -386,82 +495,74 @@ void Renderer::LoadAssets() {
 
 
 
-	const UINT vertex_buffer_size = modelLoader.GetVertexBufferSize();
-	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(modelLoader.GetVertexBufferSize()),
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		nullptr,
-		IID_PPV_ARGS(&vertex_buffer))
-	);
-	vertex_buffer->SetName(L"Vertex buffer");
-
-	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(modelLoader.GetVertexBufferSize()),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&upload_vertex_buffer))
-	);
-
-	D3D12_SUBRESOURCE_DATA vertexData = {};
-	vertexData.pData = modelLoader.GetVertexBuffer();
-	vertexData.RowPitch = modelLoader.GetVertexBufferSize();
-	vertexData.SlicePitch = modelLoader.GetVertexBufferSize();
-
-	UpdateSubresources(command_list.Get(), vertex_buffer.Get(), upload_vertex_buffer.Get(), 0, 0, 1, &vertexData);
-	command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
-		vertex_buffer.Get(),
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-	));
-
-	/*UINT8 *vertex_data_begin;
-	ThrowIfFailed(vertex_buffer->Map(0, &read_range, reinterpret_cast<void **>(&vertex_data_begin)));
-	memcpy(vertex_data_begin, modelLoader.GetVertexBuffer(), modelLoader.GetVertexBufferSize());
-	vertex_buffer->Unmap(0, nullptr);*/
-
-	vertex_buffer_view.BufferLocation = vertex_buffer->GetGPUVirtualAddress();
-	vertex_buffer_view.StrideInBytes = sizeof(FullVertex);
-	vertex_buffer_view.SizeInBytes = modelLoader.GetVertexBufferSize();
-
-	// Create index buffer
-	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(modelLoader.GetIndexBufferSize()),
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		nullptr,
-		IID_PPV_ARGS(&index_buffer))
-	);
-	index_buffer->SetName(L"Index buffer");
-
-	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(modelLoader.GetIndexBufferSize()),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&upload_index_buffer))
-	);
+	// Every mesh buffer gets its own GPU buffers, so their views stay below the 32-bit size limit
+	const unsigned int buffer_num = modelLoader.GetBufferNumber();
+	vertex_buffers.resize(buffer_num);
+	upload_vertex_buffers.resize(buffer_num);
+	vertex_buffer_views.assign(buffer_num, {});
+	index_buffers.resize(buffer_num);
+	upload_index_buffers.resize(buffer_num);
+	index_buffer_views.assign(buffer_num, {});
+	short_index_buffers.resize(buffer_num);
+	upload_short_index_buffers.resize(buffer_num);
+	short_index_buffer_views.assign(buffer_num, {});
+	position_buffers.resize(buffer_num);
+	upload_position_buffers.resize(buffer_num);
+	position_buffer_views.assign(buffer_num, {});
+	position_index_buffers.resize(buffer_num);
+	upload_position_index_buffers.resize(buffer_num);
+	position_index_buffer_views.assign(buffer_num, {});
+	for (unsigned int buffer_id = 0; buffer_id < buffer_num; buffer_id++) {
+		const MeshBuffer buffer = modelLoader.GetBuffer(buffer_id);
+		const std::wstring buffer_name = L" " + std::to_wstring(buffer_id);
+
+		const UINT64 vertex_buffer_size = buffer.vertex_num * modelLoader.GetVertexStride();
+		if (vertex_buffer_size > 0) {
+			const char *vertices = static_cast<const char *>(modelLoader.GetVertexBuffer()) + buffer.start_vertex * modelLoader.GetVertexStride();
+			UploadBuffer(vertices, vertex_buffer_size, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+				(L"Vertex buffer" + buffer_name).c_str(), vertex_buffers[buffer_id], upload_vertex_buffers[buffer_id]);
+			vertex_buffer_views[buffer_id].BufferLocation = vertex_buffers[buffer_id]->GetGPUVirtualAddress();
+			vertex_buffer_views[buffer_id].StrideInBytes = modelLoader.GetVertexStride();
+			vertex_buffer_views[buffer_id].SizeInBytes = static_cast<UINT>(vertex_buffer_size);
+		}
 
-	D3D12_SUBRESOURCE_DATA indexData = {};
-	indexData.pData = modelLoader.GetIndexBuffer();
-	indexData.RowPitch = modelLoader.GetIndexBufferSize();
-	indexData.SlicePitch = modelLoader.GetIndexBufferSize();
+		// Draw calls use either of the index buffers
+		const UINT64 index_buffer_size = buffer.index_num * sizeof(unsigned int);
+		if (index_buffer_size > 0) {
+			UploadBuffer(modelLoader.GetIndexBuffer() + buffer.start_index, index_buffer_size, D3D12_RESOURCE_STATE_INDEX_BUFFER,
+				(L"Index buffer" + buffer_name).c_str(), index_buffers[buffer_id], upload_index_buffers[buffer_id]);
+			index_buffer_views[buffer_id].BufferLocation = index_buffers[buffer_id]->GetGPUVirtualAddress();
+			index_buffer_views[buffer_id].SizeInBytes = static_cast<UINT>(index_buffer_size);
+			index_buffer_views[buffer_id].Format = DXGI_FORMAT_R32_UINT;
+		}
 
-	UpdateSubresources(command_list.Get(), index_buffer.Get(), upload_index_buffer.Get(), 0, 0, 1, &indexData);
-	command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
-		index_buffer.Get(),
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		D3D12_RESOURCE_STATE_INDEX_BUFFER
-	));
+		const UINT64 short_index_buffer_size = buffer.short_index_num * sizeof(uint16_t);
+		if (short_index_buffer_size > 0) {
+			UploadBuffer(modelLoader.GetShortIndexBuffer() + buffer.start_short_index, short_index_buffer_size, D3D12_RESOURCE_STATE_INDEX_BUFFER,
+				(L"Short index buffer" + buffer_name).c_str(), short_index_buffers[buffer_id], upload_short_index_buffers[buffer_id]);
+			short_index_buffer_views[buffer_id].BufferLocation = short_index_buffers[buffer_id]->GetGPUVirtualAddress();
+			short_index_buffer_views[buffer_id].SizeInBytes = static_cast<UINT>(short_index_buffer_size);
+			short_index_buffer_views[buffer_id].Format = DXGI_FORMAT_R16_UINT;
+		}
 
-	index_buffer_view.BufferLocation = index_buffer->GetGPUVirtualAddress();
-	index_buffer_view.SizeInBytes = modelLoader.GetIndexBufferSize();
-	index_buffer_view.Format = DXGI_FORMAT_R32_UINT;
+		// Position stream buffers
+		const UINT64 position_buffer_size = buffer.position_num * modelLoader.GetPositionStride();
+		if (position_buffer_size > 0) {
+			const char *positions = static_cast<const char *>(modelLoader.GetPositionBuffer()) + buffer.start_position * modelLoader.GetPositionStride();
+			UploadBuffer(positions, position_buffer_size, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+				(L"Position buffer" + buffer_name).c_str(), position_buffers[buffer_id], upload_position_buffers[buffer_id]);
+			position_buffer_views[buffer_id].BufferLocation = position_buffers[buffer_id]->GetGPUVirtualAddress();
+			position_buffer_views[buffer_id].StrideInBytes = modelLoader.GetPositionStride();
+			position_buffer_views[buffer_id].SizeInBytes = static_cast<UINT>(position_buffer_size);
+
+			const UINT64 position_index_buffer_size = buffer.position_index_num * sizeof(unsigned int);
+			UploadBuffer(modelLoader.GetPositionIndexBuffer() + buffer.start_position_index, position_index_buffer_size, D3D12_RESOURCE_STATE_INDEX_BUFFER,
+				(L"Position index buffer" + buffer_name).c_str(), position_index_buffers[buffer_id], upload_position_index_buffers[buffer_id]);
+			position_index_buffer_views[buffer_id].BufferLocation = position_index_buffers[buffer_id]->GetGPUVirtualAddress();
+			position_index_buffer_views[buffer_id].SizeInBytes = static_cast<UINT>(position_index_buffer_size);
+			position_index_buffer_views[buffer_id].Format = DXGI_FORMAT_R32_UINT;
+		}
+	}
 
 	// Constant buffer init
 	ThrowIfFailed(device->CreateCommittedResource(
@@ -478,7 +579,7 @@ void Renderer::LoadAssets() {
 
 	D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_descriptor = {};
 	cbv_descriptor.BufferLocation = constant_buffer->GetGPUVirtualAddress();
-	cbv_descriptor.SizeInBytes = (sizeof(world_view_projection) + sizeof(light) + 255) & ~255;
+	cbv_descriptor.SizeInBytes = (sizeof(world_view_projection) + sizeof(light) + sizeof(VertexQuantization) + 255) & ~255;
 	cbv_srv_heap_handle.InitOffsetted(cbv_srv_heap->GetCPUDescriptorHandleForHeapStart(), 0, cbv_srv_descriptor_size);
 	device->CreateConstantBufferView(&cbv_descriptor, cbv_srv_heap_handle);
 	cbv_srv_heap_handle.Offset(1, cbv_srv_descriptor_size);
@@ -487,6 +588,25 @@ void Renderer::LoadAssets() {
 	ThrowIfFailed(constant_buffer->Map(0, &read_range, reinterpret_cast<void **>(&constant_buffer_data_begin)));
 	memcpy(constant_buffer_data_begin, &world_view_projection, sizeof(world_view_projection));
 	memcpy(constant_buffer_data_begin + sizeof(world_view_projection), &light, sizeof(light));
+	// The quantization never changes, so it is written once
+	VertexQuantization vertex_quantization = modelLoader.GetVertexQuantization();
+	memcpy(constant_buffer_data_begin + sizeof(world_view_projection) + sizeof(light), &vertex_quantization, sizeof(vertex_quantization));
+
+	// Material table init
+	std::vector<MaterialConstants> material_constants = modelLoader.GetMaterialConstants();
+	const UINT material_buffer_size = static_cast<UINT>(std::max<size_t>(1, material_constants.size()) * sizeof(MaterialConstants));
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(material_buffer_size),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&material_buffer))
+	);
+	material_buffer->SetName(L"Material buffer");
+
+	ThrowIfFailed(material_buffer->Map(0, &read_range, reinterpret_cast<void **>(&material_buffer_data_begin)));
+	memcpy(material_buffer_data_begin, material_constants.data(), material_constants.size() * sizeof(MaterialConstants));
 
 	// Create empty SRV
 	D3D12_SHADER_RESOURCE_VIEW_DESC emptySrvDescriptor = {};
@@ -604,6 +724,7 @@ void Renderer::PopulateCommandList() {
 	command_list->SetGraphicsRootDescriptorTable(0, cbv_srv_handle);
 	cbv_srv_handle.Offset(1, cbv_srv_descriptor_size);
 	command_list->SetGraphicsRootDescriptorTable(1, cbv_srv_handle);
+	command_list->SetGraphicsRootShaderResourceView(3, material_buffer->GetGPUVirtualAddress());
 	command_list->RSSetViewports(1, &view_port);
 	command_list->RSSetScissorRects(1, &scissor_rect);
 
@@ -625,22 +746,77 @@ void Renderer::PopulateCommandList() {
 	command_list->ClearRenderTargetView(rtv_handle, clear_color, 0, nullptr);
 	command_list->ClearDepthStencilView(dsv_handle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 	command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	command_list->IASetVertexBuffers(0, 1, &vertex_buffer_view);
-	command_list->IASetIndexBuffer(&index_buffer_view);
 
-	for (unsigned int material_id = 0; material_id < modelLoader.GetMaterialNumber() && material_id < max_draw_call_num; material_id++) {
+	const unsigned int draw_call_num = std::min(modelLoader.GetDrawCallNumber(), max_draw_call_num);
+
+	// Depth pre-pass over the position stream, one draw per run of visible full detail draw calls
+	// of the same buffer. Simplified levels live apart from the full draw calls and are drawn one by one.
+	const bool use_depth_prepass = depth_prepass && pipeline_state_depth;
+	if (use_depth_prepass) {
+		command_list->SetPipelineState(pipeline_state_depth.Get());
+		unsigned int bound_position_buffer_id = UINT_MAX;
+		for (unsigned int run_start = 0; run_start < draw_call_num; run_start++) {
+			if (!draw_call_visibility[run_start]) {
+				continue;
+			}
+			const unsigned int buffer_id = modelLoader.GetDrawCallParams(run_start).buffer_id;
+			if (buffer_id != bound_position_buffer_id) {
+				command_list->IASetVertexBuffers(0, 1, &position_buffer_views[buffer_id]);
+				command_list->IASetIndexBuffer(&position_index_buffer_views[buffer_id]);
+				bound_position_buffer_id = buffer_id;
+			}
+			if (draw_call_lods[run_start] != 0) {
+				const DrawLod lod = modelLoader.GetDrawLod(run_start, draw_call_lods[run_start]);
+				command_list->DrawIndexedInstanced(lod.index_num, 1, lod.position_start_index, 0, 0);
+				continue;
+			}
+			unsigned int run_end = run_start + 1;
+			while (run_end < draw_call_num && draw_call_visibility[run_end] && draw_call_lods[run_end] == 0 &&
+				modelLoader.GetDrawCallParams(run_end).buffer_id == buffer_id) {
+				run_end++;
+			}
+
+			const unsigned int start_index = modelLoader.GetDrawLod(run_start, 0).position_start_index;
+			const UINT index_num = static_cast<UINT>(modelLoader.GetPositionIndexNumber(run_end) - modelLoader.GetPositionIndexNumber(run_start));
+			command_list->DrawIndexedInstanced(index_num, 1, start_index, 0, 0);
+			run_start = run_end - 1;
+		}
+	}
+
+	// Vertex and index buffers are switched only when the buffer or the index width changes between draw calls
+	unsigned int bound_buffer_id = UINT_MAX;
+	unsigned int bound_index_size = 0;
+	for (unsigned int draw_call_id = 0; draw_call_id < draw_call_num; draw_call_id++) {
+		if (!draw_call_visibility[draw_call_id]) {
+			continue;
+		}
+
+		DrawCallParams params = modelLoader.GetDrawCallParams(draw_call_id);
+		if (params.buffer_id != bound_buffer_id) {
+			command_list->IASetVertexBuffers(0, 1, &vertex_buffer_views[params.buffer_id]);
+			bound_buffer_id = params.buffer_id;
+			bound_index_size = 0;
+		}
+		if (params.index_size != bound_index_size) {
+			command_list->IASetIndexBuffer((params.index_size == sizeof(uint16_t)) ?
+				&short_index_buffer_views[params.buffer_id] : &index_buffer_views[params.buffer_id]);
+			bound_index_size = params.index_size;
+		}
+
+		const unsigned int material_id = params.material_id;
+		command_list->SetGraphicsRoot32BitConstant(2, material_id, 0);
 		UINT offset = per_material_srv_offset[material_id];
 		cbv_srv_handle.InitOffsetted(cbv_srv_heap->GetGPUDescriptorHandleForHeapStart(), offset, cbv_srv_descriptor_size);
 		command_list->SetGraphicsRootDescriptorTable(1, cbv_srv_handle);
 
 		if (modelLoader.HasTexture(material_id)) {
-			command_list->SetPipelineState(pipeline_state_texture.Get());
+			command_list->SetPipelineState(use_depth_prepass ? pipeline_state_texture_equal.Get() : pipeline_state_texture.Get());
 		} else {
-			command_list->SetPipelineState(pipeline_state_color.Get());
+			command_list->SetPipelineState(use_depth_prepass ? pipeline_state_color_equal.Get() : pipeline_state_color.Get());
 		}
 
-		DrawCallParams params = modelLoader.GetDrawCallParams(material_id);
-		command_list->DrawIndexedInstanced(params.index_num, 1, params.start_index, params.start_vertex, 0);
+		const DrawLod lod = modelLoader.GetDrawLod(draw_call_id, draw_call_lods[draw_call_id]);
+		command_list->DrawIndexedInstanced(lod.index_num, 1, lod.start_index, params.start_vertex, 0);
 	}
 
 
@@ -670,6 +846,40 @@ void Renderer::WaitForPreviousFrame() {
 	frame_index = swap_chain->GetCurrentBackBufferIndex();
 }
 
+void Renderer::UploadBuffer(const void *data, UINT64 size, D3D12_RESOURCE_STATES state, LPCWSTR name,
+	ComPtr<ID3D12Resource> &buffer, ComPtr<ID3D12Resource> &upload_buffer) {
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(size),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&buffer))
+	);
+	buffer->SetName(name);
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(size),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&upload_buffer))
+	);
+
+	D3D12_SUBRESOURCE_DATA subresource_data = {};
+	subresource_data.pData = data;
+	subresource_data.RowPitch = size;
+	subresource_data.SlicePitch = size;
+
+	UpdateSubresources(command_list.Get(), buffer.Get(), upload_buffer.Get(), 0, 0, 1, &subresource_data);
+	command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
+		buffer.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		state
+	));
+}
+
 std::wstring Renderer::GetBinPath(std::wstring shader_file) {
 	WCHAR buffer[MAX_PATH];
 	GetModuleFileName(NULL, buffer, MAX_PATH);
@@ -11,7 +11,6 @@ public:
 	{
 		view_port = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
 		scissor_rect = CD3DX12_RECT(0, 0, static_cast<LONG>(width), static_cast<LONG>(height));
-		vertex_buffer_view = {};
 		fence_value = 0;
 		fence_event = nullptr;
 		aspect_ratio = static_cast<float>(width) / static_cast<float>(height);
@@ -42,6 +41,7 @@ public:
 
 	UINT GetWidth() const { return width; }
 	UINT GetHeight() const { return height; }
+	unsigned int GetCulledDrawCallNumber() const { return culled_draw_call_num; }
 	const WCHAR* GetTitle() const { return title.c_str(); }
 
 protected:
@@ -66,21 +66,53 @@ protected:
 	ComPtr<ID3D12CommandAllocator> command_allocator;
 	ComPtr<ID3D12PipelineState> pipeline_state_color;
 	ComPtr<ID3D12PipelineState> pipeline_state_texture;
+	// Shading after the depth pre-pass: EQUAL depth test without depth writes
+	ComPtr<ID3D12PipelineState> pipeline_state_color_equal;
+	ComPtr<ID3D12PipelineState> pipeline_state_texture_equal;
+	ComPtr<ID3D12PipelineState> pipeline_state_depth;
 	ComPtr<ID3D12GraphicsCommandList> command_list;
 
 	ComPtr<ID3D12RootSignature> root_signature;
 	CD3DX12_VIEWPORT view_port;
 	CD3DX12_RECT scissor_rect;
 
-	// Resources
+	// Resources, one of each per mesh buffer and indexed by DrawCallParams::buffer_id
 	//std::vector<ColorVertex> verteces;
-	ComPtr<ID3D12Resource> vertex_buffer;
-	ComPtr<ID3D12Resource> upload_vertex_buffer;
-	D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view;
-
-	ComPtr<ID3D12Resource> index_buffer;
-	ComPtr<ID3D12Resource> upload_index_buffer;
-	D3D12_INDEX_BUFFER_VIEW index_buffer_view;
+	std::vector<ComPtr<ID3D12Resource>> vertex_buffers;
+	std::vector<ComPtr<ID3D12Resource>> upload_vertex_buffers;
+	std::vector<D3D12_VERTEX_BUFFER_VIEW> vertex_buffer_views;
+
+	std::vector<ComPtr<ID3D12Resource>> index_buffers;
+	std::vector<ComPtr<ID3D12Resource>> upload_index_buffers;
+	std::vector<D3D12_INDEX_BUFFER_VIEW> index_buffer_views;
+
+	std::vector<ComPtr<ID3D12Resource>> short_index_buffers;
+	std::vector<ComPtr<ID3D12Resource>> upload_short_index_buffers;
+	std::vector<D3D12_INDEX_BUFFER_VIEW> short_index_buffer_views;
+
+	// Position only stream of the depth pre-pass
+	std::vector<ComPtr<ID3D12Resource>> position_buffers;
+	std::vector<ComPtr<ID3D12Resource>> upload_position_buffers;
+	std::vector<D3D12_VERTEX_BUFFER_VIEW> position_buffer_views;
+
+	std::vector<ComPtr<ID3D12Resource>> position_index_buffers;
+	std::vector<ComPtr<ID3D12Resource>> upload_position_index_buffers;
+	std::vector<D3D12_INDEX_BUFFER_VIEW> position_index_buffer_views;
+
+	bool depth_prepass = true;
+
+	FrustumCuller frustum_culler;
+	std::vector<uint8_t> draw_call_visibility;
+	bool frustum_culling = true;
+	// Draw calls whose bounding sphere projects smaller than this are culled as well
+	float min_projected_radius_pixels = 1.0f;
+	unsigned int culled_draw_call_num = 0;
+
+	// Level of detail of every draw call, picked each frame from the projected simplification error
+	std::vector<uint8_t> draw_call_lods;
+	bool lod_selection = true;
+	float max_lod_error_pixels = 1.0f;
+	unsigned int submitted_triangle_num = 0;
 
 	std::vector<ComPtr<ID3D12Resource>> textures;
 	std::vector<ComPtr<ID3D12Resource>> upload_textures;
@@ -92,6 +124,10 @@ protected:
 	ComPtr<ID3D12Resource> constant_buffer;
 	UINT8* constant_buffer_data_begin;
 
+	// MaterialConstants of every material, stays mapped so materials can change without touching vertices
+	ComPtr<ID3D12Resource> material_buffer;
+	UINT8* material_buffer_data_begin;
+
 	// Synchronization objects.
 	UINT frame_index;
 	HANDLE fence_event;
@@ -104,6 +140,8 @@ protected:
 	void LoadAssets();
 	void PopulateCommandList();
 	void WaitForPreviousFrame();
+	void UploadBuffer(const void *data, UINT64 size, D3D12_RESOURCE_STATES state, LPCWSTR name,
+		ComPtr<ID3D12Resource> &buffer, ComPtr<ID3D12Resource> &upload_buffer);
 	std::wstring GetBinPath(std::wstring shader_file) const;
 
 	XMMATRIX world;
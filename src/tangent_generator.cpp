@@ -0,0 +1,105 @@
+#include "tangent_generator.h"
+
+#include <cmath>
+#include <vector>
+
+static inline XMFLOAT3 Subtract(const XMFLOAT3 &a, const XMFLOAT3 &b) {
+	return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+static inline float Dot(const XMFLOAT3 &a, const XMFLOAT3 &b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline XMFLOAT3 Cross(const XMFLOAT3 &a, const XMFLOAT3 &b) {
+	return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+static inline XMFLOAT3 Normalize(const XMFLOAT3 &a) {
+	const float length = std::sqrt(Dot(a, a));
+	return (length > 0.0f) ? XMFLOAT3{a.x / length, a.y / length, a.z / length} : XMFLOAT3{0.0f, 0.0f, 0.0f};
+}
+
+// Removes the part of vector along the unit normal
+static inline XMFLOAT3 Project(const XMFLOAT3 &vector, const XMFLOAT3 &normal) {
+	const float along = Dot(vector, normal);
+	return {vector.x - along * normal.x, vector.y - along * normal.y, vector.z - along * normal.z};
+}
+
+void AccumulateTangents(TangentSums *sums, size_t first_vertex, size_t vertex_number, const FullVertex *vertices,
+	const unsigned int *indices, size_t index_number) {
+	for (size_t i = 0; i + 2 < index_number; i += 3) {
+		const unsigned int *triangle = indices + i;
+		if (triangle[0] - first_vertex >= vertex_number && triangle[1] - first_vertex >= vertex_number &&
+			triangle[2] - first_vertex >= vertex_number) {
+			continue;
+		}
+
+		const FullVertex &v0 = vertices[triangle[0]];
+		const FullVertex &v1 = vertices[triangle[1]];
+		const FullVertex &v2 = vertices[triangle[2]];
+		const XMFLOAT3 e1 = Subtract(v1.position, v0.position);
+		const XMFLOAT3 e2 = Subtract(v2.position, v0.position);
+		const float du1 = v1.texcoord.x - v0.texcoord.x;
+		const float dv1 = v1.texcoord.y - v0.texcoord.y;
+		const float du2 = v2.texcoord.x - v0.texcoord.x;
+		const float dv2 = v2.texcoord.y - v0.texcoord.y;
+
+		// Only the direction matters, so the division by the signed texture area becomes its sign
+		const float texture_area = du1 * dv2 - du2 * dv1;
+		if (texture_area == 0.0f) {
+			continue;
+		}
+		const float orientation = (texture_area > 0.0f) ? 1.0f : -1.0f;
+		const XMFLOAT3 face_tangent = {
+			orientation * (e1.x * dv2 - e2.x * dv1),
+			orientation * (e1.y * dv2 - e2.y * dv1),
+			orientation * (e1.z * dv2 - e2.z * dv1)
+		};
+		const XMFLOAT3 face_bitangent = {
+			orientation * (e2.x * du1 - e1.x * du2),
+			orientation * (e2.y * du1 - e1.y * du2),
+			orientation * (e2.z * du1 - e1.z * du2)
+		};
+
+		for (int corner = 0; corner < 3; corner++) {
+			const unsigned int vertex = triangle[corner];
+			if (vertex - first_vertex >= vertex_number) {
+				continue;
+			}
+			const XMFLOAT3 &position = vertices[vertex].position;
+			const XMFLOAT3 normal = Normalize(vertices[vertex].normal);
+			const XMFLOAT3 next = Normalize(Subtract(vertices[triangle[(corner + 1) % 3]].position, position));
+			const XMFLOAT3 previous = Normalize(Subtract(vertices[triangle[(corner + 2) % 3]].position, position));
+			const float angle = std::acos(std::fmax(-1.0f, std::fmin(1.0f, Dot(next, previous))));
+
+			const XMFLOAT3 tangent = Normalize(Project(face_tangent, normal));
+			const XMFLOAT3 bitangent = Normalize(Project(face_bitangent, normal));
+			XMFLOAT3 &tangent_sum = sums[vertex - first_vertex].tangent;
+			XMFLOAT3 &bitangent_sum = sums[vertex - first_vertex].bitangent;
+			tangent_sum = {tangent_sum.x + angle * tangent.x, tangent_sum.y + angle * tangent.y, tangent_sum.z + angle * tangent.z};
+			bitangent_sum = {bitangent_sum.x + angle * bitangent.x, bitangent_sum.y + angle * bitangent.y, bitangent_sum.z + angle * bitangent.z};
+		}
+	}
+}
+
+void ResolveTangents(XMFLOAT4 *tangents, const TangentSums *sums, const FullVertex *vertices, size_t vertex_number) {
+	for (size_t v = 0; v < vertex_number; v++) {
+		const XMFLOAT3 normal = Normalize(vertices[v].normal);
+		XMFLOAT3 tangent = Normalize(Project(sums[v].tangent, normal));
+		if (Dot(tangent, tangent) == 0.0f) {
+			// Any direction in the normal plane, starting from the axis least aligned with the normal
+			const XMFLOAT3 axis = (std::fabs(normal.x) < 0.5f) ? XMFLOAT3{1.0f, 0.0f, 0.0f} : XMFLOAT3{0.0f, 1.0f, 0.0f};
+			tangent = (Dot(normal, normal) > 0.0f) ? Normalize(Project(axis, normal)) : axis;
+		}
+		const float sign = (Dot(Cross(normal, tangent), sums[v].bitangent) < 0.0f) ? -1.0f : 1.0f;
+		tangents[v] = {tangent.x, tangent.y, tangent.z, sign};
+	}
+}
+
+void GenerateTangents(XMFLOAT4 *tangents, const FullVertex *vertices, size_t vertex_number,
+	const unsigned int *indices, size_t index_number) {
+	std::vector<TangentSums> sums(vertex_number, TangentSums{{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}});
+	AccumulateTangents(sums.data(), 0, vertex_number, vertices, indices, index_number);
+	ResolveTangents(tangents, sums.data(), vertices, vertex_number);
+}
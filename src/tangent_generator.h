@@ -0,0 +1,29 @@
+#pragma once
+
+#include "vertex_formats.h"
+
+#include <cstddef>
+
+// Per vertex tangents in the MikkTSpace way: every triangle's texture space
+// tangent and bitangent are projected onto the plane of each corner's vertex
+// normal, normalized and summed weighted by the corner angle. The tangent is
+// orthogonalized against the normal and w holds the bitangent sign, so
+// bitangent = w * cross(normal, tangent). Unlike MikkTSpace vertices are never
+// split; a vertex shared by triangles of opposite texture orientation gets the
+// orientation of the larger angle sum. Vertices without a texture mapping get
+// an arbitrary tangent perpendicular to the normal.
+void GenerateTangents(XMFLOAT4 *tangents, const FullVertex *vertices, size_t vertex_number,
+	const unsigned int *indices, size_t index_number);
+
+// Angle weighted texture space directions around one vertex
+struct TangentSums {
+	XMFLOAT3 tangent;
+	XMFLOAT3 bitangent;
+};
+
+// GenerateTangents in two steps for meshes whose sums do not fit in memory at once.
+// Only corners of the vertices [first_vertex, first_vertex + vertex_number) are
+// added to sums, which ResolveTangents then turns into the tangents of those vertices.
+void AccumulateTangents(TangentSums *sums, size_t first_vertex, size_t vertex_number, const FullVertex *vertices,
+	const unsigned int *indices, size_t index_number);
+void ResolveTangents(XMFLOAT4 *tangents, const TangentSums *sums, const FullVertex *vertices, size_t vertex_number);
@@ -0,0 +1,216 @@
+#include "vertex_conversion.h"
+
+#include <climits>
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define VERTEX_CONVERSION_TARGET_AVX2
+#else
+#define VERTEX_CONVERSION_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static_assert(sizeof(FullVertex) == 8 * sizeof(float), "kernels write FullVertex as eight floats");
+static_assert(sizeof(tinyobj::index_t) == 3 * sizeof(int), "kernels read index_t as three ints");
+
+// Reference kernel, the others must match it bit for bit
+static void ConvertVerticesScalar(FullVertex *destination, const ObjAttributes &attributes, const tinyobj::index_t *keys, size_t key_number) {
+	for (size_t k = 0; k < key_number; k++) {
+		const tinyobj::index_t &idx = keys[k];
+		tinyobj::real_t vx = attributes.vertices[3 * idx.vertex_index + 0];
+		tinyobj::real_t vy = attributes.vertices[3 * idx.vertex_index + 1];
+		tinyobj::real_t vz = -1.0f - attributes.vertices[3 * idx.vertex_index + 2];
+		tinyobj::real_t nx = (idx.normal_index > -1) ? attributes.normals[3 * idx.normal_index + 0] : 0.0f;
+		tinyobj::real_t ny = (idx.normal_index > -1) ? attributes.normals[3 * idx.normal_index + 1] : 0.0f;
+		tinyobj::real_t nz = (idx.normal_index > -1) ? -1.0f * attributes.normals[3 * idx.normal_index + 2] : 0.0f;
+		tinyobj::real_t tu = (idx.texcoord_index > -1) ? attributes.texcoords[2 * idx.texcoord_index + 0] : 0.0f;
+		tinyobj::real_t tv = (idx.texcoord_index > -1) ? 1.0f - attributes.texcoords[2 * idx.texcoord_index + 1] : 0.0f;
+
+		FullVertex &vertex = destination[k];
+		vertex.position = {vx, vy, vz};
+		vertex.normal = {nx, ny, nz};
+		vertex.texcoord = {tu, tv};
+	}
+}
+
+// Four vertices per step: attributes are loaded into SoA registers, converted and
+// transposed back into two 16 byte halves of every vertex
+static void ConvertVerticesSSE2(FullVertex *destination, const ObjAttributes &attributes, const tinyobj::index_t *keys, size_t key_number) {
+	// Missing attributes are read from here instead of branching; -1 * 0 and 1 - 0 are masked back to 0 afterwards
+	static const float missing_attribute[3] = {0.0f, 0.0f, 0.0f};
+	const float *positions = attributes.vertices;
+	const float *normals = attributes.normals;
+	const float *texcoords = attributes.texcoords;
+	const __m128 minus_one = _mm_set1_ps(-1.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128i missing_index = _mm_set1_epi32(-1);
+
+	size_t k = 0;
+	for (; k + 4 <= key_number; k += 4) {
+		const tinyobj::index_t *idx = keys + k;
+		const float *position[4];
+		const float *normal[4];
+		const float *texcoord[4];
+		for (int lane = 0; lane < 4; lane++) {
+			position[lane] = positions + 3 * static_cast<ptrdiff_t>(idx[lane].vertex_index);
+			normal[lane] = (idx[lane].normal_index > -1) ? normals + 3 * static_cast<ptrdiff_t>(idx[lane].normal_index) : missing_attribute;
+			texcoord[lane] = (idx[lane].texcoord_index > -1) ? texcoords + 2 * static_cast<ptrdiff_t>(idx[lane].texcoord_index) : missing_attribute;
+		}
+		const __m128 normal_mask = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_setr_epi32(idx[0].normal_index, idx[1].normal_index,
+			idx[2].normal_index, idx[3].normal_index), missing_index));
+		const __m128 texcoord_mask = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_setr_epi32(idx[0].texcoord_index, idx[1].texcoord_index,
+			idx[2].texcoord_index, idx[3].texcoord_index), missing_index));
+
+		__m128 px = _mm_setr_ps(position[0][0], position[1][0], position[2][0], position[3][0]);
+		__m128 py = _mm_setr_ps(position[0][1], position[1][1], position[2][1], position[3][1]);
+		__m128 pz = _mm_setr_ps(position[0][2], position[1][2], position[2][2], position[3][2]);
+		__m128 nx = _mm_setr_ps(normal[0][0], normal[1][0], normal[2][0], normal[3][0]);
+		__m128 ny = _mm_setr_ps(normal[0][1], normal[1][1], normal[2][1], normal[3][1]);
+		__m128 nz = _mm_setr_ps(normal[0][2], normal[1][2], normal[2][2], normal[3][2]);
+		__m128 tu = _mm_setr_ps(texcoord[0][0], texcoord[1][0], texcoord[2][0], texcoord[3][0]);
+		__m128 tv = _mm_setr_ps(texcoord[0][1], texcoord[1][1], texcoord[2][1], texcoord[3][1]);
+
+		pz = _mm_sub_ps(minus_one, pz);
+		nz = _mm_and_ps(_mm_mul_ps(minus_one, nz), normal_mask);
+		tv = _mm_and_ps(_mm_sub_ps(one, tv), texcoord_mask);
+
+		_MM_TRANSPOSE4_PS(px, py, pz, nx);
+		_MM_TRANSPOSE4_PS(ny, nz, tu, tv);
+		float *vertex = reinterpret_cast<float *>(destination + k);
+		_mm_storeu_ps(vertex + 0, px);
+		_mm_storeu_ps(vertex + 4, ny);
+		_mm_storeu_ps(vertex + 8, py);
+		_mm_storeu_ps(vertex + 12, nz);
+		_mm_storeu_ps(vertex + 16, pz);
+		_mm_storeu_ps(vertex + 20, tu);
+		_mm_storeu_ps(vertex + 24, nx);
+		_mm_storeu_ps(vertex + 28, tv);
+	}
+
+	ConvertVerticesScalar(destination + k, attributes, keys + k, key_number - k);
+}
+
+// Rows become columns; with attributes in rows every output row is one FullVertex
+VERTEX_CONVERSION_TARGET_AVX2 static inline void Transpose8x8(__m256 rows[8]) {
+	const __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+	const __m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+	const __m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+	const __m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+	const __m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]);
+	const __m256 t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+	const __m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]);
+	const __m256 t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+	const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	rows[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	rows[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	rows[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	rows[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	rows[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	rows[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	rows[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	rows[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// Eight vertices per step with hardware gathers: the index triples are gathered
+// apart, attributes are gathered under the masks of present indices, and the
+// 8x8 transpose turns the eight attribute rows into eight vertices
+VERTEX_CONVERSION_TARGET_AVX2 static void ConvertVerticesAVX2(FullVertex *destination, const ObjAttributes &attributes,
+	const tinyobj::index_t *keys, size_t key_number) {
+	const float *positions = attributes.vertices;
+	const float *normals = attributes.normals;
+	const float *texcoords = attributes.texcoords;
+	const __m256i key_offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256i missing_index = _mm256_set1_epi32(-1);
+	const __m256i one_int = _mm256_set1_epi32(1);
+	const __m256i two_int = _mm256_set1_epi32(2);
+	const __m256 minus_one = _mm256_set1_ps(-1.0f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	size_t k = 0;
+	for (; k + 8 <= key_number; k += 8) {
+		const int *key_ints = reinterpret_cast<const int *>(keys + k);
+		const __m256i vertex_index = _mm256_i32gather_epi32(key_ints, key_offsets, 4);
+		const __m256i normal_index = _mm256_i32gather_epi32(key_ints + 1, key_offsets, 4);
+		const __m256i texcoord_index = _mm256_i32gather_epi32(key_ints + 2, key_offsets, 4);
+		const __m256 normal_mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(normal_index, missing_index));
+		const __m256 texcoord_mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(texcoord_index, missing_index));
+
+		const __m256i position_offset = _mm256_add_epi32(_mm256_add_epi32(vertex_index, vertex_index), vertex_index);
+		const __m256i normal_offset = _mm256_add_epi32(_mm256_add_epi32(normal_index, normal_index), normal_index);
+		const __m256i texcoord_offset = _mm256_add_epi32(texcoord_index, texcoord_index);
+
+		__m256 rows[8];
+		rows[0] = _mm256_i32gather_ps(positions, position_offset, 4);
+		rows[1] = _mm256_i32gather_ps(positions, _mm256_add_epi32(position_offset, one_int), 4);
+		rows[2] = _mm256_sub_ps(minus_one, _mm256_i32gather_ps(positions, _mm256_add_epi32(position_offset, two_int), 4));
+		rows[3] = _mm256_mask_i32gather_ps(zero, normals, normal_offset, normal_mask, 4);
+		rows[4] = _mm256_mask_i32gather_ps(zero, normals, _mm256_add_epi32(normal_offset, one_int), normal_mask, 4);
+		rows[5] = _mm256_and_ps(_mm256_mul_ps(minus_one, _mm256_mask_i32gather_ps(zero, normals,
+			_mm256_add_epi32(normal_offset, two_int), normal_mask, 4)), normal_mask);
+		rows[6] = _mm256_mask_i32gather_ps(zero, texcoords, texcoord_offset, texcoord_mask, 4);
+		rows[7] = _mm256_and_ps(_mm256_sub_ps(one, _mm256_mask_i32gather_ps(zero, texcoords,
+			_mm256_add_epi32(texcoord_offset, one_int), texcoord_mask, 4)), texcoord_mask);
+
+		Transpose8x8(rows);
+		float *vertex = reinterpret_cast<float *>(destination + k);
+		for (int lane = 0; lane < 8; lane++) {
+			_mm256_storeu_ps(vertex + 8 * lane, rows[lane]);
+		}
+	}
+
+	ConvertVerticesScalar(destination + k, attributes, keys + k, key_number - k);
+}
+
+static bool HasAVX2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	// The OS has to save YMM registers as well
+	__cpuid(info, 1);
+	const bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	__cpuidex(info, 7, 0);
+	return os_avx && (info[1] & (1 << 5));
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+VertexConversionKernel GetVertexConversionKernel() {
+	static const VertexConversionKernel kernel = HasAVX2() ? VERTEX_CONVERSION_AVX2 : VERTEX_CONVERSION_SSE2;
+	return kernel;
+}
+
+ObjAttributes GetObjAttributes(const tinyobj::attrib_t &attrib) {
+	return {attrib.vertices.data(), attrib.vertices.size() / 3, attrib.normals.data(), attrib.normals.size() / 3,
+		attrib.texcoords.data(), attrib.texcoords.size() / 2};
+}
+
+void ConvertVertices(FullVertex *destination, const ObjAttributes &attributes, const tinyobj::index_t *keys,
+	size_t key_number, VertexConversionKernel kernel) {
+	// Gather offsets are 32-bit element numbers
+	const bool gather_offsets_fit = attributes.vertex_number <= INT_MAX / 3 && attributes.normal_number <= INT_MAX / 3 &&
+		attributes.texcoord_number <= INT_MAX / 2;
+	if (kernel == VERTEX_CONVERSION_AVX2 && gather_offsets_fit) {
+		ConvertVerticesAVX2(destination, attributes, keys, key_number);
+	} else if (kernel != VERTEX_CONVERSION_SCALAR) {
+		ConvertVerticesSSE2(destination, attributes, keys, key_number);
+	} else {
+		ConvertVerticesScalar(destination, attributes, keys, key_number);
+	}
+}
+
+void ConvertVertices(FullVertex *destination, const tinyobj::attrib_t &attrib, const tinyobj::index_t *keys,
+	size_t key_number, VertexConversionKernel kernel) {
+	ConvertVertices(destination, GetObjAttributes(attrib), keys, key_number, kernel);
+}
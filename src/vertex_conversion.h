@@ -0,0 +1,35 @@
+#pragma once
+
+#include "vertex_formats.h"
+#include "tiny_obj_loader.h"
+
+#include <cstddef>
+
+enum VertexConversionKernel {
+	VERTEX_CONVERSION_SCALAR,
+	VERTEX_CONVERSION_SSE2,
+	VERTEX_CONVERSION_AVX2,
+};
+
+// Widest kernel the CPU supports
+VertexConversionKernel GetVertexConversionKernel();
+
+// Attribute arrays of an OBJ, from a tinyobj::attrib_t or from mapped files
+struct ObjAttributes {
+	const float *vertices;
+	size_t vertex_number;
+	const float *normals;
+	size_t normal_number;
+	const float *texcoords;
+	size_t texcoord_number;
+};
+
+ObjAttributes GetObjAttributes(const tinyobj::attrib_t &attrib);
+
+// Builds a FullVertex for every OBJ index triple: z and the normal z are flipped
+// to the left-handed space, v is flipped, and missing normals and texcoords
+// become zeros. All kernels produce bit identical results.
+void ConvertVertices(FullVertex *destination, const ObjAttributes &attributes, const tinyobj::index_t *keys,
+	size_t key_number, VertexConversionKernel kernel = GetVertexConversionKernel());
+void ConvertVertices(FullVertex *destination, const tinyobj::attrib_t &attrib, const tinyobj::index_t *keys,
+	size_t key_number, VertexConversionKernel kernel = GetVertexConversionKernel());
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "platform.h"
+
+#include <cstdint>
+
+// Material parameters live in MaterialConstants, indexed per draw call
+struct FullVertex {
+	XMFLOAT3 position;
+	XMFLOAT3 normal;
+	XMFLOAT2 texcoord;
+};
+
+// Compact FullVertex, see vertex_packing.h
+struct PackedVertex {
+	// Unorm16 within the mesh bounds, w is always 1
+	uint16_t position[4];
+	// Octahedral snorm16
+	int16_t normal[2];
+	// Half floats
+	uint16_t texcoord[2];
+};
+
+// Tangent frame next to the vertex normal, see PackTangent
+struct PackedTangent {
+	// Octahedral tangent: x is snorm16, y is stored in 14 bits as [1, 16383] with
+	// the sign of the bitangent, so a snorm16 read gives sign(y) and
+	// v = (|y| * 32767 - 1) / 16382 * 2 - 1
+	int16_t tangent[2];
+};
+
+// Element of the material structured buffer
+struct MaterialConstants {
+	XMFLOAT4 diffuse;
+};
@@ -0,0 +1,64 @@
+#include "vertex_index_map.h"
+
+VertexIndexMap::VertexIndexMap(size_t expected_size) {
+	Reserve(expected_size);
+}
+
+void VertexIndexMap::Reserve(size_t expected_size) {
+	size_t group_number = GetGroupNumber(expected_size);
+	if (control.empty() || group_number > group_mask + 1) {
+		Rehash(group_number);
+	}
+}
+
+void VertexIndexMap::Clear() {
+	control.assign(control.size(), empty_control);
+	size = 0;
+	growth_left = control.size() - control.size() / 8;
+}
+
+void VertexIndexMap::Reset(size_t expected_size) {
+	// Clearing a table much larger than needed costs more than a new one
+	size_t group_number = GetGroupNumber(expected_size);
+	if (control.empty() || group_number > group_mask + 1 || 4 * group_number < group_mask + 1) {
+		control.assign(group_number * group_width, empty_control);
+		slots.resize(group_number * group_width);
+		slots.shrink_to_fit();
+		control.shrink_to_fit();
+		group_mask = group_number - 1;
+		size = 0;
+		growth_left = control.size() - control.size() / 8;
+	} else {
+		Clear();
+	}
+}
+
+size_t VertexIndexMap::GetGroupNumber(size_t expected_size) {
+	// Keep the load factor under 7/8
+	size_t required_slots = expected_size + expected_size / 7 + 1;
+	size_t group_number = 1;
+	while (group_number * group_width < required_slots) {
+		group_number *= 2;
+	}
+	return group_number;
+}
+
+void VertexIndexMap::Rehash(size_t group_number) {
+	std::vector<int8_t> old_control(group_number * group_width, empty_control);
+	std::vector<Slot> old_slots(group_number * group_width);
+	old_control.swap(control);
+	old_slots.swap(slots);
+
+	group_mask = group_number - 1;
+	size = 0;
+	growth_left = control.size() - control.size() / 8;
+
+	bool inserted;
+	for (size_t slot_id = 0; slot_id < old_control.size(); slot_id++) {
+		if (old_control[slot_id] != empty_control) {
+			const Slot &slot = old_slots[slot_id];
+			tinyobj::index_t key = {slot.vertex_index, slot.normal_index, slot.texcoord_index};
+			FindOrInsert(key, slot.value, inserted);
+		}
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "tiny_obj_loader.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Flat open addressing map from an OBJ (vertex, normal, texcoord) index triple
+// to the deduplicated vertex number. Slots are grouped by 16 and every group has
+// a row of control bytes (empty marker or 7 bits of the hash) which is probed
+// with one SSE2 compare, so a lookup usually touches two cache lines.
+class VertexIndexMap {
+public:
+	VertexIndexMap() = default;
+	explicit VertexIndexMap(size_t expected_size);
+
+	// Allocate enough groups to hold expected_size keys without rehashing
+	void Reserve(size_t expected_size);
+	void Clear();
+	// Clear and resize for expected_size keys, reusing the storage when it fits
+	void Reset(size_t expected_size);
+
+	size_t Size() const { return size; }
+
+	// Returns the value stored for key. If key is absent, new_value is stored
+	// and returned, and inserted is set to true.
+	unsigned int FindOrInsert(const tinyobj::index_t &key, unsigned int new_value, bool &inserted);
+
+protected:
+	struct Slot {
+		int vertex_index;
+		int normal_index;
+		int texcoord_index;
+		unsigned int value;
+	};
+
+	static constexpr size_t group_width = 16;
+	static constexpr int8_t empty_control = -128;
+
+	std::vector<int8_t> control;
+	std::vector<Slot> slots;
+	size_t group_mask = 0;
+	size_t size = 0;
+	size_t growth_left = 0;
+
+	void Rehash(size_t group_number);
+
+	static size_t GetGroupNumber(size_t expected_size);
+
+	static uint64_t Hash(const tinyobj::index_t &key);
+	static unsigned int FirstBit(unsigned int mask);
+};
+
+inline uint64_t VertexIndexMap::Hash(const tinyobj::index_t &key) {
+	uint64_t h = static_cast<uint32_t>(key.vertex_index) * 0x9E3779B97F4A7C15ull;
+	h ^= static_cast<uint32_t>(key.normal_index) * 0xC2B2AE3D27D4EB4Full;
+	h ^= static_cast<uint32_t>(key.texcoord_index) * 0x165667B19E3779F9ull;
+	h ^= h >> 29;
+	h *= 0xBF58476D1CE4E5B9ull;
+	h ^= h >> 32;
+	return h;
+}
+
+inline unsigned int VertexIndexMap::FirstBit(unsigned int mask) {
+#ifdef _MSC_VER
+	unsigned long bit;
+	_BitScanForward(&bit, mask);
+	return static_cast<unsigned int>(bit);
+#else
+	return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+inline unsigned int VertexIndexMap::FindOrInsert(const tinyobj::index_t &key, unsigned int new_value, bool &inserted) {
+	if (growth_left == 0) {
+		Rehash(control.empty() ? 1 : 2 * (group_mask + 1));
+	}
+
+	const uint64_t hash = Hash(key);
+	const int8_t tag = static_cast<int8_t>(hash & 0x7f);
+	const __m128i tag_vector = _mm_set1_epi8(tag);
+
+	size_t group = static_cast<size_t>(hash >> 7) & group_mask;
+	for (size_t step = 1;; step++) {
+		const int8_t *group_control = control.data() + group * group_width;
+		const __m128i control_vector = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group_control));
+
+		unsigned int match = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(control_vector, tag_vector)));
+		while (match != 0) {
+			const size_t slot_id = group * group_width + FirstBit(match);
+			const Slot &slot = slots[slot_id];
+			if (slot.vertex_index == key.vertex_index &&
+				slot.normal_index == key.normal_index &&
+				slot.texcoord_index == key.texcoord_index) {
+				inserted = false;
+				return slot.value;
+			}
+			match &= match - 1;
+		}
+
+		// Only the empty marker has the sign bit set, and nothing is ever erased,
+		// so the first empty slot in the probe sequence ends the search
+		const unsigned int empty = static_cast<unsigned int>(_mm_movemask_epi8(control_vector));
+		if (empty != 0) {
+			const size_t slot_id = group * group_width + FirstBit(empty);
+			control[slot_id] = tag;
+			slots[slot_id] = {key.vertex_index, key.normal_index, key.texcoord_index, new_value};
+			size++;
+			growth_left--;
+			inserted = true;
+			return new_value;
+		}
+
+		// Triangular probing visits every group of a power of two table
+		group = (group + step) & group_mask;
+	}
+}
@@ -0,0 +1,194 @@
+#include "vertex_packing.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX::PackedVector;
+
+static const float unorm16_max = 65535.0f;
+static const float snorm16_max = 32767.0f;
+// Steps of the octahedral v of a tangent, the sign of the bitangent takes the remaining bit
+static const float tangent_v_steps = 16382.0f;
+
+static inline float SignNotZero(float value) {
+	return (value >= 0.0f) ? 1.0f : -1.0f;
+}
+
+static inline uint16_t QuantizeUnorm16(float value) {
+	return static_cast<uint16_t>(std::clamp(value, 0.0f, 1.0f) * unorm16_max + 0.5f);
+}
+
+static inline int16_t QuantizeSnorm16(float value) {
+	return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * snorm16_max));
+}
+
+static inline float DequantizeSnorm16(int16_t value) {
+	// Both -32768 and -32767 map to -1 like the DXGI snorm conversion
+	return std::max(value / snorm16_max, -1.0f);
+}
+
+// Project the vector onto the octahedron and fold the lower half over the upper one
+static void EncodeOctahedral(const XMFLOAT3 &vector, float &u, float &v) {
+	const float length = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+	u = 0.0f;
+	v = 0.0f;
+	if (length > 0.0f) {
+		u = vector.x / length;
+		v = vector.y / length;
+		if (vector.z < 0.0f) {
+			const float folded_u = (1.0f - std::abs(v)) * SignNotZero(u);
+			const float folded_v = (1.0f - std::abs(u)) * SignNotZero(v);
+			u = folded_u;
+			v = folded_v;
+		}
+	}
+}
+
+static XMFLOAT3 DecodeOctahedral(float x, float y) {
+	const float z = 1.0f - std::abs(x) - std::abs(y);
+	const float fold = std::max(-z, 0.0f);
+	x += (x >= 0.0f) ? -fold : fold;
+	y += (y >= 0.0f) ? -fold : fold;
+	const float length = std::sqrt(x * x + y * y + z * z);
+	return {x / length, y / length, z / length};
+}
+
+// Rounding u and v separately can miss the closest code by a few hundredths of a degree,
+// so the four codes around the projection are decoded and the closest one is kept
+static void QuantizeOctahedral(const XMFLOAT3 &vector, int16_t &x, int16_t &y) {
+	float u;
+	float v;
+	EncodeOctahedral(vector, u, v);
+	x = QuantizeSnorm16(u);
+	y = QuantizeSnorm16(v);
+	if (u == 0.0f && v == 0.0f) {
+		return;
+	}
+
+	const float base_x = std::floor(std::clamp(u, -1.0f, 1.0f) * snorm16_max);
+	const float base_y = std::floor(std::clamp(v, -1.0f, 1.0f) * snorm16_max);
+	float best_cosine = -2.0f;
+	for (int corner = 0; corner < 4; corner++) {
+		const float code_x = std::min(base_x + (corner & 1), snorm16_max);
+		const float code_y = std::min(base_y + (corner >> 1), snorm16_max);
+		const XMFLOAT3 decoded = DecodeOctahedral(code_x / snorm16_max, code_y / snorm16_max);
+		const float cosine = decoded.x * vector.x + decoded.y * vector.y + decoded.z * vector.z;
+		if (cosine > best_cosine) {
+			best_cosine = cosine;
+			x = static_cast<int16_t>(code_x);
+			y = static_cast<int16_t>(code_y);
+		}
+	}
+}
+
+VertexQuantization ComputeVertexQuantization(const FullVertex *vertices, size_t vertex_number) {
+	VertexQuantization quantization = {};
+	quantization.position_scale = {1.0f, 1.0f, 1.0f, 0.0f};
+	if (vertex_number == 0) {
+		return quantization;
+	}
+
+	XMFLOAT3 min_corner = vertices[0].position;
+	XMFLOAT3 max_corner = vertices[0].position;
+	for (size_t v = 1; v < vertex_number; v++) {
+		const XMFLOAT3 &position = vertices[v].position;
+		min_corner = {std::min(min_corner.x, position.x), std::min(min_corner.y, position.y), std::min(min_corner.z, position.z)};
+		max_corner = {std::max(max_corner.x, position.x), std::max(max_corner.y, position.y), std::max(max_corner.z, position.z)};
+	}
+
+	// A flat axis still gets a non zero scale, so encoding never divides by zero
+	const float extent[3] = {max_corner.x - min_corner.x, max_corner.y - min_corner.y, max_corner.z - min_corner.z};
+	quantization.position_offset = {min_corner.x, min_corner.y, min_corner.z, 0.0f};
+	quantization.position_scale = {
+		extent[0] > 0.0f ? extent[0] : 1.0f,
+		extent[1] > 0.0f ? extent[1] : 1.0f,
+		extent[2] > 0.0f ? extent[2] : 1.0f,
+		0.0f
+	};
+	return quantization;
+}
+
+PackedVertex PackVertex(const FullVertex &vertex, const VertexQuantization &quantization) {
+	PackedVertex packed = {};
+
+	const XMFLOAT4 &offset = quantization.position_offset;
+	const XMFLOAT4 &scale = quantization.position_scale;
+	packed.position[0] = QuantizeUnorm16((vertex.position.x - offset.x) / scale.x);
+	packed.position[1] = QuantizeUnorm16((vertex.position.y - offset.y) / scale.y);
+	packed.position[2] = QuantizeUnorm16((vertex.position.z - offset.z) / scale.z);
+	packed.position[3] = static_cast<uint16_t>(unorm16_max);
+
+	QuantizeOctahedral(vertex.normal, packed.normal[0], packed.normal[1]);
+
+	packed.texcoord[0] = XMConvertFloatToHalf(vertex.texcoord.x);
+	packed.texcoord[1] = XMConvertFloatToHalf(vertex.texcoord.y);
+	return packed;
+}
+
+FullVertex UnpackVertex(const PackedVertex &packed, const VertexQuantization &quantization) {
+	FullVertex vertex = {};
+
+	const XMFLOAT4 &offset = quantization.position_offset;
+	const XMFLOAT4 &scale = quantization.position_scale;
+	vertex.position = {
+		offset.x + scale.x * (packed.position[0] / unorm16_max),
+		offset.y + scale.y * (packed.position[1] / unorm16_max),
+		offset.z + scale.z * (packed.position[2] / unorm16_max)
+	};
+
+	vertex.normal = DecodeOctahedral(DequantizeSnorm16(packed.normal[0]), DequantizeSnorm16(packed.normal[1]));
+
+	vertex.texcoord = {XMConvertHalfToFloat(packed.texcoord[0]), XMConvertHalfToFloat(packed.texcoord[1])};
+	return vertex;
+}
+
+void PackVertices(PackedVertex *destination, const FullVertex *vertices, size_t vertex_number,
+	const VertexQuantization &quantization) {
+	for (size_t v = 0; v < vertex_number; v++) {
+		destination[v] = PackVertex(vertices[v], quantization);
+	}
+}
+
+VertexPackingError MeasureVertexPackingError(const FullVertex *vertices, const PackedVertex *packed_vertices,
+	size_t vertex_number, const VertexQuantization &quantization) {
+	VertexPackingError error = {};
+	for (size_t v = 0; v < vertex_number; v++) {
+		const FullVertex &vertex = vertices[v];
+		const FullVertex unpacked = UnpackVertex(packed_vertices[v], quantization);
+
+		error.position = std::max({error.position,
+			std::abs(vertex.position.x - unpacked.position.x),
+			std::abs(vertex.position.y - unpacked.position.y),
+			std::abs(vertex.position.z - unpacked.position.z)});
+
+		const float normal_length = std::sqrt(vertex.normal.x * vertex.normal.x + vertex.normal.y * vertex.normal.y + vertex.normal.z * vertex.normal.z);
+		if (normal_length > 0.0f) {
+			const float cosine = (vertex.normal.x * unpacked.normal.x + vertex.normal.y * unpacked.normal.y + vertex.normal.z * unpacked.normal.z) / normal_length;
+			error.normal_degrees = std::max(error.normal_degrees, std::acos(std::clamp(cosine, -1.0f, 1.0f)) * 180.0f / XM_PI);
+		}
+
+		error.texcoord = std::max({error.texcoord,
+			std::abs(vertex.texcoord.x - unpacked.texcoord.x),
+			std::abs(vertex.texcoord.y - unpacked.texcoord.y)});
+	}
+	return error;
+}
+
+PackedTangent PackTangent(const XMFLOAT4 &tangent) {
+	float u;
+	float v;
+	EncodeOctahedral({tangent.x, tangent.y, tangent.z}, u, v);
+
+	// The second component is [1, tangent_v_steps + 1] with the sign of w, so it is never 0
+	PackedTangent packed = {};
+	packed.tangent[0] = QuantizeSnorm16(u);
+	const int v_step = static_cast<int>(std::round((std::clamp(v, -1.0f, 1.0f) * 0.5f + 0.5f) * tangent_v_steps)) + 1;
+	packed.tangent[1] = static_cast<int16_t>((tangent.w < 0.0f) ? -v_step : v_step);
+	return packed;
+}
+
+XMFLOAT4 UnpackTangent(const PackedTangent &packed) {
+	const float v = (std::abs(packed.tangent[1]) - 1) / tangent_v_steps * 2.0f - 1.0f;
+	const XMFLOAT3 tangent = DecodeOctahedral(DequantizeSnorm16(packed.tangent[0]), v);
+	return {tangent.x, tangent.y, tangent.z, (packed.tangent[1] < 0) ? -1.0f : 1.0f};
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vertex_formats.h"
+
+#include <cstddef>
+
+// Maps unorm16 positions back to the mesh bounds: position = offset + scale * unorm,
+// with unorm in [0, 1] like the input assembler delivers it
+struct VertexQuantization {
+	XMFLOAT4 position_offset;
+	XMFLOAT4 position_scale;
+};
+
+// Largest differences between vertices and their packed round trip
+struct VertexPackingError {
+	float position;
+	float normal_degrees;
+	float texcoord;
+};
+
+VertexQuantization ComputeVertexQuantization(const FullVertex *vertices, size_t vertex_number);
+
+// Zero normals have no octahedral encoding and come back as +Z
+PackedVertex PackVertex(const FullVertex &vertex, const VertexQuantization &quantization);
+// CPU mirror of the decode in shaders.hlsl
+FullVertex UnpackVertex(const PackedVertex &vertex, const VertexQuantization &quantization);
+
+void PackVertices(PackedVertex *destination, const FullVertex *vertices, size_t vertex_number,
+	const VertexQuantization &quantization);
+
+VertexPackingError MeasureVertexPackingError(const FullVertex *vertices, const PackedVertex *packed_vertices,
+	size_t vertex_number, const VertexQuantization &quantization);
+
+// Tangent xyz with the bitangent sign in w: bitangent = w * cross(normal, tangent)
+PackedTangent PackTangent(const XMFLOAT4 &tangent);
+XMFLOAT4 UnpackTangent(const PackedTangent &tangent);